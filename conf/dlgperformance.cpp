@@ -28,6 +28,10 @@ DlgPerformance::DlgPerformance( QWidget * parent )
 //     m_dlg->memoryLabel->setPixmap( BarIcon( "kcmmemory", 32 ) ); // TODO: enable again when proper icon is available
 
     connect( m_dlg->kcfg_MemoryLevel, SIGNAL(changed(int)), this, SLOT(radioGroup_changed(int)) );
+
+    // the previews are rendered only in background
+    m_dlg->kcfg_ProgressiveRendering->setEnabled( m_dlg->kcfg_EnableThreading->isChecked() );
+    connect( m_dlg->kcfg_EnableThreading, SIGNAL(toggled(bool)), m_dlg->kcfg_ProgressiveRendering, SLOT(setEnabled(bool)) );
 }
 
 DlgPerformance::~DlgPerformance()
@@ -0,0 +1,69 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "accountedcache.h"
+
+#include <QtCore/QMutexLocker>
+
+#include "generator.h"
+#include "generator_p.h"
+
+using namespace Okular;
+
+AccountedCache::AccountedCache( Generator *generator )
+    : m_generator( generator )
+{
+    if ( !m_generator )
+        return;
+
+    GeneratorPrivate *d = m_generator->d_func();
+    QMutexLocker locker( &d->mAccountedCachesMutex );
+    d->mAccountedCaches.append( this );
+}
+
+AccountedCache::~AccountedCache()
+{
+    if ( !m_generator )
+        return;
+
+    GeneratorPrivate *d = m_generator->d_func();
+    QMutexLocker locker( &d->mAccountedCachesMutex );
+    d->mAccountedCaches.removeAll( this );
+}
+
+qulonglong AccountedCache::totalMemoryUsage( const Generator *generator )
+{
+    if ( !generator )
+        return 0;
+
+    const GeneratorPrivate *d = generator->d_func();
+    QMutexLocker locker( &d->mAccountedCachesMutex );
+    qulonglong memory = 0;
+    foreach ( const AccountedCache *cache, d->mAccountedCaches )
+        memory += cache->memoryUsage();
+    return memory;
+}
+
+qulonglong AccountedCache::shrinkAll( Generator *generator, qulonglong bytes )
+{
+    if ( !generator )
+        return 0;
+
+    GeneratorPrivate *d = generator->d_func();
+    QMutexLocker locker( &d->mAccountedCachesMutex );
+    qulonglong freed = 0;
+    foreach ( AccountedCache *cache, d->mAccountedCaches )
+    {
+        if ( freed >= bytes )
+            break;
+
+        freed += cache->shrink( bytes - freed );
+    }
+    return freed;
+}
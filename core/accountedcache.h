@@ -0,0 +1,83 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef _OKULAR_ACCOUNTEDCACHE_H_
+#define _OKULAR_ACCOUNTEDCACHE_H_
+
+#include <QtCore/QtGlobal>
+
+#include "okular_export.h"
+
+namespace Okular {
+
+class Generator;
+
+/**
+ * @short A cache of a generator, accounted in the memory budget of the document.
+ *
+ * The Document frees the memory of the pixmaps according to the memory level
+ * chosen by the user, but it knows nothing about what the generators keep for
+ * themselves (decoded pages, rendered images, and so on). Caches of that kind
+ * should derive from this class: while they exist, their memory is counted
+ * along with the pixmaps, and when memory has to be freed they are asked to
+ * shrink() before any pixmap is dropped, as their contents can be rebuilt.
+ *
+ * A cache registers itself with its generator when created and unregisters
+ * when destroyed, so it is accounted only for the document of the generator.
+ * memoryUsage() and shrink() are called in the thread of the document, so
+ * they have to be thread safe if the cache is used by a generator running in
+ * other threads.
+ *
+ * @since 0.15 (KDE 4.9)
+ */
+class OKULAR_EXPORT AccountedCache
+{
+    public:
+        /**
+         * Creates a cache of the @p generator, registering it; a cache without
+         * a generator is not accounted.
+         */
+        explicit AccountedCache( Generator *generator );
+
+        /**
+         * Destroys the cache, unregistering it.
+         */
+        virtual ~AccountedCache();
+
+        /**
+         * Returns the memory used by the cache, in bytes.
+         */
+        virtual qulonglong memoryUsage() const = 0;
+
+        /**
+         * Frees about @p bytes of memory, dropping the least valuable contents
+         * first, and returns the memory actually freed.
+         */
+        virtual qulonglong shrink( qulonglong bytes ) = 0;
+
+        /**
+         * Returns the memory used by the caches of the @p generator, in bytes.
+         */
+        static qulonglong totalMemoryUsage( const Generator *generator );
+
+        /**
+         * Asks the caches of the @p generator to free about @p bytes of memory
+         * overall, in the order they were created, and returns the memory freed.
+         */
+        static qulonglong shrinkAll( Generator *generator, qulonglong bytes );
+
+    private:
+        Generator * const m_generator;
+
+        Q_DISABLE_COPY( AccountedCache )
+};
+
+}
+
+#endif
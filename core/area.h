@@ -11,6 +11,7 @@
 #define _OKULAR_AREA_H_
 
 #include <QtCore/QList>
+#include <QtCore/QMetaType>
 #include <QtGui/QColor>
 #include <QtGui/QPainterPath>
 #include <kdebug.h>
@@ -860,6 +861,8 @@ class HighlightAreaRect : public RegularAreaRect
 
 }
 
+Q_DECLARE_METATYPE( Okular::NormalizedRect )
+
 #ifndef QT_NO_DEBUG_STREAM
 /**
  * Debug operator for normalized @p point.
@@ -22,14 +22,17 @@
 
 // qt/kde/system includes
 #include <QtCore/QtAlgorithms>
+#include <QtCore/QBitArray>
 #include <QtCore/QDir>
 #include <QtCore/QFile>
 #include <QtCore/QFileInfo>
 #include <QtCore/QMap>
 #include <QtCore/QTextStream>
+#include <QtCore/QThread>
 #include <QtCore/QTimer>
 #include <QtGui/QApplication>
 #include <QtGui/QLabel>
+#include <QtGui/QPixmap>
 #include <QtGui/QPrinter>
 #include <QtGui/QPrintDialog>
 
@@ -51,7 +54,10 @@
 #include <ktoolinvocation.h>
 #include <kzip.h>
 
+#include <stdlib.h>
+
 // local includes
+#include "accountedcache.h"
 #include "action.h"
 #include "annotations.h"
 #include "annotations_p.h"
@@ -70,11 +76,14 @@
 #include "page.h"
 #include "page_p.h"
 #include "pagecontroller_p.h"
+#include "pixmapdiskcache_p.h"
 #include "scripter.h"
 #include "settings.h"
 #include "sourcereference.h"
 #include "sourcereference_p.h"
 #include "texteditors_p.h"
+#include "textindex_p.h"
+#include "tilesmanager_p.h"
 #include "utils_p.h"
 #include "view.h"
 #include "view_p.h"
@@ -85,16 +94,6 @@
 
 using namespace Okular;
 
-struct AllocatedPixmap
-{
-    // owner of the page
-    int id;
-    int page;
-    qulonglong memory;
-    // public constructor: initialize data
-    AllocatedPixmap( int i, int p, qulonglong m ) : id( i ), page( p ), memory( m ) {}
-};
-
 struct ArchiveData
 {
     ArchiveData()
@@ -120,6 +119,10 @@ struct RunningSearch
     bool cachedNoDialogs : 1;
     bool isCurrentlySearching : 1;
     QColor cachedColor;
+
+    // the pages which may match the search according to the text index
+    // (all of them if empty)
+    QBitArray candidatePages;
 };
 
 #define foreachObserver( cmd ) {\
@@ -132,6 +135,11 @@ struct RunningSearch
 
 #define OKULAR_HISTORY_MAXSTEPS 100
 #define OKULAR_HISTORY_SAVEDSTEPS 10
+// pages estimated to take longer than this (in milliseconds) are rendered
+// in two passes, a smaller preview first, if so configured
+#define OKULAR_SLOW_RENDER_MSECS 300
+// the preview is this many times smaller than the page in each direction
+#define OKULAR_PREVIEW_SCALE 4
 
 /***** Document ******/
 
@@ -175,34 +183,41 @@ QString DocumentPrivate::localizedSize(const QSizeF &size) const
 
 void DocumentPrivate::cleanupPixmapMemory( qulonglong /*sure? bytesOffset*/ )
 {
-    // [MEM] choose memory parameters based on configuration profile
+    // [MEM] choose memory parameters based on configuration profile; the
+    // caches of the generators count as well
+    const qulonglong cachesMemory = AccountedCache::totalMemoryUsage( m_generator );
+    const qulonglong allocatedMemory = m_pixmapCache.totalMemory() + cachesMemory;
     qulonglong clipValue = 0;
     qulonglong memoryToFree = 0;
+    qulonglong memoryAllowance = 0;
     switch ( Settings::memoryLevel() )
     {
         case Settings::EnumMemoryLevel::Low:
-            memoryToFree = m_allocatedPixmapsTotalMemory;
+            memoryToFree = allocatedMemory;
             break;
 
         case Settings::EnumMemoryLevel::Normal:
         {
             qulonglong thirdTotalMemory = getTotalMemory() / 3;
             qulonglong freeMemory = getFreeMemory();
-            if (m_allocatedPixmapsTotalMemory > thirdTotalMemory) memoryToFree = m_allocatedPixmapsTotalMemory - thirdTotalMemory;
-            if (m_allocatedPixmapsTotalMemory > freeMemory) clipValue = (m_allocatedPixmapsTotalMemory - freeMemory) / 2;
+            if (allocatedMemory > thirdTotalMemory) memoryToFree = allocatedMemory - thirdTotalMemory;
+            if (allocatedMemory > freeMemory) clipValue = (allocatedMemory - freeMemory) / 2;
+            memoryAllowance = thirdTotalMemory;
         }
         break;
 
         case Settings::EnumMemoryLevel::Aggressive:
         {
             qulonglong freeMemory = getFreeMemory();
-            if (m_allocatedPixmapsTotalMemory > freeMemory) clipValue = (m_allocatedPixmapsTotalMemory - freeMemory) / 2;
+            if (allocatedMemory > freeMemory) clipValue = (allocatedMemory - freeMemory) / 2;
+            memoryAllowance = getTotalMemory() / 2;
         }
         break;
         case Settings::EnumMemoryLevel::Greedy:
         {
             const qulonglong memoryLimit = qMax(getFreeMemory(), getTotalMemory() / 2);
-            if (m_allocatedPixmapsTotalMemory > memoryLimit) clipValue = (m_allocatedPixmapsTotalMemory - memoryLimit) / 2;
+            if (allocatedMemory > memoryLimit) clipValue = (allocatedMemory - memoryLimit) / 2;
+            memoryAllowance = memoryLimit;
         }
         break;
     }
@@ -210,31 +225,20 @@ void DocumentPrivate::cleanupPixmapMemory( qulonglong /*sure? bytesOffset*/ )
     if ( clipValue > memoryToFree )
         memoryToFree = clipValue;
 
-    if ( memoryToFree > 0 )
-    {
-        // [MEM] free memory starting from older pixmaps
-        int pagesFreed = 0;
-        QLinkedList< AllocatedPixmap * >::iterator pIt = m_allocatedPixmapsFifo.begin();
-        QLinkedList< AllocatedPixmap * >::iterator pEnd = m_allocatedPixmapsFifo.end();
-        while ( (pIt != pEnd) && (memoryToFree > 0) )
-        {
-            AllocatedPixmap * p = *pIt;
-            if ( m_observers.value( p->id )->canUnloadPixmap( p->page ) )
-            {
-                // update internal variables
-                pIt = m_allocatedPixmapsFifo.erase( pIt );
-                m_allocatedPixmapsTotalMemory -= p->memory;
-                memoryToFree -= p->memory;
-                pagesFreed++;
-                // delete pixmap
-                m_pagesVector.at( p->page )->deletePixmap( p->id );
-                // delete allocation descriptor
-                delete p;
-            } else
-                ++pIt;
-        }
-        //p--rintf("freeMemory A:[%d -%d = %d] \n", m_allocatedPixmapsFifo.count() + pagesFreed, pagesFreed, m_allocatedPixmapsFifo.count() );
-    }
+    // [MEM] the thumbnails and the presentation can use only a share of the
+    // memory, so that they do not push the pixmaps of the main view out
+    m_pixmapCache.setBudget( THUMBNAILS_ID, memoryAllowance / 8 );
+    m_pixmapCache.setBudget( PRESENTATION_ID, memoryAllowance / 4 );
+
+    // [MEM] the contents of the caches of the generators can be rebuilt
+    // without rendering anything visible again, so they go first
+    if ( memoryToFree > 0 && cachesMemory > 0 )
+        memoryToFree -= qMin( memoryToFree, AccountedCache::shrinkAll( m_generator, memoryToFree ) );
+
+    // [MEM] free memory starting from the least valuable pixmaps
+    const QList< PixmapCache::Entry > evicted = m_pixmapCache.evict( memoryToFree, m_observers );
+    foreach ( const PixmapCache::Entry &entry, evicted )
+        m_pagesVector.at( entry.page )->deletePixmap( entry.id );
 }
 
 qulonglong DocumentPrivate::getTotalMemory()
@@ -275,6 +279,18 @@ qulonglong DocumentPrivate::getTotalMemory()
     return (cachedValue = 134217728);
 }
 
+#if defined(Q_OS_LINUX)
+// returns the value (in kB) of the @p field in the contents of /proc/meminfo
+static qulonglong memInfoValue( const QByteArray &memInfo, const char *field )
+{
+    const int pos = memInfo.indexOf( field );
+    if ( pos == -1 )
+        return 0;
+
+    return strtoull( memInfo.constData() + pos + qstrlen( field ), 0, 10 );
+}
+#endif
+
 qulonglong DocumentPrivate::getFreeMemory()
 {
     static QTime lastUpdate = QTime::currentTime().addSecs(-3);
@@ -289,24 +305,15 @@ qulonglong DocumentPrivate::getFreeMemory()
     if ( !memFile.open( QIODevice::ReadOnly ) )
         return 0;
 
-    // read /proc/meminfo and sum up the contents of 'MemFree', 'Buffers'
-    // and 'Cached' fields. consider swapped memory as used memory.
-    qulonglong memoryFree = 0;
-    QString entry;
-    QTextStream readStream( &memFile );
-    while ( true )
-    {
-        entry = readStream.readLine();
-        if ( entry.isNull() ) break;
-        if ( entry.startsWith( "MemFree:" ) ||
-                entry.startsWith( "Buffers:" ) ||
-                entry.startsWith( "Cached:" ) ||
-                entry.startsWith( "SwapFree:" ) )
-            memoryFree += entry.section( ' ', -2, -2 ).toULongLong();
-        if ( entry.startsWith( "SwapTotal:" ) )
-            memoryFree -= entry.section( ' ', -2, -2 ).toULongLong();
-    }
+    // read /proc/meminfo in one go and sum up the contents of 'MemFree',
+    // 'Buffers' and 'Cached' fields. consider swapped memory as used memory.
+    const QByteArray memInfo = '\n' + memFile.readAll();
     memFile.close();
+    const qulonglong memoryFree = memInfoValue( memInfo, "\nMemFree:" )
+                                + memInfoValue( memInfo, "\nBuffers:" )
+                                + memInfoValue( memInfo, "\nCached:" )
+                                + memInfoValue( memInfo, "\nSwapFree:" )
+                                - memInfoValue( memInfo, "\nSwapTotal:" );
 
     lastUpdate = QTime::currentTime();
 
@@ -790,6 +797,55 @@ void DocumentPrivate::warnLimitedAnnotSupport()
     }
 }
 
+void DocumentPrivate::savePixmapDiskCache()
+{
+    if ( !m_pixmapDiskCache )
+        return;
+
+    m_pixmapDiskCache->clear();
+
+    // the visible pages and the (first) thumbnails are what is shown first
+    // when the document is opened again
+    QList< QPair< int, int > > pixmaps;
+    foreach ( const VisiblePageRect *rect, m_pageRects )
+        pixmaps.append( qMakePair( (int)PAGEVIEW_ID, rect->pageNumber ) );
+    const int thumbnails = qMin( m_pagesVector.count(), 100 );
+    for ( int i = 0; i < thumbnails; ++i )
+        pixmaps.append( qMakePair( (int)THUMBNAILS_ID, i ) );
+
+    QList< QPair< int, int > >::const_iterator it = pixmaps.constBegin(), end = pixmaps.constEnd();
+    for ( ; it != end; ++it )
+    {
+        const Page *page = m_pagesVector.value( (*it).second );
+        if ( !page || page->rotation() != Rotation0 )
+            continue;
+
+        QMap< int, PagePrivate::PixmapObject >::const_iterator pIt = page->d->m_pixmaps.constFind( (*it).first );
+        if ( pIt == page->d->m_pixmaps.constEnd() || pIt.value().m_rotation != Rotation0 )
+            continue;
+
+        m_pixmapDiskCache->insert( (*it).first, (*it).second, Rotation0, *pIt.value().m_pixmap );
+    }
+
+    m_pixmapDiskCache->save();
+}
+
+void DocumentPrivate::startBoundingBoxExtraction()
+{
+    // the bounding boxes of all the pages are needed only to trim the margins;
+    // the generators which cannot compute them in a thread get them from the
+    // rendered pixmaps instead
+    if ( m_boundingBoxesExtracted || !m_generator || !Settings::trimMargins() ||
+         !m_generator->hasFeature( Generator::PageBoundingBoxes ) || !m_generator->hasFeature( Generator::Threaded ) )
+        return;
+
+    m_boundingBoxesExtracted = true;
+    m_boundingBoxThread = new BoundingBoxExtractionThread( m_generator, m_pagesVector );
+    QObject::connect( m_boundingBoxThread, SIGNAL(gotBoundingBox(int,Okular::NormalizedRect)),
+                      m_parent, SLOT(boundingBoxExtracted(int,Okular::NormalizedRect)) );
+    m_boundingBoxThread->startExtraction( true );
+}
+
 void DocumentPrivate::saveDocumentInfo() const
 {
     if ( m_xmlFileName.isEmpty() )
@@ -883,30 +939,75 @@ void DocumentPrivate::slotTimedMemoryCheck()
 {
     // [MEM] clean memory (for 'free mem dependant' profiles only)
     if ( Settings::memoryLevel() != Settings::EnumMemoryLevel::Low &&
-         m_allocatedPixmapsTotalMemory > 1024*1024 )
+         m_pixmapCache.totalMemory() + AccountedCache::totalMemoryUsage( m_generator ) > 1024*1024 )
         cleanupPixmapMemory();
 }
 
+void DocumentPrivate::indexNextTextPage()
+{
+    // index one page at a time, only while no page is being rendered; the
+    // page is extracted by the background threads and indexed when done, in
+    // textGenerationDone(), which goes on with the next one
+    if ( !m_textIndex || !m_generator || m_closingLoop )
+        return;
+
+    // the page being extracted might have got its text page in other ways
+    if ( m_indexedTextPage >= 0 && !m_textIndex->isPageIndexed( m_indexedTextPage ) )
+        return;
+    m_indexedTextPage = -1;
+
+    m_pixmapRequestsMutex.lock();
+    const bool rendering = !m_executingPixmapRequests.isEmpty() || !m_pixmapRequestsQueue.isEmpty();
+    m_pixmapRequestsMutex.unlock();
+    if ( rendering )
+        return;
+
+    // the pages fetched for a search get indexed anyway
+    if ( !m_prefetchedTextPages.isEmpty() || !m_textPagesToPrefetch.isEmpty() )
+        return;
+
+    int pageNumber = m_textIndex->nextPageToIndex( 0 );
+    while ( pageNumber >= 0 && m_pagesVector.at( pageNumber )->hasTextPage() )
+    {
+        m_textIndex->addPage( pageNumber, m_pagesVector.at( pageNumber )->d->m_text );
+        pageNumber = m_textIndex->nextPageToIndex( pageNumber + 1 );
+    }
+    if ( pageNumber < 0 )
+    {
+        m_textIndex->save();
+        return;
+    }
+
+    // without a background extraction, the index grows only with the text
+    // pages generated for other reasons (searches first of all)
+    if ( m_generator->d_func()->extractTextPage( m_pagesVector.at( pageNumber ) ) )
+        m_indexedTextPage = pageNumber;
+}
+
 void DocumentPrivate::sendGeneratorRequest()
 {
     // find a request
     PixmapRequest * request = 0;
     m_pixmapRequestsMutex.lock();
-    while ( !m_pixmapRequestsStack.isEmpty() && !request )
+    while ( !m_pixmapRequestsQueue.isEmpty() && !request )
     {
-        PixmapRequest * r = m_pixmapRequestsStack.last();
-        if (!r)
-            m_pixmapRequestsStack.pop_back();
+        PixmapRequest * r = m_pixmapRequestsQueue.top();
 
         // request only if page isn't already present or request has invalid id
-        else if ( ( !r->d->mForce && r->page()->hasPixmap( r->id(), r->width(), r->height() ) ) || r->id() <= 0 || r->id() >= MAX_OBSERVER_ID )
+        if ( !r->d->mForce && r->page()->hasPixmap( r->id(), r->width(), r->height(), r->normalizedRect() ) )
+        {
+            m_pixmapCache.hit( r->id(), r->pageNumber() );
+            m_pixmapRequestsQueue.remove( r );
+            delete r;
+        }
+        else if ( r->id() <= 0 || r->id() >= MAX_OBSERVER_ID )
         {
-            m_pixmapRequestsStack.pop_back();
+            m_pixmapRequestsQueue.remove( r );
             delete r;
         }
-        else if ( (long)r->width() * (long)r->height() > 20000000L )
+        else if ( !r->isTile() && (long)r->width() * (long)r->height() > 20000000L )
         {
-            m_pixmapRequestsStack.pop_back();
+            m_pixmapRequestsQueue.remove( r );
             if ( !m_warnedOutOfMemory )
             {
                 kWarning(OkularDebug).nospace() << "Running out of memory on page " << r->pageNumber()
@@ -928,7 +1029,8 @@ void DocumentPrivate::sendGeneratorRequest()
     }
 
     // [MEM] preventive memory freeing
-    qulonglong pixmapBytes = 4 * request->width() * request->height();
+    const QRect pixelRect = request->pixelRect();
+    qulonglong pixmapBytes = 4 * pixelRect.width() * pixelRect.height();
     if ( pixmapBytes > (1024 * 1024) )
         cleanupPixmapMemory( pixmapBytes );
 
@@ -936,7 +1038,9 @@ void DocumentPrivate::sendGeneratorRequest()
     if ( m_generator->canGeneratePixmap() )
     {
         kDebug(OkularDebug).nospace() << "sending request id=" << request->id() << " " <<request->width() << "x" << request->height() << "@" << request->pageNumber() << " async == " << request->asynchronous();
-        m_pixmapRequestsStack.removeAll ( request );
+        m_pixmapRequestsQueue.remove( request );
+        m_pixmapCache.miss();
+        request->d->mGenerationTime.start();
 
         if ( (int)m_rotation % 2 )
             request->d->swap();
@@ -947,6 +1051,14 @@ void DocumentPrivate::sendGeneratorRequest()
         m_executingPixmapRequests.push_back( request );
         m_pixmapRequestsMutex.unlock();
         m_generator->generatePixmap( request );
+
+        // generators with more render threads can take another request
+        // right away, without waiting for this one to be done
+        m_pixmapRequestsMutex.lock();
+        const bool hasPixmaps = !m_pixmapRequestsQueue.isEmpty();
+        m_pixmapRequestsMutex.unlock();
+        if ( hasPixmaps && m_generator && m_generator->canGeneratePixmap() )
+            sendGeneratorRequest();
     }
     else
     {
@@ -988,6 +1100,11 @@ void DocumentPrivate::fontReadingGotFont( const Okular::FontInfo& font )
     emit m_parent->gotFont( font );
 }
 
+void DocumentPrivate::boundingBoxExtracted( int page, const Okular::NormalizedRect &boundingBox )
+{
+    setPageBoundingBox( page, boundingBox );
+}
+
 void DocumentPrivate::slotGeneratorConfigChanged( const QString& )
 {
     if ( !m_generator )
@@ -1015,12 +1132,7 @@ void DocumentPrivate::slotGeneratorConfigChanged( const QString& )
         }
 
         // [MEM] remove allocation descriptors
-        QLinkedList< AllocatedPixmap * >::const_iterator aIt = m_allocatedPixmapsFifo.constBegin();
-        QLinkedList< AllocatedPixmap * >::const_iterator aEnd = m_allocatedPixmapsFifo.constEnd();
-        for ( ; aIt != aEnd; ++aIt )
-            delete *aIt;
-        m_allocatedPixmapsFifo.clear();
-        m_allocatedPixmapsTotalMemory = 0;
+        m_pixmapCache.clear();
 
         // send reload signals to observers
         foreachObserverD( notifyContentsCleared( DocumentObserver::Pixmap ) );
@@ -1028,7 +1140,7 @@ void DocumentPrivate::slotGeneratorConfigChanged( const QString& )
 
     // free memory if in 'low' profile
     if ( Settings::memoryLevel() == Settings::EnumMemoryLevel::Low &&
-         !m_allocatedPixmapsFifo.isEmpty() && !m_pagesVector.isEmpty() )
+         !m_pixmapCache.isEmpty() && !m_pagesVector.isEmpty() )
         cleanupPixmapMemory();
 }
 
@@ -1102,8 +1214,7 @@ void DocumentPrivate::doContinueNextMatchSearch(void *pagesToNotifySet, void * t
                 // get page
                 Page * page = m_pagesVector[ currentPage ];
                 // request search page if needed
-                if ( !page->hasTextPage() )
-                    m_parent->requestTextPage( page->number() );
+                ensureTextPage( page->number() );
                 // if found a match on the current page, end the loop
                 match = page->findText( searchID, text, FromTop, caseSensitivity );
 
@@ -1215,8 +1326,7 @@ void DocumentPrivate::doContinuePrevMatchSearch(void *pagesToNotifySet, void * t
                 // get page
                 Page * page = m_pagesVector[ currentPage ];
                 // request search page if needed
-                if ( !page->hasTextPage() )
-                    m_parent->requestTextPage( page->number() );
+                ensureTextPage( page->number() );
                 // if found a match on the current page, end the loop
                 match = page->findText( searchID, text, FromBottom, caseSensitivity );
 
@@ -1261,6 +1371,10 @@ void DocumentPrivate::doContinueAllDocumentSearch(void *pagesToNotifySet, void *
         return;
     }
 
+    // skip the pages which cannot match, without fetching their text
+    while ( currentPage < m_pagesVector.count() && !search->candidatePages.isEmpty() && !search->candidatePages.testBit( currentPage ) )
+        ++currentPage;
+
     if (currentPage < m_pagesVector.count())
     {
         // get page (from the first to the last)
@@ -1268,8 +1382,7 @@ void DocumentPrivate::doContinueAllDocumentSearch(void *pagesToNotifySet, void *
         int pageNumber = page->number(); // redundant? is it == currentPage ?
 
         // request search page if needed
-        if ( !page->hasTextPage() )
-            m_parent->requestTextPage( pageNumber );
+        ensureTextPage( pageNumber );
 
         // loop on a page adding highlights for all found items
         RegularAreaRect * lastMatch = 0;
@@ -1359,6 +1472,10 @@ void DocumentPrivate::doContinueGooglesDocumentSearch(void *pagesToNotifySet, vo
     int baseHue, baseSat, baseVal;
     color.getHsv( &baseHue, &baseSat, &baseVal );
 
+    // skip the pages which cannot match, without fetching their text
+    while ( currentPage < m_pagesVector.count() && !search->candidatePages.isEmpty() && !search->candidatePages.testBit( currentPage ) )
+        ++currentPage;
+
     if (currentPage < m_pagesVector.count())
     {
         // get page (from the first to the last)
@@ -1366,8 +1483,7 @@ void DocumentPrivate::doContinueGooglesDocumentSearch(void *pagesToNotifySet, vo
         int pageNumber = page->number(); // redundant? is it == currentPage ?
 
         // request search page if needed
-        if ( !page->hasTextPage() )
-            m_parent->requestTextPage( pageNumber );
+        ensureTextPage( pageNumber );
 
         // loop on a page adding highlights for all found items
         bool allMatched = wordCount > 0,
@@ -1713,9 +1829,30 @@ bool Document::openDocument( const QString & docFile, const KUrl& url, const KMi
     d->m_showWarningLimitedAnnotSupport = true;
     d->m_bookmarkManager->setUrl( d->m_url );
 
+    // the renderings and the text index saved when the document was closed
+    // the last time are stored next to the document info file
+    QString xmlBaseName;
+    QByteArray documentHash;
+    if ( !d->m_xmlFileName.isEmpty() )
+    {
+        xmlBaseName = d->m_xmlFileName.left( d->m_xmlFileName.length() - 4 );
+        documentHash = documentFileHash( d->m_docFileName );
+        d->m_pixmapDiskCache = new PixmapDiskCache( xmlBaseName + QLatin1String( ".cache" ), documentHash );
+    }
+    if ( d->m_generator->hasFeature( Generator::TextExtraction ) )
+    {
+        d->m_textIndex = new TextIndex( xmlBaseName.isEmpty() ? QString() : xmlBaseName + QLatin1String( ".index" ),
+                                        d->m_pagesVector.count(), documentHash );
+        d->m_indexedTextPage = -1;
+        QMetaObject::invokeMethod( this, "indexNextTextPage", Qt::QueuedConnection );
+    }
+
     // 3. setup observers inernal lists and data
     foreachObserver( notifySetup( d->m_pagesVector, DocumentObserver::DocumentChanged ) );
 
+    d->m_boundingBoxesExtracted = false;
+    d->startBoundingBoxExtraction();
+
     // 4. set initial page (restoring the page saved in xml if loaded)
     DocumentViewport loadedViewport = (*d->m_viewportIterator);
     if ( loadedViewport.isValid() )
@@ -1791,11 +1928,11 @@ void Document::closeDocument()
 
      // remove requests left in queue
     d->m_pixmapRequestsMutex.lock();
-    QLinkedList< PixmapRequest * >::const_iterator sIt = d->m_pixmapRequestsStack.constBegin();
-    QLinkedList< PixmapRequest * >::const_iterator sEnd = d->m_pixmapRequestsStack.constEnd();
-    for ( ; sIt != sEnd; ++sIt )
-        delete *sIt;
-    d->m_pixmapRequestsStack.clear();
+    qDeleteAll( d->m_pixmapRequestsQueue.takeAll() );
+    // ..and abort the ones being generated
+    QLinkedList< PixmapRequest * >::const_iterator eIt = d->m_executingPixmapRequests.constBegin(), eEnd = d->m_executingPixmapRequests.constEnd();
+    for ( ; eIt != eEnd; ++eIt )
+        (*eIt)->d->mShouldAbortRender.fetchAndStoreRelease( 1 );
     d->m_pixmapRequestsMutex.unlock();
 
     QEventLoop loop;
@@ -1822,12 +1959,21 @@ void Document::closeDocument()
         d->m_fontThread = 0;
     }
 
+    if ( d->m_boundingBoxThread )
+    {
+        disconnect( d->m_boundingBoxThread, 0, this, 0 );
+        d->m_boundingBoxThread->stopExtraction();
+        d->m_boundingBoxThread->wait();
+        d->m_boundingBoxThread = 0;
+    }
+
     // stop any audio playback
     AudioPlayer::instance()->stopPlaybacks();
 
     // close the current document and save document info if a document is still opened
     if ( d->m_generator && d->m_pagesVector.size() > 0 )
     {
+        d->savePixmapDiskCache();
         d->saveDocumentInfo();
         d->m_generator->closeDocument();
     }
@@ -1837,6 +1983,8 @@ void Document::closeDocument()
         d->m_memCheckTimer->stop();
     if ( d->m_saveBookmarksTimer )
         d->m_saveBookmarksTimer->stop();
+    if ( d->m_relayoutTimer )
+        d->m_relayoutTimer->stop();
 
     if ( d->m_generator )
     {
@@ -1855,6 +2003,13 @@ void Document::closeDocument()
     d->m_url = KUrl();
     d->m_docFileName = QString();
     d->m_xmlFileName = QString();
+    delete d->m_pixmapDiskCache;
+    d->m_pixmapDiskCache = 0;
+    if ( d->m_textIndex )
+        d->m_textIndex->save();
+    delete d->m_textIndex;
+    d->m_textIndex = 0;
+    d->m_indexedTextPage = -1;
     delete d->m_tempFile;
     d->m_tempFile = 0;
     delete d->m_archiveData;
@@ -1878,11 +2033,11 @@ void Document::closeDocument()
     d->m_pagesVector.clear();
 
     // clear 'memory allocation' descriptors
-    QLinkedList< AllocatedPixmap * >::const_iterator aIt = d->m_allocatedPixmapsFifo.constBegin();
-    QLinkedList< AllocatedPixmap * >::const_iterator aEnd = d->m_allocatedPixmapsFifo.constEnd();
-    for ( ; aIt != aEnd; ++aIt )
-        delete *aIt;
-    d->m_allocatedPixmapsFifo.clear();
+    kDebug(OkularDebug) << "Pixmap cache hits:" << d->m_pixmapCache.hits() << "misses:" << d->m_pixmapCache.misses()
+                        << "evictions:" << d->m_pixmapCache.evictions();
+    d->m_pixmapCache.clear();
+    d->m_pageRenderRates.clear();
+    d->m_averageRenderRate = 0;
 
     // clear 'running searches' descriptors
     QMap< int, RunningSearch * >::const_iterator rIt = d->m_searches.constBegin();
@@ -1904,8 +2059,9 @@ void Document::closeDocument()
     d->m_viewportHistory.clear();
     d->m_viewportHistory.append( DocumentViewport() );
     d->m_viewportIterator = d->m_viewportHistory.begin();
-    d->m_allocatedPixmapsTotalMemory = 0;
     d->m_allocatedTextPagesFifo.clear();
+    d->m_textPagesToPrefetch.clear();
+    d->m_prefetchedTextPages.clear();
     d->m_pageSize = PageSize();
     d->m_pageSizes.clear();
     
@@ -1940,19 +2096,7 @@ void Document::removeObserver( DocumentObserver * pObserver )
             (*it)->deletePixmap( observerId );
 
         // [MEM] free observer's allocation descriptors
-        QLinkedList< AllocatedPixmap * >::iterator aIt = d->m_allocatedPixmapsFifo.begin();
-        QLinkedList< AllocatedPixmap * >::iterator aEnd = d->m_allocatedPixmapsFifo.end();
-        while ( aIt != aEnd )
-        {
-            AllocatedPixmap * p = *aIt;
-            if ( p->id == observerId )
-            {
-                aIt = d->m_allocatedPixmapsFifo.erase( aIt );
-                delete p;
-            }
-            else
-                ++aIt;
-        }
+        d->m_pixmapCache.removeObserver( observerId );
 
         // delete observer entry from the map
         d->m_observers.remove( observerId );
@@ -1978,12 +2122,7 @@ void Document::reparseConfig()
         }
 
         // [MEM] remove allocation descriptors
-        QLinkedList< AllocatedPixmap * >::const_iterator aIt = d->m_allocatedPixmapsFifo.constBegin();
-        QLinkedList< AllocatedPixmap * >::const_iterator aEnd = d->m_allocatedPixmapsFifo.constEnd();
-        for ( ; aIt != aEnd; ++aIt )
-            delete *aIt;
-        d->m_allocatedPixmapsFifo.clear();
-        d->m_allocatedPixmapsTotalMemory = 0;
+        d->m_pixmapCache.clear();
 
         // send reload signals to observers
         foreachObserver( notifyContentsCleared( DocumentObserver::Pixmap ) );
@@ -1991,8 +2130,12 @@ void Document::reparseConfig()
 
     // free memory if in 'low' profile
     if ( Settings::memoryLevel() == Settings::EnumMemoryLevel::Low &&
-         !d->m_allocatedPixmapsFifo.isEmpty() && !d->m_pagesVector.isEmpty() )
+         !d->m_pixmapCache.isEmpty() && !d->m_pagesVector.isEmpty() )
         d->cleanupPixmapMemory();
+
+    // the bounding boxes are needed once the margins are trimmed
+    if ( !d->m_pagesVector.isEmpty() )
+        d->startBoundingBoxExtraction();
 }
 
 
@@ -2174,6 +2317,11 @@ bool Document::supportsPageSizes() const
     return d->m_generator ? d->m_generator->hasFeature( Generator::PageSizes ) : false;
 }
 
+bool Document::supportsTiles() const
+{
+    return d->m_generator ? d->m_generator->hasFeature( Generator::TiledRendering ) : false;
+}
+
 PageSize::List Document::pageSizes() const
 {
     if ( d->m_generator )
@@ -2290,36 +2438,36 @@ void Document::requestPixmaps( const QLinkedList< PixmapRequest * > & requests,
         return;
     }
 
-    // 1. [CLEAN STACK] remove previous requests of requesterID
-    int requesterID = requests.first()->id();
+    // 0. [TILES] split the requests for parts of pages in tiles; the pages
+    // count as requested even when all their tiles are already rendered, so
+    // the previous requests for them are cleaned anyway
+    const int requesterID = requests.first()->id();
     QSet< int > requestedPages;
+    QLinkedList< PixmapRequest * > allRequests;
     {
         QLinkedList< PixmapRequest * >::const_iterator rIt = requests.constBegin(), rEnd = requests.constEnd();
         for ( ; rIt != rEnd; ++rIt )
-            requestedPages.insert( (*rIt)->pageNumber() );
-    }
-    const bool removeAllPrevious = reqOptions & RemoveAllPrevious;
-    d->m_pixmapRequestsMutex.lock();
-    QLinkedList< PixmapRequest * >::iterator sIt = d->m_pixmapRequestsStack.begin(), sEnd = d->m_pixmapRequestsStack.end();
-    while ( sIt != sEnd )
-    {
-        if ( (*sIt)->id() == requesterID
-             && ( removeAllPrevious || requestedPages.contains( (*sIt)->pageNumber() ) ) )
         {
-            // delete request and remove it from stack
-            delete *sIt;
-            sIt = d->m_pixmapRequestsStack.erase( sIt );
+            if ( (*rIt)->isTile() )
+            {
+                if ( d->m_pagesVector.value( (*rIt)->pageNumber() ) )
+                    requestedPages.insert( (*rIt)->pageNumber() );
+                allRequests += d->splitTileRequest( *rIt );
+            }
+            else
+                allRequests.append( *rIt );
         }
-        else
-            ++sIt;
     }
 
-    // 2. [ADD TO STACK] add requests to stack
+    // 1. [VALIDATE] set the 'page field' (see PixmapRequest) and check if it is valid
     bool threadingDisabled = !Settings::enableThreading();
-    QLinkedList< PixmapRequest * >::const_iterator rIt = requests.constBegin(), rEnd = requests.constEnd();
+    QLinkedList< PixmapRequest * > newRequests;
+    QSet< PixmapRequest * > keptRequests;
+    QList< QPair< PixmapRequest *, QString > > diskCachedRequests;
+    d->m_pixmapRequestsMutex.lock();
+    QLinkedList< PixmapRequest * >::const_iterator rIt = allRequests.constBegin(), rEnd = allRequests.constEnd();
     for ( ; rIt != rEnd; ++rIt )
     {
-        // set the 'page field' (see PixmapRequest) and check if it is valid
         PixmapRequest * request = *rIt;
         kDebug(OkularDebug).nospace() << "request id=" << request->id() << " " <<request->width() << "x" << request->height() << "@" << request->pageNumber();
         if ( d->m_pagesVector.value( request->pageNumber() ) == 0 )
@@ -2330,6 +2478,7 @@ void Document::requestPixmaps( const QLinkedList< PixmapRequest * > & requests,
         }
 
         request->d->mPage = d->m_pagesVector.value( request->pageNumber() );
+        requestedPages.insert( request->pageNumber() );
 
         if ( !request->asynchronous() )
             request->d->mPriority = 0;
@@ -2337,23 +2486,102 @@ void Document::requestPixmaps( const QLinkedList< PixmapRequest * > & requests,
         if ( request->asynchronous() && threadingDisabled )
             request->d->mAsynchronous = false;
 
-        // add request to the 'stack' at the right place
-        if ( !request->priority() )
-            // add priority zero requests to the top of the stack
-            d->m_pixmapRequestsStack.append( request );
-        else
+        // 2. [REPRIORITIZE] an identical request is either being generated
+        // (and it will be done soon), or it is queued and just moves in the queue
+        PixmapRequest * sameRequest = request->d->mForce ? 0 : d->findSameRequest( request );
+        if ( sameRequest )
         {
-            // insert in stack sorted by priority
-            sIt = d->m_pixmapRequestsStack.begin();
-            sEnd = d->m_pixmapRequestsStack.end();
-            while ( sIt != sEnd && (*sIt)->priority() > request->priority() )
-                ++sIt;
-            d->m_pixmapRequestsStack.insert( sIt, request );
+            if ( sameRequest->d->mQueuePosition >= 0 )
+                d->m_pixmapRequestsQueue.setPriority( sameRequest, request->priority() );
+            keptRequests.insert( sameRequest );
+            delete request;
+            continue;
+        }
+
+        // a page rendered when the document was closed the last time is shown
+        // as soon as its image is read, and then it is rendered again to get it
+        // up to date: like a preview, the request reading the image stands for
+        // the full one until it is done
+        if ( d->m_pixmapDiskCache && !request->isTile() && !request->page()->hasPixmap( request->id() ) &&
+             request->page()->rotation() == Rotation0 )
+        {
+            const QString fileName = d->m_pixmapDiskCache->take( request->id(), request->pageNumber(), request->width(), request->height(), Rotation0 );
+            if ( !fileName.isEmpty() )
+            {
+                request->d->mForce = true;
+                PixmapRequest * cached = new PixmapRequest( request->id(), request->pageNumber(), request->width(), request->height(),
+                                                            request->priority(), true );
+                cached->d->mPage = request->d->mPage;
+                cached->d->mFullRequest = request;
+                cached->d->mGenerationTime.start();
+                d->m_executingPixmapRequests.push_back( cached );
+                keptRequests.insert( cached );
+                diskCachedRequests.append( qMakePair( cached, fileName ) );
+                continue;
+            }
         }
+
+        // a slow page shows a quick preview first: the request for the full
+        // page is queued only when the preview is done
+        if ( !request->isTile() && request->asynchronous() &&
+             !request->page()->hasPixmap( request->id() ) && d->needsPreview( request ) )
+        {
+            PixmapRequest * preview = new PixmapRequest( request->id(), request->pageNumber(),
+                                                         qMax( request->width() / OKULAR_PREVIEW_SCALE, 1 ),
+                                                         qMax( request->height() / OKULAR_PREVIEW_SCALE, 1 ),
+                                                         request->priority(), true );
+            preview->d->mPage = request->d->mPage;
+            preview->d->mFullRequest = request;
+            request = preview;
+        }
+
+        newRequests.append( request );
+    }
+
+    // 3. [CLEAN QUEUE] remove the other previous requests of requesterID
+    const bool removeAllPrevious = reqOptions & RemoveAllPrevious;
+    QList< PixmapRequest * > previousRequests;
+    if ( removeAllPrevious )
+    {
+        previousRequests = d->m_pixmapRequestsQueue.requests( requesterID );
+    }
+    else
+    {
+        foreach ( int page, requestedPages )
+            previousRequests += d->m_pixmapRequestsQueue.requests( requesterID, page );
+    }
+    foreach ( PixmapRequest * request, previousRequests )
+    {
+        if ( keptRequests.contains( request ) )
+            continue;
+
+        d->m_pixmapRequestsQueue.remove( request );
+        delete request;
+    }
+
+    // the ones being generated cannot be removed, but they can be aborted
+    QLinkedList< PixmapRequest * >::const_iterator eIt = d->m_executingPixmapRequests.constBegin(), eEnd = d->m_executingPixmapRequests.constEnd();
+    for ( ; eIt != eEnd; ++eIt )
+    {
+        PixmapRequest * request = *eIt;
+        if ( request->id() == requesterID && !keptRequests.contains( request ) &&
+             ( removeAllPrevious || requestedPages.contains( request->pageNumber() ) ) )
+            request->d->mShouldAbortRender.fetchAndStoreRelease( 1 );
     }
+
+    // 4. [ADD TO QUEUE] add the new requests
+    rIt = newRequests.constBegin();
+    rEnd = newRequests.constEnd();
+    for ( ; rIt != rEnd; ++rIt )
+        d->m_pixmapRequestsQueue.insert( *rIt );
     d->m_pixmapRequestsMutex.unlock();
 
-    // 3. [START FIRST GENERATION] if <NO>generator is ready, start a new generation,
+    // the images are decoded in a background thread, which hands the requests
+    // back to diskCachedPixmapLoaded()
+    if ( !diskCachedRequests.isEmpty() )
+        PixmapDiskCache::load( this, diskCachedRequests );
+
+    // 5. [START FIRST GENERATION] if <NO>generator is ready, start a new generation,
     // or else (if gen is running) it will be started when the new contents will
     //come from generator (in requestDone())</NO>
     // all handling of requests put into sendGeneratorRequest
@@ -2369,7 +2597,98 @@ void Document::requestTextPage( uint page )
 
     // Memory management for TextPages
 
-    d->m_generator->generateTextPage( kp );
+    // the page is wanted, so it is kept even if it was extracted for the index
+    if ( (int)page == d->m_indexedTextPage )
+        d->m_indexedTextPage = -1;
+
+    // take it from the background extraction, if it is there
+    const bool hadTextPage = kp->hasTextPage();
+    d->m_generator->d_func()->waitForTextPage( kp );
+    if ( hadTextPage || !kp->hasTextPage() )
+        d->m_generator->generateTextPage( kp );
+
+    d->textPageUsed( page );
+}
+
+void Document::prefetchTextPages( const QList< int > &pages )
+{
+    if ( !d->m_generator )
+        return;
+
+    d->m_textPagesToPrefetch.clear();
+    d->m_prefetchedTextPages.clear();
+    foreach ( int page, pages )
+    {
+        if ( page >= 0 && page < d->m_pagesVector.count() )
+            d->m_textPagesToPrefetch.append( page );
+    }
+    d->prefetchTextPages();
+}
+
+void DocumentPrivate::prefetchTextPages()
+{
+    // do not extract much more than what can be kept in memory, or the
+    // first pages would be thrown away before being used
+    const int window = qBound( 1, m_maxAllocatedTextPages / 2, 8 * qMax( QThread::idealThreadCount(), 1 ) );
+    while ( m_prefetchedTextPages.count() < window && !m_textPagesToPrefetch.isEmpty() )
+    {
+        const int pageNumber = m_textPagesToPrefetch.takeFirst();
+        Page *page = m_pagesVector.at( pageNumber );
+        if ( page->hasTextPage() )
+            continue;
+
+        if ( pageNumber == m_indexedTextPage )
+            m_indexedTextPage = -1;
+
+        if ( !m_generator->d_func()->extractTextPage( page ) )
+        {
+            // no background extraction for this generator
+            m_textPagesToPrefetch.clear();
+            return;
+        }
+        m_prefetchedTextPages.append( pageNumber );
+    }
+}
+
+void DocumentPrivate::textPageUsed( int pageNumber )
+{
+    // the pages are used in the order they were prefetched, so the ones
+    // before this are not waited for anymore
+    const int index = m_prefetchedTextPages.indexOf( pageNumber );
+    if ( index >= 0 )
+    {
+        m_prefetchedTextPages.erase( m_prefetchedTextPages.begin(), m_prefetchedTextPages.begin() + index + 1 );
+    }
+    else
+    {
+        const int toPrefetchIndex = m_textPagesToPrefetch.indexOf( pageNumber );
+        if ( toPrefetchIndex >= 0 )
+        {
+            m_prefetchedTextPages.clear();
+            m_textPagesToPrefetch.erase( m_textPagesToPrefetch.begin(), m_textPagesToPrefetch.begin() + toPrefetchIndex + 1 );
+        }
+    }
+
+    prefetchTextPages();
+}
+
+void DocumentPrivate::prefetchSearchPages( const RunningSearch *search, int fromPage, int step )
+{
+    QList< int > pages;
+    for ( int i = fromPage; i >= 0 && i < m_pagesVector.count(); i += step )
+    {
+        if ( search->candidatePages.isEmpty() || search->candidatePages.testBit( i ) )
+            pages.append( i );
+    }
+    m_parent->prefetchTextPages( pages );
+}
+
+void DocumentPrivate::ensureTextPage( int pageNumber )
+{
+    if ( m_pagesVector.at( pageNumber )->hasTextPage() )
+        textPageUsed( pageNumber );
+    else
+        m_parent->requestTextPage( pageNumber );
 }
 
 void DocumentPrivate::notifyAnnotationChanges( int page )
@@ -2715,26 +3034,8 @@ void Document::setViewport( const DocumentViewport & viewport, int excludeId, bo
         if ( it.key() != excludeId )
             (*it)->notifyViewportChanged( smoothMove );
 
-    // [MEM] raise position of currently viewed page in allocation queue
-    if ( d->m_allocatedPixmapsFifo.count() > 1 )
-    {
-        const int page = viewport.pageNumber;
-        QLinkedList< AllocatedPixmap * > viewportPixmaps;
-        QLinkedList< AllocatedPixmap * >::iterator aIt = d->m_allocatedPixmapsFifo.begin();
-        QLinkedList< AllocatedPixmap * >::iterator aEnd = d->m_allocatedPixmapsFifo.end();
-        while ( aIt != aEnd )
-        {
-            if ( (*aIt)->page == page )
-            {
-                viewportPixmaps.append( *aIt );
-                aIt = d->m_allocatedPixmapsFifo.erase( aIt );
-                continue;
-            }
-            ++aIt;
-        }
-        if ( !viewportPixmaps.isEmpty() )
-            d->m_allocatedPixmapsFifo += viewportPixmaps;
-    }
+    // [MEM] the pixmaps of the currently viewed page are used again
+    d->m_pixmapCache.touchPage( viewport.pageNumber );
 }
 
 void Document::setZoom(int factor, int excludeId)
@@ -2831,6 +3132,7 @@ void Document::searchText( int searchID, const QString & text, bool fromStart, Q
     s->cachedNoDialogs = noDialogs;
     s->cachedColor = color;
     s->isCurrentlySearching = true;
+    s->candidatePages.clear();
 
     // global data for search
     QSet< int > *pagesToNotify = new QSet< int >;
@@ -2849,6 +3151,10 @@ void Document::searchText( int searchID, const QString & text, bool fromStart, Q
     {
         QMap< Page *, QVector<RegularAreaRect *> > *pageMatches = new QMap< Page *, QVector<RegularAreaRect *> >;
 
+        if ( d->m_textIndex )
+            s->candidatePages = d->m_textIndex->pagesContaining( text );
+        d->prefetchSearchPages( s, 0, 1 );
+
         // search and highlight 'text' (as a solid phrase) on all pages
         QMetaObject::invokeMethod(this, "doContinueAllDocumentSearch", Qt::QueuedConnection, Q_ARG(void *, pagesToNotify), Q_ARG(void *, pageMatches), Q_ARG(int, 0), Q_ARG(int, searchID), Q_ARG(QString, text), Q_ARG(int, caseSensitivity), Q_ARG(QColor, color));
     }
@@ -2861,6 +3167,8 @@ void Document::searchText( int searchID, const QString & text, bool fromStart, Q
         Page * lastPage = fromStart ? 0 : d->m_pagesVector[ currentPage ];
         int pagesDone = 0;
 
+        d->prefetchSearchPages( s, currentPage, 1 );
+
         // continue checking last TextPage first (if it is the current page)
         RegularAreaRect * match = 0;
         if ( lastPage && lastPage->number() == s->continueOnPage )
@@ -2887,6 +3195,8 @@ void Document::searchText( int searchID, const QString & text, bool fromStart, Q
         Page * lastPage = fromStart ? 0 : d->m_pagesVector[ currentPage ];
         int pagesDone = 0;
 
+        d->prefetchSearchPages( s, currentPage, -1 );
+
         // continue checking last TextPage first (if it is the current page)
         RegularAreaRect * match = 0;
         if ( lastPage && lastPage->number() == s->continueOnPage )
@@ -2912,6 +3222,19 @@ void Document::searchText( int searchID, const QString & text, bool fromStart, Q
         QMap< Page *, QVector< QPair<RegularAreaRect *, QColor> > > *pageMatches = new QMap< Page *, QVector<QPair<RegularAreaRect *, QColor> > >;
         const QStringList words = text.split( ' ', QString::SkipEmptyParts );
 
+        if ( d->m_textIndex && !words.isEmpty() )
+        {
+            s->candidatePages = d->m_textIndex->pagesContaining( words.first() );
+            for ( int i = 1; i < words.count(); ++i )
+            {
+                if ( matchAll )
+                    s->candidatePages &= d->m_textIndex->pagesContaining( words.at( i ) );
+                else
+                    s->candidatePages |= d->m_textIndex->pagesContaining( words.at( i ) );
+            }
+        }
+        d->prefetchSearchPages( s, 0, 1 );
+
         // search and highlight every word in 'text' on all pages
         QMetaObject::invokeMethod(this, "doContinueGooglesDocumentSearch", Qt::QueuedConnection, Q_ARG(void *, pagesToNotify), Q_ARG(void *, pageMatches), Q_ARG(int, 0), Q_ARG(int, searchID), Q_ARG(QStringList, words), Q_ARG(int, caseSensitivity), Q_ARG(QColor, color), Q_ARG(bool, matchAll));
     }
@@ -3792,27 +4115,54 @@ void DocumentPrivate::requestDone( PixmapRequest * req )
         kDebug(OkularDebug) << "requestDone with generator not in READY state.";
 #endif
 
-    // [MEM] 1.1 find and remove a previous entry for the same page and id
-    QLinkedList< AllocatedPixmap * >::iterator aIt = m_allocatedPixmapsFifo.begin();
-    QLinkedList< AllocatedPixmap * >::iterator aEnd = m_allocatedPixmapsFifo.end();
-    for ( ; aIt != aEnd; ++aIt )
-        if ( (*aIt)->page == req->pageNumber() && (*aIt)->id == req->id() )
-        {
-            AllocatedPixmap * p = *aIt;
-            m_allocatedPixmapsFifo.erase( aIt );
-            m_allocatedPixmapsTotalMemory -= p->memory;
-            delete p;
-            break;
-        }
+    // an aborted request brings no pixmap: just go on with the pending ones
+    if ( req->shouldAbortRender() )
+    {
+        m_pixmapRequestsMutex.lock();
+        m_executingPixmapRequests.removeAll( req );
+        const bool hasPixmaps = !m_pixmapRequestsQueue.isEmpty();
+        m_pixmapRequestsMutex.unlock();
+        delete req;
+        if ( hasPixmaps )
+            sendGeneratorRequest();
+        else
+            indexNextTextPage();
+        return;
+    }
 
     QMap< int, DocumentObserver * >::const_iterator itObserver = m_observers.constFind( req->id() );
     if ( itObserver != m_observers.constEnd() )
     {
-        // [MEM] 1.2 append memory allocation descriptor to the FIFO
-        qulonglong memoryBytes = 4 * req->width() * req->height();
-        AllocatedPixmap * memoryPage = new AllocatedPixmap( req->id(), req->pageNumber(), memoryBytes );
-        m_allocatedPixmapsFifo.append( memoryPage );
-        m_allocatedPixmapsTotalMemory += memoryBytes;
+        // [MEM] 1. replace the memory allocation descriptor of the pixmap; tiles
+        // are accounted as a whole, with the memory of all the tiles of the page
+        TilesManager *tm = req->isTile() ? req->page()->d->tilesManager( req->id() ) : 0;
+        qulonglong memoryBytes = 0;
+        if ( tm )
+        {
+            memoryBytes = tm->totalMemory();
+        }
+        else
+        {
+            // measure what the pixmap really takes, not what was asked
+            QMap< int, PagePrivate::PixmapObject >::const_iterator pIt = req->page()->d->m_pixmaps.constFind( req->id() );
+            if ( pIt != req->page()->d->m_pixmaps.constEnd() )
+            {
+                const QPixmap *pixmap = pIt.value().m_pixmap;
+                const int bytesPerPixel = pixmap->depth() > 16 ? 4 : ( pixmap->depth() + 7 ) / 8;
+                memoryBytes = (qulonglong)bytesPerPixel * pixmap->width() * pixmap->height();
+            }
+        }
+        const int generationTime = req->d->mGenerationTime.elapsed();
+        m_pixmapCache.insert( req->id(), req->pageNumber(), memoryBytes, generationTime );
+
+        // remember how slow the page is, to know whether it needs a preview
+        // the next time (the previews are too small to tell)
+        if ( !req->isTile() && !req->d->mFullRequest )
+        {
+            const double rate = generationTime * 1000000.0 / qMax( req->width() * req->height(), 1 );
+            m_pageRenderRates.insert( req->pageNumber(), rate );
+            m_averageRenderRate = m_averageRenderRate > 0 ? ( 3 * m_averageRenderRate + rate ) / 4 : rate;
+        }
 
         // 2. notify an observer that its pixmap changed
         itObserver.value()->notifyPageChanged( req->pageNumber(), DocumentObserver::Pixmap );
@@ -3822,18 +4172,160 @@ void DocumentPrivate::requestDone( PixmapRequest * req )
         kWarning(OkularDebug) << "Receiving a done request for the defunct observer" << req->id();
 #endif
 
-    // 3. delete request
+    // 3. delete request, queueing the full page after its preview
     m_pixmapRequestsMutex.lock();
     m_executingPixmapRequests.removeAll( req );
+    if ( req->d->mFullRequest )
+    {
+        m_pixmapRequestsQueue.insert( req->d->mFullRequest );
+        req->d->mFullRequest = 0;
+    }
     m_pixmapRequestsMutex.unlock();
     delete req;
 
-    // 4. start a new generation if some is pending
+    // 4. start a new generation if some is pending, or else go on indexing
     m_pixmapRequestsMutex.lock();
-    bool hasPixmaps = !m_pixmapRequestsStack.isEmpty();
+    bool hasPixmaps = !m_pixmapRequestsQueue.isEmpty();
     m_pixmapRequestsMutex.unlock();
     if ( hasPixmaps )
         sendGeneratorRequest();
+    else
+        indexNextTextPage();
+}
+
+void DocumentPrivate::diskCachedPixmapLoaded( void *request, const QImage &image )
+{
+    PixmapRequest * req = static_cast< PixmapRequest * >( request );
+
+    if ( !image.isNull() && m_generator && !m_closingLoop && !req->shouldAbortRender() &&
+         !req->page()->hasPixmap( req->id() ) )
+    {
+        req->page()->setPixmap( req->id(), new QPixmap( QPixmap::fromImage( image ) ) );
+    }
+    else if ( image.isNull() && !req->shouldAbortRender() )
+    {
+        // nothing to show: just render the page
+        m_pixmapRequestsMutex.lock();
+        m_executingPixmapRequests.removeAll( req );
+        if ( m_generator && !m_closingLoop )
+        {
+            m_pixmapRequestsQueue.insert( req->d->mFullRequest );
+            req->d->mFullRequest = 0;
+        }
+        m_pixmapRequestsMutex.unlock();
+        delete req;
+
+        if ( m_closingLoop )
+            m_closingLoop->exit();
+        else if ( m_generator )
+            sendGeneratorRequest();
+        return;
+    }
+
+    requestDone( req );
+}
+
+PixmapRequest * DocumentPrivate::findSameRequest( const PixmapRequest * request ) const
+{
+    // look among the queued requests..
+    // (a preview stands for the full page request queued after it)
+    foreach ( PixmapRequest * r, m_pixmapRequestsQueue.requests( request->id(), request->pageNumber() ) )
+    {
+        const PixmapRequest * full = r->d->mFullRequest ? r->d->mFullRequest : r;
+        if ( full->width() == request->width() && full->height() == request->height() &&
+             full->asynchronous() == request->asynchronous() && full->isTile() == request->isTile() &&
+             full->normalizedRect() == request->normalizedRect() )
+            return r;
+    }
+
+    // ..and among the ones being generated, which have the size swapped
+    // when the document is rotated by 90 or 270 degrees
+    const bool swapped = (int)m_rotation % 2;
+    QLinkedList< PixmapRequest * >::const_iterator eIt = m_executingPixmapRequests.constBegin(), eEnd = m_executingPixmapRequests.constEnd();
+    for ( ; eIt != eEnd; ++eIt )
+    {
+        PixmapRequest * r = *eIt;
+        if ( r->d->mFullRequest )
+        {
+            const PixmapRequest * full = r->d->mFullRequest;
+            if ( !r->shouldAbortRender() && full->id() == request->id() && full->pageNumber() == request->pageNumber() &&
+                 full->width() == request->width() && full->height() == request->height() )
+                return r;
+            continue;
+        }
+        if ( !r->shouldAbortRender() && r->id() == request->id() && r->pageNumber() == request->pageNumber() &&
+             ( swapped ? r->height() : r->width() ) == request->width() &&
+             ( swapped ? r->width() : r->height() ) == request->height() &&
+             r->isTile() == request->isTile() && r->normalizedRect() == request->normalizedRect() )
+            return r;
+    }
+
+    return 0;
+}
+
+bool DocumentPrivate::needsPreview( const PixmapRequest * request ) const
+{
+    // a preview of a small page would be a waste of time
+    if ( request->width() * request->height() < 256 * 256 )
+        return false;
+
+    switch ( Settings::progressiveRendering() )
+    {
+        case Settings::EnumProgressiveRendering::Never:
+            return false;
+        case Settings::EnumProgressiveRendering::Always:
+            return true;
+        default: ;
+    }
+
+    // unknown pages are expected to be as slow as the average one
+    const double rate = m_pageRenderRates.value( request->pageNumber(), m_averageRenderRate );
+    return rate * request->width() * request->height() / 1000000.0 > OKULAR_SLOW_RENDER_MSECS;
+}
+
+QLinkedList< PixmapRequest * > DocumentPrivate::splitTileRequest( PixmapRequest * request )
+{
+    QLinkedList< PixmapRequest * > tiles;
+
+    Page * page = m_pagesVector.value( request->pageNumber() );
+    if ( !page || !m_generator->hasFeature( Generator::TiledRendering ) || m_rotation != Rotation0 )
+    {
+        // serve it as a plain request for the whole page
+        request->setTile( false );
+        request->setNormalizedRect( NormalizedRect( 0., 0., 1., 1. ) );
+        tiles.append( request );
+        return tiles;
+    }
+
+    // 1. get (or create) the tiles of the page for the observer
+    TilesManager * tm = page->d->tilesManager( request->id() );
+    if ( !tm )
+    {
+        tm = new TilesManager( request->width(), request->height() );
+        page->d->setTilesManager( request->id(), tm );
+    }
+    else
+    {
+        tm->setSize( request->width(), request->height() );
+    }
+
+    // 2. drop the tiles the observer does not want any more
+    tm->discardTilesOutside( request->normalizedRect() );
+
+    // 3. create a request for each tile not rendered yet
+    const QList< NormalizedRect > missing = tm->missingTiles( request->normalizedRect() );
+    foreach ( const NormalizedRect &rect, missing )
+    {
+        PixmapRequest * tile = new PixmapRequest( request->id(), request->pageNumber(), request->width(), request->height(),
+                                                  request->priority(), request->asynchronous() );
+        tile->setTile( true );
+        tile->setNormalizedRect( rect );
+        tile->d->mForce = request->d->mForce;
+        tiles.append( tile );
+    }
+
+    delete request;
+    return tiles;
 }
 
 void DocumentPrivate::setPageBoundingBox( int page, const NormalizedRect& boundingBox )
@@ -3849,13 +4341,48 @@ void DocumentPrivate::setPageBoundingBox( int page, const NormalizedRect& boundi
     // notify observers about the change
     foreachObserverD( notifyPageChanged( page, DocumentObserver::BoundingBox ) );
 
+    // Generators with the PageBoundingBoxes feature compute the bbox of all the pages
+    // when the margins are trimmed (see startBoundingBoxExtraction()), the others
+    // by pixmap scanning.
     // TODO: For generators that generate the bbox by pixmap scanning, if the first generated pixmap is very small, the bounding box will forever be inaccurate.
     // TODO: Crop computation should also consider annotations, actions, etc. to make sure they're not cropped away.
-    // TODO: Help compute bounding box for generators that create a QPixmap without a QImage, like text and plucker.
-    // TODO: Don't compute the bounding box if no one needs it (e.g., Trim Borders is off).
 
 }
 
+void DocumentPrivate::resizePage( int page, double width, double height )
+{
+    Page * kp = m_pagesVector.value( page );
+    if ( !m_generator || !kp )
+        return;
+
+    kp->setSizeKnown( true );
+    const bool swapped = kp->rotation() % 2;
+    if ( ( swapped ? kp->height() : kp->width() ) == width && ( swapped ? kp->width() : kp->height() ) == height )
+        return;
+
+    // the pixmaps of the page are deleted
+    kp->d->changeSize( PageSize( width, height, QString() ) );
+    QMap< int, DocumentObserver * >::const_iterator it = m_observers.constBegin(), end = m_observers.constEnd();
+    for ( ; it != end; ++it )
+        m_pixmapCache.remove( it.key(), page );
+
+    // the pages are usually measured one after the other: lay them out
+    // once for a bunch of them
+    if ( !m_relayoutTimer )
+    {
+        m_relayoutTimer = new QTimer( m_parent );
+        m_relayoutTimer->setSingleShot( true );
+        QObject::connect( m_relayoutTimer, SIGNAL(timeout()), m_parent, SLOT(relayoutResizedPages()) );
+    }
+    if ( !m_relayoutTimer->isActive() )
+        m_relayoutTimer->start( 200 );
+}
+
+void DocumentPrivate::relayoutResizedPages()
+{
+    foreachObserverD( notifySetup( m_pagesVector, DocumentObserver::NewLayoutForPages ) );
+}
+
 void DocumentPrivate::calculateMaxTextPages()
 {
     int multipliers = qMax(1, qRound(getTotalMemory() / 536870912.0)); // 512 MB
@@ -3883,6 +4410,19 @@ void DocumentPrivate::textGenerationDone( Page *page )
 {
     if ( !m_generator || m_closingLoop ) return;
 
+    if ( m_textIndex )
+        m_textIndex->addPage( page->number(), page->d->m_text );
+
+    // a page extracted only to be indexed is not needed anymore, so it does
+    // not take the place of other text pages
+    if ( page->number() == m_indexedTextPage )
+    {
+        m_indexedTextPage = -1;
+        page->setTextPage( 0 );
+        indexNextTextPage();
+        return;
+    }
+
     // 1. If we reached the cache limit, delete the first text page from the fifo
     if (m_allocatedTextPagesFifo.size() == m_maxAllocatedTextPages)
     {
@@ -3895,6 +4435,8 @@ void DocumentPrivate::textGenerationDone( Page *page )
 
     // 2. Add the page to the fifo of generated text pages
     m_allocatedTextPagesFifo.append( page->number() );
+
+    indexNextTextPage();
 }
 
 void Document::setRotation( int r )
@@ -3946,12 +4488,7 @@ void Document::setPageSize( const PageSize &size )
     for ( ; pIt != pEnd; ++pIt )
         (*pIt)->d->changeSize( size );
     // clear 'memory allocation' descriptors
-    QLinkedList< AllocatedPixmap * >::const_iterator aIt = d->m_allocatedPixmapsFifo.constBegin();
-    QLinkedList< AllocatedPixmap * >::const_iterator aEnd = d->m_allocatedPixmapsFifo.constEnd();
-    for ( ; aIt != aEnd; ++aIt )
-        delete *aIt;
-    d->m_allocatedPixmapsFifo.clear();
-    d->m_allocatedPixmapsTotalMemory = 0;
+    d->m_pixmapCache.clear();
     // notify the generator that the current page size has changed
     d->m_generator->pageSizeChanged( size, d->m_pageSize );
     // set the new page size
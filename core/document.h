@@ -218,6 +218,14 @@ class OKULAR_EXPORT Document : public QObject
          */
         bool supportsPageSizes() const;
 
+        /**
+         * Returns whether the document can render parts of its pages,
+         * see PixmapRequest::setTile().
+         *
+         * @since 0.15 (KDE 4.9)
+         */
+        bool supportsTiles() const;
+
         /**
          * Returns the list of supported page sizes or an empty list if this
          * feature is not available.
@@ -362,6 +370,18 @@ class OKULAR_EXPORT Document : public QObject
          */
         void requestTextPage( uint number );
 
+        /**
+         * Starts extracting in background the text pages of the given
+         * @p pages, which are going to be requested in that order with
+         * requestTextPage(); it replaces the pages of the previous call.
+         *
+         * It does nothing if the generator cannot extract text pages in
+         * background.
+         *
+         * @since 0.15 (KDE 4.9)
+         */
+        void prefetchTextPages( const QList< int > &pages );
+
         /**
          * Adds a new @p annotation to the given @p page.
          */
@@ -811,10 +831,14 @@ class OKULAR_EXPORT Document : public QObject
 
         Q_PRIVATE_SLOT( d, void saveDocumentInfo() const )
         Q_PRIVATE_SLOT( d, void slotTimedMemoryCheck() )
+        Q_PRIVATE_SLOT( d, void indexNextTextPage() )
         Q_PRIVATE_SLOT( d, void sendGeneratorRequest() )
+        Q_PRIVATE_SLOT( d, void diskCachedPixmapLoaded( void *request, const QImage &image ) )
         Q_PRIVATE_SLOT( d, void rotationFinished( int page, Okular::Page *okularPage ) )
         Q_PRIVATE_SLOT( d, void fontReadingProgress( int page ) )
         Q_PRIVATE_SLOT( d, void fontReadingGotFont( const Okular::FontInfo& font ) )
+        Q_PRIVATE_SLOT( d, void boundingBoxExtracted( int page, const Okular::NormalizedRect &boundingBox ) )
+        Q_PRIVATE_SLOT( d, void relayoutResizedPages() )
         Q_PRIVATE_SLOT( d, void slotGeneratorConfigChanged( const QString& ) )
         Q_PRIVATE_SLOT( d, void refreshPixmaps( int ) )
         Q_PRIVATE_SLOT( d, void _o_configChanged() )
@@ -26,12 +26,14 @@
 // local includes
 #include "fontinfo.h"
 #include "generator.h"
+#include "pixmapcache_p.h"
+#include "pixmaprequestqueue_p.h"
 
 class QEventLoop;
+class QImage;
 class QTimer;
 class KTemporaryFile;
 
-struct AllocatedPixmap;
 struct ArchiveData;
 struct RunningSearch;
 
@@ -61,7 +63,10 @@ struct GeneratorInfo
 
 namespace Okular {
 
+class BoundingBoxExtractionThread;
 class FontExtractionThread;
+class PixmapDiskCache;
+class TextIndex;
 
 class DocumentPrivate
 {
@@ -71,19 +76,24 @@ class DocumentPrivate
             m_lastSearchID( -1 ),
             m_tempFile( 0 ),
             m_docSize( -1 ),
-            m_allocatedPixmapsTotalMemory( 0 ),
             m_maxAllocatedTextPages( 0 ),
             m_warnedOutOfMemory( false ),
+            m_pixmapDiskCache( 0 ),
+            m_averageRenderRate( 0 ),
+            m_textIndex( 0 ),
+            m_indexedTextPage( -1 ),
             m_rotation( Rotation0 ),
             m_exportCached( false ),
             m_bookmarkManager( 0 ),
             m_memCheckTimer( 0 ),
             m_saveBookmarksTimer( 0 ),
+            m_relayoutTimer( 0 ),
             m_generator( 0 ),
             m_generatorsLoaded( false ),
             m_closingLoop( 0 ),
             m_scripter( 0 ),
             m_archiveData( 0 ),
+            m_boundingBoxesExtracted( false ),
             m_fontsCached( false ),
             m_documentInfo( 0 ),
             m_annotationEditingEnabled ( true ),
@@ -96,6 +106,12 @@ class DocumentPrivate
         QString pagesSizeString() const;
         QString localizedSize(const QSizeF &size) const;
         void cleanupPixmapMemory( qulonglong bytesOffset = 0 );
+        void savePixmapDiskCache();
+        /**
+         * Starts computing the bounding boxes of all the pages in background,
+         * if they are needed to trim the margins and the generator can.
+         */
+        void startBoundingBoxExtraction();
         void calculateMaxTextPages();
         qulonglong getTotalMemory();
         qulonglong getFreeMemory();
@@ -125,10 +141,14 @@ class DocumentPrivate
         // private slots
         void saveDocumentInfo() const;
         void slotTimedMemoryCheck();
+        void indexNextTextPage();
         void sendGeneratorRequest();
+        void diskCachedPixmapLoaded( void *request, const QImage &image );
         void rotationFinished( int page, Okular::Page *okularPage );
         void fontReadingProgress( int page );
         void fontReadingGotFont( const Okular::FontInfo& font );
+        void boundingBoxExtracted( int page, const Okular::NormalizedRect &boundingBox );
+        void relayoutResizedPages();
         void slotGeneratorConfigChanged( const QString& );
         void refreshPixmaps( int );
         void _o_configChanged();
@@ -145,11 +165,45 @@ class DocumentPrivate
          * the pixmap generation @p request.
          */
         void requestDone( PixmapRequest * request );
+        /**
+         * Splits the tile @p request in requests for the single tiles of
+         * the page not rendered yet, consuming @p request.
+         */
+        QLinkedList< PixmapRequest * > splitTileRequest( PixmapRequest * request );
+        PixmapRequest * findSameRequest( const PixmapRequest * request ) const;
+        /**
+         * Returns whether a low resolution preview of the page should be
+         * rendered before the full size pixmap of the @p request.
+         */
+        bool needsPreview( const PixmapRequest * request ) const;
+        /**
+         * Queues more pages of m_textPagesToPrefetch for the background text
+         * extraction, as long as there is room for their text pages.
+         */
+        void prefetchTextPages();
+        /**
+         * Records that the text page of @p pageNumber was used.
+         */
+        void textPageUsed( int pageNumber );
+        /**
+         * Makes sure the @p pageNumber has its text page.
+         */
+        void ensureTextPage( int pageNumber );
+        /**
+         * Prefetches the pages the @p search will look at, starting from
+         * @p fromPage in the direction of @p step.
+         */
+        void prefetchSearchPages( const RunningSearch *search, int fromPage, int step );
         void textGenerationDone( Page *page );
         /**
          * Sets the bounding box of the given @p page (in terms of upright orientation, i.e., Rotation0).
          */
         void setPageBoundingBox( int page, const NormalizedRect& boundingBox );
+        /**
+         * Sets the actual size of the given @p page, created with an estimated
+         * one (in terms of upright orientation, i.e., Rotation0).
+         */
+        void resizePage( int page, double width, double height );
         /**
          * Request a particular metadata of the Document itself (ie, not something
          * depending on the document type/backend).
@@ -183,14 +237,25 @@ class DocumentPrivate
 
         // observers / requests / allocator stuff
         QMap< int, DocumentObserver * > m_observers;
-        QLinkedList< PixmapRequest * > m_pixmapRequestsStack;
+        PixmapRequestQueue m_pixmapRequestsQueue;
         QLinkedList< PixmapRequest * > m_executingPixmapRequests;
         QMutex m_pixmapRequestsMutex;
-        QLinkedList< AllocatedPixmap * > m_allocatedPixmapsFifo;
-        qulonglong m_allocatedPixmapsTotalMemory;
+        PixmapCache m_pixmapCache;
         QList< int > m_allocatedTextPagesFifo;
+        // the pages whose text page is wanted soon, and the ones already
+        // queued for the background extraction (see prefetchTextPages())
+        QList< int > m_textPagesToPrefetch;
+        QList< int > m_prefetchedTextPages;
         int m_maxAllocatedTextPages;
         bool m_warnedOutOfMemory;
+        PixmapDiskCache *m_pixmapDiskCache;
+        // milliseconds taken to render a megapixel, for each page and on average
+        QHash< int, double > m_pageRenderRates;
+        double m_averageRenderRate;
+        // the words of the pages, to skip the ones not matching a search
+        TextIndex *m_textIndex;
+        // the page being extracted in background only to be indexed, or -1
+        int m_indexedTextPage;
 
         // the rotation applied to the document
         Rotation m_rotation;
@@ -211,6 +276,7 @@ class DocumentPrivate
         // timers (memory checking / info saver)
         QTimer *m_memCheckTimer;
         QTimer *m_saveBookmarksTimer;
+        QTimer *m_relayoutTimer;
 
         QHash<QString, GeneratorInfo> m_loadedGenerators;
         Generator * m_generator;
@@ -230,6 +296,9 @@ class DocumentPrivate
         QString m_archivedFileName;
 
         QPointer< FontExtractionThread > m_fontThread;
+        QPointer< BoundingBoxExtractionThread > m_boundingBoxThread;
+        // whether the bounding boxes of all the pages were extracted already
+        bool m_boundingBoxesExtracted;
         bool m_fontsCached;
         DocumentInfo *m_documentInfo;
         FontInfo::List m_fontsCache;
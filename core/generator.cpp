@@ -22,46 +22,52 @@
 #include "document_p.h"
 #include "page.h"
 #include "textpage.h"
+#include "tilesmanager_p.h"
 #include "utils.h"
 
 using namespace Okular;
 
 GeneratorPrivate::GeneratorPrivate()
     : m_document( 0 ),
-      mPixmapGenerationThread( 0 ), mTextPageGenerationThread( 0 ),
-      m_mutex( 0 ), m_threadsMutex( 0 ), mPixmapReady( true ), mTextPageReady( true ),
-      m_closing( false ), m_closingLoop( 0 )
+      mTextPageGenerationThread( 0 ),
+      m_mutex( 0 ), m_threadsMutex( 0 ), mPixmapThreadsCount( 1 ), mRunningPixmapGenerations( 0 ),
+      mTextPageThreadsCount( 0 ), mTextPageReady( true ), m_closing( false ), m_closingLoop( 0 )
 {
 }
 
 GeneratorPrivate::~GeneratorPrivate()
 {
-    if ( mPixmapGenerationThread )
-        mPixmapGenerationThread->wait();
+    foreach ( PixmapGenerationThread *thread, mPixmapGenerationThreads )
+        thread->wait();
 
-    delete mPixmapGenerationThread;
+    qDeleteAll( mPixmapGenerationThreads );
 
     if ( mTextPageGenerationThread )
         mTextPageGenerationThread->wait();
 
     delete mTextPageGenerationThread;
 
+    stopTextPageExtraction();
+    qDeleteAll( mTextPageExtractionThreads );
+
     delete m_mutex;
     delete m_threadsMutex;
 }
 
 PixmapGenerationThread* GeneratorPrivate::pixmapGenerationThread()
 {
-    if ( mPixmapGenerationThread )
-        return mPixmapGenerationThread;
+    foreach ( PixmapGenerationThread *thread, mPixmapGenerationThreads )
+        if ( !thread->request() )
+            return thread;
 
     Q_Q( Generator );
-    mPixmapGenerationThread = new PixmapGenerationThread( q );
-    QObject::connect( mPixmapGenerationThread, SIGNAL(finished()),
+    PixmapGenerationThread *thread = new PixmapGenerationThread( q );
+    QObject::connect( thread, SIGNAL(finished()),
                       q, SLOT(pixmapGenerationFinished()),
                       Qt::QueuedConnection );
+    mPixmapGenerationThreads.append( thread );
 
-    return mPixmapGenerationThread;
+    return thread;
 }
 
 TextPageGenerationThread* GeneratorPrivate::textPageGenerationThread()
@@ -81,30 +87,53 @@ TextPageGenerationThread* GeneratorPrivate::textPageGenerationThread()
 void GeneratorPrivate::pixmapGenerationFinished()
 {
     Q_Q( Generator );
-    PixmapRequest *request = mPixmapGenerationThread->request();
-    mPixmapGenerationThread->endGeneration();
-
-    QMutexLocker locker( threadsLock() );
-    mPixmapReady = true;
 
-    if ( m_closing )
+    // the finished() notifications are queued, so collect every thread
+    // which is done by now; the later notifications will find nothing left
+    foreach ( PixmapGenerationThread *thread, mPixmapGenerationThreads )
     {
-        delete request;
-        if ( mTextPageReady )
+        PixmapRequest *request = thread->request();
+        if ( !request || !thread->isDone() )
+            continue;
+
+        const QImage img = thread->image();
+        // the bounding box might have been computed by the generator meanwhile
+        const bool calcBoundingBox = thread->calcBoundingBox() && !request->page()->isBoundingBoxKnown();
+        const NormalizedRect boundingBox = thread->boundingBox();
+        thread->endGeneration();
+
+        QMutexLocker locker( threadsLock() );
+        --mRunningPixmapGenerations;
+
+        if ( m_closing )
         {
-            locker.unlock();
-            m_closingLoop->quit();
+            delete request;
+            if ( mRunningPixmapGenerations == 0 && mTextPageReady )
+            {
+                locker.unlock();
+                m_closingLoop->quit();
+            }
+            continue;
         }
-        return;
-    }
+        locker.unlock();
 
-    const QImage& img = mPixmapGenerationThread->image();
-    request->page()->setPixmap( request->id(), new QPixmap( QPixmap::fromImage( img ) ) );
-    const int pageNumber = request->page()->number();
+        // an aborted request has no valid image, just hand it back
+        if ( request->shouldAbortRender() )
+        {
+            q->signalPixmapRequestDone( request );
+            continue;
+        }
 
-    q->signalPixmapRequestDone( request );
-    if ( mPixmapGenerationThread->calcBoundingBox() )
-        q->updatePageBoundingBox( pageNumber, mPixmapGenerationThread->boundingBox() );
+        if ( request->isTile() )
+            request->page()->setPixmap( request->id(), new QPixmap( QPixmap::fromImage( img ) ), request->normalizedRect() );
+        else
+            request->page()->setPixmap( request->id(), new QPixmap( QPixmap::fromImage( img ) ) );
+        const int pageNumber = request->page()->number();
+
+        q->signalPixmapRequestDone( request );
+        if ( calcBoundingBox )
+            q->updatePageBoundingBox( pageNumber, boundingBox );
+    }
 }
 
 void GeneratorPrivate::textpageGenerationFinished()
@@ -119,7 +148,7 @@ void GeneratorPrivate::textpageGenerationFinished()
     if ( m_closing )
     {
         delete mTextPageGenerationThread->textPage();
-        if ( mPixmapReady )
+        if ( mRunningPixmapGenerations == 0 )
         {
             locker.unlock();
             m_closingLoop->quit();
@@ -135,6 +164,114 @@ void GeneratorPrivate::textpageGenerationFinished()
     }
 }
 
+bool GeneratorPrivate::extractTextPage( Page *page )
+{
+    Q_Q( Generator );
+    if ( mTextPageThreadsCount < 1 || !q->hasFeature( Generator::Threaded ) || !q->hasFeature( Generator::TextExtraction ) )
+        return false;
+
+    QMutexLocker locker( &mTextPagesMutex );
+    if ( mTextPagesToExtract.contains( page ) || mExtractingTextPages.contains( page ) )
+        return true;
+
+    mTextPagesToExtract.append( page );
+
+    // an active thread not extracting anything is going to take it
+    const int activeThreads = mActiveTextPageExtractionThreads.count();
+    if ( activeThreads > mExtractingTextPages.count() || activeThreads >= mTextPageThreadsCount )
+        return true;
+
+    TextPageExtractionThread *thread = 0;
+    foreach ( TextPageExtractionThread *t, mTextPageExtractionThreads )
+    {
+        if ( !mActiveTextPageExtractionThreads.contains( t ) )
+        {
+            thread = t;
+            break;
+        }
+    }
+    if ( !thread )
+    {
+        thread = new TextPageExtractionThread( q );
+        QObject::connect( thread, SIGNAL(textPageExtracted()),
+                          q, SLOT(textPagesExtracted()),
+                          Qt::QueuedConnection );
+        mTextPageExtractionThreads.append( thread );
+    }
+
+    // the thread may still be finishing after leaving the active ones
+    thread->wait();
+    mActiveTextPageExtractionThreads.insert( thread );
+    thread->start( QThread::LowPriority );
+    return true;
+}
+
+int GeneratorPrivate::pendingTextPages()
+{
+    QMutexLocker locker( &mTextPagesMutex );
+    return mTextPagesToExtract.count() + mExtractingTextPages.count();
+}
+
+void GeneratorPrivate::waitForTextPage( Page *page )
+{
+    mTextPagesMutex.lock();
+    mTextPagesToExtract.removeAll( page );
+    while ( mExtractingTextPages.contains( page ) )
+        mTextPagesCondition.wait( &mTextPagesMutex );
+
+    // the page might have been extracted already, with the notification of
+    // the thread not delivered yet
+    bool extracted = false;
+    QList< QPair< Page *, TextPage * > >::const_iterator it = mExtractedTextPages.constBegin(), end = mExtractedTextPages.constEnd();
+    for ( ; !extracted && it != end; ++it )
+        extracted = (*it).first == page;
+    mTextPagesMutex.unlock();
+
+    if ( extracted )
+        textPagesExtracted();
+}
+
+void GeneratorPrivate::stopTextPageExtraction()
+{
+    mTextPagesMutex.lock();
+    mTextPagesToExtract.clear();
+    mTextPagesMutex.unlock();
+
+    foreach ( TextPageExtractionThread *thread, mTextPageExtractionThreads )
+        thread->wait();
+
+    // nobody wants these anymore
+    QList< QPair< Page *, TextPage * > >::const_iterator it = mExtractedTextPages.constBegin(), end = mExtractedTextPages.constEnd();
+    for ( ; it != end; ++it )
+        delete (*it).second;
+    mExtractedTextPages.clear();
+}
+
+void GeneratorPrivate::textPagesExtracted()
+{
+    mTextPagesMutex.lock();
+    const QList< QPair< Page *, TextPage * > > extracted = mExtractedTextPages;
+    mExtractedTextPages.clear();
+    mTextPagesMutex.unlock();
+
+    Q_Q( Generator );
+    QList< QPair< Page *, TextPage * > >::const_iterator it = extracted.constBegin(), end = extracted.constEnd();
+    for ( ; it != end; ++it )
+    {
+        Page *page = (*it).first;
+        TextPage *textPage = (*it).second;
+        // the page might have got a text page in the meanwhile
+        if ( page->hasTextPage() )
+        {
+            delete textPage;
+            continue;
+        }
+
+        page->setTextPage( textPage );
+        q->signalTextGenerationDone( page, textPage );
+    }
+}
+
 QMutex* GeneratorPrivate::threadsLock()
 {
     if ( !m_threadsMutex )
@@ -183,8 +320,10 @@ bool Generator::closeDocument()
 
     d->m_closing = true;
 
+    d->stopTextPageExtraction();
+
     d->threadsLock()->lock();
-    if ( !( d->mPixmapReady && d->mTextPageReady ) )
+    if ( d->mRunningPixmapGenerations > 0 || !d->mTextPageReady )
     {
         QEventLoop loop;
         d->m_closingLoop = &loop;
@@ -210,17 +349,20 @@ bool Generator::closeDocument()
 bool Generator::canGeneratePixmap() const
 {
     Q_D( const Generator );
-    return d->mPixmapReady;
+    const int threads = hasFeature( Threaded ) ? d->mPixmapThreadsCount : 1;
+    return d->mRunningPixmapGenerations < threads;
 }
 
 void Generator::generatePixmap( PixmapRequest *request )
 {
     Q_D( Generator );
-    d->mPixmapReady = false;
+    ++d->mRunningPixmapGenerations;
 
     if ( request->asynchronous() && hasFeature( Threaded ) )
     {
-        d->pixmapGenerationThread()->startGeneration( request, !request->page()->isBoundingBoxKnown() );
+        // the bounding box can be computed only out of a whole page image
+        const bool calcBoundingBox = !request->isTile() && !request->page()->isBoundingBoxKnown();
+        d->pixmapGenerationThread()->startGeneration( request, calcBoundingBox );
 
         /**
          * We create the text page for every page that is visible to the
@@ -235,11 +377,14 @@ void Generator::generatePixmap( PixmapRequest *request )
     }
 
     const QImage& img = image( request );
-    request->page()->setPixmap( request->id(), new QPixmap( QPixmap::fromImage( img ) ) );
-    const bool bboxKnown = request->page()->isBoundingBoxKnown();
+    if ( request->isTile() )
+        request->page()->setPixmap( request->id(), new QPixmap( QPixmap::fromImage( img ) ), request->normalizedRect() );
+    else
+        request->page()->setPixmap( request->id(), new QPixmap( QPixmap::fromImage( img ) ) );
+    const bool bboxKnown = request->page()->isBoundingBoxKnown() || request->isTile();
     const int pageNumber = request->page()->number();
 
-    d->mPixmapReady = true;
+    --d->mRunningPixmapGenerations;
 
     signalPixmapRequestDone( request );
     if ( !bboxKnown )
@@ -271,6 +416,11 @@ TextPage* Generator::textPage( Page* )
     return 0;
 }
 
+NormalizedRect Generator::pageBoundingBox( Page* )
+{
+    return NormalizedRect();
+}
+
 const DocumentInfo * Generator::generateDocumentInfo()
 {
     return 0;
@@ -385,6 +535,18 @@ void Generator::setFeature( GeneratorFeature feature, bool on )
         d->m_features.remove( feature );
 }
 
+void Generator::setPixmapGenerationThreads( int threads )
+{
+    Q_D( Generator );
+    d->mPixmapThreadsCount = qBound( 1, threads, qMax( QThread::idealThreadCount(), 1 ) );
+}
+
+void Generator::setTextPageGenerationThreads( int threads )
+{
+    Q_D( Generator );
+    d->mTextPageThreadsCount = qBound( 0, threads, qMax( QThread::idealThreadCount(), 1 ) );
+}
+
 QVariant Generator::documentMetaData( const QString &key, const QVariant &option ) const
 {
     Q_D( const Generator );
@@ -411,6 +573,13 @@ void Generator::updatePageBoundingBox( int page, const NormalizedRect & bounding
         d->m_document->setPageBoundingBox( page, boundingBox );
 }
 
+void Generator::updatePageSize( int page, double width, double height )
+{
+    Q_D( Generator );
+    if ( d->m_document ) // still connected to document?
+        d->m_document->resizePage( page, width, height );
+}
+
 void Generator::requestFontData(const Okular::FontInfo & /*font*/, QByteArray * /*data*/)
 {
 
@@ -431,10 +600,17 @@ PixmapRequest::PixmapRequest( int id, int pageNumber, int width, int height, int
     d->mPriority = priority;
     d->mAsynchronous = asynchronous;
     d->mForce = false;
+    d->mTile = false;
+    d->mShouldAbortRender = 0;
+    d->mNormalizedRect = NormalizedRect( 0., 0., 1., 1. );
+    d->mQueuePosition = -1;
+    d->mQueueSerial = 0;
+    d->mFullRequest = 0;
 }
 
 PixmapRequest::~PixmapRequest()
 {
+    delete d->mFullRequest;
     delete d;
 }
 
@@ -473,6 +649,36 @@ Page* PixmapRequest::page() const
     return d->mPage;
 }
 
+void PixmapRequest::setTile( bool tile )
+{
+    d->mTile = tile;
+}
+
+bool PixmapRequest::isTile() const
+{
+    return d->mTile;
+}
+
+void PixmapRequest::setNormalizedRect( const NormalizedRect &rect )
+{
+    d->mNormalizedRect = rect;
+}
+
+const NormalizedRect& PixmapRequest::normalizedRect() const
+{
+    return d->mNormalizedRect;
+}
+
+QRect PixmapRequest::pixelRect() const
+{
+    return TilesManager::pixelRect( d->mNormalizedRect, d->mWidth, d->mHeight );
+}
+
+bool PixmapRequest::shouldAbortRender() const
+{
+    return d->mShouldAbortRender.fetchAndAddAcquire( 0 ) != 0;
+}
+
 void PixmapRequestPrivate::swap()
 {
     qSwap( mWidth, mHeight );
@@ -590,6 +796,11 @@ QDebug operator<<( QDebug str, const Okular::PixmapRequest &req )
         .arg( req.height() )
         .arg( req.priority() )
         .arg( req.pageNumber() );
+    if ( req.isTile() )
+    {
+        const QRect r = req.pixelRect();
+        s += QString( " tile(%1,%2 %3x%4)" ).arg( r.x() ).arg( r.y() ).arg( r.width() ).arg( r.height() );
+    }
     str << qPrintable( s );
     return str;
 }
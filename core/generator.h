@@ -13,12 +13,14 @@
 #define _OKULAR_GENERATOR_H_
 
 #include "okular_export.h"
+#include "area.h"
 #include "fontinfo.h"
 #include "global.h"
 #include "pagesize.h"
 
 #include <QtCore/QList>
 #include <QtCore/QObject>
+#include <QtCore/QRect>
 #include <QtCore/QSharedDataPointer>
 #include <QtCore/QString>
 #include <QtCore/QVariant>
@@ -39,6 +41,7 @@ class KIcon;
 
 namespace Okular {
 
+class AccountedCache;
 class Document;
 class DocumentFonts;
 class DocumentInfo;
@@ -185,6 +188,7 @@ class OKULAR_EXPORT Generator : public QObject
 {
     /// @cond PRIVATE
     friend class PixmapGenerationThread;
+    friend class TextPageExtractionThread;
     friend class TextPageGenerationThread;
     /// @endcond
 
@@ -204,7 +208,9 @@ class OKULAR_EXPORT Generator : public QObject
             PageSizes,         ///< Whether the Generator can change the size of the document pages.
             PrintNative,       ///< Whether the Generator supports native cross-platform printing (QPainter-based).
             PrintPostscript,   ///< Whether the Generator supports postscript-based file printing.
-            PrintToFile        ///< Whether the Generator supports export to PDF & PS through the Print Dialog
+            PrintToFile,       ///< Whether the Generator supports export to PDF & PS through the Print Dialog
+            TiledRendering,    ///< Whether the Generator can render only a part of a page (see PixmapRequest::isTile()). @since 0.15 (KDE 4.9)
+            PageBoundingBoxes  ///< Whether the Generator can compute the bounding box of the contents of a page without rendering it (see pageBoundingBox()). @since 0.15 (KDE 4.9)
         };
 
         /**
@@ -430,6 +436,9 @@ class OKULAR_EXPORT Generator : public QObject
          * Returns the image of the page as specified in
          * the passed pixmap @p request.
          *
+         * Long renderings should check PixmapRequest::shouldAbortRender() and
+         * return early (with any image) when it becomes true.
+         *
          * @warning this method may be executed in its own separated thread if the
          * @ref Threaded is enabled!
          */
@@ -443,6 +452,22 @@ class OKULAR_EXPORT Generator : public QObject
          */
         virtual TextPage* textPage( Page *page );
 
+        /**
+         * Returns the bounding box of the contents of the given @p page,
+         * computed from the document data rather than by scanning a rendered
+         * pixmap, or a null rect if it cannot be computed (in that case it
+         * will be computed from the first pixmap of the page, as usual).
+         *
+         * It is called for all the pages after the document is loaded, if the
+         * generator has the @ref PageBoundingBoxes feature enabled.
+         *
+         * @warning this method may be executed in its own separated thread if the
+         * @ref Threaded is enabled, concurrently with image() and textPage()!
+         *
+         * @since 0.15 (KDE 4.9)
+         */
+        virtual NormalizedRect pageBoundingBox( Page *page );
+
         /**
          * Returns a pointer to the document.
          */
@@ -453,6 +478,32 @@ class OKULAR_EXPORT Generator : public QObject
          */
         void setFeature( GeneratorFeature feature, bool on = true );
 
+        /**
+         * Sets how many pixmaps the generator can render at the same time
+         * (the default is 1); it is meaningful only for generators with the
+         * @ref Threaded feature, and it is bounded by the number of cores.
+         *
+         * @warning with more than one thread, image() will be executed
+         * concurrently, so it must not share any state without locking.
+         *
+         * @since 0.15 (KDE 4.9)
+         */
+        void setPixmapGenerationThreads( int threads );
+
+        /**
+         * Sets how many text pages the generator can extract at the same time
+         * in background, when many of them are needed (e.g. for a search);
+         * the default is 0, i.e. no background extraction. It is meaningful
+         * only for generators with the @ref Threaded feature, and it is
+         * bounded by the number of cores.
+         *
+         * @warning textPage() will be executed concurrently, also with
+         * image(), so it must not share any state without locking.
+         *
+         * @since 0.15 (KDE 4.9)
+         */
+        void setTextPageGenerationThreads( int threads );
+
         /**
          * Request a meta data of the Document, if available, like an internal
          * setting.
@@ -473,6 +524,16 @@ class OKULAR_EXPORT Generator : public QObject
          */
         void updatePageBoundingBox( int page, const NormalizedRect & boundingBox );
 
+        /**
+         * Sets the actual size of a page created with an estimated one (see
+         * Page::setSizeKnown()), in terms of the upright orientation, after the
+         * page has already been handed to the Document; the pages are laid
+         * out again.
+         *
+         * @since 0.15 (KDE 4.9)
+         */
+        void updatePageSize( int page, double width, double height );
+
     protected Q_SLOTS:
         /**
          * Gets the font data for the given font
@@ -502,6 +563,7 @@ class OKULAR_EXPORT Generator : public QObject
         Q_DECLARE_PRIVATE( Generator )
         GeneratorPrivate *d_ptr;
 
+        friend class AccountedCache;
         friend class Document;
         friend class DocumentPrivate;
         /// @endcond PRIVATE
@@ -511,6 +573,7 @@ class OKULAR_EXPORT Generator : public QObject
 
         Q_PRIVATE_SLOT( d_func(), void pixmapGenerationFinished() )
         Q_PRIVATE_SLOT( d_func(), void textpageGenerationFinished() )
+        Q_PRIVATE_SLOT( d_func(), void textPagesExtracted() )
 };
 
 /**
@@ -520,6 +583,7 @@ class OKULAR_EXPORT PixmapRequest
 {
     friend class Document;
     friend class DocumentPrivate;
+    friend class PixmapRequestQueue;
 
     public:
         /**
@@ -579,6 +643,63 @@ class OKULAR_EXPORT PixmapRequest
          */
         Page *page() const;
 
+        /**
+         * Sets whether the request is for a part of the page only (a tile),
+         * described by normalizedRect().
+         *
+         * The Document splits such requests in fixed-size tiles before
+         * handing them to the generator, and only if the generator has the
+         * @ref Generator::TiledRendering feature; otherwise the request is
+         * served as a whole page request.
+         *
+         * @since 0.15 (KDE 4.9)
+         */
+        void setTile( bool tile );
+
+        /**
+         * Returns whether the request is for a part of the page only.
+         *
+         * @since 0.15 (KDE 4.9)
+         */
+        bool isTile() const;
+
+        /**
+         * Sets the area of the page, in normalized coordinates of the upright
+         * page, the request refers to.
+         *
+         * @since 0.15 (KDE 4.9)
+         */
+        void setNormalizedRect( const NormalizedRect &rect );
+
+        /**
+         * Returns the area of the page the request refers to; it is the whole
+         * page for non-tile requests.
+         *
+         * @since 0.15 (KDE 4.9)
+         */
+        const NormalizedRect& normalizedRect() const;
+
+        /**
+         * Returns the area to render, in pixels of a width() x height() page.
+         *
+         * The generator has to return an image of exactly this size for tile
+         * requests.
+         *
+         * @since 0.15 (KDE 4.9)
+         */
+        QRect pixelRect() const;
+
+        /**
+         * Returns whether the result of the request is not needed anymore
+         * (e.g. the page scrolled out of view), so the generator can stop
+         * rendering it as soon as possible; the image it returns is discarded.
+         *
+         * This method can be called from any thread.
+         *
+         * @since 0.15 (KDE 4.9)
+         */
+        bool shouldAbortRender() const;
+
     private:
         Q_DISABLE_COPY( PixmapRequest )
 
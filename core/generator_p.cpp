@@ -13,19 +13,28 @@
 
 #include "fontinfo.h"
 #include "generator.h"
+#include "page.h"
+#include "page_p.h"
+#include "textpage.h"
+#include "textpage_p.h"
 #include "utils.h"
 
 using namespace Okular;
 
 PixmapGenerationThread::PixmapGenerationThread( Generator *generator )
-    : mGenerator( generator ), mRequest( 0 ), mCalcBoundingBox( false )
+    : mGenerator( generator ), mRequest( 0 ), mCalcBoundingBox( false ), mDone( 0 )
 {
 }
 
 void PixmapGenerationThread::startGeneration( PixmapRequest *request, bool calcBoundingBox )
 {
+    // the previous run() might be over while the thread is still finishing,
+    // and in that case start() would do nothing
+    wait();
+
     mRequest = request;
     mCalcBoundingBox = calcBoundingBox;
+    mDone = 0;
 
     start( QThread::InheritPriority );
 }
@@ -33,6 +42,7 @@ void PixmapGenerationThread::startGeneration( PixmapRequest *request, bool calcB
 void PixmapGenerationThread::endGeneration()
 {
     mRequest = 0;
+    mDone = 0;
 }
 
 PixmapRequest *PixmapGenerationThread::request() const
@@ -40,6 +50,11 @@ PixmapRequest *PixmapGenerationThread::request() const
     return mRequest;
 }
 
+bool PixmapGenerationThread::isDone() const
+{
+    return mDone.fetchAndAddAcquire( 0 ) != 0;
+}
+
 QImage PixmapGenerationThread::image() const
 {
     return mImage;
@@ -59,12 +74,14 @@ void PixmapGenerationThread::run()
 {
     mImage = QImage();
 
-    if ( mRequest )
+    if ( mRequest && !mRequest->shouldAbortRender() )
     {
         mImage = mGenerator->image( mRequest );
-        if ( mCalcBoundingBox )
+        if ( mCalcBoundingBox && !mRequest->shouldAbortRender() )
             mBoundingBox = Utils::imageBoundingBox( &mImage );
     }
+
+    mDone.fetchAndStoreRelease( 1 );
 }
 
 
@@ -104,8 +121,50 @@ void TextPageGenerationThread::run()
 }
 
 
+TextPageExtractionThread::TextPageExtractionThread( Generator *generator )
+    : mGenerator( generator )
+{
+}
+
+void TextPageExtractionThread::run()
+{
+    GeneratorPrivate *d = mGenerator->d_func();
+
+    forever
+    {
+        d->mTextPagesMutex.lock();
+        if ( d->mTextPagesToExtract.isEmpty() )
+        {
+            d->mActiveTextPageExtractionThreads.remove( this );
+            d->mTextPagesMutex.unlock();
+            return;
+        }
+        Page *page = d->mTextPagesToExtract.takeFirst();
+        d->mExtractingTextPages.insert( page );
+        d->mTextPagesMutex.unlock();
+
+        // the text layout analysis is expensive too, so do it here rather
+        // than when the text page is set in the GUI thread
+        TextPage *textPage = mGenerator->textPage( page );
+        if ( textPage )
+        {
+            textPage->d->m_page = page->d;
+            textPage->d->correctTextOrder();
+        }
+
+        d->mTextPagesMutex.lock();
+        d->mExtractingTextPages.remove( page );
+        d->mExtractedTextPages.append( qMakePair( page, textPage ) );
+        d->mTextPagesCondition.wakeAll();
+        d->mTextPagesMutex.unlock();
+
+        emit textPageExtracted();
+    }
+}
+
+
 FontExtractionThread::FontExtractionThread( Generator *generator, int pages )
-    : mGenerator( generator ), mNumOfPages( pages ), mGoOn( true )
+    : mGenerator( generator ), mNumOfPages( pages ), mGoOn( 1 )
 {
 }
 
@@ -125,12 +184,12 @@ void FontExtractionThread::startExtraction( bool async )
 
 void FontExtractionThread::stopExtraction()
 {
-    mGoOn = false;
+    mGoOn.fetchAndStoreRelease( 0 );
 }
 
 void FontExtractionThread::run()
 {
-    for ( int i = -1; i < mNumOfPages && mGoOn; ++i )
+    for ( int i = -1; i < mNumOfPages && mGoOn.fetchAndAddAcquire( 0 ); ++i )
     {
         FontInfo::List list = mGenerator->fontsForPage( i );
         foreach ( const FontInfo& fi, list )
@@ -141,4 +200,40 @@ void FontExtractionThread::run()
     }
 }
 
+BoundingBoxExtractionThread::BoundingBoxExtractionThread( Generator *generator, const QVector< Page * > &pages )
+    : mGenerator( generator ), mPages( pages ), mGoOn( 1 )
+{
+    qRegisterMetaType< Okular::NormalizedRect >();
+}
+
+void BoundingBoxExtractionThread::startExtraction( bool async )
+{
+    if ( async )
+    {
+        connect( this, SIGNAL(finished()), this, SLOT(deleteLater()) );
+        start( QThread::LowPriority );
+    }
+    else
+    {
+        run();
+        deleteLater();
+    }
+}
+
+void BoundingBoxExtractionThread::stopExtraction()
+{
+    mGoOn.fetchAndStoreRelease( 0 );
+}
+
+void BoundingBoxExtractionThread::run()
+{
+    for ( int i = 0; i < mPages.count() && mGoOn.fetchAndAddAcquire( 0 ); ++i )
+    {
+        Page *page = mPages.at( i );
+        const NormalizedRect boundingBox = mGenerator->pageBoundingBox( page );
+        if ( !boundingBox.isNull() )
+            emit gotBoundingBox( page->number(), boundingBox );
+    }
+}
+
 #include "generator_p.moc"
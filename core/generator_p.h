@@ -12,15 +12,22 @@
 
 #include "area.h"
 
+#include <QtCore/QAtomicInt>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QPair>
 #include <QtCore/QSet>
 #include <QtCore/QThread>
+#include <QtCore/QTime>
+#include <QtCore/QVector>
+#include <QtCore/QWaitCondition>
 #include <QtGui/QImage>
 
 class QEventLoop;
-class QMutex;
 
 namespace Okular {
 
+class AccountedCache;
 class DocumentPrivate;
 class FontInfo;
 class Generator;
@@ -28,6 +35,7 @@ class Page;
 class PixmapGenerationThread;
 class PixmapRequest;
 class TextPage;
+class TextPageExtractionThread;
 class TextPageGenerationThread;
 
 class GeneratorPrivate
@@ -46,6 +54,28 @@ class GeneratorPrivate
         void pixmapGenerationFinished();
         void textpageGenerationFinished();
 
+        /**
+         * Queues the @p page for the batch text extraction; returns false if
+         * the generator does not support it.
+         */
+        bool extractTextPage( Page *page );
+        /**
+         * Returns how many pages are queued or being extracted.
+         */
+        int pendingTextPages();
+        /**
+         * Makes sure the text page of the @p page is not being extracted in
+         * background anymore: a queued page is removed from the queue, while
+         * for a page being extracted it waits for the extraction to finish;
+         * a text page already extracted is set to the page right away.
+         */
+        void waitForTextPage( Page *page );
+        /**
+         * Removes all the queued pages, and waits for the ones being extracted.
+         */
+        void stopTextPageExtraction();
+        void textPagesExtracted();
+
         QMutex* threadsLock();
 
         virtual QVariant metaData( const QString &key, const QVariant &option ) const;
@@ -55,11 +85,24 @@ class GeneratorPrivate
         // NOTE: the following should be a QSet< GeneratorFeature >,
         // but it is not to avoid #include'ing generator.h
         QSet< int > m_features;
-        PixmapGenerationThread *mPixmapGenerationThread;
+        QList< PixmapGenerationThread * > mPixmapGenerationThreads;
         TextPageGenerationThread *mTextPageGenerationThread;
         mutable QMutex *m_mutex;
         QMutex *m_threadsMutex;
-        bool mPixmapReady : 1;
+        int mPixmapThreadsCount;
+        int mRunningPixmapGenerations;
+        // the batch text extraction, see TextPageExtractionThread
+        QList< TextPageExtractionThread * > mTextPageExtractionThreads;
+        int mTextPageThreadsCount;
+        QList< Page * > mTextPagesToExtract;
+        QSet< Page * > mExtractingTextPages;
+        QSet< TextPageExtractionThread * > mActiveTextPageExtractionThreads;
+        QList< QPair< Page *, TextPage * > > mExtractedTextPages;
+        QMutex mTextPagesMutex;
+        QWaitCondition mTextPagesCondition;
+        // the caches of the generator, see AccountedCache
+        QList< AccountedCache * > mAccountedCaches;
+        mutable QMutex mAccountedCachesMutex;
         bool mTextPageReady : 1;
         bool m_closing : 1;
         QEventLoop *m_closingLoop;
@@ -78,7 +121,19 @@ class PixmapRequestPrivate
         int mPriority;
         bool mAsynchronous;
         bool mForce : 1;
+        bool mTile : 1;
+        // set by the document thread, read by the one rendering the request
+        QAtomicInt mShouldAbortRender;
         Page *mPage;
+        NormalizedRect mNormalizedRect;
+        // see PixmapRequestQueue
+        int mQueuePosition;
+        qulonglong mQueueSerial;
+        // how long the generation took, see PixmapCache
+        QTime mGenerationTime;
+        // the request for the full size page to queue when this preview is
+        // done, owned by this request
+        PixmapRequest *mFullRequest;
 };
 
 
@@ -95,6 +150,12 @@ class PixmapGenerationThread : public QThread
 
         PixmapRequest *request() const;
 
+        /**
+         * Whether the generation of the current request is over, and it
+         * has still to be collected with endGeneration().
+         */
+        bool isDone() const;
+
         QImage image() const;
         bool calcBoundingBox() const;
         NormalizedRect boundingBox() const;
@@ -108,6 +169,9 @@ class PixmapGenerationThread : public QThread
         QImage mImage;
         NormalizedRect mBoundingBox;
         bool mCalcBoundingBox : 1;
+        // set with release semantics by run() once mImage and mBoundingBox
+        // are written, read with acquire semantics by isDone()
+        mutable QAtomicInt mDone;
 };
 
 
@@ -135,6 +199,27 @@ class TextPageGenerationThread : public QThread
         TextPage *mTextPage;
 };
 
+/**
+ * Extracts the text pages queued in the generator, one after the other,
+ * until the queue is empty; several of these threads can run together.
+ */
+class TextPageExtractionThread : public QThread
+{
+    Q_OBJECT
+
+    public:
+        TextPageExtractionThread( Generator *generator );
+
+    Q_SIGNALS:
+        void textPageExtracted();
+
+    protected:
+        virtual void run();
+
+    private:
+        Generator *mGenerator;
+};
+
 class FontExtractionThread : public QThread
 {
     Q_OBJECT
@@ -155,7 +240,33 @@ class FontExtractionThread : public QThread
     private:
         Generator *mGenerator;
         int mNumOfPages;
-        bool mGoOn;
+        QAtomicInt mGoOn;
+};
+
+/**
+ * Computes, one after the other, the bounding boxes of the given pages
+ * using Generator::pageBoundingBox().
+ */
+class BoundingBoxExtractionThread : public QThread
+{
+    Q_OBJECT
+
+    public:
+        BoundingBoxExtractionThread( Generator *generator, const QVector< Page * > &pages );
+
+        void startExtraction( bool async );
+        void stopExtraction();
+
+    Q_SIGNALS:
+        void gotBoundingBox( int page, const Okular::NormalizedRect &boundingBox );
+
+    protected:
+        virtual void run();
+
+    private:
+        Generator *mGenerator;
+        QVector< Page * > mPages;
+        QAtomicInt mGoOn;
 };
 
 }
@@ -37,6 +37,7 @@
 #include "rotationjob_p.h"
 #include "textpage.h"
 #include "textpage_p.h"
+#include "tilesmanager_p.h"
 
 #include <limits>
 
@@ -65,7 +66,7 @@ PagePrivate::PagePrivate( Page *page, uint n, double w, double h, Rotation o )
       m_rotation( Rotation0 ),
       m_text( 0 ), m_transition( 0 ), m_textSelections( 0 ),
       m_openingAction( 0 ), m_closingAction( 0 ), m_duration( -1 ),
-      m_isBoundingBoxKnown( false )
+      m_isBoundingBoxKnown( false ), m_isSizeKnown( true ), m_wasSizeEstimated( false )
 {
     // avoid Division-By-Zero problems in the program
     if ( m_width <= 0 )
@@ -82,6 +83,7 @@ PagePrivate::~PagePrivate()
     delete m_closingAction;
     delete m_text;
     delete m_transition;
+    qDeleteAll( m_tilesManagers );
 }
 
 
@@ -102,6 +104,33 @@ void PagePrivate::imageRotationDone( RotationJob * job )
     }
 }
 
+TilesManager *PagePrivate::tilesManager( int id ) const
+{
+    return m_tilesManagers.value( id, 0 );
+}
+
+QList< Tile > PagePrivate::tilesAt( int id, const NormalizedRect &rect ) const
+{
+    const TilesManager *tm = tilesManager( id );
+    if ( !tm )
+        return QList< Tile >();
+
+    return tm->tilesAt( rect );
+}
+
+void PagePrivate::setTilesManager( int id, TilesManager *manager )
+{
+    TilesManager *old = m_tilesManagers.value( id, 0 );
+    if ( old == manager )
+        return;
+
+    delete old;
+    if ( manager )
+        m_tilesManagers.insert( id, manager );
+    else
+        m_tilesManagers.remove( id );
+}
+
 QMatrix PagePrivate::rotationMatrix() const
 {
     QMatrix matrix;
@@ -178,6 +207,18 @@ double Page::ratio() const
     return d->m_height / d->m_width;
 }
 
+bool Page::isSizeKnown() const
+{
+    return d->m_isSizeKnown;
+}
+
+void Page::setSizeKnown( bool known )
+{
+    d->m_isSizeKnown = known;
+    if ( !known )
+        d->m_wasSizeEstimated = true;
+}
+
 NormalizedRect Page::boundingBox() const
 {
     return d->m_boundingBox;
@@ -215,6 +256,15 @@ bool Page::hasPixmap( int id, int width, int height ) const
     return (pixmap->width() == width && pixmap->height() == height);
 }
 
+bool Page::hasPixmap( int id, int width, int height, const NormalizedRect &rect ) const
+{
+    const TilesManager *tm = d->tilesManager( id );
+    if ( tm && tm->width() == width && tm->height() == height && tm->hasPixmap( rect ) )
+        return true;
+
+    return hasPixmap( id, width, height );
+}
+
 bool Page::hasTextPage() const
 {
     return d->m_text != 0;
@@ -366,6 +416,12 @@ void PagePrivate::rotateAt( Rotation orientation )
         PageController::self()->addRotationJob(job);
     }
 
+    /**
+     * Tiles are kept only for the upright orientation, drop them.
+     */
+    qDeleteAll( m_tilesManagers );
+    m_tilesManagers.clear();
+
     /**
      * Rotate the object rects on the page.
      */
@@ -482,6 +538,18 @@ void Page::setPixmap( int id, QPixmap *pixmap )
     }
 }
 
+void Page::setPixmap( int id, QPixmap *pixmap, const NormalizedRect &rect )
+{
+    TilesManager *tm = d->tilesManager( id );
+    if ( !tm || d->m_rotation != Rotation0 )
+    {
+        delete pixmap;
+        return;
+    }
+
+    tm->setPixmap( pixmap, rect );
+}
+
 void Page::setTextPage( TextPage * textPage )
 {
     delete d->m_text;
@@ -491,9 +559,11 @@ void Page::setTextPage( TextPage * textPage )
     {
         d->m_text->d->m_page = d;
         /**
-         * Correct text order for before text selection
+         * Correct text order for before text selection (unless it was
+         * already done while extracting it in background)
          */
-        d->m_text->d->correctTextOrder();
+        if ( !d->m_text->d->m_textOrderCorrected )
+            d->m_text->d->correctTextOrder();
     }
 }
 
@@ -660,6 +730,7 @@ void Page::deletePixmap( int id )
 {
     PagePrivate::PixmapObject object = d->m_pixmaps.take( id );
     delete object.m_pixmap;
+    d->setTilesManager( id, 0 );
 }
 
 void Page::deletePixmaps()
@@ -671,6 +742,9 @@ void Page::deletePixmaps()
     }
 
     d->m_pixmaps.clear();
+
+    qDeleteAll( d->m_tilesManagers );
+    d->m_tilesManagers.clear();
 }
 
 void Page::deleteRects()
@@ -764,6 +838,21 @@ void PagePrivate::restoreLocalContents( const QDomNode & pageNode )
             kDebug(OkularDebug).nospace() << "annots: XML Load time: " << time.elapsed() << "ms";
 #endif
         }
+        // parse the size measured by the generator, if it still estimates it
+        else if ( childElement.tagName() == "size" )
+        {
+            if ( !m_wasSizeEstimated || m_isSizeKnown )
+                continue;
+
+            bool okWidth, okHeight;
+            const double width = childElement.attribute( "width" ).toDouble( &okWidth );
+            const double height = childElement.attribute( "height" ).toDouble( &okHeight );
+            if ( okWidth && okHeight && width > 0 && height > 0 )
+            {
+                changeSize( PageSize( width, height, QString() ) );
+                m_isSizeKnown = true;
+            }
+        }
         // parse formList child element
         else if ( childElement.tagName() == "forms" )
         {
@@ -890,6 +979,17 @@ void PagePrivate::saveLocalContents( QDomNode & parentNode, QDomDocument & docum
             pageElement.appendChild( formListElement );
     }
 
+    // add the size measured by the generator, if the page was created with an estimated one
+    if ( ( what & SizePageItems ) && m_wasSizeEstimated && m_isSizeKnown )
+    {
+        // the size is saved in terms of the upright orientation
+        const bool swapped = m_rotation % 2;
+        QDomElement sizeElement = document.createElement( "size" );
+        sizeElement.setAttribute( "width", swapped ? m_height : m_width );
+        sizeElement.setAttribute( "height", swapped ? m_width : m_height );
+        pageElement.appendChild( sizeElement );
+    }
+
     // append the page element only if has children
     if ( pageElement.hasChildNodes() )
         parentNode.appendChild( pageElement );
@@ -924,3 +1024,9 @@ const QPixmap * Page::_o_nearestPixmap( int pixID, int w, int h ) const
 
     return pixmap;
 }
+
+bool Page::_o_hasTiles( int pixID, int w, int h ) const
+{
+    const TilesManager *tm = d->tilesManager( pixID );
+    return tm && tm->width() == w && tm->height() == h;
+}
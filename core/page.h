@@ -107,6 +107,25 @@ class OKULAR_EXPORT Page
          */
         double ratio() const;
 
+        /**
+         * Returns whether the size of the page is the actual one, rather than
+         * an estimate made by the generator without laying the page out.
+         *
+         * @since 0.15 (KDE 4.9)
+         */
+        bool isSizeKnown() const;
+
+        /**
+         * Sets whether the size of the page is known.
+         *
+         * Generators which can tell the size of a page only by laying it out
+         * can create the pages with an estimated size, marking it as not known,
+         * and report the actual one later with Generator::updatePageSize().
+         *
+         * @since 0.15 (KDE 4.9)
+         */
+        void setSizeKnown( bool known );
+
         /**
          * Returns the bounding box of the page content in normalized [0,1] coordinates,
          * in terms of the upright orientation (Rotation0).
@@ -141,6 +160,15 @@ class OKULAR_EXPORT Page
          */
         bool hasPixmap( int id, int width = -1, int height = -1 ) const;
 
+        /**
+         * Returns whether the page has a pixmap of size @p width x @p height
+         * covering the normalized @p rect for the observer with given @p id,
+         * either as a whole pixmap or as rendered tiles.
+         *
+         * @since 0.15 (KDE 4.9)
+         */
+        bool hasPixmap( int id, int width, int height, const NormalizedRect &rect ) const;
+
         /**
          * Returns whether the page provides a text page (@ref TextPage).
          */
@@ -257,6 +285,17 @@ class OKULAR_EXPORT Page
          */
         void setPixmap( int id, QPixmap *pixmap );
 
+        /**
+         * Sets the @p pixmap for the part of the page identified by the
+         * normalized @p rect, for the observer with the given @p id.
+         *
+         * The page must have been tiled for the observer by the Document
+         * (see PixmapRequest::setTile()), otherwise the pixmap is discarded.
+         *
+         * @since 0.15 (KDE 4.9)
+         */
+        void setPixmap( int id, QPixmap *pixmap, const NormalizedRect &rect );
+
         /**
          * Sets the @p text page.
          */
@@ -363,6 +402,7 @@ class OKULAR_EXPORT Page
         friend class PagePrivate;
         friend class Document;
         friend class DocumentPrivate;
+        friend class TextPageExtractionThread;
 
         /**
          * To improve performance PagePainter accesses the following
@@ -372,6 +412,7 @@ class OKULAR_EXPORT Page
         /// @endcond
 
         const QPixmap * _o_nearestPixmap( int, int, int ) const;
+        bool _o_hasTiles( int, int, int ) const;
 
         QLinkedList< ObjectRect* > m_rects;
         QLinkedList< HighlightAreaRect* > m_highlights;
@@ -19,6 +19,7 @@
 #include <qdom.h>
 
 // local includes
+#include "okular_export.h"
 #include "global.h"
 #include "area.h"
 
@@ -36,12 +37,15 @@ class PageSize;
 class PageTransition;
 class RotationJob;
 class TextPage;
+class Tile;
+class TilesManager;
 
 enum PageItem
 {
     None = 0,
     AnnotationPageItems = 0x01,
     FormFieldPageItems = 0x02,
+    SizePageItems = 0x04,
     AllPageItems = 0xff,
 
     /* If set along with AnnotationPageItems, tells saveLocalContents to save
@@ -110,6 +114,28 @@ class PagePrivate
         };
         QMap< int, PixmapObject > m_pixmaps;
 
+        /**
+         * Returns the tiles manager of the observer with the given @p id,
+         * or 0 if the page is not tiled for it.
+         */
+        TilesManager *tilesManager( int id ) const;
+
+        /**
+         * Sets the tiles @p manager for the observer with the given @p id,
+         * deleting the previous one (if any); 0 removes the tiles.
+         */
+        void setTilesManager( int id, TilesManager *manager );
+
+        /**
+         * Returns the tiles of the observer with the given @p id which
+         * intersect @p rect, or an empty list if the page is not tiled for it.
+         *
+         * Exported for the page painter, which draws the tiles one by one.
+         */
+        OKULAR_EXPORT QList< Tile > tilesAt( int id, const NormalizedRect &rect ) const;
+
+        QMap< int, TilesManager * > m_tilesManagers;
+
         Page *m_page;
         int m_number;
         Rotation m_orientation;
@@ -128,6 +154,8 @@ class PagePrivate
         QString m_label;
 
         bool m_isBoundingBoxKnown : 1;
+        bool m_isSizeKnown : 1;
+        bool m_wasSizeEstimated : 1;
         QDomDocument restoredLocalAnnotationList; // <annotationList>...</annotationList>
 };
 
@@ -0,0 +1,230 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "pixmapcache_p.h"
+
+#include "observer.h"
+
+using namespace Okular;
+
+static inline qulonglong entryKey( int id, int page )
+{
+    return ( (qulonglong)(uint)id << 32 ) | (uint)page;
+}
+
+PixmapCache::PixmapCache()
+    : m_totalMemory( 0 ), m_age( 0 ), m_hits( 0 ), m_misses( 0 ), m_evictions( 0 )
+{
+}
+
+PixmapCache::~PixmapCache()
+{
+    qDeleteAll( m_entries );
+}
+
+void PixmapCache::insert( int id, int page, qulonglong memory, int cost )
+{
+    Entry *entry = m_entries.value( entryKey( id, page ) );
+    if ( entry )
+    {
+        m_entriesByScore.remove( entry->score, entry );
+        m_totalMemory -= entry->memory;
+        m_observersMemory[ id ] -= entry->memory;
+    }
+    else
+    {
+        entry = new Entry;
+        entry->id = id;
+        entry->page = page;
+        m_entries.insert( entryKey( id, page ), entry );
+    }
+
+    entry->memory = memory;
+    entry->cost = qMax( cost, 1 );
+    m_totalMemory += memory;
+    m_observersMemory[ id ] += memory;
+    updateScore( entry );
+}
+
+void PixmapCache::remove( int id, int page )
+{
+    Entry *entry = m_entries.value( entryKey( id, page ) );
+    if ( entry )
+        removeEntry( entry );
+}
+
+void PixmapCache::removeObserver( int id )
+{
+    QList< Entry * > entries;
+    QHash< qulonglong, Entry * >::const_iterator it = m_entries.constBegin(), end = m_entries.constEnd();
+    for ( ; it != end; ++it )
+        if ( (*it)->id == id )
+            entries.append( *it );
+
+    foreach ( Entry *entry, entries )
+        removeEntry( entry );
+}
+
+void PixmapCache::clear()
+{
+    qDeleteAll( m_entries );
+    m_entries.clear();
+    m_entriesByScore.clear();
+    m_observersMemory.clear();
+    m_totalMemory = 0;
+    m_age = 0;
+}
+
+void PixmapCache::hit( int id, int page )
+{
+    ++m_hits;
+
+    Entry *entry = m_entries.value( entryKey( id, page ) );
+    if ( entry )
+    {
+        m_entriesByScore.remove( entry->score, entry );
+        updateScore( entry );
+    }
+}
+
+void PixmapCache::miss()
+{
+    ++m_misses;
+}
+
+void PixmapCache::touchPage( int page )
+{
+    QList< Entry * > entries;
+    QHash< int, qulonglong >::const_iterator it = m_observersMemory.constBegin(), end = m_observersMemory.constEnd();
+    for ( ; it != end; ++it )
+    {
+        Entry *entry = m_entries.value( entryKey( it.key(), page ) );
+        if ( entry )
+            entries.append( entry );
+    }
+
+    foreach ( Entry *entry, entries )
+    {
+        m_entriesByScore.remove( entry->score, entry );
+        updateScore( entry );
+    }
+}
+
+bool PixmapCache::isEmpty() const
+{
+    return m_entries.isEmpty();
+}
+
+qulonglong PixmapCache::totalMemory() const
+{
+    return m_totalMemory;
+}
+
+qulonglong PixmapCache::memory( int id ) const
+{
+    return m_observersMemory.value( id );
+}
+
+void PixmapCache::setBudget( int id, qulonglong bytes )
+{
+    if ( bytes )
+        m_budgets.insert( id, bytes );
+    else
+        m_budgets.remove( id );
+}
+
+QList< PixmapCache::Entry > PixmapCache::evict( qulonglong bytes, const QMap< int, DocumentObserver * > &observers )
+{
+    QList< Entry > evicted;
+
+    // first pass: bring the observers back within their budget;
+    // second pass: free what is still needed from everybody
+    for ( int pass = 0; pass < 2; ++pass )
+    {
+        if ( pass == 0 && !isOverBudget() )
+            continue;
+        if ( pass == 1 && bytes == 0 )
+            break;
+
+        QList< Entry * > toEvict;
+        QHash< int, qulonglong > freed;
+        QMultiMap< double, Entry * >::const_iterator it = m_entriesByScore.constBegin(), end = m_entriesByScore.constEnd();
+        for ( ; it != end && ( pass == 0 || bytes > 0 ); ++it )
+        {
+            Entry *entry = *it;
+            if ( pass == 0 )
+            {
+                const qulonglong budget = m_budgets.value( entry->id );
+                if ( !budget || m_observersMemory.value( entry->id ) - freed.value( entry->id ) <= budget )
+                    continue;
+            }
+
+            DocumentObserver *observer = observers.value( entry->id );
+            if ( observer && !observer->canUnloadPixmap( entry->page ) )
+                continue;
+
+            toEvict.append( entry );
+            freed[ entry->id ] += entry->memory;
+            bytes -= qMin( bytes, entry->memory );
+        }
+
+        foreach ( Entry *entry, toEvict )
+        {
+            m_age = qMax( m_age, entry->score );
+            evicted.append( *entry );
+            removeEntry( entry );
+            ++m_evictions;
+        }
+    }
+
+    return evicted;
+}
+
+int PixmapCache::hits() const
+{
+    return m_hits;
+}
+
+int PixmapCache::misses() const
+{
+    return m_misses;
+}
+
+int PixmapCache::evictions() const
+{
+    return m_evictions;
+}
+
+bool PixmapCache::isOverBudget() const
+{
+    QHash< int, qulonglong >::const_iterator it = m_budgets.constBegin(), end = m_budgets.constEnd();
+    for ( ; it != end; ++it )
+        if ( m_observersMemory.value( it.key() ) > it.value() )
+            return true;
+
+    return false;
+}
+
+void PixmapCache::updateScore( Entry *entry )
+{
+    // milliseconds of rendering per megabyte of pixmap
+    entry->score = m_age + (double)entry->cost * 1048576. / qMax( entry->memory, Q_UINT64_C(1) );
+    m_entriesByScore.insert( entry->score, entry );
+}
+
+void PixmapCache::removeEntry( Entry *entry )
+{
+    m_entriesByScore.remove( entry->score, entry );
+    m_entries.remove( entryKey( entry->id, entry->page ) );
+    m_totalMemory -= entry->memory;
+    m_observersMemory[ entry->id ] -= entry->memory;
+    if ( m_observersMemory.value( entry->id ) == 0 )
+        m_observersMemory.remove( entry->id );
+    delete entry;
+}
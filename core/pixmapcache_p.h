@@ -0,0 +1,127 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef _OKULAR_PIXMAPCACHE_P_H_
+#define _OKULAR_PIXMAPCACHE_P_H_
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMap>
+
+namespace Okular {
+
+class DocumentObserver;
+
+/**
+ * @short Keeps track of the pixmaps the observers have in the pages.
+ *
+ * The pixmaps are owned by the pages: the cache only knows, for each observer
+ * and page, how much memory the pixmap uses and how long it took to render,
+ * and it chooses which ones to drop when memory has to be freed.
+ *
+ * The eviction follows the GreedyDual-Size policy: each pixmap has a score,
+ * its rendering cost per byte plus an "age" value which grows every time a
+ * pixmap is evicted; a pixmap gets a fresh score every time it is used.
+ * So the pixmaps not used for a long time go first, but the ones which are
+ * expensive to render again stay longer than the cheap ones.
+ *
+ * Observers using more memory than their budget are trimmed first.
+ */
+class PixmapCache
+{
+    public:
+        struct Entry
+        {
+            int id;
+            int page;
+            qulonglong memory;
+            int cost;
+            double score;
+        };
+
+        PixmapCache();
+        ~PixmapCache();
+
+        /**
+         * Adds the pixmap of the observer @p id for the @p page, replacing
+         * the previous one; @p cost is the time (in milliseconds) it took to render.
+         */
+        void insert( int id, int page, qulonglong memory, int cost );
+
+        /**
+         * Forgets about the pixmap of the observer @p id for the @p page.
+         */
+        void remove( int id, int page );
+
+        /**
+         * Forgets about all the pixmaps of the observer @p id.
+         */
+        void removeObserver( int id );
+
+        /**
+         * Forgets about all the pixmaps.
+         */
+        void clear();
+
+        /**
+         * Marks the pixmap of the observer @p id for the @p page as used again.
+         */
+        void hit( int id, int page );
+
+        /**
+         * Records that the observer @p id asked for a pixmap not in the cache.
+         */
+        void miss();
+
+        /**
+         * Marks the pixmaps of all the observers for the @p page as used again.
+         */
+        void touchPage( int page );
+
+        bool isEmpty() const;
+        qulonglong totalMemory() const;
+        qulonglong memory( int id ) const;
+
+        /**
+         * Sets how much memory the observer @p id should use at most;
+         * 0 means no limit.
+         */
+        void setBudget( int id, qulonglong bytes );
+
+        /**
+         * Removes from the cache the pixmaps exceeding the budgets, and then
+         * more until at least @p bytes are freed (if possible), skipping the
+         * ones the @p observers want to keep. Returns the removed pixmaps,
+         * which have to be deleted by the caller.
+         */
+        QList< Entry > evict( qulonglong bytes, const QMap< int, DocumentObserver * > &observers );
+
+        int hits() const;
+        int misses() const;
+        int evictions() const;
+
+    private:
+        bool isOverBudget() const;
+        void updateScore( Entry *entry );
+        void removeEntry( Entry *entry );
+
+        QHash< qulonglong, Entry * > m_entries;
+        QMultiMap< double, Entry * > m_entriesByScore;
+        QHash< int, qulonglong > m_observersMemory;
+        QHash< int, qulonglong > m_budgets;
+        qulonglong m_totalMemory;
+        double m_age;
+        int m_hits;
+        int m_misses;
+        int m_evictions;
+};
+
+}
+
+#endif
@@ -0,0 +1,258 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "pixmapdiskcache_p.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QPointer>
+#include <QtCore/QThread>
+#include <QtGui/QPixmap>
+
+#include <kglobal.h>
+
+#include "generator.h"
+
+using namespace Okular;
+
+// the space taken by the images of all the documents, in bytes
+static const qint64 MaxTotalSize = 100 * 1024 * 1024;
+
+namespace {
+
+class PixmapDiskCacheWriter : public QThread
+{
+    public:
+        PixmapDiskCacheWriter( const QString &directory, const QByteArray &documentHash,
+                               const QList< QPair< QString, QImage > > &images )
+            : m_directory( directory ), m_documentHash( documentHash ), m_images( images )
+        {
+        }
+
+        QString directory() const
+        {
+            return m_directory;
+        }
+
+    protected:
+        virtual void run();
+
+    private:
+        static void removeDirectory( const QString &path );
+        void pruneDirectories();
+
+        QString m_directory;
+        QByteArray m_documentHash;
+        QList< QPair< QString, QImage > > m_images;
+};
+
+void PixmapDiskCacheWriter::run()
+{
+    QDir dir( m_directory );
+    if ( dir.exists() )
+    {
+        foreach ( const QString &name, dir.entryList( QDir::Files ) )
+            dir.remove( name );
+    }
+
+    if ( !m_images.isEmpty() && ( dir.exists() || dir.mkpath( m_directory ) ) )
+    {
+        QFile keyFile( m_directory + QLatin1String( "/key" ) );
+        if ( keyFile.open( QIODevice::WriteOnly ) )
+        {
+            keyFile.write( m_documentHash );
+            keyFile.close();
+
+            // a fast compression is enough, these are mostly flat colors;
+            // an image is renamed only when complete, in case the write is
+            // interrupted
+            QList< QPair< QString, QImage > >::const_iterator it = m_images.constBegin(), end = m_images.constEnd();
+            for ( ; it != end; ++it )
+            {
+                const QString fileName = m_directory + QLatin1Char( '/' ) + (*it).first;
+                if ( (*it).second.save( fileName + QLatin1String( ".part" ), "PNG", 80 ) )
+                    QFile::rename( fileName + QLatin1String( ".part" ), fileName );
+            }
+        }
+    }
+    m_images.clear();
+
+    pruneDirectories();
+}
+
+void PixmapDiskCacheWriter::removeDirectory( const QString &path )
+{
+    QDir dir( path );
+    foreach ( const QString &name, dir.entryList( QDir::Files ) )
+        dir.remove( name );
+    dir.rmdir( path );
+}
+
+void PixmapDiskCacheWriter::pruneDirectories()
+{
+    // the directory of a document is written when it is closed, so the ones
+    // modified least recently belong to the documents closed least recently
+    const QDir parent = QFileInfo( m_directory ).dir();
+    const QFileInfoList caches = parent.entryInfoList( QStringList() << QLatin1String( "*.cache" ),
+                                                       QDir::Dirs | QDir::NoDotAndDotDot, QDir::Time );
+    const QString current = QFileInfo( m_directory ).absoluteFilePath();
+
+    qint64 totalSize = 0;
+    foreach ( const QFileInfo &cache, caches )
+    {
+        if ( cache.absoluteFilePath() == current )
+            continue;
+
+        if ( totalSize < MaxTotalSize )
+        {
+            foreach ( const QFileInfo &file, QDir( cache.absoluteFilePath() ).entryInfoList( QDir::Files ) )
+                totalSize += file.size();
+            if ( totalSize <= MaxTotalSize )
+                continue;
+        }
+
+        removeDirectory( cache.absoluteFilePath() );
+    }
+}
+
+class PixmapDiskCacheReader : public QThread
+{
+    public:
+        PixmapDiskCacheReader( QObject *document, const QList< QPair< PixmapRequest *, QString > > &requests )
+            : m_document( document ), m_requests( requests )
+        {
+        }
+
+    protected:
+        virtual void run();
+
+    private:
+        QObject *m_document;
+        QList< QPair< PixmapRequest *, QString > > m_requests;
+};
+
+void PixmapDiskCacheReader::run()
+{
+    // the document waits for the requests before closing, so it is still
+    // there when they are handed back
+    QList< QPair< PixmapRequest *, QString > >::const_iterator it = m_requests.constBegin(), end = m_requests.constEnd();
+    for ( ; it != end; ++it )
+    {
+        PixmapRequest *request = (*it).first;
+        QImage image;
+        if ( !request->shouldAbortRender() )
+        {
+            image.load( (*it).second, "PNG" );
+            if ( image.width() != request->width() || image.height() != request->height() )
+                image = QImage();
+        }
+
+        QMetaObject::invokeMethod( m_document, "diskCachedPixmapLoaded", Qt::QueuedConnection,
+                                   Q_ARG( void *, request ), Q_ARG( QImage, image ) );
+    }
+}
+
+// the writers still running, waited for at exit
+class PixmapDiskCacheWriters : public QList< QPointer< PixmapDiskCacheWriter > >
+{
+    public:
+        ~PixmapDiskCacheWriters()
+        {
+            foreach ( const QPointer< PixmapDiskCacheWriter > &writer, *this )
+            {
+                if ( writer )
+                    writer->wait();
+            }
+        }
+
+        void waitFor( const QString &directory )
+        {
+            QMutableListIterator< QPointer< PixmapDiskCacheWriter > > it( *this );
+            while ( it.hasNext() )
+            {
+                const QPointer< PixmapDiskCacheWriter > writer = it.next();
+                if ( !writer )
+                    it.remove();
+                else if ( writer->directory() == directory )
+                    writer->wait();
+            }
+        }
+};
+
+}
+
+K_GLOBAL_STATIC( PixmapDiskCacheWriters, s_writers )
+
+PixmapDiskCache::PixmapDiskCache( const QString &directory, const QByteArray &documentHash )
+    : m_directory( directory ), m_documentHash( documentHash )
+{
+    // the document might have been closed just now, with its images still
+    // being written
+    s_writers->waitFor( m_directory );
+
+    QFile keyFile( m_directory + QLatin1String( "/key" ) );
+    if ( m_documentHash.isEmpty() || !keyFile.open( QIODevice::ReadOnly ) || keyFile.readAll() != m_documentHash )
+        return;
+
+    const QStringList images = QDir( m_directory ).entryList( QStringList() << QLatin1String( "*.png" ), QDir::Files );
+    m_images = images.toSet();
+}
+
+QString PixmapDiskCache::take( int id, int page, int width, int height, Rotation rotation )
+{
+    if ( m_images.isEmpty() )
+        return QString();
+
+    const QString name = imageName( id, page, width, height, rotation );
+    if ( !m_images.remove( name ) )
+        return QString();
+
+    return m_directory + QLatin1Char( '/' ) + name;
+}
+
+void PixmapDiskCache::load( QObject *document, const QList< QPair< PixmapRequest *, QString > > &requests )
+{
+    PixmapDiskCacheReader *reader = new PixmapDiskCacheReader( document, requests );
+    QObject::connect( reader, SIGNAL(finished()), reader, SLOT(deleteLater()) );
+    reader->start( QThread::LowPriority );
+}
+
+void PixmapDiskCache::clear()
+{
+    m_images.clear();
+    m_pendingImages.clear();
+}
+
+void PixmapDiskCache::insert( int id, int page, Rotation rotation, const QPixmap &pixmap )
+{
+    if ( m_documentHash.isEmpty() || pixmap.isNull() )
+        return;
+
+    // the pixmap can be read only in the GUI thread, the encoding is done later
+    const QString name = imageName( id, page, pixmap.width(), pixmap.height(), rotation );
+    m_pendingImages.append( qMakePair( name, pixmap.toImage() ) );
+}
+
+void PixmapDiskCache::save()
+{
+    s_writers->waitFor( m_directory );
+
+    PixmapDiskCacheWriter *writer = new PixmapDiskCacheWriter( m_directory, m_documentHash, m_pendingImages );
+    QObject::connect( writer, SIGNAL(finished()), writer, SLOT(deleteLater()) );
+    s_writers->append( writer );
+    writer->start( QThread::LowPriority );
+
+    m_pendingImages.clear();
+}
+
+QString PixmapDiskCache::imageName( int id, int page, int width, int height, Rotation rotation )
+{
+    return QString::fromLatin1( "%1-%2-%3x%4-%5.png" ).arg( id ).arg( page ).arg( width ).arg( height ).arg( (int)rotation );
+}
@@ -0,0 +1,98 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef _OKULAR_PIXMAPDISKCACHE_P_H_
+#define _OKULAR_PIXMAPDISKCACHE_P_H_
+
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+#include <QtCore/QPair>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtGui/QImage>
+
+#include "global.h"
+
+class QObject;
+class QPixmap;
+
+namespace Okular {
+
+class PixmapRequest;
+
+/**
+ * @short Keeps some rendered pages of a document on disk.
+ *
+ * When a document is closed, the pixmaps of the visible pages and the
+ * thumbnails are saved as PNG images in a directory next to the document info
+ * file, so they can be shown right away the next time the document is opened,
+ * while the real renderings are done.
+ *
+ * The images are valid only for the same document: the directory is emptied
+ * when the hash of the document file changes. The images are decoded in a
+ * background thread, as well as encoded and written, and the writing thread
+ * also removes the directories of the documents closed least recently when
+ * all of them take too much space.
+ */
+class PixmapDiskCache
+{
+    public:
+        /**
+         * Creates a cache in @p directory for the document with the given
+         * @p documentHash (see documentFileHash()).
+         */
+        PixmapDiskCache( const QString &directory, const QByteArray &documentHash );
+
+        /**
+         * Returns the file of the image of the observer @p id for the @p page,
+         * of the given size and rotation, and forgets about it; an empty string
+         * is returned if there is none.
+         */
+        QString take( int id, int page, int width, int height, Rotation rotation );
+
+        /**
+         * Reads the images of the @p requests, each from the file returned by
+         * take(), in a background thread. Each request is then passed with its
+         * image (a null one if it could not be read) to the
+         * diskCachedPixmapLoaded() slot of the @p document.
+         */
+        static void load( QObject *document, const QList< QPair< PixmapRequest *, QString > > &requests );
+
+        /**
+         * Forgets all the images of the document; the ones on disk are
+         * replaced at the next save().
+         */
+        void clear();
+
+        /**
+         * Adds the @p pixmap of the observer @p id for the @p page to the
+         * images to save.
+         */
+        void insert( int id, int page, Rotation rotation, const QPixmap &pixmap );
+
+        /**
+         * Replaces the images on disk with the ones inserted since the last
+         * clear(), in a background thread.
+         */
+        void save();
+
+    private:
+        static QString imageName( int id, int page, int width, int height, Rotation rotation );
+
+        QString m_directory;
+        QByteArray m_documentHash;
+        QSet< QString > m_images;
+        QList< QPair< QString, QImage > > m_pendingImages;
+
+        Q_DISABLE_COPY( PixmapDiskCache )
+};
+
+}
+
+#endif
@@ -0,0 +1,156 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "pixmaprequestqueue_p.h"
+
+#include "generator.h"
+#include "generator_p.h"
+
+using namespace Okular;
+
+PixmapRequestQueue::PixmapRequestQueue()
+    : m_serial( 0 )
+{
+}
+
+bool PixmapRequestQueue::isEmpty() const
+{
+    return m_heap.isEmpty();
+}
+
+int PixmapRequestQueue::count() const
+{
+    return m_heap.count();
+}
+
+void PixmapRequestQueue::insert( PixmapRequest *request )
+{
+    request->d->mQueueSerial = m_serial++;
+    request->d->mQueuePosition = m_heap.count();
+    m_heap.append( request );
+    m_index[ request->id() ].insert( request->pageNumber(), request );
+    siftUp( request->d->mQueuePosition );
+}
+
+void PixmapRequestQueue::remove( PixmapRequest *request )
+{
+    const int position = request->d->mQueuePosition;
+    if ( position < 0 || position >= m_heap.count() || m_heap.at( position ) != request )
+        return;
+
+    // move the last request in place of the removed one, and restore the heap
+    const int last = m_heap.count() - 1;
+    if ( position != last )
+        swap( position, last );
+    m_heap.remove( last );
+    request->d->mQueuePosition = -1;
+    if ( position != last )
+    {
+        siftUp( position );
+        siftDown( position );
+    }
+
+    QHash< int, QMultiHash< int, PixmapRequest * > >::iterator it = m_index.find( request->id() );
+    if ( it != m_index.end() )
+    {
+        it.value().remove( request->pageNumber(), request );
+        if ( it.value().isEmpty() )
+            m_index.erase( it );
+    }
+}
+
+void PixmapRequestQueue::setPriority( PixmapRequest *request, int priority )
+{
+    const int position = request->d->mQueuePosition;
+    if ( position < 0 || position >= m_heap.count() || m_heap.at( position ) != request )
+        return;
+
+    request->d->mPriority = priority;
+    siftUp( position );
+    siftDown( request->d->mQueuePosition );
+}
+
+PixmapRequest *PixmapRequestQueue::top() const
+{
+    return m_heap.isEmpty() ? 0 : m_heap.first();
+}
+
+QList< PixmapRequest * > PixmapRequestQueue::requests( int id ) const
+{
+    return m_index.value( id ).values();
+}
+
+QList< PixmapRequest * > PixmapRequestQueue::requests( int id, int page ) const
+{
+    QHash< int, QMultiHash< int, PixmapRequest * > >::const_iterator it = m_index.constFind( id );
+    if ( it == m_index.constEnd() )
+        return QList< PixmapRequest * >();
+
+    return it.value().values( page );
+}
+
+QList< PixmapRequest * > PixmapRequestQueue::takeAll()
+{
+    QList< PixmapRequest * > requests = m_heap.toList();
+    foreach ( PixmapRequest *request, requests )
+        request->d->mQueuePosition = -1;
+
+    m_heap.clear();
+    m_index.clear();
+    return requests;
+}
+
+bool PixmapRequestQueue::isMoreUrgent( int first, int second ) const
+{
+    const PixmapRequestPrivate *a = m_heap.at( first )->d;
+    const PixmapRequestPrivate *b = m_heap.at( second )->d;
+    if ( a->mPriority != b->mPriority )
+        return a->mPriority < b->mPriority;
+
+    return a->mQueueSerial < b->mQueueSerial;
+}
+
+void PixmapRequestQueue::swap( int first, int second )
+{
+    qSwap( m_heap[ first ], m_heap[ second ] );
+    m_heap[ first ]->d->mQueuePosition = first;
+    m_heap[ second ]->d->mQueuePosition = second;
+}
+
+void PixmapRequestQueue::siftUp( int position )
+{
+    while ( position > 0 )
+    {
+        const int parent = ( position - 1 ) / 2;
+        if ( !isMoreUrgent( position, parent ) )
+            break;
+
+        swap( position, parent );
+        position = parent;
+    }
+}
+
+void PixmapRequestQueue::siftDown( int position )
+{
+    const int count = m_heap.count();
+    for ( ;; )
+    {
+        const int left = 2 * position + 1, right = left + 1;
+        int mostUrgent = position;
+        if ( left < count && isMoreUrgent( left, mostUrgent ) )
+            mostUrgent = left;
+        if ( right < count && isMoreUrgent( right, mostUrgent ) )
+            mostUrgent = right;
+        if ( mostUrgent == position )
+            break;
+
+        swap( position, mostUrgent );
+        position = mostUrgent;
+    }
+}
@@ -0,0 +1,89 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef _OKULAR_PIXMAPREQUESTQUEUE_P_H_
+#define _OKULAR_PIXMAPREQUESTQUEUE_P_H_
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QVector>
+
+namespace Okular {
+
+class PixmapRequest;
+
+/**
+ * @short The pending pixmap requests, ordered by priority.
+ *
+ * The requests are kept in a binary heap: the most urgent one (the lowest
+ * priority value, and among equal priorities the oldest one) is at the top.
+ * Each request knows its position in the heap, so removing it or changing its
+ * priority costs O(log n), and the requests of an observer for a page can be
+ * looked up directly.
+ *
+ * The queue does not own the requests.
+ */
+class PixmapRequestQueue
+{
+    public:
+        PixmapRequestQueue();
+
+        bool isEmpty() const;
+        int count() const;
+
+        /**
+         * Adds the @p request to the queue.
+         */
+        void insert( PixmapRequest *request );
+
+        /**
+         * Removes the @p request from the queue, without deleting it.
+         */
+        void remove( PixmapRequest *request );
+
+        /**
+         * Changes the priority of the queued @p request.
+         */
+        void setPriority( PixmapRequest *request, int priority );
+
+        /**
+         * Returns the most urgent request, or 0 if the queue is empty.
+         */
+        PixmapRequest *top() const;
+
+        /**
+         * Returns the queued requests of the observer @p id.
+         */
+        QList< PixmapRequest * > requests( int id ) const;
+
+        /**
+         * Returns the queued requests of the observer @p id for the page @p page.
+         */
+        QList< PixmapRequest * > requests( int id, int page ) const;
+
+        /**
+         * Empties the queue, returning all the requests it contained.
+         */
+        QList< PixmapRequest * > takeAll();
+
+    private:
+        bool isMoreUrgent( int first, int second ) const;
+        void swap( int first, int second );
+        void siftUp( int position );
+        void siftDown( int position );
+
+        QVector< PixmapRequest * > m_heap;
+        // observer id -> page number -> requests
+        QHash< int, QMultiHash< int, PixmapRequest * > > m_index;
+        qulonglong m_serial;
+};
+
+}
+
+#endif
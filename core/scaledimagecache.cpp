@@ -0,0 +1,123 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "scaledimagecache.h"
+#include "accountedcache.h"
+
+#include <QtCore/QCache>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtGui/QImage>
+
+using namespace Okular;
+
+static const int MaxReduction = 8;
+
+class ScaledImageCache::Private : public AccountedCache
+{
+    public:
+        Private( Generator *generator, int maxMemory )
+            : AccountedCache( generator ), images( qMax( maxMemory / 1024, 1 ) )
+        {
+        }
+
+        qulonglong memoryUsage() const
+        {
+            QMutexLocker locker( &mutex );
+            return (qulonglong)images.totalCost() * 1024;
+        }
+
+        qulonglong shrink( qulonglong bytes )
+        {
+            QMutexLocker locker( &mutex );
+            // lowering the maximum cost drops the least recently used images
+            const int maxCost = images.maxCost();
+            const int totalCost = images.totalCost();
+            images.setMaxCost( totalCost - (int)qMin( bytes / 1024, (qulonglong)totalCost ) );
+            images.setMaxCost( maxCost );
+            return (qulonglong)( totalCost - images.totalCost() ) * 1024;
+        }
+
+        static qint64 key( int page, int reduction )
+        {
+            return ( (qint64)page << 8 ) | reduction;
+        }
+
+        // the costs are in KB, not to overflow the int of QCache
+        QCache< qint64, QImage > images;
+        mutable QMutex mutex;
+};
+
+ScaledImageCache::ScaledImageCache( Generator *generator, int maxMemory )
+    : d( new Private( generator, maxMemory ) )
+{
+}
+
+ScaledImageCache::~ScaledImageCache()
+{
+    delete d;
+}
+
+int ScaledImageCache::reduction( const QSize &fullSize, const QSize &size )
+{
+    int reduction = 1;
+    while ( reduction < MaxReduction )
+    {
+        const QSize smaller = reducedSize( fullSize, reduction * 2 );
+        if ( smaller.width() < size.width() || smaller.height() < size.height() )
+            break;
+
+        reduction *= 2;
+    }
+    return reduction;
+}
+
+QSize ScaledImageCache::reducedSize( const QSize &fullSize, int reduction )
+{
+    // round up, like the decoders do
+    return QSize( ( fullSize.width() + reduction - 1 ) / reduction,
+                  ( fullSize.height() + reduction - 1 ) / reduction );
+}
+
+QImage ScaledImageCache::scaled( const QImage &image, const QSize &size )
+{
+    if ( image.isNull() || image.size() == size )
+        return image;
+
+    return image.scaled( size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation );
+}
+
+QImage ScaledImageCache::find( int page, const QSize &size ) const
+{
+    QMutexLocker locker( &d->mutex );
+
+    for ( int reduction = MaxReduction; reduction >= 1; reduction /= 2 )
+    {
+        const QImage *image = d->images.object( Private::key( page, reduction ) );
+        if ( image && image->width() >= size.width() && image->height() >= size.height() )
+            return *image;
+    }
+
+    return QImage();
+}
+
+void ScaledImageCache::insert( int page, int reduction, const QImage &image )
+{
+    if ( image.isNull() )
+        return;
+
+    QMutexLocker locker( &d->mutex );
+    d->images.insert( Private::key( page, reduction ), new QImage( image ), qMax( image.byteCount() / 1024, 1 ) );
+}
+
+void ScaledImageCache::clear()
+{
+    QMutexLocker locker( &d->mutex );
+    d->images.clear();
+}
@@ -0,0 +1,96 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef _OKULAR_SCALEDIMAGECACHE_H_
+#define _OKULAR_SCALEDIMAGECACHE_H_
+
+#include <QtCore/QtGlobal>
+
+#include "okular_export.h"
+
+class QImage;
+class QSize;
+
+namespace Okular {
+
+class Generator;
+
+/**
+ * @short A cache of the pages of a raster document, decoded at reduced sizes.
+ *
+ * Generators of raster documents (e.g. scanned images) should not decode a
+ * page at full resolution just to scale it down to a small pixmap: they can
+ * decode it with the power-of-two reduction() suited for the requested size
+ * (many image formats support that cheaply), store the result here, and then
+ * scale it to the exact size with scaled().
+ *
+ * The cache keeps the most recently used images, up to a maximum memory,
+ * which counts in the memory budget of the document of the generator (see
+ * AccountedCache);
+ * all its methods are thread safe.
+ *
+ * @since 0.15 (KDE 4.9)
+ */
+class OKULAR_EXPORT ScaledImageCache
+{
+    public:
+        /**
+         * Creates a new cache of the @p generator, which holds at most
+         * @p maxMemory bytes of images.
+         */
+        explicit ScaledImageCache( Generator *generator, int maxMemory = 64 * 1024 * 1024 );
+
+        /**
+         * Destroys the cache.
+         */
+        ~ScaledImageCache();
+
+        /**
+         * Returns the largest reduction among 1, 2, 4 and 8 which turns an
+         * image of @p fullSize into one still at least as large as @p size.
+         */
+        static int reduction( const QSize &fullSize, const QSize &size );
+
+        /**
+         * Returns the size of an image of @p fullSize decoded with @p reduction.
+         */
+        static QSize reducedSize( const QSize &fullSize, int reduction );
+
+        /**
+         * Returns @p image smoothly scaled to @p size (or @p image itself, if it
+         * already has that size).
+         */
+        static QImage scaled( const QImage &image, const QSize &size );
+
+        /**
+         * Returns the smallest cached image of the @p page at least as large as
+         * @p size, or a null image if there is none.
+         */
+        QImage find( int page, const QSize &size ) const;
+
+        /**
+         * Stores the @p image of the @p page decoded with @p reduction.
+         */
+        void insert( int page, int reduction, const QImage &image );
+
+        /**
+         * Removes all the images.
+         */
+        void clear();
+
+    private:
+        class Private;
+        Private * const d;
+
+        Q_DISABLE_COPY( ScaledImageCache )
+};
+
+}
+
+#endif
@@ -72,29 +72,58 @@ Okular::TextPage* TextDocumentGeneratorPrivate::createTextPage( int pageNumber )
     q->userMutex()->lock();
 #endif
     TextDocumentUtils::calculatePositions( mDocument, pageNumber, start, end );
+    TextDocumentUtils::appendText( mDocument, start, end - 1, textPage );
+#ifdef OKULAR_TEXTDOCUMENT_THREADED_RENDERING
+    q->userMutex()->unlock();
+#endif
+
+    return textPage;
+}
+
+Okular::NormalizedRect TextDocumentGeneratorPrivate::createBoundingBox( int pageNumber ) const
+{
+#ifdef OKULAR_TEXTDOCUMENT_THREADED_RENDERING
+    Q_Q( const TextDocumentGenerator );
+#endif
+
+    QRectF contents;
+
+#ifdef OKULAR_TEXTDOCUMENT_THREADED_RENDERING
+    q->userMutex()->lock();
+#endif
+    const QSizeF pageSize = mDocument->pageSize();
+    const QRectF pageRect( 0, pageNumber * pageSize.height(), pageSize.width(), pageSize.height() );
+    const QAbstractTextDocumentLayout *layout = mDocument->documentLayout();
 
+    int start, end;
+    TextDocumentUtils::calculatePositions( mDocument, pageNumber, start, end );
+
+    // the union of the text lines laid out in the page, images included
+    for ( QTextBlock block = mDocument->findBlock( start ); block.isValid() && block.position() <= end; block = block.next() )
     {
-    QTextCursor cursor( mDocument );
-    for ( int i = start; i < end - 1; ++i ) {
-        cursor.setPosition( i );
-        cursor.setPosition( i + 1, QTextCursor::KeepAnchor );
-
-        QString text = cursor.selectedText();
-        if ( text.length() == 1 ) {
-            QRectF rect;
-            TextDocumentUtils::calculateBoundingRect( mDocument, i, i + 1, rect, pageNumber );
-            if ( pageNumber == -1 )
-                text = "\n";
-
-            textPage->append( text, new Okular::NormalizedRect( rect.left(), rect.top(), rect.right(), rect.bottom() ) );
+        const QPointF blockPosition = layout->blockBoundingRect( block ).topLeft();
+        const QTextLayout *textLayout = block.layout();
+        for ( int i = 0; i < textLayout->lineCount(); ++i )
+        {
+            const QTextLine line = textLayout->lineAt( i );
+            if ( line.naturalTextWidth() <= 0 )
+                continue;
+
+            const QRectF lineRect = line.naturalTextRect().translated( blockPosition ) & pageRect;
+            if ( !lineRect.isEmpty() )
+                contents |= lineRect;
         }
     }
-    }
 #ifdef OKULAR_TEXTDOCUMENT_THREADED_RENDERING
     q->userMutex()->unlock();
 #endif
 
-    return textPage;
+    if ( contents.isEmpty() )
+        return Okular::NormalizedRect();
+
+    contents.translate( 0, -pageRect.top() );
+    return Okular::NormalizedRect( contents.left() / pageSize.width(), contents.top() / pageSize.height(),
+                                   contents.right() / pageSize.width(), contents.bottom() / pageSize.height() );
 }
 
 void TextDocumentGeneratorPrivate::addAction( Action *action, int cursorBegin, int cursorEnd )
@@ -221,6 +250,8 @@ TextDocumentGenerator::TextDocumentGenerator( TextDocumentConverter *converter,
     setFeature( TextExtraction );
     setFeature( PrintNative );
     setFeature( PrintToFile );
+    setFeature( TiledRendering );
+    setFeature( PageBoundingBoxes );
 #ifdef OKULAR_TEXTDOCUMENT_THREADED_RENDERING
     if ( QFontDatabase::supportsThreadedFontRendering() )
         setFeature( Threaded );
@@ -355,11 +386,14 @@ QImage TextDocumentGeneratorPrivate::image( PixmapRequest * request )
     Q_Q( TextDocumentGenerator );
 #endif
 
-    QImage image( request->width(), request->height(), QImage::Format_ARGB32 );
+    // for tiles, only the requested part of the page is painted
+    const QRect pixelRect = request->pixelRect();
+    QImage image( pixelRect.size(), QImage::Format_ARGB32 );
     image.fill( Qt::white );
 
     QPainter p;
     p.begin( &image );
+    p.translate( -pixelRect.topLeft() );
 
     qreal width = request->width();
     qreal height = request->height();
@@ -368,8 +402,10 @@ QImage TextDocumentGeneratorPrivate::image( PixmapRequest * request )
 
     p.scale( width / (qreal)size.width(), height / (qreal)size.height() );
 
+    const NormalizedRect &area = request->normalizedRect();
     QRect rect;
-    rect = QRect( 0, request->pageNumber() * size.height(), size.width(), size.height() );
+    rect = QRectF( area.left * size.width(), request->pageNumber() * size.height() + area.top * size.height(),
+                   ( area.right - area.left ) * size.width(), ( area.bottom - area.top ) * size.height() ).toAlignedRect();
     p.translate( QPoint( 0, request->pageNumber() * size.height() * -1 ) );
 #ifdef OKULAR_TEXTDOCUMENT_THREADED_RENDERING
     q->userMutex()->lock();
@@ -389,6 +425,12 @@ Okular::TextPage* TextDocumentGenerator::textPage( Okular::Page * page )
     return d->createTextPage( page->number() );
 }
 
+Okular::NormalizedRect TextDocumentGenerator::pageBoundingBox( Okular::Page * page )
+{
+    Q_D( TextDocumentGenerator );
+    return d->createBoundingBox( page->number() );
+}
+
 bool TextDocumentGenerator::print( QPrinter& printer )
 {
     Q_D( TextDocumentGenerator );
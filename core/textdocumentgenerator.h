@@ -169,6 +169,7 @@ class OKULAR_EXPORT TextDocumentGenerator : public Generator
     protected:
         bool doCloseDocument();
         Okular::TextPage* textPage( Okular::Page *page );
+        Okular::NormalizedRect pageBoundingBox( Okular::Page *page );
 
     private:
         Q_DECLARE_PRIVATE( TextDocumentGenerator )
@@ -18,6 +18,7 @@
 #include "document.h"
 #include "generator_p.h"
 #include "textdocumentgenerator.h"
+#include "textpage.h"
 
 namespace Okular {
 
@@ -61,6 +62,88 @@ namespace TextDocumentUtils {
                            (r - x) / pageSize.width(), (b - y) / pageSize.height() );
         }
 
+        /**
+         * Returns the line of @p layout with the text @p position, starting
+         * the search from the line at @p index (updated to the found one).
+         */
+        static QTextLine lineForPosition( const QTextLayout *layout, int position, int *index )
+        {
+            while ( *index + 1 < layout->lineCount() && layout->lineAt( *index + 1 ).textStart() <= position )
+                ++( *index );
+            return layout->lineAt( *index );
+        }
+
+        /**
+         * Appends to @p textPage the characters from @p startPosition to
+         * @p endPosition (excluded), each with the bounding rect given by
+         * calculateBoundingRect() for it and the next position, and with a
+         * pseudo "\n" character for each line break.
+         *
+         * Instead of looking for the block and the line of each position,
+         * the blocks and their lines are walked once.
+         */
+        static void appendText( QTextDocument *document, int startPosition, int endPosition, Okular::TextPage *textPage )
+        {
+            const QSizeF pageSize = document->pageSize();
+            const int pageHeight = qRound( pageSize.height() );
+            const QAbstractTextDocumentLayout *layout = document->documentLayout();
+
+            for ( QTextBlock block = document->findBlock( startPosition ); block.isValid() && block.position() < endPosition; block = block.next() )
+            {
+                const QTextBlock nextBlock = block.next();
+                const QTextLayout *textLayout = block.layout();
+                if ( !textLayout || textLayout->lineCount() == 0 )
+                    continue;
+
+                const QRectF blockRect = layout->blockBoundingRect( block );
+                const QString text = block.text();
+                const int blockPosition = block.position();
+                const int last = qMin( block.length(), endPosition - blockPosition );
+                int lineIndex = 0;
+                int endLineIndex = 0;
+                for ( int pos = qMax( startPosition - blockPosition, 0 ); pos < last; ++pos )
+                {
+                    const QTextLine line = lineForPosition( textLayout, pos, &lineIndex );
+                    const double x = blockRect.x() + line.cursorToX( pos );
+                    const double y = blockRect.y() + line.y();
+
+                    // the next position is in the next block after the end
+                    // of this one (the paragraph separator)
+                    double r, b;
+                    if ( pos + 1 < block.length() )
+                    {
+                        const QTextLine endLine = lineForPosition( textLayout, pos + 1, &endLineIndex );
+                        r = blockRect.x() + endLine.cursorToX( pos + 1 );
+                        b = blockRect.y() + endLine.y() + endLine.height();
+                    }
+                    else
+                    {
+                        if ( !nextBlock.isValid() || !nextBlock.layout() || nextBlock.layout()->lineCount() == 0 )
+                            break;
+                        const QRectF nextBlockRect = layout->blockBoundingRect( nextBlock );
+                        const QTextLine endLine = nextBlock.layout()->lineAt( 0 );
+                        r = nextBlockRect.x() + endLine.cursorToX( 0 );
+                        b = nextBlockRect.y() + endLine.y() + endLine.height();
+                    }
+
+                    const int offset = qRound( y ) % pageHeight;
+                    QRectF rect;
+                    QString character;
+                    if ( x > r ) { // line break, so add a pseudo character on the start line
+                        rect = QRectF( x / pageSize.width(), offset / pageSize.height(),
+                                       3 / pageSize.width(), line.height() / pageSize.height() );
+                        character = "\n";
+                    } else {
+                        rect = QRectF( x / pageSize.width(), offset / pageSize.height(),
+                                       (r - x) / pageSize.width(), (b - y) / pageSize.height() );
+                        character = pos < text.length() ? QString( text.at( pos ) ) : QString( QChar( QChar::ParagraphSeparator ) );
+                    }
+
+                    textPage->append( character, new Okular::NormalizedRect( rect.left(), rect.top(), rect.right(), rect.bottom() ) );
+                }
+            }
+        }
+
         static void calculatePositions( QTextDocument *document, int page, int &start, int &end )
         {
             const QAbstractTextDocumentLayout *layout = document->documentLayout();
@@ -127,6 +210,7 @@ class TextDocumentGeneratorPrivate : public GeneratorPrivate
         void calculateBoundingRect( int startPosition, int endPosition, QRectF &rect, int &page ) const;
         void calculatePositions( int page, int &start, int &end ) const;
         Okular::TextPage* createTextPage( int ) const;
+        Okular::NormalizedRect createBoundingBox( int ) const;
 
         void addAction( Action *action, int cursorBegin, int cursorEnd );
         void addAnnotation( Annotation *annotation, int cursorBegin, int cursorEnd );
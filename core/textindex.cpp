@@ -0,0 +1,273 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "textindex_p.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QFile>
+#include <QtCore/QSet>
+
+#include <algorithm>
+
+#include "textpage.h"
+
+using namespace Okular;
+
+static const quint32 TextIndexMagic = 0x4f4b5449; // "OKTI"
+static const quint32 TextIndexVersion = 2;
+
+namespace {
+
+// orders the suffixes of the words, see TextIndex::m_suffixes
+class SuffixLessThan
+{
+    public:
+        SuffixLessThan( const QStringList &words )
+            : m_words( words )
+        {
+        }
+
+        bool operator()( const QPair< int, int > &a, const QPair< int, int > &b ) const
+        {
+            return suffix( a ) < suffix( b );
+        }
+
+        bool operator()( const QPair< int, int > &a, const QString &text ) const
+        {
+            return suffix( a ) < QStringRef( &text );
+        }
+
+        bool operator()( const QString &text, const QPair< int, int > &a ) const
+        {
+            return QStringRef( &text ) < suffix( a );
+        }
+
+    private:
+        QStringRef suffix( const QPair< int, int > &s ) const
+        {
+            const QString &word = m_words.at( s.first );
+            return QStringRef( &word, s.second, word.length() - s.second );
+        }
+
+        const QStringList &m_words;
+};
+
+}
+
+TextIndex::TextIndex( const QString &fileName, int pagesCount, const QByteArray &documentHash )
+    : m_fileName( fileName ), m_documentHash( documentHash ), m_indexedPages( pagesCount ), m_modified( false ),
+      m_suffixesValid( false )
+{
+    if ( m_fileName.isEmpty() || m_documentHash.isEmpty() )
+        return;
+
+    QFile file( m_fileName );
+    if ( !file.open( QIODevice::ReadOnly ) )
+        return;
+
+    QDataStream stream( &file );
+    quint32 magic, version;
+    QByteArray hash;
+    stream >> magic >> version >> hash;
+    if ( magic != TextIndexMagic || version != TextIndexVersion || hash != m_documentHash )
+        return;
+
+    QBitArray indexedPages;
+    QHash< QString, QVector< int > > pages;
+    stream >> indexedPages >> pages;
+    if ( stream.status() != QDataStream::Ok || indexedPages.size() != pagesCount )
+        return;
+
+    m_indexedPages = indexedPages;
+    m_pages = pages;
+}
+
+void TextIndex::save()
+{
+    if ( !m_modified || m_fileName.isEmpty() || m_documentHash.isEmpty() )
+        return;
+
+    QFile file( m_fileName );
+    if ( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+        return;
+
+    QDataStream stream( &file );
+    stream << TextIndexMagic << TextIndexVersion << m_documentHash << m_indexedPages << m_pages;
+    m_modified = false;
+}
+
+void TextIndex::addPage( int page, const TextPage *textPage )
+{
+    if ( page < 0 || page >= m_indexedPages.size() || m_indexedPages.testBit( page ) )
+        return;
+
+    // a page without text page has no words at all
+    if ( textPage )
+    {
+        const QString text = textPage->text();
+        foreach ( const QString &word, ( words( text ) + hyphenatedWords( text ) ).toSet() )
+        {
+            QHash< QString, QVector< int > >::iterator it = m_pages.find( word );
+            if ( it == m_pages.end() )
+            {
+                it = m_pages.insert( word, QVector< int >() );
+                m_suffixesValid = false;
+            }
+            it.value().append( page );
+        }
+    }
+
+    m_indexedPages.setBit( page );
+    m_modified = true;
+}
+
+bool TextIndex::isPageIndexed( int page ) const
+{
+    return page >= 0 && page < m_indexedPages.size() && m_indexedPages.testBit( page );
+}
+
+int TextIndex::nextPageToIndex( int page ) const
+{
+    for ( int i = qMax( page, 0 ); i < m_indexedPages.size(); ++i )
+        if ( !m_indexedPages.testBit( i ) )
+            return i;
+
+    return -1;
+}
+
+QBitArray TextIndex::pagesContaining( const QString &text ) const
+{
+    // the pages not indexed may contain anything
+    QBitArray result = ~m_indexedPages;
+
+    const QStringList textWords = words( text );
+    if ( textWords.isEmpty() )
+    {
+        result.fill( true );
+        return result;
+    }
+
+    // each word of the text can be a part of a word of the page (the text
+    // can start or end in the middle of a word, and the spacing of the page
+    // may differ), so each one is looked for among the suffixes of the
+    // indexed words
+    buildSuffixes();
+    QBitArray indexed = m_indexedPages;
+    foreach ( const QString &textWord, textWords )
+    {
+        QBitArray wordPages( m_indexedPages.size() );
+        QVector< QPair< int, int > >::const_iterator it = std::lower_bound( m_suffixes.constBegin(), m_suffixes.constEnd(), textWord, SuffixLessThan( m_words ) );
+        QSet< int > matchingWords;
+        for ( ; it != m_suffixes.constEnd(); ++it )
+        {
+            const QString &word = m_words.at( (*it).first );
+            if ( word.length() - (*it).second < textWord.length() ||
+                 QStringRef( &word, (*it).second, textWord.length() ) != textWord )
+                break;
+
+            matchingWords.insert( (*it).first );
+        }
+
+        foreach ( int wordIndex, matchingWords )
+        {
+            foreach ( int page, m_pages.value( m_words.at( wordIndex ) ) )
+                wordPages.setBit( page );
+        }
+        indexed &= wordPages;
+    }
+
+    return result | indexed;
+}
+
+void TextIndex::buildSuffixes() const
+{
+    if ( m_suffixesValid )
+        return;
+
+    m_words = m_pages.keys();
+    m_suffixes.clear();
+    for ( int i = 0; i < m_words.count(); ++i )
+    {
+        const int length = m_words.at( i ).length();
+        for ( int offset = 0; offset < length; ++offset )
+            m_suffixes.append( qMakePair( i, offset ) );
+    }
+    qSort( m_suffixes.begin(), m_suffixes.end(), SuffixLessThan( m_words ) );
+    m_suffixesValid = true;
+}
+
+QStringList TextIndex::words( const QString &text )
+{
+    QStringList result;
+
+    const QString lower = text.toLower();
+    int start = -1;
+    for ( int i = 0; i <= lower.length(); ++i )
+    {
+        const bool isWordChar = i < lower.length() && lower.at( i ).isLetterOrNumber();
+        if ( isWordChar && start < 0 )
+        {
+            start = i;
+        }
+        else if ( !isWordChar && start >= 0 )
+        {
+            result.append( lower.mid( start, i - start ) );
+            start = -1;
+        }
+    }
+
+    return result;
+}
+
+QStringList TextIndex::hyphenatedWords( const QString &text )
+{
+    // TextPage::findText() matches a word broken by a hyphen at a line end as
+    // a whole, but the line ends cannot be told from the text alone, so the
+    // words around any hyphen are indexed joined too
+    QStringList result;
+
+    const QString lower = text.toLower();
+    const int length = lower.length();
+    int i = 0;
+    while ( i < length )
+    {
+        if ( !lower.at( i ).isLetterOrNumber() )
+        {
+            ++i;
+            continue;
+        }
+
+        QString joined;
+        int parts = 0;
+        forever
+        {
+            const int start = i;
+            while ( i < length && lower.at( i ).isLetterOrNumber() )
+                ++i;
+            joined += lower.mid( start, i - start );
+            ++parts;
+
+            if ( i >= length || lower.at( i ) != QLatin1Char( '-' ) )
+                break;
+
+            int next = i + 1;
+            while ( next < length && lower.at( next ).isSpace() )
+                ++next;
+            if ( next >= length || !lower.at( next ).isLetterOrNumber() )
+                break;
+
+            i = next;
+        }
+
+        if ( parts > 1 )
+            result.append( joined );
+    }
+
+    return result;
+}
@@ -0,0 +1,90 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef _OKULAR_TEXTINDEX_P_H_
+#define _OKULAR_TEXTINDEX_P_H_
+
+#include <QtCore/QBitArray>
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QPair>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+
+namespace Okular {
+
+class TextPage;
+
+/**
+ * @short An inverted index of the words of the pages of a document.
+ *
+ * The pages are added one by one, as soon as their TextPage is available, and
+ * the index can be saved to file to be reused the next time the same document
+ * is opened.
+ *
+ * The index knows only whole words, case insensitively, so it answers whether
+ * a page @em may contain a text: the pages not indexed yet always may.
+ */
+class TextIndex
+{
+    public:
+        /**
+         * Creates an index for a document of @p pagesCount pages, loading it
+         * from @p fileName if it was saved for the document with the given
+         * @p documentHash.
+         */
+        TextIndex( const QString &fileName, int pagesCount, const QByteArray &documentHash );
+
+        /**
+         * Saves the index to its file, if it changed.
+         */
+        void save();
+
+        /**
+         * Adds the words of the @p textPage of the @p page; a null @p textPage
+         * means the page has no text.
+         */
+        void addPage( int page, const TextPage *textPage );
+
+        bool isPageIndexed( int page ) const;
+
+        /**
+         * Returns the first page not indexed yet starting from @p page, or -1
+         * if all the pages after it are indexed.
+         */
+        int nextPageToIndex( int page ) const;
+
+        /**
+         * Returns the pages which may contain @p text.
+         */
+        QBitArray pagesContaining( const QString &text ) const;
+
+    private:
+        static QStringList words( const QString &text );
+        static QStringList hyphenatedWords( const QString &text );
+        void buildSuffixes() const;
+
+        QString m_fileName;
+        QByteArray m_documentHash;
+        QBitArray m_indexedPages;
+        QHash< QString, QVector< int > > m_pages;
+        bool m_modified;
+
+        // all the suffixes of the indexed words, sorted, as pairs of the
+        // index of the word in m_words and of the offset in the word: the
+        // words containing a text are the ones with a suffix starting with it
+        mutable QStringList m_words;
+        mutable QVector< QPair< int, int > > m_suffixes;
+        mutable bool m_suffixesValid;
+};
+
+}
+
+#endif
@@ -29,12 +29,12 @@ class SearchPoint
 {
     public:
         SearchPoint()
-            : offset_begin( -1 ), offset_end( -1 )
+            : it_begin( -1 ), it_end( -1 ), offset_begin( -1 ), offset_end( -1 )
         {
         }
 
-        TextList::ConstIterator it_begin;
-        TextList::ConstIterator it_end;
+        int it_begin;
+        int it_end;
         int offset_begin;
         int offset_end;
 };
@@ -125,6 +125,9 @@ static bool doesConsumeY(const QRect& first, const QRect& second, int threshold)
   Even better, if the string we need to store has at most
   MaxStaticChars characters, then we store those in place of the QChar*
   that would be used (with new[] + free[]) for the data.
+
+  TinyTextEntity is used only while analyzing the layout of a page, the
+  text of a TextPage is kept in a TextEntityStore.
  */
 class TinyTextEntity
 {
@@ -223,15 +226,89 @@ NormalizedRect TextEntity::transformedArea(const QMatrix &matrix) const
 }
 
 
+static inline quint16 quantizeCoordinate( double value )
+{
+    return qRound( qBound( 0.0, value, 1.0 ) * 65535 );
+}
+
+static inline double dequantizeCoordinate( quint16 value )
+{
+    return value / 65535.0;
+}
+
+void TextEntityStore::clear()
+{
+    m_text.clear();
+    m_offsets.clear();
+    m_boxes.clear();
+    m_entities.clear();
+}
+
+void TextEntityStore::append( const QString &text, const NormalizedRect &area )
+{
+    Q_ASSERT_X( !text.isEmpty(), "TextEntityStore", "empty string" );
+    const int entity = count();
+    if ( m_offsets.isEmpty() )
+        m_offsets.append( 0 );
+
+    m_text.append( text );
+    m_offsets.append( m_text.length() );
+    m_boxes << quantizeCoordinate( area.left ) << quantizeCoordinate( area.top )
+            << quantizeCoordinate( area.right ) << quantizeCoordinate( area.bottom );
+    m_entities.insert( m_entities.end(), text.length(), entity );
+}
+
+void TextEntityStore::squeeze()
+{
+    m_text.squeeze();
+    m_offsets.squeeze();
+    m_boxes.squeeze();
+    m_entities.squeeze();
+}
+
+QString TextEntityStore::text( int entity ) const
+{
+    return QString( m_text.constData() + position( entity ), length( entity ) );
+}
+
+QStringRef TextEntityStore::textRef( int entity, int position, int n ) const
+{
+    const int entityLength = length( entity );
+    if ( position > entityLength )
+        return QStringRef();
+    if ( n < 0 || n > entityLength - position )
+        n = entityLength - position;
+    if ( position < 0 )
+    {
+        n += position;
+        position = 0;
+    }
+    return QStringRef( &m_text, m_offsets.at( entity ) + position, n );
+}
+
+NormalizedRect TextEntityStore::area( int entity ) const
+{
+    const quint16 *box = m_boxes.constData() + 4 * entity;
+    return NormalizedRect( dequantizeCoordinate( box[0] ), dequantizeCoordinate( box[1] ),
+                           dequantizeCoordinate( box[2] ), dequantizeCoordinate( box[3] ) );
+}
+
+NormalizedRect TextEntityStore::transformedArea( int entity, const QMatrix &matrix ) const
+{
+    NormalizedRect transformed_area = area( entity );
+    transformed_area.transform( matrix );
+    return transformed_area;
+}
+
+
 TextPagePrivate::TextPagePrivate()
-    : m_page( 0 )
+    : m_page( 0 ), m_textOrderCorrected( false )
 {
 }
 
 TextPagePrivate::~TextPagePrivate()
 {
     qDeleteAll( m_searchPoints );
-    qDeleteAll( m_words );
 }
 
 
@@ -248,9 +325,10 @@ TextPage::TextPage( const TextEntity::List &words )
     {
         TextEntity *e = *it;
         if ( !e->text().isEmpty() )
-            d->m_words.append( new TinyTextEntity( e->text(), *e->area() ) );
+            d->m_words.append( e->text(), *e->area() );
         delete e;
     }
+    d->m_words.squeeze();
 }
 
 TextPage::~TextPage()
@@ -261,7 +339,7 @@ TextPage::~TextPage()
 void TextPage::append( const QString &text, NormalizedRect *area )
 {
     if ( !text.isEmpty() )
-        d->m_words.append( new TinyTextEntity( text.normalized(QString::NormalizationForm_KC), *area ) );
+        d->m_words.append( text.normalized(QString::NormalizationForm_KC), *area );
     delete area;
 }
 
@@ -541,15 +619,15 @@ RegularAreaRect * TextPage::textArea ( TextSelection * sel) const
         if(endC.y * scaleY < minY) endC.y = minY/scaleY;
     }
 
-    TextList::ConstIterator it = d->m_words.constBegin(), itEnd = d->m_words.constEnd();
-    TextList::ConstIterator start = it, end = itEnd, tmpIt = it; //, tmpItEnd = itEnd;
+    int it = 0, itEnd = d->m_words.count();
+    int start = it, end = itEnd, tmpIt = it; //, tmpItEnd = itEnd;
     const MergeSide side = d->m_page ? (MergeSide)d->m_page->m_page->totalOrientation() : MergeRight;
 
     NormalizedRect tmp;
     //case 2(a)
     for ( ; it != itEnd; ++it )
     {
-        tmp = (*it)->area;
+        tmp = d->m_words.area( it );
         if(tmp.contains(startC.x,startC.y)){
             start = it;
         }
@@ -565,7 +643,7 @@ RegularAreaRect * TextPage::textArea ( TextSelection * sel) const
         for ( ; it != itEnd; ++it )
         {
             // is there any text reactangle within the start_end rect
-            tmp = (*it)->area;
+            tmp = d->m_words.area( it );
             if(start_end.intersects(tmp))
                 break;
         }
@@ -591,7 +669,7 @@ RegularAreaRect * TextPage::textArea ( TextSelection * sel) const
         {
             for ( ; it != itEnd; ++it )
             {
-                rect= (*it)->area;
+                rect= d->m_words.area( it );
                 rect.isBottom(startC) ? flagV = false: flagV = true;
 
                 if(flagV && rect.isRight(startC))
@@ -611,7 +689,7 @@ RegularAreaRect * TextPage::textArea ( TextSelection * sel) const
 
             for ( ; it != itEnd; ++it )
             {
-                rect= (*it)->area;
+                rect= d->m_words.area( it );
 
                 if(rect.isBottomOrLevel(startC) && rect.isRight(startC))
                 {
@@ -648,7 +726,7 @@ RegularAreaRect * TextPage::textArea ( TextSelection * sel) const
         {
             for ( ; itEnd >= it; itEnd-- )
             {
-                rect= (*itEnd)->area;
+                rect= d->m_words.area( itEnd );
                 rect.isTop(endC) ? flagV = false: flagV = true;
 
                 if(flagV && rect.isLeft(endC))
@@ -664,7 +742,7 @@ RegularAreaRect * TextPage::textArea ( TextSelection * sel) const
             int distance = scaleX + scaleY + 100;
             for ( ; itEnd >= it; itEnd-- )
             {
-                rect= (*itEnd)->area;
+                rect= d->m_words.area( itEnd );
 
                 if(rect.isTopOrLevel(endC) && rect.isLeft(endC))
                 {
@@ -709,11 +787,11 @@ RegularAreaRect * TextPage::textArea ( TextSelection * sel) const
     }
 
     // removes the possibility of crash, in case none of 1 to 3 is true
-    if(end == d->m_words.constEnd()) end--;
+    if(end == d->m_words.count()) end--;
 
     for( ;start <= end ; start++)
     {
-        ret->appendShape( (*start)->transformedArea( matrix ), side );
+        ret->appendShape( d->m_words.transformedArea( start, matrix ), side );
      }
 
 #endif
@@ -729,8 +807,8 @@ RegularAreaRect* TextPage::findText( int searchID, const QString &query, SearchD
     // invalid search request
     if ( d->m_words.isEmpty() || query.isEmpty() || ( area && area->isNull() ) )
         return 0;
-    TextList::ConstIterator start;
-    TextList::ConstIterator end;
+    int start;
+    int end;
     const QMap< int, SearchPoint* >::const_iterator sIt = d->m_searchPoints.constFind( searchID );
     if ( sIt == d->m_searchPoints.constEnd() )
     {
@@ -745,12 +823,12 @@ RegularAreaRect* TextPage::findText( int searchID, const QString &query, SearchD
     switch ( dir )
     {
         case FromTop:
-            start = d->m_words.constBegin();
-            end = d->m_words.constEnd();
+            start = 0;
+            end = d->m_words.count();
             break;
         case FromBottom:
-            start = d->m_words.constEnd();
-            end = d->m_words.constBegin();
+            start = d->m_words.count();
+            end = 0;
             Q_ASSERT( start != end );
             // we can safely go one step back, as we already checked
             // that the list is not empty
@@ -759,13 +837,13 @@ RegularAreaRect* TextPage::findText( int searchID, const QString &query, SearchD
             break;
         case NextResult:
             start = (*sIt)->it_end;
-            end = d->m_words.constEnd();
+            end = d->m_words.count();
             if ( ( start + 1 ) != end )
                 ++start;
             break;
         case PreviousResult:
             start = (*sIt)->it_begin;
-            end = d->m_words.constBegin();
+            end = 0;
             if ( start != end )
                 --start;
             forward = false;
@@ -789,22 +867,23 @@ RegularAreaRect* TextPage::findText( int searchID, const QString &query, SearchD
 // we have a '-' just followed by a '\n' character
 // check if the string contains a '-' character
 // if the '-' is the last entry
-static int stringLengthAdaptedWithHyphen(const QString &str, const TextList::ConstIterator &it, const TextList::ConstIterator &end, PagePrivate *page)
+static int stringLengthAdaptedWithHyphen(const TextEntityStore &words, int it, PagePrivate *page)
 {
-    int len = str.length();
+    const QString &buffer = words.buffer();
+    const int position = words.position( it );
+    int len = words.length( it );
     
     // hyphenated '-' must be at the end of a word, so hyphenation means
     // we have a '-' just followed by a '\n' character
     // check if the string contains a '-' character
     // if the '-' is the last entry
-    if ( str.endsWith( '-' ) )
+    if ( buffer.at( position + len - 1 ) == QLatin1Char( '-' ) )
     {
         // validity chek of it + 1
-        if ( ( it + 1 ) != end )
+        if ( ( it + 1 ) < words.count() )
         {
             // 1. if the next character is '\n'
-            const QString &lookahedStr = (*(it+1))->text();
-            if (lookahedStr.startsWith('\n'))
+            if ( buffer.at( words.position( it + 1 ) ) == QLatin1Char( '\n' ) )
             {
                 len -= 1;
             }
@@ -814,8 +893,8 @@ static int stringLengthAdaptedWithHyphen(const QString &str, const TextList::Con
                 const int pageWidth = page->m_page->width();
                 const int pageHeight = page->m_page->height();
 
-                const QRect hyphenArea = (*it)->area.roundedGeometry(pageWidth, pageHeight);
-                const QRect lookaheadArea = (*(it + 1))->area.roundedGeometry(pageWidth, pageHeight);
+                const QRect hyphenArea = words.area( it ).roundedGeometry(pageWidth, pageHeight);
+                const QRect lookaheadArea = words.area( it + 1 ).roundedGeometry(pageWidth, pageHeight);
 
                 // lookahead to check whether both the '-' rect and next character rect overlap
                 if( !doesConsumeY( hyphenArea, lookaheadArea, 70 ) )
@@ -826,7 +905,8 @@ static int stringLengthAdaptedWithHyphen(const QString &str, const TextList::Con
         }
     }
     // else if it is the second last entry - for example in pdf format
-    else if (str.endsWith("-\n"))
+    else if ( len >= 2 && buffer.at( position + len - 1 ) == QLatin1Char( '\n' )
+              && buffer.at( position + len - 2 ) == QLatin1Char( '-' ) )
     {
         len -= 2;
     }
@@ -834,11 +914,68 @@ static int stringLengthAdaptedWithHyphen(const QString &str, const TextList::Con
     return len;
 }
 
+/**
+ * Finds, moving forward in a TextEntityStore, the entities a match of a query
+ * can start from: the ones whose text begins with the first character of the
+ * query, or with an hyphen (which may not count in the length of the entity,
+ * see stringLengthAdaptedWithHyphen()).
+ * The occurrences are looked for in the text buffer, so the entities in
+ * between are not even touched.
+ */
+class MatchStartFinder
+{
+    public:
+        MatchStartFinder( const TextEntityStore &words, QChar first, Qt::CaseSensitivity caseSensitivity )
+            : m_words( words ), m_first( first ), m_caseSensitivity( caseSensitivity ),
+              m_firstPosition( Unknown ), m_hyphenPosition( Unknown )
+        {
+        }
+
+        /**
+         * Returns the first entity starting from @p entity a match can start
+         * from, or the count of the entities if there is none.
+         */
+        int next( int entity )
+        {
+            const QString &buffer = m_words.buffer();
+            const int count = m_words.count();
+            while ( entity < count )
+            {
+                const int position = m_words.position( entity );
+                if ( m_firstPosition == Unknown || ( m_firstPosition >= 0 && m_firstPosition < position ) )
+                    m_firstPosition = buffer.indexOf( m_first, position, m_caseSensitivity );
+                if ( m_hyphenPosition == Unknown || ( m_hyphenPosition >= 0 && m_hyphenPosition < position ) )
+                    m_hyphenPosition = buffer.indexOf( QLatin1Char( '-' ), position );
+
+                int found = m_firstPosition;
+                if ( found < 0 || ( m_hyphenPosition >= 0 && m_hyphenPosition < found ) )
+                    found = m_hyphenPosition;
+                if ( found < 0 )
+                    return count;
+
+                // the character has to be the first one of its entity
+                entity = m_words.entityAt( found );
+                if ( m_words.position( entity ) == found )
+                    return entity;
+                ++entity;
+            }
+            return count;
+        }
+
+    private:
+        enum { Unknown = -2 };
+
+        const TextEntityStore &m_words;
+        const QChar m_first;
+        const Qt::CaseSensitivity m_caseSensitivity;
+        int m_firstPosition;
+        int m_hyphenPosition;
+};
+
 RegularAreaRect* TextPagePrivate::findTextInternalForward( int searchID, const QString &_query,
                                                              Qt::CaseSensitivity caseSensitivity,
                                                              TextComparisonFunction comparer,
-                                                             const TextList::ConstIterator &start,
-                                                             const TextList::ConstIterator &end )
+                                                             int start, int end )
 {
     const QMatrix matrix = m_page ? m_page->rotationMatrix() : QMatrix();
 
@@ -852,18 +989,15 @@ RegularAreaRect* TextPagePrivate::findTextInternalForward( int searchID, const Q
     // j is the current position in our query
     // len is the length of the string in TextEntity
     // queryLeft is the length of the query we have left
-    const TinyTextEntity* curEntity = 0;
     int j=0, len=0, queryLeft=query.length();
     int offset = 0;
     bool haveMatch=false;
     bool offsetMoved = false;
-    TextList::ConstIterator it = start;
-    TextList::ConstIterator it_begin;
+    int it = start;
+    int it_begin = -1;
+    MatchStartFinder matchStarts( m_words, query.at( 0 ), caseSensitivity );
     for ( ; it != end; ++it )
     {
-        curEntity = *it;
-        const QString &str = curEntity->text();
-	kDebug() << str;
         if ( !offsetMoved && ( it == start ) )
         {
             if ( m_searchPoints.contains( searchID ) )
@@ -872,17 +1006,25 @@ RegularAreaRect* TextPagePrivate::findTextInternalForward( int searchID, const Q
             }
             offsetMoved = true;
         }
+        if ( it_begin == -1 && offset == 0 )
         {
-            len = stringLengthAdaptedWithHyphen(str, it, end, m_page);
+            // not in the middle of a match, so skip directly to the next
+            // entity which can start one
+            it = matchStarts.next( it );
+            if ( it == end )
+                break;
+        }
+        {
+            len = stringLengthAdaptedWithHyphen(m_words, it, m_page);
             int min=qMin(queryLeft,len);
 #ifdef DEBUG_TEXTPAGE
-            kDebug(OkularDebug) << str.mid(offset,min) << ":" << _query.mid(j,min);
+            kDebug(OkularDebug) << m_words.textRef(it, offset, min).toString() << ":" << _query.mid(j,min);
 #endif
             // we have equal (or less than) area of the query left as the length of the current 
             // entity
 
             int resStrLen = 0, resQueryLen = 0;
-            if ( !comparer( str.midRef( offset, min ), query.midRef( j, min ),
+            if ( !comparer( m_words.textRef( it, offset, min ), query.midRef( j, min ),
                             &resStrLen, &resQueryLen ) )
             {
                     // we not have matched
@@ -897,7 +1039,7 @@ RegularAreaRect* TextPagePrivate::findTextInternalForward( int searchID, const Q
                     j=0;
                     offset = 0;
                     queryLeft=query.length();
-                    it_begin = TextList::ConstIterator();
+                    it_begin = -1;
             }
             else
             {
@@ -911,10 +1053,10 @@ RegularAreaRect* TextPagePrivate::findTextInternalForward( int searchID, const Q
             kDebug(OkularDebug) << "\tmatched";
 #endif
                     haveMatch=true;
-                    ret->append( curEntity->transformedArea( matrix ) );
+                    ret->append( m_words.transformedArea( it, matrix ) );
                     j += resStrLen;
                     queryLeft -= resQueryLen;
-                    if ( it_begin == TextList::ConstIterator() )
+                    if ( it_begin == -1 )
                     {
                         it_begin = it;
                     }
@@ -953,8 +1095,7 @@ RegularAreaRect* TextPagePrivate::findTextInternalForward( int searchID, const Q
 RegularAreaRect* TextPagePrivate::findTextInternalBackward( int searchID, const QString &_query,
                                                             Qt::CaseSensitivity caseSensitivity,
                                                             TextComparisonFunction comparer,
-                                                            const TextList::ConstIterator &start,
-                                                            const TextList::ConstIterator &end )
+                                                            int start, int end )
 {
     const QMatrix matrix = m_page ? m_page->rotationMatrix() : QMatrix();
 
@@ -968,16 +1109,13 @@ RegularAreaRect* TextPagePrivate::findTextInternalBackward( int searchID, const
     // j is the current position in our query
     // len is the length of the string in TextEntity
     // queryLeft is the length of the query we have left
-    const TinyTextEntity* curEntity = 0;
     int j=query.length() - 1, len=0, queryLeft=query.length();
     bool haveMatch=false;
     bool offsetMoved = false;
-    TextList::ConstIterator it = start;
-    TextList::ConstIterator it_begin;
+    int it = start;
+    int it_begin = -1;
     while ( true )
     {
-        curEntity = *it;
-        const QString &str = curEntity->text();
         if ( !offsetMoved && ( it == start ) )
         {
             offsetMoved = true;
@@ -993,18 +1131,18 @@ RegularAreaRect* TextPagePrivate::findTextInternalBackward( int searchID, const
         }
         else
         {
-            len = stringLengthAdaptedWithHyphen(str, it, end, m_page);
+            len = stringLengthAdaptedWithHyphen(m_words, it, m_page);
             int min=qMin(queryLeft,len);
 #ifdef DEBUG_TEXTPAGE
-            kDebug(OkularDebug) << str.right(min) << " : " << _query.mid(j-min+1,min);
+            kDebug(OkularDebug) << m_words.text(it).right(min) << " : " << _query.mid(j-min+1,min);
 #endif
             // we have equal (or less than) area of the query left as the length of the current 
             // entity
 
             int resStrLen = 0, resQueryLen = 0;
-            // Note len is not str.length() so we can't use rightRef here
+            // Note len is not the length of the text so we can't use rightRef here
             const int offset = len - min;
-            if ( !comparer( str.midRef(offset, min ), query.midRef( j - min + 1, min ),
+            if ( !comparer( m_words.textRef( it, offset, min ), query.midRef( j - min + 1, min ),
                             &resStrLen, &resQueryLen ) )
             {
                     // we not have matched
@@ -1018,7 +1156,7 @@ RegularAreaRect* TextPagePrivate::findTextInternalBackward( int searchID, const
 #endif
                     j=query.length() - 1;
                     queryLeft=query.length();
-                    it_begin = TextList::ConstIterator();
+                    it_begin = -1;
             }
             else
             {
@@ -1032,10 +1170,10 @@ RegularAreaRect* TextPagePrivate::findTextInternalBackward( int searchID, const
                     kDebug(OkularDebug) << "\tmatched";
 #endif
                     haveMatch=true;
-                    ret->append( curEntity->transformedArea( matrix ) );
+                    ret->append( m_words.transformedArea( it, matrix ) );
                     j -= resStrLen;
                     queryLeft -= resQueryLen;
-                    if ( it_begin == TextList::ConstIterator() )
+                    if ( it_begin == -1 )
                     {
                         it_begin = it;
                     }
@@ -1085,33 +1223,33 @@ QString TextPage::text(const RegularAreaRect *area, TextAreaInclusionBehaviour b
     if ( area && area->isNull() )
         return QString();
 
-    TextList::ConstIterator it = d->m_words.constBegin(), itEnd = d->m_words.constEnd();
     QString ret;
     if ( area )
     {
-        for ( ; it != itEnd; ++it )
+        const int count = d->m_words.count();
+        for ( int it = 0; it < count; ++it )
         {
             if (b == AnyPixelTextAreaInclusionBehaviour)
             {
-                if ( area->intersects( (*it)->area ) )
+                if ( area->intersects( d->m_words.area( it ) ) )
                 {
-                    ret += (*it)->text();
+                    ret.append( d->m_words.textRef( it ) );
                 }
             }
             else
             {
-                NormalizedPoint center = (*it)->area.center();
+                NormalizedPoint center = d->m_words.area( it ).center();
                 if ( area->contains( center.x, center.y ) )
                 {
-                    ret += (*it)->text();
+                    ret.append( d->m_words.textRef( it ) );
                 }
             }
         }
     }
     else
     {
-        for ( ; it != itEnd; ++it )
-            ret += (*it)->text();
+        // the text of the entities is already stored all together
+        ret = d->m_words.buffer();
     }
     return ret;
 }
@@ -1137,8 +1275,13 @@ static bool compareTinyTextEntityY(const WordWithCharacters &first, const WordWi
  */
 void TextPagePrivate::setWordList(const TextList &list)
 {
-    qDeleteAll(m_words);
-    m_words = list;
+    m_words.clear();
+    foreach (TinyTextEntity *word, list)
+    {
+        m_words.append( word->text(), word->area );
+    }
+    m_words.squeeze();
+    qDeleteAll(list);
 }
 
 /**
@@ -1888,7 +2031,13 @@ void TextPagePrivate::correctTextOrder()
     const int pageWidth = m_page->m_page->width();
     const int pageHeight = m_page->m_page->height();
 
-    TextList characters = m_words;
+    // the layout analysis works on standalone entities
+    TextList characters;
+    for ( int i = 0; i < m_words.count(); ++i )
+    {
+        characters.append( new TinyTextEntity( m_words.text( i ), m_words.area( i ) ) );
+    }
+    const TextList pageCharacters = characters;
 
     /**
      * Remove spaces from the text
@@ -1919,7 +2068,9 @@ void TextPagePrivate::correctTextOrder()
         delete word.word;
         listOfCharacters.append(word.characters);
     }
+    qDeleteAll(pageCharacters);
     setWordList(listOfCharacters);
+    m_textOrderCorrected = true;
 }
 
 TextEntity::List TextPage::words(const RegularAreaRect *area, TextAreaInclusionBehaviour b) const
@@ -1928,32 +2079,34 @@ TextEntity::List TextPage::words(const RegularAreaRect *area, TextAreaInclusionB
         return TextEntity::List();
 
     TextEntity::List ret;
+    const int count = d->m_words.count();
     if ( area )
     {
-        foreach (TinyTextEntity *te, d->m_words)
+        for ( int i = 0; i < count; ++i )
         {
+            const NormalizedRect teArea = d->m_words.area( i );
             if (b == AnyPixelTextAreaInclusionBehaviour)
             {
-                if ( area->intersects( te->area ) )
+                if ( area->intersects( teArea ) )
                 {
-                    ret.append( new TextEntity( te->text(), new Okular::NormalizedRect( te->area) ) );
+                    ret.append( new TextEntity( d->m_words.text( i ), new Okular::NormalizedRect( teArea ) ) );
                 }
             }
             else
             {
-                const NormalizedPoint center = te->area.center();
+                const NormalizedPoint center = teArea.center();
                 if ( area->contains( center.x, center.y ) )
                 {
-                    ret.append( new TextEntity( te->text(), new Okular::NormalizedRect( te->area) ) );
+                    ret.append( new TextEntity( d->m_words.text( i ), new Okular::NormalizedRect( teArea ) ) );
                 }
             }
         }
     }
     else
     {
-        foreach (TinyTextEntity *te, d->m_words)
+        for ( int i = 0; i < count; ++i )
         {
-            ret.append( new TextEntity( te->text(), new Okular::NormalizedRect( te->area) ) );
+            ret.append( new TextEntity( d->m_words.text( i ), new Okular::NormalizedRect( d->m_words.area( i ) ) ) );
         }
     }
     return ret;
@@ -1961,12 +2114,12 @@ TextEntity::List TextPage::words(const RegularAreaRect *area, TextAreaInclusionB
 
 RegularAreaRect * TextPage::wordAt( const NormalizedPoint &p, QString *word ) const
 {
-    TextList::ConstIterator itBegin = d->m_words.constBegin(), itEnd = d->m_words.constEnd();
-    TextList::ConstIterator it = itBegin;
-    TextList::ConstIterator posIt = itEnd;
+    const int itBegin = 0, itEnd = d->m_words.count();
+    int it = itBegin;
+    int posIt = itEnd;
     for ( ; it != itEnd; ++it )
     {
-        if ( (*it)->area.contains( p.x, p.y ) )
+        if ( d->m_words.area( it ).contains( p.x, p.y ) )
         {
             posIt = it;
             break;
@@ -1975,7 +2128,7 @@ RegularAreaRect * TextPage::wordAt( const NormalizedPoint &p, QString *word ) co
     QString text;
     if ( posIt != itEnd )
     {
-        if ( (*posIt)->text().simplified().isEmpty() )
+        if ( d->m_words.text( posIt ).simplified().isEmpty() )
         {
             return NULL;
         }
@@ -1983,7 +2136,7 @@ RegularAreaRect * TextPage::wordAt( const NormalizedPoint &p, QString *word ) co
         while ( posIt != itBegin )
         {
             --posIt;
-            const QString itText = (*posIt)->text();
+            const QString itText = d->m_words.text( posIt );
             if ( itText.right(1).at(0).isSpace() )
             {
                 if (itText.endsWith("-\n"))
@@ -1996,7 +2149,7 @@ RegularAreaRect * TextPage::wordAt( const NormalizedPoint &p, QString *word ) co
                 if (itText == "\n" && posIt != itBegin )
                 {
                     --posIt;
-                    if ((*posIt)->text().endsWith("-")) {
+                    if (d->m_words.text( posIt ).endsWith("-")) {
                         // Is an hyphenated word
                         // continue searching the start of the word back
                         continue;
@@ -2011,14 +2164,14 @@ RegularAreaRect * TextPage::wordAt( const NormalizedPoint &p, QString *word ) co
         RegularAreaRect *ret = new RegularAreaRect();
         for ( ; posIt != itEnd; ++posIt )
         {
-            const QString itText = (*posIt)->text();
+            const QString itText = d->m_words.text( posIt );
             if ( itText.simplified().isEmpty() )
             {
                 break;
             }
             
-            ret->appendShape( (*posIt)->area );
-            text += (*posIt)->text();
+            ret->appendShape( d->m_words.area( posIt ) );
+            text += itText;
             if (itText.right(1).at(0).isSpace())
             {
                 if (!text.endsWith("-\n"))
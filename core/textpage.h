@@ -92,6 +92,7 @@ class OKULAR_EXPORT TextPage
     /// @cond PRIVATE
     friend class Page;
     friend class PagePrivate;
+    friend class TextPageExtractionThread;
     /// @endcond
 
     public:
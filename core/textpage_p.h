@@ -14,8 +14,12 @@
 #include <QtCore/QList>
 #include <QtCore/QMap>
 #include <QtCore/QPair>
+#include <QtCore/QString>
+#include <QtCore/QVector>
 #include <QtGui/QMatrix>
 
+#include "area.h"
+
 class SearchPoint;
 class TinyTextEntity;
 class RegionText;
@@ -34,6 +38,57 @@ typedef bool ( *TextComparisonFunction )( const QStringRef & from, const QString
  */
 typedef QList<RegionText> RegionTextList;
 
+/**
+ * The entities of a TextPage in a compact form: the text of all of them one
+ * after the other in a single UTF-16 buffer, and their rectangles quantized
+ * to 16 bits per coordinate in a parallel array, so that a page with
+ * thousands of glyphs needs only a handful of allocations.
+ *
+ * The position of each character of the buffer is mapped back to its entity.
+ */
+class TextEntityStore
+{
+    public:
+        void clear();
+        void append( const QString &text, const NormalizedRect &area );
+        void squeeze();
+
+        inline int count() const { return m_boxes.count() / 4; }
+        inline bool isEmpty() const { return m_boxes.isEmpty(); }
+
+        /**
+         * The text of all the entities.
+         */
+        inline const QString &buffer() const { return m_text; }
+
+        /**
+         * The position in buffer() of the first character of @p entity.
+         */
+        inline int position( int entity ) const { return m_offsets.at( entity ); }
+        inline int length( int entity ) const { return m_offsets.at( entity + 1 ) - m_offsets.at( entity ); }
+
+        /**
+         * The entity the character at @p position of buffer() belongs to.
+         */
+        inline int entityAt( int position ) const { return m_entities.at( position ); }
+
+        QString text( int entity ) const;
+
+        /**
+         * Like text( @p entity ).midRef( @p position, @p n ), without copying.
+         */
+        QStringRef textRef( int entity, int position = 0, int n = -1 ) const;
+
+        NormalizedRect area( int entity ) const;
+        NormalizedRect transformedArea( int entity, const QMatrix &matrix ) const;
+
+    private:
+        QString m_text;
+        QVector< int > m_offsets;
+        QVector< quint16 > m_boxes;
+        QVector< int > m_entities;
+};
+
 class TextPagePrivate
 {
     public:
@@ -43,16 +98,14 @@ class TextPagePrivate
         RegularAreaRect * findTextInternalForward( int searchID, const QString &query,
                                                    Qt::CaseSensitivity caseSensitivity,
                                                    TextComparisonFunction comparer,
-                                                   const TextList::ConstIterator &start,
-                                                   const TextList::ConstIterator &end );
+                                                   int start, int end );
         RegularAreaRect * findTextInternalBackward( int searchID, const QString &query,
                                                     Qt::CaseSensitivity caseSensitivity,
                                                     TextComparisonFunction comparer,
-                                                    const TextList::ConstIterator &start,
-                                                    const TextList::ConstIterator &end );
+                                                    int start, int end );
 
         /**
-         * Copy a TextList to m_words, the pointers of list are adopted
+         * Copy a TextList to m_words, the entities of list are deleted
          */
         void setWordList(const TextList &list);
 
@@ -63,9 +116,11 @@ class TextPagePrivate
         void correctTextOrder();
 
         // variables those can be accessed directly from TextPage
-        TextList m_words;
+        TextEntityStore m_words;
         QMap< int, SearchPoint* > m_searchPoints;
         PagePrivate *m_page;
+        // whether correctTextOrder() was already applied
+        bool m_textOrderCorrected;
 };
 
 }
@@ -0,0 +1,208 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "tilesmanager_p.h"
+
+#include <QtGui/QPixmap>
+
+using namespace Okular;
+
+TilesManager::TilesManager( int width, int height )
+    : m_width( 0 ), m_height( 0 ), m_columns( 0 ), m_rows( 0 ), m_totalMemory( 0 )
+{
+    setSize( width, height );
+}
+
+TilesManager::~TilesManager()
+{
+    deleteTiles();
+}
+
+void TilesManager::setSize( int width, int height )
+{
+    if ( width == m_width && height == m_height )
+        return;
+
+    deleteTiles();
+    m_width = qMax( width, 1 );
+    m_height = qMax( height, 1 );
+    buildTiles();
+}
+
+int TilesManager::width() const
+{
+    return m_width;
+}
+
+int TilesManager::height() const
+{
+    return m_height;
+}
+
+QRect TilesManager::pixelRect( const NormalizedRect &rect, int width, int height )
+{
+    const int l = qRound( rect.left * width ),
+              t = qRound( rect.top * height ),
+              r = qRound( rect.right * width ),
+              b = qRound( rect.bottom * height );
+
+    return QRect( l, t, r - l, b - t );
+}
+
+void TilesManager::setPixmap( QPixmap *pixmap, const NormalizedRect &rect )
+{
+    const QRect pixmapRect = pixelRect( rect, m_width, m_height );
+    const QRect indexes = tileIndexesAt( rect );
+
+    for ( int row = indexes.top(); row <= indexes.bottom(); ++row )
+    {
+        for ( int column = indexes.left(); column <= indexes.right(); ++column )
+        {
+            Tile &tile = m_tiles[ row * m_columns + column ];
+            // only fill the tiles fully covered by the pixmap
+            if ( !pixmapRect.contains( tile.geometry ) )
+                continue;
+
+            if ( tile.pixmap )
+            {
+                m_totalMemory -= 4 * tile.pixmap->width() * tile.pixmap->height();
+                delete tile.pixmap;
+            }
+
+            if ( tile.geometry == pixmapRect )
+            {
+                tile.pixmap = pixmap;
+                pixmap = 0;
+            }
+            else
+            {
+                tile.pixmap = new QPixmap( pixmap->copy( tile.geometry.translated( -pixmapRect.topLeft() ) ) );
+            }
+            m_totalMemory += 4 * tile.pixmap->width() * tile.pixmap->height();
+        }
+    }
+
+    delete pixmap;
+}
+
+bool TilesManager::hasPixmap( const NormalizedRect &rect ) const
+{
+    const QRect indexes = tileIndexesAt( rect );
+    for ( int row = indexes.top(); row <= indexes.bottom(); ++row )
+        for ( int column = indexes.left(); column <= indexes.right(); ++column )
+            if ( !m_tiles.at( row * m_columns + column ).pixmap )
+                return false;
+
+    return true;
+}
+
+QList< Tile > TilesManager::tilesAt( const NormalizedRect &rect ) const
+{
+    QList< Tile > tiles;
+
+    const QRect indexes = tileIndexesAt( rect );
+    for ( int row = indexes.top(); row <= indexes.bottom(); ++row )
+        for ( int column = indexes.left(); column <= indexes.right(); ++column )
+            tiles.append( m_tiles.at( row * m_columns + column ) );
+
+    return tiles;
+}
+
+QList< NormalizedRect > TilesManager::missingTiles( const NormalizedRect &rect ) const
+{
+    QList< NormalizedRect > rects;
+
+    const QRect indexes = tileIndexesAt( rect );
+    for ( int row = indexes.top(); row <= indexes.bottom(); ++row )
+    {
+        for ( int column = indexes.left(); column <= indexes.right(); ++column )
+        {
+            const Tile &tile = m_tiles.at( row * m_columns + column );
+            if ( !tile.pixmap )
+                rects.append( tile.rect );
+        }
+    }
+
+    return rects;
+}
+
+void TilesManager::discardTilesOutside( const NormalizedRect &rect )
+{
+    const QRect indexes = tileIndexesAt( rect );
+    for ( int row = 0; row < m_rows; ++row )
+    {
+        for ( int column = 0; column < m_columns; ++column )
+        {
+            if ( indexes.contains( column, row ) )
+                continue;
+
+            Tile &tile = m_tiles[ row * m_columns + column ];
+            if ( tile.pixmap )
+            {
+                m_totalMemory -= 4 * tile.pixmap->width() * tile.pixmap->height();
+                delete tile.pixmap;
+                tile.pixmap = 0;
+            }
+        }
+    }
+}
+
+qulonglong TilesManager::totalMemory() const
+{
+    return m_totalMemory;
+}
+
+void TilesManager::buildTiles()
+{
+    m_columns = ( m_width + TileSize - 1 ) / TileSize;
+    m_rows = ( m_height + TileSize - 1 ) / TileSize;
+    m_tiles.resize( m_columns * m_rows );
+
+    for ( int row = 0; row < m_rows; ++row )
+    {
+        for ( int column = 0; column < m_columns; ++column )
+        {
+            Tile &tile = m_tiles[ row * m_columns + column ];
+            tile.geometry = QRect( column * TileSize, row * TileSize,
+                                   qMin( TileSize, m_width - column * TileSize ),
+                                   qMin( TileSize, m_height - row * TileSize ) );
+            tile.rect = NormalizedRect( (double)tile.geometry.left() / m_width,
+                                        (double)tile.geometry.top() / m_height,
+                                        (double)( tile.geometry.left() + tile.geometry.width() ) / m_width,
+                                        (double)( tile.geometry.top() + tile.geometry.height() ) / m_height );
+            tile.pixmap = 0;
+        }
+    }
+}
+
+void TilesManager::deleteTiles()
+{
+    QVector< Tile >::iterator it = m_tiles.begin(), end = m_tiles.end();
+    for ( ; it != end; ++it )
+        delete (*it).pixmap;
+
+    m_tiles.clear();
+    m_totalMemory = 0;
+}
+
+QRect TilesManager::tileIndexesAt( const NormalizedRect &rect ) const
+{
+    // an empty result (left > right) is returned for rects out of the page
+    const NormalizedRect clipped = rect & NormalizedRect( 0., 0., 1., 1. );
+    if ( clipped.isNull() || clipped.right <= clipped.left || clipped.bottom <= clipped.top )
+        return QRect();
+
+    const QRect pixels = pixelRect( clipped, m_width, m_height );
+    const int firstColumn = qBound( 0, pixels.left() / TileSize, m_columns - 1 ),
+              firstRow = qBound( 0, pixels.top() / TileSize, m_rows - 1 ),
+              lastColumn = qBound( 0, ( pixels.left() + pixels.width() - 1 ) / TileSize, m_columns - 1 ),
+              lastRow = qBound( 0, ( pixels.top() + pixels.height() - 1 ) / TileSize, m_rows - 1 );
+
+    return QRect( QPoint( firstColumn, firstRow ), QPoint( lastColumn, lastRow ) );
+}
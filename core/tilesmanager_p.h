@@ -0,0 +1,132 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef _OKULAR_TILESMANAGER_P_H_
+#define _OKULAR_TILESMANAGER_P_H_
+
+#include <QtCore/QList>
+#include <QtCore/QRect>
+#include <QtCore/QVector>
+
+#include "area.h"
+
+class QPixmap;
+
+namespace Okular {
+
+/**
+ * A rectangular part of a page, together with its rendered pixmap (if any).
+ */
+class Tile
+{
+    public:
+        Tile() : pixmap( 0 ) {}
+
+        /**
+         * The rectangle of the tile in normalized page coordinates.
+         */
+        NormalizedRect rect;
+
+        /**
+         * The rectangle of the tile, in pixels of the tiled page.
+         */
+        QRect geometry;
+
+        /**
+         * The pixmap of the tile, or 0 if it has not been rendered yet.
+         * The pixmap is owned by the TilesManager.
+         */
+        QPixmap *pixmap;
+};
+
+/**
+ * @short Splits a page of a given pixel size in a grid of fixed-size tiles.
+ *
+ * Each observer showing a page at high zoom owns one TilesManager per page:
+ * only the tiles intersecting the visible area are requested to the generator,
+ * and the ones far from it can be dropped to save memory.
+ *
+ * The tiles are always expressed in terms of the upright orientation (Rotation0).
+ */
+class TilesManager
+{
+    public:
+        /**
+         * The side, in pixels, of each tile.
+         */
+        static const int TileSize = 512;
+
+        TilesManager( int width, int height );
+        ~TilesManager();
+
+        /**
+         * Changes the pixel size of the tiled page; if it is different than
+         * the current one, all the tiles are discarded.
+         */
+        void setSize( int width, int height );
+
+        int width() const;
+        int height() const;
+
+        /**
+         * Returns the rectangle in pixels of a @p width x @p height page
+         * corresponding to the normalized @p rect.
+         */
+        static QRect pixelRect( const NormalizedRect &rect, int width, int height );
+
+        /**
+         * Stores the @p pixmap covering the normalized @p rect, which has to be
+         * aligned to the tiles grid. Takes ownership of the pixmap.
+         */
+        void setPixmap( QPixmap *pixmap, const NormalizedRect &rect );
+
+        /**
+         * Returns whether all the tiles intersecting @p rect have a pixmap.
+         */
+        bool hasPixmap( const NormalizedRect &rect ) const;
+
+        /**
+         * Returns the tiles intersecting @p rect (rendered or not).
+         */
+        QList< Tile > tilesAt( const NormalizedRect &rect ) const;
+
+        /**
+         * Returns the rectangles of the tiles intersecting @p rect which have
+         * no pixmap yet.
+         */
+        QList< NormalizedRect > missingTiles( const NormalizedRect &rect ) const;
+
+        /**
+         * Deletes the pixmaps of the tiles not intersecting @p rect.
+         */
+        void discardTilesOutside( const NormalizedRect &rect );
+
+        /**
+         * Returns the memory (in bytes) used by the rendered tiles.
+         */
+        qulonglong totalMemory() const;
+
+    private:
+        void buildTiles();
+        void deleteTiles();
+        QRect tileIndexesAt( const NormalizedRect &rect ) const;
+
+        int m_width;
+        int m_height;
+        int m_columns;
+        int m_rows;
+        QVector< Tile > m_tiles;
+        qulonglong m_totalMemory;
+
+        Q_DISABLE_COPY( TilesManager )
+};
+
+}
+
+#endif
@@ -11,7 +11,12 @@
 #include "utils.h"
 #include "utils_p.h"
 
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDateTime>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
 #include <QtCore/QRect>
+#include <QtCore/QVector>
 #include <QApplication>
 #include <QDesktopWidget>
 #include <QImage>
@@ -187,58 +192,172 @@ double Utils::realDpiY()
 }
 #endif
 
-inline static bool isWhite( QRgb argb ) {
-    return ( argb & 0xFFFFFF ) == 0xFFFFFF; // ignore alpha
-}
+namespace {
 
-NormalizedRect Utils::imageBoundingBox( const QImage * image )
+// whiteness of 32 bit pixels, ignoring the alpha
+struct Rgb32WhiteTest
 {
-    if ( !image )
-        return NormalizedRect();
+    inline bool operator()( QRgb argb ) const
+    {
+        return ( argb & 0xFFFFFF ) == 0xFFFFFF;
+    }
 
-    int width = image->width();
-    int height = image->height();
-    int left, top, bottom, right, x, y;
+    // the and of white pixels is white, and any other pixel clears some bit;
+    // this is a plain loop the compiler can vectorize
+    inline bool allWhite( const QRgb * pixels, int count ) const
+    {
+        QRgb all = 0xFFFFFFFF;
+        for ( int i = 0; i < count; ++i )
+            all &= pixels[i];
+        return ( all & 0xFFFFFF ) == 0xFFFFFF;
+    }
+};
 
-#ifdef BBOX_DEBUG
-    QTime time;
-    time.start();
-#endif
+// whiteness of 8 bit indexes, looked up in the color table of the image
+struct Indexed8WhiteTest
+{
+    explicit Indexed8WhiteTest( const QVector< QRgb > &colorTable )
+    {
+        for ( int i = 0; i < 256; ++i )
+            white[i] = i < colorTable.count() && ( colorTable.at( i ) & 0xFFFFFF ) == 0xFFFFFF;
+    }
+
+    inline bool operator()( uchar index ) const
+    {
+        return white[index];
+    }
+
+    inline bool allWhite( const uchar * pixels, int count ) const
+    {
+        bool all = true;
+        for ( int i = 0; i < count; ++i )
+            all &= white[pixels[i]];
+        return all;
+    }
+
+    bool white[256];
+};
+
+// the pixels are tested in chunks, looking for the non-white one only in
+// the chunk that has it
+static const int WhiteTestChunk = 64;
+
+// the first non-white pixel in [from, to) of a row, or -1
+template < typename Pixel, typename WhiteTest >
+inline int firstNonWhite( const Pixel * row, int from, int to, const WhiteTest &isWhite )
+{
+    for ( int x = from; x < to; x += WhiteTestChunk )
+    {
+        const int count = qMin( WhiteTestChunk, to - x );
+        if ( isWhite.allWhite( row + x, count ) )
+            continue;
+        for ( ; ; ++x )
+            if ( !isWhite( row[x] ) )
+                return x;
+    }
+    return -1;
+}
+
+// the last non-white pixel in [from, to) of a row, or -1
+template < typename Pixel, typename WhiteTest >
+inline int lastNonWhite( const Pixel * row, int from, int to, const WhiteTest &isWhite )
+{
+    for ( int end = to; end > from; end -= WhiteTestChunk )
+    {
+        const int count = qMin( WhiteTestChunk, end - from );
+        if ( isWhite.allWhite( row + end - count, count ) )
+            continue;
+        for ( int x = end - 1; ; --x )
+            if ( !isWhite( row[x] ) )
+                return x;
+    }
+    return -1;
+}
+
+template < typename Pixel, typename WhiteTest >
+NormalizedRect boundingBox( const QImage * image, const WhiteTest &isWhite )
+{
+    const int width = image->width();
+    const int height = image->height();
+    int left = -1, top, bottom, right, x = -1, y;
 
-    // Scan pixels for top non-white
+    // Scan rows for top non-white
     for ( top = 0; top < height; ++top )
-        for ( x = 0; x < width; ++x )
-            if ( !isWhite( image->pixel( x, top ) ) )
-                goto got_top;
-    return NormalizedRect( 0, 0, 0, 0 ); // the image is blank
-got_top:
-    left = right = x;
-
-    // Scan pixels for bottom non-white
-    for ( bottom = height-1; bottom >= top; --bottom )
-        for ( x = width-1; x >= 0; --x )
-            if ( !isWhite( image->pixel( x, bottom ) ) )
-                goto got_bottom;
-    Q_ASSERT( 0 ); // image changed?!
-got_bottom:
+    {
+        left = firstNonWhite( reinterpret_cast< const Pixel * >( image->scanLine( top ) ), 0, width, isWhite );
+        if ( left >= 0 )
+            break;
+    }
+    if ( top == height )
+        return NormalizedRect( 0, 0, 0, 0 ); // the image is blank
+    right = left;
+
+    // Scan rows for bottom non-white
+    for ( bottom = height - 1; bottom >= top; --bottom )
+    {
+        x = lastNonWhite( reinterpret_cast< const Pixel * >( image->scanLine( bottom ) ), 0, width, isWhite );
+        if ( x >= 0 )
+            break;
+    }
     if ( x < left )
         left = x;
     if ( x > right )
         right = x;
 
     // Scan for leftmost and rightmost (we already found some bounds on these):
-    for ( y = top; y <= bottom && ( left > 0 || right < width-1 ); ++y )
+    for ( y = top; y <= bottom && ( left > 0 || right < width - 1 ); ++y )
     {
-        for ( x = 0; x < left; ++x )
-            if ( !isWhite( image->pixel( x, y ) ) )
-                left = x;
-        for ( x = width-1; x > right+1; --x )
-            if ( !isWhite( image->pixel( x, y ) ) )
-                right = x;
+        const Pixel * row = reinterpret_cast< const Pixel * >( image->scanLine( y ) );
+        x = firstNonWhite( row, 0, left, isWhite );
+        if ( x >= 0 )
+            left = x;
+        x = lastNonWhite( row, right + 1, width, isWhite );
+        if ( x >= 0 )
+            right = x;
     }
 
-    NormalizedRect bbox( QRect( left, top, ( right - left + 1), ( bottom - top + 1 ) ),
-                         image->width(), image->height() );
+    return NormalizedRect( QRect( left, top, ( right - left + 1 ), ( bottom - top + 1 ) ),
+                           width, height );
+}
+
+}
+
+NormalizedRect Utils::imageBoundingBox( const QImage * image )
+{
+    if ( !image )
+        return NormalizedRect();
+
+#ifdef BBOX_DEBUG
+    QTime time;
+    time.start();
+#endif
+
+    // the scanlines are read directly, so only a few formats are handled;
+    // the others are converted to the closest of them
+    NormalizedRect bbox;
+    switch ( image->format() )
+    {
+        case QImage::Format_RGB32:
+        case QImage::Format_ARGB32:
+        case QImage::Format_ARGB32_Premultiplied:
+            bbox = boundingBox< QRgb >( image, Rgb32WhiteTest() );
+            break;
+        case QImage::Format_Indexed8:
+            bbox = boundingBox< uchar >( image, Indexed8WhiteTest( image->colorTable() ) );
+            break;
+        case QImage::Format_Mono:
+        case QImage::Format_MonoLSB:
+        {
+            const QImage indexed = image->convertToFormat( QImage::Format_Indexed8 );
+            bbox = boundingBox< uchar >( &indexed, Indexed8WhiteTest( indexed.colorTable() ) );
+            break;
+        }
+        default:
+        {
+            const QImage rgb = image->convertToFormat( QImage::Format_ARGB32 );
+            bbox = boundingBox< QRgb >( &rgb, Rgb32WhiteTest() );
+        }
+    }
 
 #ifdef BBOX_DEBUG
     kDebug() << "Computed bounding box" << bbox << "in" << time.elapsed() << "ms";
@@ -259,3 +378,18 @@ void Okular::copyQIODevice( QIODevice *from, QIODevice *to )
             break;
     }
 }
+
+QByteArray Okular::documentFileHash( const QString &fileName )
+{
+    QFile file( fileName );
+    if ( !file.open( QIODevice::ReadOnly ) )
+        return QByteArray();
+
+    // this is enough to notice a changed document without reading it all
+    const QFileInfo info( fileName );
+    QCryptographicHash hash( QCryptographicHash::Md5 );
+    hash.addData( QByteArray::number( info.size() ) );
+    hash.addData( QByteArray::number( info.lastModified().toTime_t() ) );
+    hash.addData( file.read( 65536 ) );
+    return hash.result().toHex();
+}
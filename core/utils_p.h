@@ -10,13 +10,22 @@
 #ifndef _OKULAR_UTILS_P_H_
 #define _OKULAR_UTILS_P_H_
 
+class QByteArray;
 class QIODevice;
+class QString;
 
 namespace Okular
 {
 
 void copyQIODevice( QIODevice *from, QIODevice *to );
 
+/**
+ * Returns a hash identifying the contents of the file @p fileName, made out of
+ * its size, modification time and first bytes; an empty hash is returned if
+ * the file cannot be read.
+ */
+QByteArray documentFileHash( const QString &fileName );
+
 }
 
 #endif
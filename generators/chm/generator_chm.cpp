@@ -11,7 +11,8 @@
 #include "generator_chm.h"
 
 #include <QtCore/QEventLoop>
-#include <QtCore/QMutex>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QTimer>
 #include <QtGui/QPainter>
 #include <QtXml/QDomElement>
 
@@ -65,21 +66,70 @@ static QString absolutePath( const QString &baseUrl, const QString &path )
     return absPath;
 }
 
+// how many topics can be loaded at the same time
+static const int MaxRenderers = 3;
+
+/**
+ * An off-screen HTML renderer, together with the topic it has loaded.
+ *
+ * The topic is kept loaded after rendering it, so that rendering it again
+ * (e.g. as a thumbnail) or extracting its text only lays it out again.
+ */
+class CHMRenderer
+{
+    public:
+        CHMRenderer()
+            : part( new KHTMLPart() ), request( 0 ), loading( false ), lastUse( 0 )
+        {
+        }
+
+        ~CHMRenderer()
+        {
+            delete part;
+        }
+
+        bool isBusy() const
+        {
+            return request || loading;
+        }
+
+        KHTMLPart *part;
+        QString url;
+        Okular::PixmapRequest *request;
+        bool loading;
+        uint lastUse;
+};
+
+static void openUrlSync( KHTMLPart *part, const KUrl &url )
+{
+    part->openUrl(url);
+    part->view()->layout();
+
+    QEventLoop loop;
+    QObject::connect( part, SIGNAL(completed()), &loop, SLOT(quit()) );
+    QObject::connect( part, SIGNAL(canceled(QString)), &loop, SLOT(quit()) );
+    // discard any user input, otherwise it breaks the "synchronicity" of this
+    // function
+    loop.exec( QEventLoop::ExcludeUserInputEvents );
+}
+
 CHMGenerator::CHMGenerator( QObject *parent, const QVariantList &args )
     : Okular::Generator( parent, args )
 {
     setFeature( TextExtraction );
 
-    m_syncGen=0;
+    m_rendererClock=0;
+    m_measureGen=0;
+    m_measuredPage=-1;
+    m_nextPageToMeasure=0;
     m_file=0;
     m_docInfo=0;
-    m_pixmapRequestZoom=1;
-    m_request = 0;
 }
 
 CHMGenerator::~CHMGenerator()
 {
-    delete m_syncGen;
+    qDeleteAll( m_renderers );
+    delete m_measureGen;
 }
 
 bool CHMGenerator::loadDocument( const QString & fileName, QVector< Okular::Page * > & pagesVector )
@@ -141,27 +191,49 @@ bool CHMGenerator::loadDocument( const QString & fileName, QVector< Okular::Page
     pagesVector.resize(m_pageUrl.count());
     m_textpageAddedList.fill(false, pagesVector.count());
 
-    if (!m_syncGen)
+    if (!m_measureGen)
     {
-        m_syncGen = new KHTMLPart();
+        m_measureGen = new KHTMLPart();
     }
-    disconnect( m_syncGen, 0, this, 0 );
+    disconnect( m_measureGen, 0, this, 0 );
 
-    for (int i = 0; i < m_pageUrl.count(); ++i)
+    // laying out every page takes long: only the first one is measured now,
+    // and its size is the estimate for the others, which are measured later
+    // in the background (or before, when asked for)
+    if (!m_pageUrl.isEmpty())
     {
-        preparePageForSyncOperation(100, m_pageUrl.at(i));
-        pagesVector[ i ] = new Okular::Page (i, m_syncGen->view()->contentsWidth(),
-            m_syncGen->view()->contentsHeight(), Okular::Rotation0 );
+        openUrlSync(m_measureGen, KUrl(QString("ms-its:" + m_fileName + "::" + m_pageUrl.first())));
+        const int width = m_measureGen->view()->contentsWidth();
+        const int height = m_measureGen->view()->contentsHeight();
+        m_measureGen->closeUrl();
+
+        for (int i = 0; i < m_pageUrl.count(); ++i)
+        {
+            pagesVector[ i ] = new Okular::Page (i, width, height, Okular::Rotation0 );
+            if (i > 0)
+                pagesVector[ i ]->setSizeKnown( false );
+        }
     }
 
-    connect( m_syncGen, SIGNAL(completed()), this, SLOT(slotCompleted()) );
-    connect( m_syncGen, SIGNAL(canceled(QString)), this, SLOT(slotCompleted()) );
+    connect( m_measureGen, SIGNAL(completed()), this, SLOT(slotMeasureCompleted()) );
+    connect( m_measureGen, SIGNAL(canceled(QString)), this, SLOT(slotMeasureCompleted()) );
+
+    // start after the document has restored the sizes measured in the past
+    m_nextPageToMeasure = 1;
+    QTimer::singleShot( 0, this, SLOT(measureNextPage()) );
 
     return true;
 }
 
 bool CHMGenerator::doCloseDocument()
 {
+    foreach (CHMRenderer *renderer, m_renderers)
+    {
+        // requests being loaded are completed (blank) by this, while the
+        // document data is still there
+        renderer->part->closeUrl();
+        renderer->url.clear();
+    }
     // delete the document information of the old document
     delete m_docInfo;
     m_docInfo=0;
@@ -171,61 +243,125 @@ bool CHMGenerator::doCloseDocument()
     m_urlPage.clear();
     m_pageUrl.clear();
     m_docSyn.clear();
-    if (m_syncGen)
+    m_measuredPage = -1;
+    m_nextPageToMeasure = 0;
+    m_pagesToMeasure.clear();
+    if (m_measureGen)
     {
-        m_syncGen->closeUrl();
+        m_measureGen->closeUrl();
     }
 
     return true;
 }
 
-void CHMGenerator::preparePageForSyncOperation( int zoom , const QString & url)
+CHMRenderer *CHMGenerator::takeRenderer( const QString &url )
 {
-    KUrl pAddress= QString("ms-its:" + m_fileName + "::" + url);
-    m_chmUrl = url;
-    m_syncGen->setZoomFactor(zoom);
-    m_syncGen->openUrl(pAddress);
-    m_syncGen->view()->layout();
+    // prefer one with the topic loaded already, then a new one, then
+    // the one used longest ago
+    CHMRenderer *renderer = 0;
+    foreach (CHMRenderer *r, m_renderers)
+    {
+        if (r->isBusy())
+            continue;
+        if (r->url == url)
+        {
+            renderer = r;
+            break;
+        }
+        if (!renderer || r->lastUse < renderer->lastUse)
+            renderer = r;
+    }
 
-    QEventLoop loop;
-    connect( m_syncGen, SIGNAL(completed()), &loop, SLOT(quit()) );
-    connect( m_syncGen, SIGNAL(canceled(QString)), &loop, SLOT(quit()) );
-    // discard any user input, otherwise it breaks the "synchronicity" of this
-    // function
-    loop.exec( QEventLoop::ExcludeUserInputEvents );
+    if ((!renderer || renderer->url != url) && m_renderers.count() < MaxRenderers)
+    {
+        renderer = new CHMRenderer();
+        connect( renderer->part, SIGNAL(completed()), this, SLOT(slotCompleted()) );
+        connect( renderer->part, SIGNAL(canceled(QString)), this, SLOT(slotCompleted()) );
+        m_renderers.append(renderer);
+    }
+
+    if (renderer)
+        renderer->lastUse = ++m_rendererClock;
+    return renderer;
 }
 
-void CHMGenerator::slotCompleted()
+void CHMGenerator::measureNextPage()
+{
+    if ( !m_file || m_measuredPage != -1 )
+        return;
+
+    // first the pages asked for, then all the others in order
+    const Okular::Document *doc = document();
+    int page = -1;
+    while ( page == -1 && !m_pagesToMeasure.isEmpty() )
+    {
+        const int p = m_pagesToMeasure.takeFirst();
+        if ( !doc->page( p )->isSizeKnown() )
+            page = p;
+    }
+    for ( ; page == -1 && m_nextPageToMeasure < m_pageUrl.count(); ++m_nextPageToMeasure )
+    {
+        if ( !doc->page( m_nextPageToMeasure )->isSizeKnown() )
+            page = m_nextPageToMeasure;
+    }
+    if ( page == -1 )
+        return;
+
+    m_measuredPage = page;
+    m_measureGen->openUrl( KUrl( QString( "ms-its:" + m_fileName + "::" + m_pageUrl.at( page ) ) ) );
+}
+
+void CHMGenerator::slotMeasureCompleted()
 {
-    if ( !m_request )
+    if ( m_measuredPage == -1 )
         return;
 
-    QImage image( m_request->width(), m_request->height(), QImage::Format_ARGB32 );
+    const int page = m_measuredPage;
+    m_measuredPage = -1;
+
+    m_measureGen->view()->layout();
+    updatePageSize( page, m_measureGen->view()->contentsWidth(), m_measureGen->view()->contentsHeight() );
+    m_measureGen->closeUrl();
+
+    // one page at a time, not to block the user interface
+    QTimer::singleShot( 0, this, SLOT(measureNextPage()) );
+}
+
+void CHMGenerator::slotCompleted()
+{
+    KHTMLPart *part = qobject_cast< KHTMLPart * >( sender() );
+    foreach ( CHMRenderer *renderer, m_renderers )
+    {
+        // the loads for the text extraction are waited for there
+        if ( renderer->part == part && renderer->request )
+        {
+            paintRequest( renderer );
+            return;
+        }
+    }
+}
+
+void CHMGenerator::paintRequest( CHMRenderer *renderer )
+{
+    Okular::PixmapRequest *req = renderer->request;
+
+    QImage image( req->width(), req->height(), QImage::Format_ARGB32 );
     image.fill( qRgb( 255, 255, 255 ) );
 
     QPainter p( &image );
-    QRect r( 0, 0, m_request->width(), m_request->height() );
+    QRect r( 0, 0, req->width(), req->height() );
 
     bool moreToPaint;
-    m_syncGen->paint( &p, r, 0, &moreToPaint );
+    renderer->part->paint( &p, r, 0, &moreToPaint );
 
     p.end();
 
-    if ( m_pixmapRequestZoom > 1 )
-        m_pixmapRequestZoom = 1;
-
-    if ( !m_textpageAddedList.at( m_request->pageNumber() ) ) {
-        additionalRequestData();
-        m_textpageAddedList[ m_request->pageNumber() ] = true;
+    if ( !m_textpageAddedList.at( req->pageNumber() ) ) {
+        additionalRequestData( renderer );
+        m_textpageAddedList[ req->pageNumber() ] = true;
     }
 
-    m_syncGen->closeUrl();
-    m_chmUrl = QString();
-
-    userMutex()->unlock();
-
-    Okular::PixmapRequest *req = m_request;
-    m_request = 0;
+    renderer->request = 0;
 
     if ( !req->page()->isBoundingBoxKnown() )
         updatePageBoundingBox( req->page()->number(), Okular::Utils::imageBoundingBox( &image ) );
@@ -252,13 +388,14 @@ const Okular::DocumentSynopsis * CHMGenerator::generateDocumentSynopsis()
 
 bool CHMGenerator::canGeneratePixmap () const
 {
-    bool isLocked = true;
-    if ( userMutex()->tryLock() ) {
-        userMutex()->unlock();
-        isLocked = false;
-    }
+    if ( m_renderers.count() < MaxRenderers )
+        return true;
 
-    return !isLocked;
+    foreach ( CHMRenderer *renderer, m_renderers )
+        if ( !renderer->isBusy() )
+            return true;
+
+    return false;
 }
 
 void CHMGenerator::generatePixmap( Okular::PixmapRequest * request ) 
@@ -267,35 +404,48 @@ void CHMGenerator::generatePixmap( Okular::PixmapRequest * request )
     int requestHeight = request->height();
     if (requestWidth<300)
     {
-        m_pixmapRequestZoom=900/requestWidth;
-        requestWidth*=m_pixmapRequestZoom;
-        requestHeight*=m_pixmapRequestZoom;
+        const int pixmapRequestZoom=900/requestWidth;
+        requestWidth*=pixmapRequestZoom;
+        requestHeight*=pixmapRequestZoom;
+    }
+
+    // the page will be laid out again when measured, but the sooner the better
+    if ( !request->page()->isSizeKnown() && !m_pagesToMeasure.contains( request->pageNumber() ) )
+    {
+        m_pagesToMeasure.prepend( request->pageNumber() );
+        measureNextPage();
     }
 
-    userMutex()->lock();
     QString url= m_pageUrl[request->pageNumber()];
     int zoom = qRound( qMax( static_cast<double>(requestWidth)/static_cast<double>(request->page()->width())
         , static_cast<double>(requestHeight)/static_cast<double>(request->page()->height())
         ) ) * 100;
 
+    CHMRenderer *renderer = takeRenderer( url );
+    renderer->request = request;
+    renderer->part->setZoomFactor(zoom);
+    renderer->part->view()->resize(requestWidth,requestHeight);
+    if ( renderer->url == url )
+    {
+        // already loaded: only lay it out again
+        renderer->part->view()->layout();
+        paintRequest( renderer );
+        return;
+    }
+
     KUrl pAddress= QString("ms-its:" + m_fileName + "::" + url);
-    m_chmUrl = url;
-    m_syncGen->setZoomFactor(zoom);
-    m_syncGen->view()->resize(requestWidth,requestHeight);
-    m_request=request;
+    renderer->url = url;
     // will emit openURL without problems
-    m_syncGen->openUrl ( pAddress );
+    renderer->part->openUrl ( pAddress );
 }
 
 
-void CHMGenerator::recursiveExploreNodes(DOM::Node node,Okular::TextPage *tp)
+void CHMGenerator::recursiveExploreNodes(DOM::Node node,Okular::TextPage *tp, int vWidth, int vHeight)
 {
     if (node.nodeType() == DOM::Node::TEXT_NODE && !node.getRect().isNull())
     {
         QString nodeText=node.nodeValue().string();
         QRect r=node.getRect();
-        int vWidth=m_syncGen->view()->width();
-        int vHeight=m_syncGen->view()->height();
         Okular::NormalizedRect *nodeNormRect;
 #define NOEXP
 #ifndef NOEXP
@@ -339,26 +489,27 @@ void CHMGenerator::recursiveExploreNodes(DOM::Node node,Okular::TextPage *tp)
     DOM::Node child = node.firstChild();
     while ( !child.isNull() )
     {
-        recursiveExploreNodes(child,tp);
+        recursiveExploreNodes(child,tp,vWidth,vHeight);
         child = child.nextSibling();
     }
 }
 
-void CHMGenerator::additionalRequestData() 
+void CHMGenerator::additionalRequestData( CHMRenderer *renderer ) 
 {
-    Okular::Page * page=m_request->page();
-    bool genObjectRects = m_request->id() & (PAGEVIEW_ID | PRESENTATION_ID);
-    bool genTextPage = !m_request->page()->hasTextPage() && genObjectRects;
+    Okular::PixmapRequest *request=renderer->request;
+    Okular::Page * page=request->page();
+    bool genObjectRects = request->id() & (PAGEVIEW_ID | PRESENTATION_ID);
+    bool genTextPage = !request->page()->hasTextPage() && genObjectRects;
 
     if (genObjectRects || genTextPage )
     {
-        DOM::HTMLDocument domDoc=m_syncGen->htmlDocument();
+        DOM::HTMLDocument domDoc=renderer->part->htmlDocument();
         // only generate object info when generating a full page not a thumbnail
         if ( genObjectRects )
         {
             QLinkedList< Okular::ObjectRect * > objRects;
-            int xScale=m_syncGen->view()->width();
-            int yScale=m_syncGen->view()->height();
+            int xScale=renderer->part->view()->width();
+            int yScale=renderer->part->view()->height();
             // getting links
             DOM::HTMLCollection coll=domDoc.links();
             DOM::Node n;
@@ -386,7 +537,7 @@ void CHMGenerator::additionalRequestData()
                         }
                         else
                         {
-                            Okular::DocumentViewport viewport( metaData( "NamedViewport", absolutePath( m_chmUrl, url ) ).toString() );
+                            Okular::DocumentViewport viewport( metaData( "NamedViewport", absolutePath( renderer->url, url ) ).toString() );
                             objRects.push_back(
                                 new Okular::ObjectRect ( Okular::NormalizedRect(r,xScale,yScale),
                                 false,
@@ -415,13 +566,13 @@ void CHMGenerator::additionalRequestData()
                     }
                 }
             }
-            m_request->page()->setObjectRects( objRects );
+            request->page()->setObjectRects( objRects );
         }
 
         if ( genTextPage )
         {
             Okular::TextPage *tp=new Okular::TextPage();
-            recursiveExploreNodes(domDoc,tp);
+            recursiveExploreNodes(domDoc,tp,renderer->part->view()->width(),renderer->part->view()->height());
             page->setTextPage (tp);
         }
     }
@@ -430,15 +581,36 @@ void CHMGenerator::additionalRequestData()
 Okular::TextPage* CHMGenerator::textPage( Okular::Page * page )
 {
     bool ok = true;
-    userMutex()->lock();
     double zoomP = documentMetaData( "ZoomFactor" ).toInt( &ok );
     int zoom = ok ? qRound( zoomP * 100 ) : 100;
-    m_syncGen->view()->resize(qRound( page->width() * zoomP ) , qRound( page->height() * zoomP ));
-    
-    preparePageForSyncOperation(zoom, m_pageUrl[page->number()]);
+    const QString url = m_pageUrl[page->number()];
+
+    // when all the renderers are busy with pixmaps, use a temporary one
+    CHMRenderer *renderer = takeRenderer( url );
+    QScopedPointer< CHMRenderer > temporaryRenderer;
+    if ( !renderer )
+    {
+        temporaryRenderer.reset( new CHMRenderer() );
+        renderer = temporaryRenderer.data();
+    }
+
+    renderer->part->setZoomFactor(zoom);
+    renderer->part->view()->resize(qRound( page->width() * zoomP ) , qRound( page->height() * zoomP ));
+    if ( renderer->url == url )
+    {
+        renderer->part->view()->layout();
+    }
+    else
+    {
+        // other requests can be started while waiting: keep this renderer
+        renderer->loading = true;
+        renderer->url = url;
+        openUrlSync( renderer->part, KUrl( QString("ms-its:" + m_fileName + "::" + url) ) );
+        renderer->loading = false;
+    }
+
     Okular::TextPage *tp=new Okular::TextPage();
-    recursiveExploreNodes( m_syncGen->htmlDocument(), tp);
-    userMutex()->unlock();
+    recursiveExploreNodes( renderer->part->htmlDocument(), tp, renderer->part->view()->width(), renderer->part->view()->height() );
     return tp;
 }
 
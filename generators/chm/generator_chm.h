@@ -19,6 +19,7 @@
 #include <qbitarray.h>
 
 class KHTMLPart;
+class CHMRenderer;
 
 namespace Okular {
 class TextPage;
@@ -47,23 +48,32 @@ class CHMGenerator : public Okular::Generator
     public slots:
         void slotCompleted();
 
+    private slots:
+        void measureNextPage();
+        void slotMeasureCompleted();
+
     protected:
         bool doCloseDocument();
         Okular::TextPage* textPage( Okular::Page *page );
 
     private:
-        void additionalRequestData();
-        void recursiveExploreNodes( DOM::Node node, Okular::TextPage *tp );
-        void preparePageForSyncOperation( int zoom , const QString &url );
+        CHMRenderer *takeRenderer( const QString &url );
+        void paintRequest( CHMRenderer *renderer );
+        void additionalRequestData( CHMRenderer *renderer );
+        void recursiveExploreNodes( DOM::Node node, Okular::TextPage *tp, int vWidth, int vHeight );
         QMap<QString, int> m_urlPage;
         QVector<QString> m_pageUrl;
         Okular::DocumentSynopsis m_docSyn;
         LCHMFile* m_file;
-        KHTMLPart *m_syncGen;
+        // the off-screen HTML renderers, which keep the last topic they loaded
+        QList<CHMRenderer*> m_renderers;
+        uint m_rendererClock;
+        // lays out the pages to measure them, one at a time
+        KHTMLPart *m_measureGen;
+        int m_measuredPage;
+        int m_nextPageToMeasure;
+        QList<int> m_pagesToMeasure;
         QString m_fileName;
-        QString m_chmUrl;
-        Okular::PixmapRequest* m_request;
-        int m_pixmapRequestZoom;
         Okular::DocumentInfo* m_docInfo;
         QBitArray m_textpageAddedList;
 };
@@ -9,12 +9,23 @@
 
 #include "document.h"
 
+#include <QtCore/QAtomicInt>
+#include <QtCore/QBuffer>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
 #include <QtCore/QScopedPointer>
+#include <QtCore/QThread>
 #include <QtGui/QImage>
 #include <QtGui/QImageReader>
 
+#include <kde_file.h>
 #include <klocale.h>
 #include <kmimetype.h>
+#include <kstandarddirs.h>
 #include <kzip.h>
 #include <ktar.h>
 
@@ -24,10 +35,24 @@
 
 #include "unrar.h"
 #include "directory.h"
+#include "imagesize.h"
 #include "qnatsort.h"
 
 using namespace ComicBook;
 
+// how much of each file is read to find the size of its image
+static const int HeaderSize = 64 * 1024;
+
+// the most threads reading the sizes of the images
+static const int MaxScanThreads = 8;
+
+// the version of the format of the files caching the sizes of the images
+static const quint32 SizeCacheVersion = 2;
+
+// the most files caching the sizes of the images, the ones used least
+// recently are removed beyond it
+static const int MaxSizeCacheFiles = 200;
+
 static void imagesInArchive( const QString &prefix, const KArchiveDirectory* dir, QStringList *entries )
 {
     Q_FOREACH ( const QString &entry, dir->entries() ) {
@@ -40,9 +65,114 @@ static void imagesInArchive( const QString &prefix, const KArchiveDirectory* dir
     }
 }
 
+/**
+ * The state shared by the threads reading the sizes of the images.
+ */
+struct EntryScan
+{
+    QStringList entries;
+    QSize *sizes;
+    QAtomicInt next;
+    QList< QByteArray > formats;
+    const Directory *directory;
+    const Unrar *unrar;
+};
+
+static QIODevice* entryDevice( const EntryScan *scan, const KArchiveDirectory *archiveDir, const QString &file, int maxSize )
+{
+    if ( archiveDir ) {
+        const KArchiveEntry *entry = archiveDir->entry( file );
+        return entry && entry->isFile() ? static_cast<const KArchiveFile*>( entry )->createDevice() : 0;
+    } else if ( scan->directory ) {
+        return scan->directory->createDevice( file );
+    }
+
+    // extracting a file is slow: extract just what is needed
+    return scan->unrar->createDevice( file, maxSize );
+}
+
+/**
+ * Returns the size of the image in @p file, or an invalid size if it is not
+ * an image that can be shown.
+ */
+static QSize entrySize( const EntryScan *scan, const KArchiveDirectory *archiveDir, const QString &file )
+{
+    QScopedPointer< QIODevice > dev( entryDevice( scan, archiveDir, file, HeaderSize ) );
+    if ( dev.isNull() )
+        return QSize();
+
+    // the common formats have the size in the header: no need to decode them
+    QByteArray header = dev->read( HeaderSize );
+    QByteArray format;
+    const QSize size = imageSizeFromHeader( header, &format );
+    if ( !format.isEmpty() && !scan->formats.contains( format ) )
+        return QSize();
+    if ( size.isValid() )
+        return size;
+
+    // other formats, or a size not in the first bytes: let Qt find it
+    QBuffer buffer( &header );
+    buffer.open( QIODevice::ReadOnly );
+    QImageReader reader( &buffer );
+    if ( !reader.canRead() )
+        return QSize();
+
+    const QSize headerSize = reader.size();
+    if ( headerSize.isValid() )
+        return headerSize;
+
+    dev.reset( entryDevice( scan, archiveDir, file, -1 ) );
+    if ( dev.isNull() )
+        return QSize();
+
+    reader.setDevice( dev.data() );
+    const QSize fullSize = reader.size();
+    return fullSize.isValid() ? fullSize : reader.read().size();
+}
+
+static void scanEntries( EntryScan *scan, const KArchiveDirectory *archiveDir )
+{
+    const int count = scan->entries.count();
+    int index;
+    while ( ( index = scan->next.fetchAndAddOrdered( 1 ) ) < count )
+        scan->sizes[ index ] = entrySize( scan, archiveDir, scan->entries.at( index ) );
+}
+
+/**
+ * A thread reading the sizes of the images, together with the other ones.
+ *
+ * The files of a KArchive are read from the file of the archive, which
+ * cannot be shared among threads: each thread opens its own copy of the
+ * zip file, if any.
+ */
+class EntryScanThread : public QThread
+{
+    public:
+        EntryScanThread( EntryScan *scan, const QString &zipFileName )
+            : mScan( scan ), mZipFileName( zipFileName )
+        {
+        }
+
+    protected:
+        void run()
+        {
+            if ( mZipFileName.isEmpty() ) {
+                scanEntries( mScan, 0 );
+                return;
+            }
+
+            KZip zip( mZipFileName );
+            if ( zip.open( QIODevice::ReadOnly ) && zip.directory() )
+                scanEntries( mScan, zip.directory() );
+        }
+
+    private:
+        EntryScan *mScan;
+        QString mZipFileName;
+};
 
 Document::Document()
-    : mDirectory( 0 ), mUnrar( 0 ), mArchive( 0 )
+    : mSizesModified( false ), mDirectory( 0 ), mUnrar( 0 ), mArchive( 0 )
 {
 }
 
@@ -54,6 +184,7 @@ bool Document::open( const QString &fileName )
 {
     close();
 
+    mFileName = QFileInfo( fileName ).absoluteFilePath();
     const KMimeType::Ptr mime = KMimeType::findByFileContent( fileName );
 
     /**
@@ -125,6 +256,9 @@ void Document::close()
     if ( !( mArchive || mUnrar || mDirectory ) )
         return;
 
+    if ( mSizesModified )
+        saveSizeCache( mSizes );
+
     delete mArchive;
     mArchive = 0;
     delete mDirectory;
@@ -132,7 +266,12 @@ void Document::close()
     delete mUnrar;
     mUnrar = 0;
     mPageMap.clear();
+    mPageEntries.clear();
+    mSizes.clear();
+    mSizesModified = false;
+    mSizeCacheKey.clear();
     mEntries.clear();
+    mFileName.clear();
 }
 
 bool Document::processArchive() {
@@ -161,39 +300,197 @@ bool Document::processArchive() {
 void Document::pages( QVector<Okular::Page*> * pagesVector )
 {
     qSort( mEntries.begin(), mEntries.end(), caseSensitiveNaturalOrderLessThen );
-    QScopedPointer< QIODevice > dev;
+    mSizeCacheKey = sizeCacheKey();
+    mSizes = mUnrar ? rarEntrySizes() : entrySizes();
 
+    // the pages of unknown size (see rarEntrySizes()) are assumed as big as
+    // the previous one
     int count = 0;
+    QSize estimatedSize;
     pagesVector->clear();
     pagesVector->resize( mEntries.size() );
-    QImageReader reader;
-    foreach(const QString &file, mEntries) {
-        if ( mArchive ) {
-            const KArchiveFile *entry = static_cast<const KArchiveFile*>( mArchiveDir->entry( file ) );
-            if ( entry ) {
-                dev.reset( entry->createDevice() );
-            }
-        } else if ( mDirectory ) {
-            dev.reset( mDirectory->createDevice( file ) );
-        } else {
-            dev.reset( mUnrar->createDevice( file ) );
-        }
+    for ( int i = 0; i < mEntries.count(); ++i ) {
+        const QSize &entrySize = mSizes.at( i );
+        if ( entrySize.isValid() )
+            estimatedSize = entrySize;
+        else if ( !mUnrar || !estimatedSize.isValid() )
+            continue;
+
+        Okular::Page *page = new Okular::Page( count, estimatedSize.width(), estimatedSize.height(), Okular::Rotation0 );
+        page->setSizeKnown( entrySize.isValid() );
+        pagesVector->replace( count, page );
+        mPageMap.append( mEntries.at( i ) );
+        mPageEntries.append( i );
+        count++;
+    }
+    pagesVector->resize( count );
+}
 
-        if ( ! dev.isNull() ) {
-            reader.setDevice( dev.data() );
-            if ( reader.canRead() )
-            {
-                QSize pageSize = reader.size();
-                if ( !pageSize.isValid() ) {
-                    pageSize = reader.read().size();
-                }
-                pagesVector->replace( count, new Okular::Page( count, pageSize.width(), pageSize.height(), Okular::Rotation0 ) );
-                mPageMap.append(file);
-                count++;
-            }
+void Document::setPageSize( int page, const QSize &size )
+{
+    if ( page < 0 || page >= mPageEntries.count() || !size.isValid() )
+        return;
+
+    QSize &entrySize = mSizes[ mPageEntries.at( page ) ];
+    if ( entrySize != size ) {
+        entrySize = size;
+        mSizesModified = true;
+    }
+}
+
+QVector< QSize > Document::entrySizes() const
+{
+    QVector< QSize > sizes;
+    if ( loadSizeCache( &sizes ) )
+        return sizes;
+
+    sizes.fill( QSize(), mEntries.count() );
+
+    EntryScan scan;
+    scan.entries = mEntries;
+    scan.sizes = sizes.data();
+    scan.formats = QImageReader::supportedImageFormats();
+    scan.directory = mDirectory;
+    scan.unrar = mUnrar;
+
+    // copies of tar archives are not cheap (compressed ones are uncompressed
+    // when opened), so they are read by this thread only
+    const bool isZip = dynamic_cast< KZip* >( mArchive );
+    int threads = 0;
+    if ( !mArchive || isZip )
+        threads = qMin( qMin( QThread::idealThreadCount(), MaxScanThreads ), mEntries.count() ) - 1;
+
+    QList< EntryScanThread* > scanThreads;
+    for ( int i = 0; i < threads; ++i ) {
+        EntryScanThread *thread = new EntryScanThread( &scan, isZip ? mFileName : QString() );
+        thread->start();
+        scanThreads.append( thread );
+    }
+
+    scanEntries( &scan, mArchive ? mArchiveDir : 0 );
+
+    Q_FOREACH ( EntryScanThread *thread, scanThreads ) {
+        thread->wait();
+        delete thread;
+    }
+
+    saveSizeCache( sizes );
+
+    return sizes;
+}
+
+QVector< QSize > Document::rarEntrySizes()
+{
+    // extracting a file from a solid archive means decompressing all the
+    // ones before it, so the images are told by the name of their files, and
+    // only the size of the first one is read: the others are estimated until
+    // their pages are decoded (see setPageSize())
+    const QList< QByteArray > formats = QImageReader::supportedImageFormats();
+    QStringList images;
+    Q_FOREACH ( const QString &entry, mEntries ) {
+        if ( formats.contains( QFileInfo( entry ).suffix().toLower().toLatin1() ) )
+            images.append( entry );
+    }
+    mEntries = images;
+
+    QVector< QSize > sizes;
+    if ( loadSizeCache( &sizes ) )
+        return sizes;
+
+    EntryScan scan;
+    scan.formats = formats;
+    scan.directory = 0;
+    scan.unrar = mUnrar;
+    while ( !mEntries.isEmpty() ) {
+        const QSize size = entrySize( &scan, 0, mEntries.first() );
+        if ( size.isValid() ) {
+            sizes.fill( QSize(), mEntries.count() );
+            sizes[ 0 ] = size;
+            break;
         }
+        mEntries.removeFirst();
     }
-    pagesVector->resize( count );
+
+    saveSizeCache( sizes );
+
+    return sizes;
+}
+
+QString Document::sizeCacheFileName() const
+{
+    const QByteArray hash = QCryptographicHash::hash( QFile::encodeName( mFileName ), QCryptographicHash::Md5 ).toHex();
+    return KStandardDirs::locateLocal( "cache", QString( "okular/comicbook/%1" ).arg( QString::fromLatin1( hash ) ) );
+}
+
+QByteArray Document::sizeCacheKey() const
+{
+    // the sizes are valid as long as the archive is not modified; the files
+    // of a directory can be rewritten in place, so each of them counts
+    QCryptographicHash hash( QCryptographicHash::Md5 );
+    QStringList files;
+    if ( mDirectory )
+        files = mEntries;
+    else
+        files.append( mFileName );
+
+    Q_FOREACH ( const QString &file, files ) {
+        const QFileInfo info( file );
+        hash.addData( QFile::encodeName( file ) );
+        hash.addData( QByteArray::number( info.lastModified().toTime_t() ) );
+        hash.addData( QByteArray::number( info.size() ) );
+    }
+    return hash.result();
+}
+
+bool Document::loadSizeCache( QVector< QSize > *sizes ) const
+{
+    const QString cacheFileName = sizeCacheFileName();
+    QFile file( cacheFileName );
+    if ( !file.open( QIODevice::ReadOnly ) )
+        return false;
+
+    QDataStream stream( &file );
+    stream.setVersion( QDataStream::Qt_4_6 );
+
+    quint32 version = 0;
+    stream >> version;
+    if ( version != SizeCacheVersion )
+        return false;
+
+    QString fileName;
+    QByteArray key;
+    QStringList entries;
+    stream >> fileName >> key >> entries >> *sizes;
+
+    const bool valid = stream.status() == QDataStream::Ok
+        && fileName == mFileName
+        && key == mSizeCacheKey
+        && entries == mEntries
+        && sizes->count() == mEntries.count();
+
+    // the cache files are pruned by their modification time, so mark this
+    // one as just used
+    if ( valid )
+        KDE::utime( cacheFileName, 0 );
+
+    return valid;
+}
+
+void Document::saveSizeCache( const QVector< QSize > &sizes ) const
+{
+    const QString cacheFileName = sizeCacheFileName();
+    QFile file( cacheFileName );
+    if ( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+        return;
+
+    QDataStream stream( &file );
+    stream.setVersion( QDataStream::Qt_4_6 );
+    stream << SizeCacheVersion << mFileName << mSizeCacheKey << mEntries << sizes;
+    file.close();
+
+    const QFileInfoList cacheFiles = QFileInfo( cacheFileName ).dir().entryInfoList( QDir::Files, QDir::Time );
+    for ( int i = MaxSizeCacheFiles; i < cacheFiles.count(); ++i )
+        QFile::remove( cacheFiles.at( i ).absoluteFilePath() );
 }
 
 QStringList Document::pageTitles() const
@@ -201,19 +498,35 @@ QStringList Document::pageTitles() const
     return QStringList();
 }
 
-QImage Document::pageImage( int page ) const
+QImage Document::pageImage( int page, const QSize &scaledSize, QSize *fullSize ) const
 {
+    QScopedPointer< QIODevice > dev;
     if ( mArchive ) {
         const KArchiveFile *entry = static_cast<const KArchiveFile*>( mArchiveDir->entry( mPageMap[ page ] ) );
         if ( entry )
-            return QImage::fromData( entry->data() );
+            dev.reset( entry->createDevice() );
     } else if ( mDirectory ) {
-        return QImage( mPageMap[ page ] );
+        dev.reset( mDirectory->createDevice( mPageMap[ page ] ) );
     } else {
-        return QImage::fromData( mUnrar->contentOf( mPageMap[ page ] ) );
+        dev.reset( mUnrar->createDevice( mPageMap[ page ] ) );
     }
 
-    return QImage();
+    if ( dev.isNull() )
+        return QImage();
+
+    // read the image straight from the device: the whole data is not needed
+    // at once, and decoders like the JPEG one can skip the pixels not needed
+    // for a smaller size
+    QImageReader reader( dev.data() );
+    if ( fullSize )
+        *fullSize = reader.size();
+    if ( scaledSize.isValid() && reader.supportsOption( QImageIOHandler::ScaledSize ) )
+        reader.setScaledSize( scaledSize );
+
+    const QImage image = reader.read();
+    if ( fullSize && !fullSize->isValid() && !scaledSize.isValid() )
+        *fullSize = image.size();
+    return image;
 }
 
 QString Document::lastErrorString() const
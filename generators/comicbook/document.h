@@ -10,12 +10,13 @@
 #ifndef COMICBOOK_DOCUMENT_H
 #define COMICBOOK_DOCUMENT_H
 
+#include <QtCore/QSize>
 #include <QtCore/QStringList>
+#include <QtCore/QVector>
 
 class KArchiveDirectory;
 class KArchive;
 class QImage;
-class QSize;
 class Unrar;
 class Directory;
 
@@ -37,20 +38,46 @@ class Document
         void pages( QVector<Okular::Page*> * pagesVector );
         QStringList pageTitles() const;
 
-        QImage pageImage( int page ) const;
+        /**
+         * Returns the image of the @p page; if @p scaledSize is valid, the
+         * image is decoded at (about) that size, if its format allows it.
+         * If @p fullSize is not null, it is set to the size of the image in
+         * the file.
+         */
+        QImage pageImage( int page, const QSize &scaledSize = QSize(), QSize *fullSize = 0 ) const;
+
+        /**
+         * Records the actual @p size of the @p page, whose size was only
+         * estimated (see Okular::Page::isSizeKnown()), to cache it.
+         */
+        void setPageSize( int page, const QSize &size );
 
         QString lastErrorString() const;
 
     private:
         bool processArchive();
+        QVector< QSize > entrySizes() const;
+        QVector< QSize > rarEntrySizes();
+        bool loadSizeCache( QVector< QSize > *sizes ) const;
+        void saveSizeCache( const QVector< QSize > &sizes ) const;
+        QString sizeCacheFileName() const;
+        QByteArray sizeCacheKey() const;
 
         QStringList mPageMap;
+        // the index in mEntries of the file of each page
+        QVector< int > mPageEntries;
+        // the size of the image of each entry, invalid if not known yet
+        QVector< QSize > mSizes;
+        bool mSizesModified;
+        // the state of the files the sizes are read from, see sizeCacheKey()
+        QByteArray mSizeCacheKey;
         Directory *mDirectory;
         Unrar *mUnrar;
         KArchive *mArchive;
         KArchiveDirectory *mArchiveDir;
         QString mLastErrorString;
         QStringList mEntries;
+        QString mFileName;
 };
 
 }
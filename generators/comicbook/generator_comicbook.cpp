@@ -38,7 +38,7 @@ static KAboutData createAboutData()
 OKULAR_EXPORT_PLUGIN( ComicBookGenerator, createAboutData() )
 
 ComicBookGenerator::ComicBookGenerator( QObject *parent, const QVariantList &args )
-    : Generator( parent, args )
+    : Generator( parent, args ), mImageCache( this )
 {
     setFeature( Threaded );
     setFeature( PrintNative );
@@ -66,18 +66,46 @@ bool ComicBookGenerator::loadDocument( const QString & fileName, QVector<Okular:
 bool ComicBookGenerator::doCloseDocument()
 {
     mDocument.close();
+    mImageCache.clear();
 
     return true;
 }
 
 QImage ComicBookGenerator::image( Okular::PixmapRequest * request )
 {
-    int width = request->width();
-    int height = request->height();
+    const QSize size( request->width(), request->height() );
 
-    QImage image = mDocument.pageImage( request->pageNumber() );
+    // decode the page at the smallest power-of-two reduction still larger
+    // than the request, so that thumbnails of big scans are cheap
+    QImage image = mImageCache.find( request->pageNumber(), size );
+    if ( image.isNull() && !request->page()->isSizeKnown() )
+    {
+        // the size of the page is just estimated: decode the whole image, and
+        // report its actual size
+        QSize fullSize;
+        image = mDocument.pageImage( request->pageNumber(), QSize(), &fullSize );
+        if ( fullSize.isValid() )
+            QMetaObject::invokeMethod( this, "slotPageSizeRead", Qt::QueuedConnection,
+                                       Q_ARG( int, request->pageNumber() ), Q_ARG( QSize, fullSize ) );
+        return Okular::ScaledImageCache::scaled( image, size );
+    }
+    else if ( image.isNull() )
+    {
+        const QSize fullSize( (int)request->page()->width(), (int)request->page()->height() );
+        const int reduction = Okular::ScaledImageCache::reduction( fullSize, size );
+        const QSize reducedSize = Okular::ScaledImageCache::reducedSize( fullSize, reduction );
+
+        image = Okular::ScaledImageCache::scaled( mDocument.pageImage( request->pageNumber(), reducedSize ), reducedSize );
+        mImageCache.insert( request->pageNumber(), reduction, image );
+    }
+
+    return Okular::ScaledImageCache::scaled( image, size );
+}
 
-    return image.scaled( width, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation );
+void ComicBookGenerator::slotPageSizeRead( int page, const QSize &size )
+{
+    mDocument.setPageSize( page, size );
+    updatePageSize( page, size.width(), size.height() );
 }
 
 bool ComicBookGenerator::print( QPrinter& printer )
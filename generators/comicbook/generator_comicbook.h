@@ -11,6 +11,7 @@
 #define GENERATOR_COMICBOOK_H
 
 #include <core/generator.h>
+#include <core/scaledimagecache.h>
 
 #include "document.h"
 
@@ -32,8 +33,12 @@ class ComicBookGenerator : public Okular::Generator
         bool doCloseDocument();
         QImage image( Okular::PixmapRequest * request );
 
+    private slots:
+        void slotPageSizeRead( int page, const QSize &size );
+
     private:
       ComicBook::Document mDocument;
+      Okular::ScaledImageCache mImageCache;
 };
 
 #endif
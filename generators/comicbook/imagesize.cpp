@@ -0,0 +1,164 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "imagesize.h"
+
+#include <string.h>
+
+static inline uint bigEndian16( const uchar *data )
+{
+    return ( data[0] << 8 ) | data[1];
+}
+
+static inline uint bigEndian32( const uchar *data )
+{
+    return ( data[0] << 24 ) | ( data[1] << 16 ) | ( data[2] << 8 ) | data[3];
+}
+
+static inline uint littleEndian16( const uchar *data )
+{
+    return data[0] | ( data[1] << 8 );
+}
+
+static inline uint littleEndian24( const uchar *data )
+{
+    return data[0] | ( data[1] << 8 ) | ( data[2] << 16 );
+}
+
+static QSize pngSize( const uchar *data, int length )
+{
+    // signature, then the IHDR chunk: length, type, width, height
+    if ( length < 24 || memcmp( data + 12, "IHDR", 4 ) != 0 )
+        return QSize();
+
+    return QSize( bigEndian32( data + 16 ), bigEndian32( data + 20 ) );
+}
+
+static QSize gifSize( const uchar *data, int length )
+{
+    // signature and version, then the logical screen descriptor
+    if ( length < 10 )
+        return QSize();
+
+    return QSize( littleEndian16( data + 6 ), littleEndian16( data + 8 ) );
+}
+
+static QSize jpegSize( const uchar *data, int length )
+{
+    // walk the segments up to the first "start of frame" one
+    int pos = 2;
+    while ( pos + 1 < length )
+    {
+        if ( data[pos] != 0xFF )
+            return QSize();
+
+        const uchar marker = data[pos + 1];
+        pos += 2;
+        // fill bytes, and markers without a segment
+        if ( marker == 0xFF )
+        {
+            --pos;
+            continue;
+        }
+        if ( marker == 0x01 || ( marker >= 0xD0 && marker <= 0xD8 ) )
+            continue;
+        // end of image, or start of the scan before any frame header
+        if ( marker == 0xD9 || marker == 0xDA )
+            return QSize();
+
+        if ( pos + 2 > length )
+            return QSize();
+        const int segmentLength = bigEndian16( data + pos );
+        if ( segmentLength < 2 )
+            return QSize();
+
+        // SOF0..SOF15, except DHT (C4), JPG (C8) and DAC (CC)
+        if ( marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC )
+        {
+            // length, precision, height, width
+            if ( pos + 7 > length )
+                return QSize();
+            return QSize( bigEndian16( data + pos + 5 ), bigEndian16( data + pos + 3 ) );
+        }
+
+        pos += segmentLength;
+    }
+
+    return QSize();
+}
+
+static QSize webpSize( const uchar *data, int length )
+{
+    // "RIFF", file size, "WEBP", then the first chunk: type, size, payload
+    if ( length < 30 )
+        return QSize();
+
+    const uchar *chunk = data + 12;
+    const uchar *payload = chunk + 8;
+    if ( memcmp( chunk, "VP8 ", 4 ) == 0 )
+    {
+        // lossy: frame tag, start code, then 14 bit width and height
+        if ( payload[3] != 0x9D || payload[4] != 0x01 || payload[5] != 0x2A )
+            return QSize();
+        return QSize( littleEndian16( payload + 6 ) & 0x3FFF, littleEndian16( payload + 8 ) & 0x3FFF );
+    }
+    if ( memcmp( chunk, "VP8L", 4 ) == 0 )
+    {
+        // lossless: signature, then 14 bit width - 1 and height - 1
+        if ( payload[0] != 0x2F )
+            return QSize();
+        const uint bits = payload[1] | ( payload[2] << 8 ) | ( payload[3] << 16 ) | ( payload[4] << 24 );
+        return QSize( ( bits & 0x3FFF ) + 1, ( ( bits >> 14 ) & 0x3FFF ) + 1 );
+    }
+    if ( memcmp( chunk, "VP8X", 4 ) == 0 )
+    {
+        // extended: flags, reserved, then 24 bit canvas width - 1 and height - 1
+        return QSize( littleEndian24( payload + 4 ) + 1, littleEndian24( payload + 7 ) + 1 );
+    }
+
+    return QSize();
+}
+
+QSize ComicBook::imageSizeFromHeader( const QByteArray &header, QByteArray *format )
+{
+    const uchar *data = reinterpret_cast< const uchar * >( header.constData() );
+    const int length = header.size();
+
+    QSize size;
+    if ( length >= 8 && memcmp( data, "\x89PNG\r\n\x1A\n", 8 ) == 0 )
+    {
+        *format = "png";
+        size = pngSize( data, length );
+    }
+    else if ( length >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF )
+    {
+        *format = "jpeg";
+        size = jpegSize( data, length );
+    }
+    else if ( length >= 6 && ( memcmp( data, "GIF87a", 6 ) == 0 || memcmp( data, "GIF89a", 6 ) == 0 ) )
+    {
+        *format = "gif";
+        size = gifSize( data, length );
+    }
+    else if ( length >= 12 && memcmp( data, "RIFF", 4 ) == 0 && memcmp( data + 8, "WEBP", 4 ) == 0 )
+    {
+        *format = "webp";
+        size = webpSize( data, length );
+    }
+    else
+    {
+        format->clear();
+    }
+
+    // sizes this big are surely a broken header
+    if ( size.isValid() && ( size.width() > 0xFFFFFF || size.height() > 0xFFFFFF ) )
+        return QSize();
+
+    return size.isEmpty() ? QSize() : size;
+}
@@ -0,0 +1,30 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef COMICBOOK_IMAGESIZE_H
+#define COMICBOOK_IMAGESIZE_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QSize>
+
+namespace ComicBook {
+
+/**
+ * Returns the size of the image whose file starts with @p header, reading
+ * it straight from the header of PNG, JPEG, GIF and WebP files, and sets
+ * @p format to the name of the format ("png", "jpeg", "gif" or "webp").
+ *
+ * An invalid size is returned for other formats, or when the size is not
+ * within @p header; no pixel is ever decoded.
+ */
+QSize imageSizeFromHeader( const QByteArray &header, QByteArray *format );
+
+}
+
+#endif
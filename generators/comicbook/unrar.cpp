@@ -9,16 +9,17 @@
 
 #include "unrar.h"
 
+#include <QtCore/QBuffer>
 #include <QtCore/QEventLoop>
 #include <QtCore/QFile>
 #include <QtCore/QRegExp>
+#include <QtCore/QSet>
 
 #include <kdebug.h>
 #include <kglobal.h>
 #include <klocale.h>
 #include <kpassworddialog.h>
 #include <kstandarddirs.h>
-#include <ktempdir.h>
 #if !defined(Q_OS_WIN)
 #include <kptyprocess.h>
 #include <kptydevice.h>
@@ -90,13 +91,12 @@ UnrarHelper::~UnrarHelper()
 
 
 Unrar::Unrar()
-    : QObject( 0 ), mLoop( 0 ), mTempDir( 0 )
+    : QObject( 0 ), mLoop( 0 )
 {
 }
 
 Unrar::~Unrar()
 {
-    delete mTempDir;
 }
 
 bool Unrar::open( const QString &fileName )
@@ -104,65 +104,98 @@ bool Unrar::open( const QString &fileName )
     if ( !isSuitableVersionAvailable() )
         return false;
 
-    delete mTempDir;
-    mTempDir = new KTempDir();
-
     mFileName = fileName;
+    mEntries.clear();
 
     /**
-     * Extract the archive to a temporary directory
+     * Just list the archive, which also tells whether it can be read
      */
     mStdOutData.clear();
     mStdErrData.clear();
 
-    int ret = startSyncProcess( QStringList() << "e" << mFileName << mTempDir->name() );
+    int ret = startSyncProcess( QStringList() << "lb" << mFileName );
     bool ok = ret == 0;
 
+    if ( ok )
+    {
+        const QStringList listFiles = helper->kind->processListing( QString::fromLocal8Bit( mStdOutData ).split( '\n', QString::SkipEmptyParts ) );
+
+        // the directories are listed too, but they are not files
+        QSet< QString > directories;
+        Q_FOREACH ( const QString &f, listFiles ) {
+            int slash = f.lastIndexOf( '/' );
+            while ( slash > 0 ) {
+                directories.insert( f.left( slash ) );
+                slash = f.lastIndexOf( '/', slash - 1 );
+            }
+        }
+        Q_FOREACH ( const QString &f, listFiles ) {
+            if ( !directories.contains( f ) ) {
+                mEntries.append( f );
+            }
+        }
+    }
+
     return ok;
 }
 
 QStringList Unrar::list()
 {
-    mStdOutData.clear();
-    mStdErrData.clear();
+    return mEntries;
+}
 
+QByteArray Unrar::contentOf( const QString &fileName, int maxSize ) const
+{
     if ( !isSuitableVersionAvailable() )
-        return QStringList();
+        return QByteArray();
 
-    startSyncProcess( QStringList() << "lb" << mFileName );
+    /**
+     * Print just that file to the standard output, without any message
+     * (-inul) nor password prompt (-p-); no event loop is needed, so this
+     * works from any thread
+     */
+    QProcess process;
+    process.start( helper->unrarPath, QStringList() << "p" << "-inul" << "-p-" << mFileName << fileName, QIODevice::ReadOnly );
+    if ( !process.waitForStarted( -1 ) )
+        return QByteArray();
 
-    const QStringList listFiles = helper->kind->processListing( QString::fromLocal8Bit( mStdOutData ).split( '\n', QString::SkipEmptyParts ) );
-    QStringList newList;
-    Q_FOREACH ( const QString &f, listFiles ) {
-        if ( QFile::exists( mTempDir->name() + f ) ) {
-            newList.append( f );
-        }
+    QByteArray data;
+    while ( maxSize < 0 || data.size() < maxSize )
+    {
+        const bool more = process.waitForReadyRead( -1 );
+        data += process.readAllStandardOutput();
+        if ( !more )
+            break;
     }
-    return newList;
-}
 
-QByteArray Unrar::contentOf( const QString &fileName ) const
-{
-    if ( !isSuitableVersionAvailable() )
+    if ( process.state() != QProcess::NotRunning )
+    {
+        // enough data: no need to extract the rest
+        process.kill();
+        process.waitForFinished( -1 );
+    }
+    else if ( maxSize < 0 && ( process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0 ) )
+    {
         return QByteArray();
+    }
 
-    QFile file( mTempDir->name() + fileName );
-    if ( !file.open( QIODevice::ReadOnly ) )
-        return QByteArray();
+    if ( maxSize >= 0 && data.size() > maxSize )
+        data.truncate( maxSize );
 
-    return file.readAll();
+    return data;
 }
 
-QIODevice* Unrar::createDevice( const QString &fileName ) const
+QIODevice* Unrar::createDevice( const QString &fileName, int maxSize ) const
 {
     if ( !isSuitableVersionAvailable() )
         return 0;
 
-    std::auto_ptr< QFile> file( new QFile( mTempDir->name() + fileName ) );
-    if ( !file->open( QIODevice::ReadOnly ) )
+    std::auto_ptr< QBuffer > buffer( new QBuffer() );
+    buffer->setData( contentOf( fileName, maxSize ) );
+    if ( buffer->data().isEmpty() || !buffer->open( QIODevice::ReadOnly ) )
         return 0;
 
-    return file.release();
+    return buffer.release();
 }
 
 bool Unrar::isAvailable()
@@ -15,7 +15,6 @@
 #include <QtCore/QStringList>
 
 class QEventLoop;
-class KTempDir;
 class KPtyProcess;
 
 class Unrar : public QObject
@@ -35,6 +34,9 @@ class Unrar : public QObject
 
         /**
          * Opens given rar archive.
+         *
+         * Nothing is extracted: the files are extracted one by one when
+         * their content is asked for.
          */
         bool open( const QString &fileName );
 
@@ -44,14 +46,19 @@ class Unrar : public QObject
         QStringList list();
 
         /**
-         * Returns the content of the file with the given name.
+         * Returns the content of the file with the given name; if
+         * @p maxSize is not negative, at most its first @p maxSize bytes
+         * are extracted.
+         *
+         * It can be called from any thread.
          */
-        QByteArray contentOf( const QString &fileName ) const;
+        QByteArray contentOf( const QString &fileName, int maxSize = -1 ) const;
 
         /**
-         * Returns a new device for reading the file with the given name.
+         * Returns a new device for reading the file with the given name
+         * (or its first @p maxSize bytes, see contentOf()).
          */
-        QIODevice* createDevice( const QString &fileName ) const;
+        QIODevice* createDevice( const QString &fileName, int maxSize = -1 ) const;
 
         static bool isAvailable();
         static bool isSuitableVersionAvailable();
@@ -74,7 +81,7 @@ class Unrar : public QObject
         QString mFileName;
         QByteArray mStdOutData;
         QByteArray mStdErrData;
-        KTempDir *mTempDir;
+        QStringList mEntries;
 };
 
 #endif
@@ -88,11 +88,15 @@ DjVuGenerator::DjVuGenerator( QObject *parent, const QVariantList &args )
 {
     setFeature( TextExtraction );
     setFeature( Threaded );
+    setFeature( TiledRendering );
     setFeature( PrintPostscript );
     if ( Okular::FilePrinter::ps2pdfAvailable() )
         setFeature( PrintToFile );
 
-    m_djvu = new KDjVu();
+    // the pixmaps are cached by the document already, so the rendered images
+    // are not kept; the decoded pages are, and they count in the memory
+    // budget of the document
+    m_djvu = new KDjVu( this );
     m_djvu->setCacheEnabled( false );
 }
 
@@ -128,10 +132,23 @@ bool DjVuGenerator::doCloseDocument()
     return true;
 }
 
+static bool shouldAbortRender( void *request )
+{
+    return static_cast< Okular::PixmapRequest * >( request )->shouldAbortRender();
+}
+
 QImage DjVuGenerator::image( Okular::PixmapRequest *request )
 {
     userMutex()->lock();
-    QImage img = m_djvu->image( request->pageNumber(), request->width(), request->height(), request->page()->rotation() );
+    QImage img;
+    // the page might have gone out of view while waiting for the lock
+    if ( !request->shouldAbortRender() )
+    {
+        if ( request->isTile() )
+            img = m_djvu->image( request->pageNumber(), request->width(), request->height(), request->page()->rotation(), request->pixelRect(), shouldAbortRender, request );
+        else
+            img = m_djvu->image( request->pageNumber(), request->width(), request->height(), request->page()->rotation(), shouldAbortRender, request );
+    }
     userMutex()->unlock();
     return img;
 }
@@ -14,13 +14,17 @@
 #include <qfile.h>
 #include <qhash.h>
 #include <qlist.h>
+#include <qmutex.h>
 #include <qpainter.h>
+#include <qpair.h>
 #include <qqueue.h>
 #include <qstring.h>
 
 #include <kdebug.h>
 #include <klocale.h>
 
+#include <core/accountedcache.h>
+
 #include <libdjvu/ddjvuapi.h>
 #include <libdjvu/miniexp.h>
 
@@ -88,6 +92,18 @@ static void wait_for_ddjvu_message( ddjvu_context_t *ctx, ddjvu_message_tag_t mi
     }
 }
 
+/**
+ * Wait until the decoding of \p page is over, sleeping on the message queue
+ * of \p ctx between the checks of its status.
+ */
+static ddjvu_status_t wait_for_ddjvu_page( ddjvu_context_t *ctx, ddjvu_page_t *page )
+{
+    ddjvu_status_t sts;
+    while ( ( sts = ddjvu_page_decoding_status( page ) ) < DDJVU_JOB_OK )
+        handle_ddjvu_messages( ctx, true );
+    return sts;
+}
+
 /**
  * Convert a clockwise coefficient \p r for a rotation to a counter-clockwise
  * and vice versa.
@@ -157,6 +173,20 @@ class ImageCacheItem
         QImage img;
 };
 
+class PageHandle
+{
+    public:
+        PageHandle( int p, ddjvu_page_t *h, qulonglong m, bool pf )
+          : page( p ), handle( h ), memory( m ), prefetched( pf ) { }
+
+        int page;
+        ddjvu_page_t *handle;
+        // an estimate of the memory of the decoded page
+        qulonglong memory;
+        // decoded ahead, and not used yet
+        bool prefetched;
+};
+
 
 // KdjVu::Page
 
@@ -425,17 +455,30 @@ QRect KDjVu::TextEntity::rect() const
 }
 
 
-class KDjVu::Private
+class KDjVu::Private : public Okular::AccountedCache
 {
     public:
-        Private()
-          : m_djvu_cxt( 0 ), m_djvu_document( 0 ), m_format( 0 ), m_docBookmarks( 0 ),
+        Private( Okular::Generator *generator )
+          : Okular::AccountedCache( generator ), m_djvu_cxt( 0 ), m_djvu_document( 0 ), m_format( 0 ), m_docBookmarks( 0 ),
             m_cacheEnabled( true )
         {
         }
 
+        // the rendered images and the decoded pages count in the memory
+        // budget of the document
+        qulonglong memoryUsage() const;
+        qulonglong shrink( qulonglong bytes );
+        void clearImageCache();
+
         QImage generateImageTile( ddjvu_page_t *djvupage, int& res,
             int width, int row, int xdelta, int height, int col, int ydelta );
+        QImage renderRect( ddjvu_page_t *djvupage, int& res,
+            int width, int height, const QRect &rect );
+        ddjvu_page_t *pageHandle( int page );
+        void prefetchPageHandles( int page );
+        void releasePageHandles();
+        qulonglong pageHandleMemory( int page ) const;
+        void addPageHandle( int index, const PageHandle &handle );
 
         void readBookmarks();
         void fillBookmarksRecurse( QDomDocument& maindoc, QDomNode& curnode,
@@ -450,9 +493,16 @@ class KDjVu::Private
         ddjvu_format_t *m_format;
 
         QVector<KDjVu::Page*> m_pages;
-        QVector<ddjvu_page_t *> m_pages_cache;
-
+        // the page handles, the most recently used first; guarded by
+        // mPagesCacheMutex, as the ones not in use (all but the first) can be
+        // released from the thread of the document
+        QList< PageHandle > m_pages_cache;
+        mutable QMutex mPagesCacheMutex;
+
+        // the most recently used first; guarded by mImgCacheMutex, as it
+        // can be shrunk from the thread of the document
         QList<ImageCacheItem*> mImgCache;
+        mutable QMutex mImgCacheMutex;
 
         QHash<QString, QVariant> m_metaData;
         QDomDocument * m_docBookmarks;
@@ -464,18 +514,30 @@ class KDjVu::Private
         static unsigned int s_formatmask[4];
 };
 
+// the most page handles kept, counting the ones decoded ahead
+static const int MaxPageHandles = 6;
+// how many pages after a rendered one are decoded ahead
+static const int PrefetchedPages = 2;
+
 unsigned int KDjVu::Private::s_formatmask[4] = { 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000 };
 
 QImage KDjVu::Private::generateImageTile( ddjvu_page_t *djvupage, int& res,
     int width, int row, int xdelta, int height, int col, int ydelta )
+{
+    const int x = row * xdelta;
+    const int y = col * ydelta;
+    const QRect rect( x, y, qMin( width - x, xdelta ), qMin( height - y, ydelta ) );
+    return renderRect( djvupage, res, width, height, rect );
+}
+
+QImage KDjVu::Private::renderRect( ddjvu_page_t *djvupage, int& res,
+    int width, int height, const QRect &rect )
 {
     ddjvu_rect_t renderrect;
-    renderrect.x = row * xdelta;
-    renderrect.y = col * ydelta;
-    int realwidth = qMin( width - renderrect.x, xdelta );
-    int realheight = qMin( height - renderrect.y, ydelta );
-    renderrect.w = realwidth;
-    renderrect.h = realheight;
+    renderrect.x = rect.x();
+    renderrect.y = rect.y();
+    renderrect.w = rect.width();
+    renderrect.h = rect.height();
 #ifdef KDJVU_DEBUG
     kDebug() << "renderrect:" << renderrect;
 #endif
@@ -488,7 +550,7 @@ QImage KDjVu::Private::generateImageTile( ddjvu_page_t *djvupage, int& res,
     kDebug() << "pagerect:" << pagerect;
 #endif
     handle_ddjvu_messages( m_djvu_cxt, false );
-    QImage res_img( realwidth, realheight, QImage::Format_RGB32 );
+    QImage res_img( rect.width(), rect.height(), QImage::Format_RGB32 );
     // the following line workarounds a rare crash in djvulibre;
     // it should be fixed with >= 3.5.21
     ddjvu_page_get_width( djvupage );
@@ -502,6 +564,134 @@ QImage KDjVu::Private::generateImageTile( ddjvu_page_t *djvupage, int& res,
     return res_img;
 }
 
+qulonglong KDjVu::Private::memoryUsage() const
+{
+    qulonglong memory = 0;
+    {
+        QMutexLocker locker( &mImgCacheMutex );
+        foreach ( const ImageCacheItem *item, mImgCache )
+            memory += item->img.byteCount();
+    }
+    QMutexLocker locker( &mPagesCacheMutex );
+    foreach ( const PageHandle &handle, m_pages_cache )
+        memory += handle.memory;
+    return memory;
+}
+
+qulonglong KDjVu::Private::shrink( qulonglong bytes )
+{
+    qulonglong freed = 0;
+    {
+        QMutexLocker locker( &mImgCacheMutex );
+        while ( freed < bytes && !mImgCache.isEmpty() )
+        {
+            ImageCacheItem *item = mImgCache.takeLast();
+            freed += item->img.byteCount();
+            delete item;
+        }
+    }
+
+    // the first page handle may be in use: the pages decoded ahead go first,
+    // then the least recently used ones
+    QMutexLocker locker( &mPagesCacheMutex );
+    for ( int pass = 0; pass < 2; ++pass )
+    {
+        for ( int i = m_pages_cache.count() - 1; i > 0 && freed < bytes; --i )
+        {
+            if ( pass == 0 && !m_pages_cache.at( i ).prefetched )
+                continue;
+
+            const PageHandle handle = m_pages_cache.takeAt( i );
+            ddjvu_page_release( handle.handle );
+            freed += handle.memory;
+        }
+    }
+    return freed;
+}
+
+void KDjVu::Private::clearImageCache()
+{
+    QMutexLocker locker( &mImgCacheMutex );
+    qDeleteAll( mImgCache );
+    mImgCache.clear();
+}
+
+qulonglong KDjVu::Private::pageHandleMemory( int page ) const
+{
+    // the mask and the wavelet coefficients of the layers of a decoded page
+    // take roughly a byte per pixel, at the resolution of the page
+    const KDjVu::Page *p = m_pages.value( page );
+    return p ? (qulonglong)p->width() * p->height() : 0;
+}
+
+void KDjVu::Private::addPageHandle( int index, const PageHandle &handle )
+{
+    // a decoded page takes a lot of memory: keep only the last used ones
+    if ( m_pages_cache.count() >= MaxPageHandles )
+        ddjvu_page_release( m_pages_cache.takeLast().handle );
+    m_pages_cache.insert( qMin( index, m_pages_cache.count() ), handle );
+}
+
+ddjvu_page_t *KDjVu::Private::pageHandle( int page )
+{
+    ddjvu_page_t *handle = 0;
+    {
+        QMutexLocker locker( &mPagesCacheMutex );
+        for ( int i = 0; i < m_pages_cache.count(); ++i )
+        {
+            if ( m_pages_cache.at( i ).page == page )
+            {
+                handle = m_pages_cache.takeAt( i ).handle;
+                break;
+            }
+        }
+        if ( !handle )
+        {
+            // DjVuLibre decodes the new page in a thread of its own
+            handle = ddjvu_page_create_by_pageno( m_djvu_document, page );
+            if ( !handle )
+                return 0;
+        }
+        addPageHandle( 0, PageHandle( page, handle, pageHandleMemory( page ), false ) );
+    }
+
+    // wait for the page to be decoded
+    wait_for_ddjvu_page( m_djvu_cxt, handle );
+    return handle;
+}
+
+void KDjVu::Private::prefetchPageHandles( int page )
+{
+    // start decoding the next pages, without waiting for them; they are put
+    // after the most recently used page, not to push it out of the cache
+    QMutexLocker locker( &mPagesCacheMutex );
+    const int last = qMin( page + PrefetchedPages, m_pages.count() - 1 );
+    for ( int next = page + 1; next <= last; ++next )
+    {
+        bool cached = false;
+        for ( int i = 0; i < m_pages_cache.count() && !cached; ++i )
+            cached = m_pages_cache.at( i ).page == next;
+        if ( cached )
+            continue;
+
+        ddjvu_page_t *handle = ddjvu_page_create_by_pageno( m_djvu_document, next );
+        if ( !handle )
+            continue;
+
+        addPageHandle( 1, PageHandle( next, handle, pageHandleMemory( next ), true ) );
+    }
+    locker.unlock();
+    handle_ddjvu_messages( m_djvu_cxt, false );
+}
+
+void KDjVu::Private::releasePageHandles()
+{
+    QMutexLocker locker( &mPagesCacheMutex );
+    foreach ( const PageHandle &handle, m_pages_cache )
+        ddjvu_page_release( handle.handle );
+    m_pages_cache.clear();
+}
+
 void KDjVu::Private::readBookmarks()
 {
     if ( !m_djvu_document )
@@ -635,7 +825,7 @@ int KDjVu::Private::pageWithName( const QString & name )
 }
 
 
-KDjVu::KDjVu() : d( new Private )
+KDjVu::KDjVu( Okular::Generator *generator ) : d( new Private( generator ) )
 {
     // creating the djvu context
     d->m_djvu_cxt = ddjvu_context_create( "KDjVu" );
@@ -682,8 +872,7 @@ bool KDjVu::openFile( const QString & fileName )
     int numofpages = ddjvu_document_get_pagenum( d->m_djvu_document );
     d->m_pages.clear();
     d->m_pages.resize( numofpages );
-    d->m_pages_cache.clear();
-    d->m_pages_cache.resize( numofpages );
+    d->releasePageHandles();
 
     // get the document type
     QString doctype;
@@ -754,13 +943,9 @@ void KDjVu::closeFile()
     qDeleteAll( d->m_pages );
     d->m_pages.clear();
     // releasing the djvu pages
-    QVector<ddjvu_page_t *>::Iterator it = d->m_pages_cache.begin(), itEnd = d->m_pages_cache.end();
-    for ( ; it != itEnd; ++it )
-        ddjvu_page_release( *it );
-    d->m_pages_cache.clear();
+    d->releasePageHandles();
     // clearing the image cache
-    qDeleteAll( d->mImgCache );
-    d->mImgCache.clear();
+    d->clearImageCache();
     // clearing the old metadata
     d->m_metaData.clear();
     // cleaing the page names mapping
@@ -905,10 +1090,12 @@ const QVector<KDjVu::Page*> &KDjVu::pages() const
     return d->m_pages;
 }
 
-QImage KDjVu::image( int page, int width, int height, int rotation )
+QImage KDjVu::image( int page, int width, int height, int rotation,
+                     AbortCheck abortCheck, void *abortData )
 {
     if ( d->m_cacheEnabled )
     {
+    QMutexLocker locker( &d->mImgCacheMutex );
     bool found = false;
     QList<ImageCacheItem*>::Iterator it = d->mImgCache.begin(), itEnd = d->mImgCache.end();
     for ( ; ( it != itEnd ) && !found; ++it )
@@ -932,16 +1119,9 @@ QImage KDjVu::image( int page, int width, int height, int rotation )
     }
     }
 
-    if ( !d->m_pages_cache.at( page ) )
-    {
-        ddjvu_page_t *newpage = ddjvu_page_create_by_pageno( d->m_djvu_document, page );
-        // wait for the new page to be loaded
-        ddjvu_status_t sts;
-        while ( ( sts = ddjvu_page_decoding_status( newpage ) ) < DDJVU_JOB_OK )
-            handle_ddjvu_messages( d->m_djvu_cxt, true );
-        d->m_pages_cache[page] = newpage;
-    }
-    ddjvu_page_t *djvupage = d->m_pages_cache[page];
+    ddjvu_page_t *djvupage = d->pageHandle( page );
+    if ( !djvupage || ( abortCheck && abortCheck( abortData ) ) )
+        return QImage();
 
 /*
     if ( ddjvu_page_get_rotation( djvupage ) != flipRotation( rotation ) )
@@ -977,6 +1157,12 @@ QImage KDjVu::image( int page, int width, int height, int rotation )
         int parts = xparts * yparts;
         for ( int i = 0; i < parts; ++i )
         {
+            if ( abortCheck && abortCheck( abortData ) )
+            {
+                p.end();
+                return QImage();
+            }
+
             int row = i % xparts;
             int col = i / xparts;
             int tmpres = 0;
@@ -991,8 +1177,13 @@ QImage KDjVu::image( int page, int width, int height, int rotation )
         p.end();
     }
 
+    // the next pages are likely to be rendered next: decode them meanwhile,
+    // so that rendering them only has to scale them
+    d->prefetchPageHandles( page );
+
     if ( res && d->m_cacheEnabled )
     {
+        QMutexLocker locker( &d->mImgCacheMutex );
         // delete all the cached pixmaps for the current page with a size that
         // differs no more than 35% of the new pixmap size
         int imgsize = newimg.width() * newimg.height();
@@ -1025,6 +1216,23 @@ QImage KDjVu::image( int page, int width, int height, int rotation )
     return newimg;
 }
 
+QImage KDjVu::image( int page, int width, int height, int rotation, const QRect &rect,
+                     AbortCheck abortCheck, void *abortData )
+{
+    Q_UNUSED( rotation )
+
+    ddjvu_page_t *djvupage = d->pageHandle( page );
+    if ( !djvupage || ( abortCheck && abortCheck( abortData ) ) )
+        return QImage();
+
+    int res = 0;
+    QImage img = d->renderRect( djvupage, res, width, height, rect );
+    if ( !res )
+        img.fill( qRgb( 255, 255, 255 ) );
+
+    return img;
+}
+
 bool KDjVu::exportAsPostScript( const QString & fileName, const QList<int>& pageList ) const
 {
     if ( !d->m_djvu_document || fileName.trimmed().isEmpty() || pageList.isEmpty() )
@@ -1138,10 +1346,7 @@ void KDjVu::setCacheEnabled( bool enable )
 
     d->m_cacheEnabled = enable;
     if ( !d->m_cacheEnabled )
-    {
-        qDeleteAll( d->mImgCache );
-        d->mImgCache.clear();
-    }
+        d->clearImageCache();
 }
 
 bool KDjVu::isCacheEnabled() const
@@ -21,6 +21,10 @@
 class QDomDocument;
 class QFile;
 
+namespace Okular {
+class Generator;
+}
+
 #ifndef MINIEXP_H
 typedef struct miniexp_s* miniexp_t;
 #endif
@@ -31,7 +35,11 @@ typedef struct miniexp_s* miniexp_t;
 class KDjVu
 {
     public:
-        KDjVu();
+        /**
+         * The decoded pages, and the rendered images if the cache is enabled,
+         * count in the memory budget of the document of the @p generator.
+         */
+        explicit KDjVu( Okular::Generator *generator );
         ~KDjVu();
 
         /**
@@ -206,6 +214,12 @@ class KDjVu
                 QRect m_rect;
         };
 
+        /**
+         * A function telling whether a rendering in progress is not needed
+         * anymore; it gets the \p data passed to image() along with it.
+         */
+        typedef bool (*AbortCheck)( void *data );
+
         /**
          * Opens the file \p fileName, closing the old one if necessary.
          */
@@ -254,8 +268,20 @@ class KDjVu
          * Check if the image for the specified \p page with the specified
          * \p width, \p height and \p rotation is already in cache, and returns
          * it. If not, a null image is returned.
+         *
+         * If \p abortCheck returns true, the rendering of big pages is stopped
+         * and a null image is returned.
+         */
+        QImage image( int page, int width, int height, int rotation,
+                      AbortCheck abortCheck = 0, void *abortData = 0 );
+
+        /**
+         * Renders only the \p rect part (in pixels) of the specified \p page
+         * scaled to \p width x \p height. The result is not cached.
+         * A null image is returned if \p abortCheck returns true.
          */
-        QImage image( int page, int width, int height, int rotation );
+        QImage image( int page, int width, int height, int rotation, const QRect &rect,
+                      AbortCheck abortCheck = 0, void *abortData = 0 );
 
         /**
          * Export the currently open document as PostScript file \p fileName.
@@ -266,6 +266,12 @@ void dviRenderer::getText(RenderedDocumentPagePixmap* page)
   _postscript = postscriptBackup;
 }
 
+bool dviRenderer::hasPostScript(const PageNumber& page) const
+{
+  // the PostScript is stored by page index, counting from 0
+  return PS_interface->hasGraphics(page - 1);
+}
+
 /*
 void dviRenderer::showThatSourceInformationIsPresent()
 {
@@ -169,6 +169,10 @@ public slots:
   virtual void  drawPage(RenderedDocumentPagePixmap* page);
   virtual void  getText(RenderedDocumentPagePixmap* page);
 
+  /** Returns true if the page has PostScript graphics, which are drawn
+      only by drawPage(), and not by getText(). */
+  bool          hasPostScript(const PageNumber& page) const;
+
   SimplePageSize sizeOfPage(const PageNumber& page);
 
   QVector<PreBookmark> getPrebookmarks() const { return prebookmarks; }
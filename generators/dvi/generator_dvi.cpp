@@ -68,6 +68,7 @@ DviGenerator::DviGenerator( QObject *parent, const QVariantList &args ) : Okular
     setFeature( Threaded );
     setFeature( TextExtraction );
     setFeature( FontInfo );
+    setFeature( PageBoundingBoxes );
     setFeature( PrintPostscript );
     if ( Okular::FilePrinter::ps2pdfAvailable() )
         setFeature( PrintToFile );
@@ -304,6 +305,34 @@ Okular::TextPage* DviGenerator::textPage( Okular::Page *page )
     return ktp;
 }
 
+Okular::NormalizedRect DviGenerator::pageBoundingBox( Okular::Page *page )
+{
+    // the text extraction draws the glyphs, the rules and the frames of the
+    // figures, but not the PostScript graphics (ghostscript would be needed):
+    // the pages with them are left to the scan of their first pixmap
+    dviPageInfo *pageInfo = new dviPageInfo();
+
+    pageInfo->width = page->width();
+    pageInfo->height = page->height();
+
+    pageInfo->pageNumber = page->number() + 1;
+
+    pageInfo->resolution = m_resolution;
+
+    QMutexLocker lock( userMutex() );
+
+    Okular::NormalizedRect bbox;
+    if ( m_dviRenderer && !m_dviRenderer->hasPostScript( pageInfo->pageNumber ) )
+    {
+        m_dviRenderer->getText( pageInfo );
+        lock.unlock();
+
+        bbox = Okular::Utils::imageBoundingBox( &pageInfo->img );
+    }
+    delete pageInfo;
+    return bbox;
+}
+
 Okular::TextPage *DviGenerator::extractTextFromPage( dviPageInfo *pageInfo )
 {
     QList<Okular::TextEntity*> textOfThePage;
@@ -47,6 +47,7 @@ class DviGenerator : public Okular::Generator
         bool doCloseDocument();
         QImage image( Okular::PixmapRequest * request );
         Okular::TextPage* textPage( Okular::Page *page );
+        Okular::NormalizedRect pageBoundingBox( Okular::Page *page );
 
     private:
         double m_resolution;
@@ -136,6 +136,12 @@ QColor ghostscript_interface::getBackgroundColor(const PageNumber& page) const {
 }
 
 
+bool ghostscript_interface::hasGraphics(const PageNumber& page) const {
+  pageInfo *info = pageList.value(page);
+  return (info != 0) && !info->PostScriptString->isEmpty();
+}
+
+
 void ghostscript_interface::clear() {
   PostScriptHeaderString->truncate(0);
 
@@ -67,6 +67,10 @@ public:
   // set, Qt::white is returned.
   QColor   getBackgroundColor(const PageNumber& page) const;
 
+  // Returns true if there is PostScript to be drawn by graphics() on a
+  // certain page
+  bool     hasGraphics(const PageNumber& page) const;
+
   QString  *PostScriptHeaderString;
 
   /** This method tries to find the PostScript file 'filename' in the
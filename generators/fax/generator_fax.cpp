@@ -39,7 +39,7 @@ static KAboutData createAboutData()
 OKULAR_EXPORT_PLUGIN( FaxGenerator, createAboutData() )
 
 FaxGenerator::FaxGenerator( QObject *parent, const QVariantList &args )
-    : Generator( parent, args )
+    : Generator( parent, args ), m_imageCache( this )
 {
     setFeature( Threaded );
     setFeature( PrintNative );
@@ -85,6 +85,7 @@ bool FaxGenerator::loadDocument( const QString & fileName, QVector<Okular::Page*
 bool FaxGenerator::doCloseDocument()
 {
     m_img = QImage();
+    m_imageCache.clear();
     delete m_docInfo;
     m_docInfo = 0;
 
@@ -98,8 +99,23 @@ QImage FaxGenerator::image( Okular::PixmapRequest * request )
     int height = request->height();
     if ( request->page()->rotation() % 2 == 1 )
         qSwap( width, height );
+    const QSize size( width, height );
 
-    return m_img.scaled( width, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation );
+    // the whole page is decoded at loading, but the small pixmaps are
+    // scaled from a reduced copy of it, made once
+    const int reduction = Okular::ScaledImageCache::reduction( m_img.size(), size );
+    if ( reduction == 1 )
+        return Okular::ScaledImageCache::scaled( m_img, size );
+
+    QImage image = m_imageCache.find( 0, size );
+    if ( image.isNull() )
+    {
+        image = m_img.scaled( Okular::ScaledImageCache::reducedSize( m_img.size(), reduction ),
+                              Qt::IgnoreAspectRatio, Qt::SmoothTransformation );
+        m_imageCache.insert( 0, reduction, image );
+    }
+
+    return Okular::ScaledImageCache::scaled( image, size );
 }
 
 const Okular::DocumentInfo * FaxGenerator::generateDocumentInfo()
@@ -11,6 +11,7 @@
 #define OKULAR_GENERATOR_FAX_H
 
 #include <core/generator.h>
+#include <core/scaledimagecache.h>
 
 #include <QtGui/QImage>
 
@@ -34,6 +35,7 @@ class FaxGenerator : public Okular::Generator
 
     private:
         QImage m_img;
+        Okular::ScaledImageCache m_imageCache;
         Okular::DocumentInfo *m_docInfo;
 };
 
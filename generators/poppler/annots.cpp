@@ -59,7 +59,7 @@ static int maskExportedFlags(int flags)
 
 //BEGIN PopplerAnnotationProxy implementation
 PopplerAnnotationProxy::PopplerAnnotationProxy( Poppler::Document *doc, QMutex *userMutex )
-    : ppl_doc ( doc ), mutex ( userMutex )
+    : ppl_doc ( doc ), mutex ( userMutex ), documentModified ( false )
 {
 }
 
@@ -82,6 +82,11 @@ bool PopplerAnnotationProxy::supports( Capability cap ) const
     }
 }
 
+bool PopplerAnnotationProxy::isDocumentModified() const
+{
+    return documentModified;
+}
+
 void PopplerAnnotationProxy::notifyAddition( Okular::Annotation *okl_ann, int page )
 {
 #ifdef HAVE_POPPLER_0_20
@@ -91,6 +96,7 @@ void PopplerAnnotationProxy::notifyAddition( Okular::Annotation *okl_ann, int pa
     Okular::AnnotationUtils::storeAnnotation( okl_ann, dom_ann, doc );
 
     QMutexLocker ml(mutex);
+    documentModified = true;
 
     // Create poppler annotation
     Poppler::Annotation *ppl_ann = Poppler::AnnotationUtils::createAnnotation( dom_ann );
@@ -144,6 +150,7 @@ void PopplerAnnotationProxy::notifyModification( const Okular::Annotation *okl_a
         return;
 
     QMutexLocker ml(mutex);
+    documentModified = true;
 
     if ( okl_ann->flags() & Okular::Annotation::BeingMoved )
     {
@@ -254,6 +261,7 @@ void PopplerAnnotationProxy::notifyRemoval( Okular::Annotation *okl_ann, int pag
         return;
 
     QMutexLocker ml(mutex);
+    documentModified = true;
 
     Poppler::Page *ppl_page = ppl_doc->page( page );
     ppl_page->removeAnnotation( ppl_ann ); // Also destroys ppl_ann
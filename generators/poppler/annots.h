@@ -30,9 +30,14 @@ class PopplerAnnotationProxy : public Okular::AnnotationProxy
         void notifyAddition( Okular::Annotation *annotation, int page );
         void notifyModification( const Okular::Annotation *annotation, int page, bool appearanceChanged );
         void notifyRemoval( Okular::Annotation *annotation, int page );
+
+        // whether the annotations of the document have been changed since
+        // it was loaded (to be called with the mutex locked)
+        bool isDocumentModified() const;
     private:
         Poppler::Document *ppl_doc;
         QMutex *mutex;
+        bool documentModified;
 };
 
 #endif
@@ -21,6 +21,7 @@
 #include <qregexp.h>
 #include <qstack.h>
 #include <qtextstream.h>
+#include <qthread.h>
 #include <QtGui/QPrinter>
 #include <QtGui/QPainter>
 
@@ -64,6 +65,8 @@ Q_DECLARE_METATYPE(const Poppler::LinkMovie*)
 
 static const int defaultPageWidth = 595;
 static const int defaultPageHeight = 842;
+// the resolution of the renderings used to find the bounding box of the pages
+static const double boundingBoxDpi = 36.0;
 
 class PDFOptionsPage : public QWidget
 {
@@ -379,6 +382,7 @@ static void PDFGeneratorPopplerDebugFunction(const QString &message, const QVari
 
 PDFGenerator::PDFGenerator( QObject *parent, const QVariantList &args )
     : Generator( parent, args ), pdfdoc( 0 ),
+    renderDocsCount( 0 ), maxRenderDocs( qMax( QThread::idealThreadCount(), 1 ) ),
     docInfoDirty( true ), docSynopsisDirty( true ),
     docEmbeddedFilesDirty( true ), nextFontPage( 0 ),
     dpiX( 72.0 /*Okular::Utils::dpiX()*/ ), dpiY( 72.0 /*Okular::Utils::dpiY()*/ ),
@@ -387,6 +391,11 @@ PDFGenerator::PDFGenerator( QObject *parent, const QVariantList &args )
     setFeature( Threaded );
     setFeature( TextExtraction );
     setFeature( FontInfo );
+    setFeature( TiledRendering );
+    setFeature( PageBoundingBoxes );
+    // each render thread gets its own Poppler::Document
+    setPixmapGenerationThreads( QThread::idealThreadCount() );
+    setTextPageGenerationThreads( QThread::idealThreadCount() );
 #ifdef Q_OS_WIN32
     setFeature( PrintNative );
 #else
@@ -420,6 +429,7 @@ bool PDFGenerator::loadDocument( const QString & filePath, QVector<Okular::Page*
 #endif
     // create PDFDoc for the given file
     pdfdoc = Poppler::Document::load( filePath, 0, 0 );
+    docFilePath = filePath;
     bool success = init(pagesVector, filePath.section('/', -1, -1));
     if (success)
     {
@@ -445,6 +455,7 @@ bool PDFGenerator::loadDocumentFromData( const QByteArray & fileData, QVector<Ok
 #endif
     // create PDFDoc for the given file
     pdfdoc = Poppler::Document::loadFromData( fileData, 0, 0 );
+    docFileData = fileData;
     return init(pagesVector, QString());
 }
 
@@ -505,6 +516,8 @@ bool PDFGenerator::init(QVector<Okular::Page*> & pagesVector, const QString &wal
 
         // 2. reopen the document using the password
         pdfdoc->unlock( password.toLatin1(), password.toLatin1() );
+        if ( !pdfdoc->isLocked() )
+            docPassword = password.toLatin1();
 
         // 3. if the password is correct and the user chose to remember it, store it to the wallet
         if ( !pdfdoc->isLocked() && wallet && /*safety check*/ wallet->isOpen() && keep )
@@ -547,6 +560,14 @@ bool PDFGenerator::doCloseDocument()
     delete pdfdoc;
     pdfdoc = 0;
     userMutex()->unlock();
+    renderDocsMutex.lock();
+    qDeleteAll(renderDocs);
+    renderDocs.clear();
+    renderDocsCount = 0;
+    renderDocsMutex.unlock();
+    docFilePath.clear();
+    docFileData.clear();
+    docPassword.clear();
     docInfoDirty = true;
     docSynopsisDirty = true;
     docSyn.clear();
@@ -863,21 +884,53 @@ QImage PDFGenerator::image( Okular::PixmapRequest * request )
     bool genObjectRects = !rectsGenerated.at( page->number() );
 
     // 0. LOCK [waits for the thread end]
+    // the links are extracted from the main document, and unsaved annotation
+    // changes are only there: otherwise render with a document of our own
     userMutex()->lock();
 
+    // the page might have gone out of view while waiting for the lock
+    if ( request->shouldAbortRender() )
+    {
+        userMutex()->unlock();
+        return QImage();
+    }
+
+    Poppler::Document *doc = pdfdoc;
+    if ( !genObjectRects && !annotProxy->isDocumentModified() )
+    {
+        const QColor paperColor = pdfdoc->paperColor();
+        const Poppler::Document::RenderHints hints = pdfdoc->renderHints();
+        userMutex()->unlock();
+
+        doc = takeRenderDocument( paperColor, hints );
+        if ( !doc )
+        {
+            userMutex()->lock();
+            doc = pdfdoc;
+        }
+    }
+
     // 1. Set OutputDev parameters and Generate contents
     // note: thread safety is set on 'false' for the GUI (this) thread
-    Poppler::Page *p = pdfdoc->page(page->number());
+    Poppler::Page *p = doc->page(page->number());
 
     // 2. Take data from outputdev and attach it to the Page
     QImage img;
     if (p)
     {
-        img = p->renderToImage(fakeDpiX, fakeDpiY, -1, -1, -1, -1, Poppler::Page::Rotate0 );
+        if ( request->isTile() )
+        {
+            const QRect rect = request->pixelRect();
+            img = p->renderToImage(fakeDpiX, fakeDpiY, rect.x(), rect.y(), rect.width(), rect.height(), Poppler::Page::Rotate0 );
+        }
+        else
+        {
+            img = p->renderToImage(fakeDpiX, fakeDpiY, -1, -1, -1, -1, Poppler::Page::Rotate0 );
+        }
     }
     else
     {
-        img = QImage( request->width(), request->height(), QImage::Format_Mono );
+        img = QImage( request->pixelRect().size(), QImage::Format_Mono );
         img.fill( Qt::white );
     }
 
@@ -893,13 +946,75 @@ QImage PDFGenerator::image( Okular::PixmapRequest * request )
     }
 
     // 3. UNLOCK [re-enables shared access]
-    userMutex()->unlock();
-
-    delete p;
+    if ( doc == pdfdoc )
+    {
+        userMutex()->unlock();
+        delete p;
+    }
+    else
+    {
+        delete p;
+        releaseRenderDocument( doc );
+    }
 
     return img;
 }
 
+Poppler::Document *PDFGenerator::takeRenderDocument( const QColor &paperColor, Poppler::Document::RenderHints hints )
+{
+    // every handle keeps its own caches of the document, so their number is
+    // bounded: past it, wait for one to be handed back
+    renderDocsMutex.lock();
+    while ( renderDocs.isEmpty() && renderDocsCount >= maxRenderDocs )
+        renderDocsFree.wait( &renderDocsMutex );
+    Poppler::Document *doc = renderDocs.isEmpty() ? 0 : renderDocs.takeLast();
+    if ( !doc )
+        ++renderDocsCount;
+    renderDocsMutex.unlock();
+
+    if ( !doc )
+    {
+        if ( !docFilePath.isEmpty() )
+            doc = Poppler::Document::load( docFilePath, docPassword, docPassword );
+        else
+            doc = Poppler::Document::loadFromData( docFileData, docPassword, docPassword );
+
+        if ( doc && doc->isLocked() )
+        {
+            delete doc;
+            doc = 0;
+        }
+        if ( !doc )
+        {
+            QMutexLocker locker( &renderDocsMutex );
+            --renderDocsCount;
+            renderDocsFree.wakeOne();
+            return 0;
+        }
+    }
+
+    // keep it in sync with the settings of the main document
+    if ( doc->paperColor() != paperColor )
+        doc->setPaperColor( paperColor );
+    if ( doc->renderHints() != hints )
+    {
+        doc->setRenderHint( Poppler::Document::Antialiasing, hints & Poppler::Document::Antialiasing );
+        doc->setRenderHint( Poppler::Document::TextAntialiasing, hints & Poppler::Document::TextAntialiasing );
+#ifdef HAVE_POPPLER_0_12_1
+        doc->setRenderHint( Poppler::Document::TextHinting, hints & Poppler::Document::TextHinting );
+#endif
+    }
+
+    return doc;
+}
+
+void PDFGenerator::releaseRenderDocument( Poppler::Document *doc )
+{
+    QMutexLocker locker( &renderDocsMutex );
+    renderDocs.append( doc );
+    renderDocsFree.wakeOne();
+}
+
 void PDFGenerator::resolveMovieLinkReference( Okular::Action *action, Okular::Page *page )
 {
 #ifdef HAVE_POPPLER_0_20
@@ -949,14 +1064,29 @@ Okular::TextPage* PDFGenerator::textPage( Okular::Page *page )
     kDebug(PDFDebug) << "page" << page->number();
 #endif
     // build a TextList...
+    // the text does not depend on the annotations, so it can be always
+    // extracted with a document of our own, and concurrently
+    userMutex()->lock();
+    const QColor paperColor = pdfdoc->paperColor();
+    const Poppler::Document::RenderHints hints = pdfdoc->renderHints();
+    userMutex()->unlock();
+    Poppler::Document *doc = takeRenderDocument( paperColor, hints );
+
     QList<Poppler::TextBox*> textList;
     double pageWidth, pageHeight;
-    Poppler::Page *pp = pdfdoc->page( page->number() );
+    Poppler::Page *pp = ( doc ? doc : pdfdoc )->page( page->number() );
     if (pp)
     {
-        userMutex()->lock();
-        textList = pp->textList();
-        userMutex()->unlock();
+        if ( doc )
+        {
+            textList = pp->textList();
+        }
+        else
+        {
+            userMutex()->lock();
+            textList = pp->textList();
+            userMutex()->unlock();
+        }
 
         QSizeF s = pp->pageSizeF();
         pageWidth = s.width();
@@ -970,11 +1100,63 @@ Okular::TextPage* PDFGenerator::textPage( Okular::Page *page )
         pageHeight = defaultPageHeight;
     }
 
+    if ( doc )
+        releaseRenderDocument( doc );
+
     Okular::TextPage *tp = abstractTextPage(textList, pageHeight, pageWidth, (Poppler::Page::Rotation)page->orientation());
     qDeleteAll(textList);
     return tp;
 }
 
+Okular::NormalizedRect PDFGenerator::pageBoundingBox( Okular::Page *page )
+{
+    // poppler knows the extents of the text, but not the ones of the graphics:
+    // these are looked for in a coarse rendering, made with a document of our own
+    userMutex()->lock();
+    const QColor paperColor = pdfdoc->paperColor();
+    const Poppler::Document::RenderHints hints = pdfdoc->renderHints();
+    userMutex()->unlock();
+    Poppler::Document *doc = takeRenderDocument( paperColor, hints );
+    if ( !doc )
+        return Okular::NormalizedRect();
+
+    QRectF contents;
+    QSizeF pageSize;
+    Poppler::Page *pp = doc->page( page->number() );
+    if ( pp )
+    {
+        pageSize = pp->pageSizeF();
+
+        const QImage img = pp->renderToImage( boundingBoxDpi, boundingBoxDpi, -1, -1, -1, -1, Poppler::Page::Rotate0 );
+        const Okular::NormalizedRect graphics = Okular::Utils::imageBoundingBox( &img );
+        if ( !graphics.isNull() )
+        {
+            // one pixel more on each side, not to lose any antialiased edge
+            const double pixelWidth = 1.0 / img.width(), pixelHeight = 1.0 / img.height();
+            contents = QRectF( ( graphics.left - pixelWidth ) * pageSize.width(),
+                               ( graphics.top - pixelHeight ) * pageSize.height(),
+                               ( graphics.right - graphics.left + 2 * pixelWidth ) * pageSize.width(),
+                               ( graphics.bottom - graphics.top + 2 * pixelHeight ) * pageSize.height() );
+        }
+
+        QList<Poppler::TextBox*> textList = pp->textList();
+        foreach ( Poppler::TextBox *word, textList )
+            contents |= word->boundingBox();
+        qDeleteAll( textList );
+
+        delete pp;
+    }
+
+    releaseRenderDocument( doc );
+
+    if ( contents.isEmpty() )
+        return Okular::NormalizedRect();
+
+    return Okular::NormalizedRect( contents.left() / pageSize.width(), contents.top() / pageSize.height(),
+                                   contents.right() / pageSize.width(), contents.bottom() / pageSize.height() )
+           & Okular::NormalizedRect( 0., 0., 1., 1. );
+}
+
 void PDFGenerator::requestFontData(const Okular::FontInfo &font, QByteArray *data)
 {
     Poppler::FontInfo fi = font.nativeId().value<Poppler::FontInfo>();
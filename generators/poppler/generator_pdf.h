@@ -18,7 +18,9 @@
 #include <poppler-qt4.h>
 
 #include <qbitarray.h>
+#include <qmutex.h>
 #include <qpointer.h>
+#include <qwaitcondition.h>
 
 #include <core/document.h>
 #include <core/generator.h>
@@ -101,6 +103,7 @@ class PDFGenerator : public Okular::Generator, public Okular::ConfigInterface, p
     protected:
         bool doCloseDocument();
         Okular::TextPage* textPage( Okular::Page *page );
+        Okular::NormalizedRect pageBoundingBox( Okular::Page *page );
 
     protected slots:
         void requestFontData(const Okular::FontInfo &font, QByteArray *data);
@@ -132,9 +135,24 @@ class PDFGenerator : public Okular::Generator, public Okular::ConfigInterface, p
 
         bool setDocumentRenderHints();
 
+        // get/put back a document handle for rendering pages without the user mutex
+        Poppler::Document *takeRenderDocument( const QColor &paperColor, Poppler::Document::RenderHints hints );
+        void releaseRenderDocument( Poppler::Document *doc );
+
         // poppler dependant stuff
         Poppler::Document *pdfdoc;
 
+        // additional handles of the same document, one per render thread;
+        // at most maxRenderDocs are created, then the threads wait for a free one
+        QList<Poppler::Document*> renderDocs;
+        int renderDocsCount;
+        int maxRenderDocs;
+        QMutex renderDocsMutex;
+        QWaitCondition renderDocsFree;
+        QString docFilePath;
+        QByteArray docFileData;
+        QByteArray docPassword;
+
 
         // misc variables for document info and synopsis caching
         bool docInfoDirty;
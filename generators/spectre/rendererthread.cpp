@@ -53,6 +53,14 @@ void GSRendererThread::run()
             GSRendererThreadRequest req = m_queue.dequeue();
             m_queueMutex.unlock();
 
+            // the page is not needed anymore, hand back an empty image
+            if (req.request->shouldAbortRender())
+            {
+                emit imageDone(new QImage(), req.request);
+                spectre_page_free(req.spectrePage);
+                continue;
+            }
+
             spectre_render_context_set_scale(m_renderContext, req.magnify, req.magnify);
             spectre_render_context_set_use_platform_fonts(m_renderContext, req.platformFonts);
             spectre_render_context_set_antialias_bits(m_renderContext, req.graphicsAAbits, req.textAAbits);
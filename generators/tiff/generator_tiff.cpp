@@ -15,6 +15,7 @@
 #include <qfileinfo.h>
 #include <qimage.h>
 #include <qlist.h>
+#include <qvector.h>
 #include <qpainter.h>
 #include <QtGui/QPrinter>
 
@@ -26,6 +27,7 @@
 #include <core/document.h>
 #include <core/page.h>
 #include <core/fileprinter.h>
+#include <core/scaledimagecache.h>
 #include <core/utils.h>
 
 #include <tiff.h>
@@ -89,12 +91,15 @@ void okular_tiffUnmapProc( thandle_t, tdata_t, toff_t )
 class TIFFGenerator::Private
 {
     public:
-        Private()
-          : tiff( 0 ), dev( 0 ) {}
+        Private( Okular::Generator *generator )
+          : tiff( 0 ), dev( 0 ), imageCache( generator ) {}
 
         TIFF* tiff;
         QByteArray data;
         QIODevice* dev;
+        // page -> directories of its reduced-resolution versions
+        QHash< int, QList< int > > reducedImages;
+        Okular::ScaledImageCache imageCache;
 };
 
 static QDateTime convertTIFFDateTime( const char* tiffdate )
@@ -158,6 +163,87 @@ static Okular::Rotation readTiffRotation( TIFF *tiff )
     return ret;
 }
 
+static inline uint32 abgrToArgb( uint32 pixel )
+{
+    // an image read by ReadRGBA* is ABGR, we need ARGB, so swap red and blue
+    const uint32 red = ( pixel & 0x00FF0000 ) >> 16;
+    const uint32 blue = ( pixel & 0x000000FF ) << 16;
+    return ( pixel & 0xFF00FF00 ) + red + blue;
+}
+
+// reads the whole image of the current directory
+static QImage readImage( TIFF *tiff, uint32 width, uint32 height, uint32 orientation )
+{
+    QImage image( width, height, QImage::Format_RGB32 );
+    uint32 * data = (uint32 *)image.bits();
+
+    if ( TIFFReadRGBAImageOriented( tiff, width, height, data, orientation ) == 0 )
+        return QImage();
+
+    const uint32 size = width * height;
+    for ( uint32 i = 0; i < size; ++i )
+        data[i] = abgrToArgb( data[i] );
+
+    return image;
+}
+
+// reads the image of the current directory strip by strip, averaging each
+// block of reduction x reduction pixels, so that the image is never in
+// memory at full size; returns a null image if the layout of the
+// directory does not allow that
+static QImage readReducedImage( TIFF *tiff, uint32 width, uint32 height, uint32 orientation, int reduction )
+{
+    uint32 rowsPerStrip = 0;
+    if ( TIFFIsTiled( tiff ) || orientation != ORIENTATION_TOPLEFT
+         || !TIFFGetFieldDefaulted( tiff, TIFFTAG_ROWSPERSTRIP, &rowsPerStrip ) || rowsPerStrip == 0 )
+        return QImage();
+    rowsPerStrip = qMin( rowsPerStrip, height );
+
+    const QSize size = Okular::ScaledImageCache::reducedSize( QSize( width, height ), reduction );
+    QImage image( size, QImage::Format_RGB32 );
+    QVector< uint32 > strip( width * rowsPerStrip );
+    // the sums of the components of the pixels of the output row being filled
+    QVector< uint32 > sums( size.width() * 3, 0 );
+    int sumRows = 0;
+
+    for ( uint32 row = 0; row < height; row += rowsPerStrip )
+    {
+        if ( TIFFReadRGBAStrip( tiff, row, strip.data() ) == 0 )
+            return QImage();
+
+        // the rows of a strip are stored from the bottom up
+        const uint32 stripRows = qMin( rowsPerStrip, height - row );
+        for ( uint32 i = 0; i < stripRows; ++i )
+        {
+            const uint32 *pixel = strip.constData() + ( stripRows - 1 - i ) * width;
+            for ( uint32 x = 0; x < width; ++x, ++pixel )
+            {
+                uint32 *sum = sums.data() + ( x / reduction ) * 3;
+                sum[0] += TIFFGetR( *pixel );
+                sum[1] += TIFFGetG( *pixel );
+                sum[2] += TIFFGetB( *pixel );
+            }
+            ++sumRows;
+
+            const uint32 y = row + i;
+            if ( sumRows < reduction && y + 1 < height )
+                continue;
+
+            QRgb *out = reinterpret_cast< QRgb * >( image.scanLine( y / reduction ) );
+            for ( int x = 0; x < size.width(); ++x )
+            {
+                const uint32 count = sumRows * qMin( (uint32)reduction, width - x * reduction );
+                const uint32 *sum = sums.constData() + x * 3;
+                out[x] = qRgb( sum[0] / count, sum[1] / count, sum[2] / count );
+            }
+            sums.fill( 0 );
+            sumRows = 0;
+        }
+    }
+
+    return image;
+}
+
 static KAboutData createAboutData()
 {
     KAboutData aboutData(
@@ -178,7 +264,7 @@ OKULAR_EXPORT_PLUGIN( TIFFGenerator, createAboutData() )
 
 TIFFGenerator::TIFFGenerator( QObject *parent, const QVariantList &args )
     : Okular::Generator( parent, args ),
-      d( new Private ), m_docInfo( 0 )
+      d( new Private( this ) ), m_docInfo( 0 )
 {
     setFeature( Threaded );
     setFeature( PrintNative );
@@ -248,6 +334,8 @@ bool TIFFGenerator::doCloseDocument()
         delete m_docInfo;
         m_docInfo = 0;
         m_pageMapping.clear();
+        d->reducedImages.clear();
+        d->imageCache.clear();
     }
 
     return true;
@@ -255,53 +343,73 @@ bool TIFFGenerator::doCloseDocument()
 
 QImage TIFFGenerator::image( Okular::PixmapRequest * request )
 {
-    bool generated = false;
-    QImage img;
-
-    if ( TIFFSetDirectory( d->tiff, mapPage( request->page()->number() ) ) )
+    const int pageNumber = request->page()->number();
+    int reqwidth = request->width();
+    int reqheight = request->height();
+    if ( request->page()->rotation() % 2 == 1 )
+        qSwap( reqwidth, reqheight );
+    const QSize size( reqwidth, reqheight );
+
+    // decode the page at the smallest power-of-two reduction still larger
+    // than the request, so that thumbnails of big scans are cheap
+    QImage img = d->imageCache.find( pageNumber, size );
+    if ( img.isNull() && TIFFSetDirectory( d->tiff, mapPage( pageNumber ) ) )
     {
-        int rotation = request->page()->rotation();
         uint32 width = 1;
         uint32 height = 1;
-        uint32 orientation = 0;
         TIFFGetField( d->tiff, TIFFTAG_IMAGEWIDTH, &width );
         TIFFGetField( d->tiff, TIFFTAG_IMAGELENGTH, &height );
 
-        if ( !TIFFGetField( d->tiff, TIFFTAG_ORIENTATION, &orientation ) )
-            orientation = ORIENTATION_TOPLEFT;
+        const QSize fullSize( width, height );
+        const int reduction = Okular::ScaledImageCache::reduction( fullSize, size );
+        const QSize reducedSize = Okular::ScaledImageCache::reducedSize( fullSize, reduction );
 
-        QImage image( width, height, QImage::Format_RGB32 );
-        uint32 * data = (uint32 *)image.bits();
-
-        // read data
-        if ( TIFFReadRGBAImageOriented( d->tiff, width, height, data, orientation ) != 0 )
+        // the smallest reduced-resolution version of the page which is
+        // large enough is the cheapest to read
+        int directory = mapPage( pageNumber );
+        foreach ( int reducedDirectory, d->reducedImages.value( pageNumber ) )
         {
-            // an image read by ReadRGBAImage is ABGR, we need ARGB, so swap red and blue
-            uint32 size = width * height;
-            for ( uint32 i = 0; i < size; ++i )
+            uint32 reducedWidth = 0;
+            uint32 reducedHeight = 0;
+            if ( !TIFFSetDirectory( d->tiff, reducedDirectory )
+                 || TIFFGetField( d->tiff, TIFFTAG_IMAGEWIDTH, &reducedWidth ) != 1
+                 || TIFFGetField( d->tiff, TIFFTAG_IMAGELENGTH, &reducedHeight ) != 1 )
+                continue;
+
+            if ( (int)reducedWidth >= reducedSize.width() && (int)reducedHeight >= reducedSize.height()
+                 && reducedWidth < width )
             {
-                uint32 red = ( data[i] & 0x00FF0000 ) >> 16;
-                uint32 blue = ( data[i] & 0x000000FF ) << 16;
-                data[i] = ( data[i] & 0xFF00FF00 ) + red + blue;
+                directory = reducedDirectory;
+                width = reducedWidth;
+                height = reducedHeight;
             }
+        }
 
-            int reqwidth = request->width();
-            int reqheight = request->height();
-            if ( rotation % 2 == 1 )
-                qSwap( reqwidth, reqheight );
-            img = image.scaled( reqwidth, reqheight, Qt::IgnoreAspectRatio, Qt::SmoothTransformation );
-
-            generated = true;
+        if ( TIFFSetDirectory( d->tiff, directory ) )
+        {
+            uint32 orientation = 0;
+            if ( !TIFFGetField( d->tiff, TIFFTAG_ORIENTATION, &orientation ) )
+                orientation = ORIENTATION_TOPLEFT;
+
+            const int subsampling = Okular::ScaledImageCache::reduction( QSize( width, height ), reducedSize );
+            if ( subsampling > 1 )
+                img = readReducedImage( d->tiff, width, height, orientation, subsampling );
+            if ( img.isNull() )
+                img = readImage( d->tiff, width, height, orientation );
+
+            img = Okular::ScaledImageCache::scaled( img, reducedSize );
+            d->imageCache.insert( pageNumber, reduction, img );
         }
     }
 
-    if ( !generated )
+    if ( img.isNull() )
     {
         img = QImage( request->width(), request->height(), QImage::Format_RGB32 );
         img.fill( qRgb( 255, 255, 255 ) );
+        return img;
     }
 
-    return img;
+    return Okular::ScaledImageCache::scaled( img, size );
 }
 
 const Okular::DocumentInfo * TIFFGenerator::generateDocumentInfo()
@@ -364,6 +472,15 @@ void TIFFGenerator::loadPages( QVector<Okular::Page*> & pagesVector )
              TIFFGetField( d->tiff, TIFFTAG_IMAGELENGTH, &height ) != 1 )
             continue;
 
+        // a reduced-resolution version of the previous page is not a page
+        uint32 subfileType = 0;
+        if ( TIFFGetField( d->tiff, TIFFTAG_SUBFILETYPE, &subfileType ) == 1
+             && ( subfileType & FILETYPE_REDUCEDIMAGE ) && realdirs > 0 )
+        {
+            d->reducedImages[ realdirs - 1 ].append( i );
+            continue;
+        }
+
         adaptSizeToResolution( d->tiff, TIFFTAG_XRESOLUTION, dpiX, &width );
         adaptSizeToResolution( d->tiff, TIFFTAG_YRESOLUTION, dpiY, &height );
 
@@ -398,20 +515,11 @@ bool TIFFGenerator::print( QPrinter& printer )
              TIFFGetField( d->tiff, TIFFTAG_IMAGELENGTH, &height ) != 1 )
             continue;
 
-        QImage image( width, height, QImage::Format_RGB32 );
-        uint32 * data = (uint32 *)image.bits();
-
-        // read data
-        if ( TIFFReadRGBAImageOriented( d->tiff, width, height, data, ORIENTATION_TOPLEFT ) != 0 )
+        QImage image = readImage( d->tiff, width, height, ORIENTATION_TOPLEFT );
+        if ( image.isNull() )
         {
-            // an image read by ReadRGBAImage is ABGR, we need ARGB, so swap red and blue
-            uint32 size = width * height;
-            for ( uint32 i = 0; i < size; ++i )
-            {
-                uint32 red = ( data[i] & 0x00FF0000 ) >> 16;
-                uint32 blue = ( data[i] & 0x000000FF ) << 16;
-                data[i] = ( data[i] & 0xFF00FF00 ) + red + blue;
-            }
+            image = QImage( width, height, QImage::Format_RGB32 );
+            image.fill( qRgb( 255, 255, 255 ) );
         }
 
         if ( i != 0 )
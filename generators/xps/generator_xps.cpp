@@ -39,6 +39,11 @@
 
 const int XpsDebug = 4712;
 
+// the memory cap of the retained page display lists, in KB
+static const int DisplayListCacheSize = 32 * 1024;
+// the memory cap of the decoded images shared by the pages, in KB
+static const int ImageCacheSize = 64 * 1024;
+
 static KAboutData createAboutData()
 {
     KAboutData aboutData(
@@ -492,7 +497,7 @@ static QString entryPath( const KZipFileEntry* entry )
 static QString absolutePath( const QString &path, const QString &location )
 {
     QString retPath;
-    if ( location.at( 0 ) == QLatin1Char( '/' ) ) {
+    if ( location.startsWith( QLatin1Char( '/' ) ) ) {
         // already absolute
         retPath = location;
     } else {
@@ -744,9 +749,192 @@ static QString unicodeString( const QString &raw )
 }
 
 
+XpsDisplayList::XpsDisplayList()
+    : m_cost( 0 ), m_lastDrawItem( -1 )
+{
+    m_state.opacity = 1.0;
+    m_state.saveItem = -1;
+}
+
+void XpsDisplayList::save()
+{
+    m_states.push( m_state );
+    m_state.saveItem = m_items.count();
+    m_items.append( Item( Save ) );
+}
+
+void XpsDisplayList::restore()
+{
+    if ( m_states.isEmpty() )
+        return;
+
+    if ( m_lastDrawItem < m_state.saveItem ) {
+        // nothing was drawn since the matching save(), so drop all of it
+        m_items.resize( m_state.saveItem );
+    } else {
+        m_items.append( Item( Restore ) );
+    }
+    m_state = m_states.pop();
+}
+
+qreal XpsDisplayList::opacity() const
+{
+    return m_state.opacity;
+}
+
+void XpsDisplayList::setOpacity( qreal opacity )
+{
+    m_state.opacity = opacity;
+    Item item( Opacity );
+    item.opacity = opacity;
+    m_items.append( item );
+}
+
+void XpsDisplayList::setWorldMatrix( const QMatrix &matrix, bool combine )
+{
+    Item item( WorldMatrix );
+    item.matrix = matrix;
+    item.combine = combine;
+    m_items.append( item );
+}
+
+void XpsDisplayList::setClipPath( const QPainterPath &path )
+{
+    Item item( ClipPath );
+    item.path = path;
+    m_items.append( item );
+    m_cost += path.elementCount() * sizeof( QPainterPath::Element );
+}
+
+void XpsDisplayList::setFont( const QFont &font )
+{
+    m_state.font = font;
+    Item item( Font );
+    item.font = font;
+    m_items.append( item );
+}
+
+void XpsDisplayList::setBrush( const QBrush &brush )
+{
+    Item item( Brush );
+    item.brush = brush;
+    m_items.append( item );
+    addBrushCost( brush );
+}
+
+void XpsDisplayList::setPen( const QPen &pen )
+{
+    Item item( Pen );
+    item.pen = pen;
+    m_items.append( item );
+    addBrushCost( pen.brush() );
+}
+
+void XpsDisplayList::setLayoutDirection( Qt::LayoutDirection direction )
+{
+    Item item( LayoutDirection );
+    item.direction = direction;
+    m_items.append( item );
+}
+
+void XpsDisplayList::drawPath( const QPainterPath &path )
+{
+    m_lastDrawItem = m_items.count();
+    Item item( DrawPath );
+    item.path = path;
+    m_items.append( item );
+    m_cost += path.elementCount() * sizeof( QPainterPath::Element );
+}
+
+void XpsDisplayList::drawGlyphRun( const QVector<QPointF> &positions, const QString &text )
+{
+    if ( text.isEmpty() )
+        return;
+
+    m_lastDrawItem = m_items.count();
+    Item item( DrawGlyphRun );
+    item.positions = positions;
+    item.text = text;
+    m_items.append( item );
+    m_cost += positions.count() * sizeof( QPointF ) + text.length() * sizeof( QChar );
+}
+
+QFontMetrics XpsDisplayList::fontMetrics() const
+{
+    // the same resolution the pages are rendered at, see XpsPage::renderToImage()
+    QImage device( 1, 1, QImage::Format_ARGB32 );
+    device.setDotsPerMeterX( 2835 );
+    device.setDotsPerMeterY( 2835 );
+    return QFontMetrics( m_state.font, &device );
+}
+
+void XpsDisplayList::replay( QPainter *painter ) const
+{
+    QVector<Item>::const_iterator it = m_items.constBegin(), itEnd = m_items.constEnd();
+    for ( ; it != itEnd; ++it ) {
+        const Item &item = *it;
+        switch ( item.type ) {
+            case Save:
+                painter->save();
+                break;
+            case Restore:
+                painter->restore();
+                break;
+            case WorldMatrix:
+                painter->setWorldMatrix( item.matrix, item.combine );
+                break;
+            case Opacity:
+                painter->setOpacity( item.opacity );
+                break;
+            case ClipPath:
+                painter->setClipPath( item.path );
+                break;
+            case Font:
+                painter->setFont( item.font );
+                break;
+            case Brush:
+                painter->setBrush( item.brush );
+                break;
+            case Pen:
+                painter->setPen( item.pen );
+                break;
+            case LayoutDirection:
+                painter->setLayoutDirection( item.direction );
+                break;
+            case DrawPath:
+                painter->drawPath( item.path );
+                break;
+            case DrawGlyphRun:
+                for ( int i = 0; i < item.text.length(); ++i ) {
+                    painter->drawText( item.positions.at( i ), QString( item.text.at( i ) ) );
+                }
+                break;
+        }
+    }
+}
+
+int XpsDisplayList::cost() const
+{
+    return m_cost + m_items.count() * sizeof( Item );
+}
+
+void XpsDisplayList::addBrushCost( const QBrush &brush )
+{
+    if ( brush.style() != Qt::TexturePattern )
+        return;
+
+    // the same image is often used by several brushes of the page
+    const QImage texture = brush.textureImage();
+    if ( !m_textures.contains( texture.cacheKey() ) ) {
+        m_textures.insert( texture.cacheKey() );
+        m_cost += texture.byteCount();
+    }
+}
+
+
 XpsHandler::XpsHandler(XpsPage *page): m_page(page)
 {
-    m_painter = NULL;
+    m_displayList = NULL;
 }
 
 XpsHandler::~XpsHandler()
@@ -810,7 +998,7 @@ void XpsHandler::processGlyph( XpsRenderNode &node )
 
     QString att;
 
-    m_painter->save();
+    m_displayList->save();
 
     // Get font (doesn't work well because qt doesn't allow to load font from file)
     // This works despite the fact that font size isn't specified in points as required by qt. It's because I set point size to be equal to drawing unit.
@@ -818,10 +1006,10 @@ void XpsHandler::processGlyph( XpsRenderNode &node )
     // kDebug(XpsDebug) << "Font Rendering EmSize:" << fontSize;
     // a value of 0.0 means the text is not visible (see XPS specs, chapter 12, "Glyphs")
     if ( fontSize < 0.1 ) {
-        m_painter->restore();
+        m_displayList->restore();
         return;
     }
-    QFont font = m_page->m_file->getFontByName( node.attributes.value("FontUri"), fontSize );
+    QFont font = m_page->m_file->getFontByName( absolutePath( entryPath( m_page->m_fileName ), node.attributes.value("FontUri") ), fontSize );
     att = node.attributes.value( "StyleSimulations" );
     if  ( !att.isEmpty() ) {
         if ( att == QLatin1String( "ItalicSimulation" ) ) {
@@ -833,7 +1021,7 @@ void XpsHandler::processGlyph( XpsRenderNode &node )
             font.setBold( true );
         }
     }
-    m_painter->setFont(font);
+    m_displayList->setFont(font);
 
     //Origin
     QPointF origin( node.attributes.value("OriginX").toDouble(), node.attributes.value("OriginY").toDouble() );
@@ -848,19 +1036,19 @@ void XpsHandler::processGlyph( XpsRenderNode &node )
         } else {
             // no "Fill" attribute and no "Glyphs.Fill" child, so show nothing
             // (see XPS specs, 5.10)
-            m_painter->restore();
+            m_displayList->restore();
             return;
         }
     } else {
         brush = parseRscRefColorForBrush( att );
         if ( brush.style() > Qt::NoBrush && brush.style() < Qt::LinearGradientPattern
              && brush.color().alpha() == 0 ) {
-            m_painter->restore();
+            m_displayList->restore();
             return;
         }
     }
-    m_painter->setBrush( brush );
-    m_painter->setPen( QPen( brush, 0 ) );
+    m_displayList->setBrush( brush );
+    m_displayList->setPen( QPen( brush, 0 ) );
 
     // Opacity
     att = node.attributes.value("Opacity");
@@ -868,9 +1056,9 @@ void XpsHandler::processGlyph( XpsRenderNode &node )
         bool ok = true;
         double value = att.toDouble( &ok );
         if ( ok && value >= 0.1 ) {
-            m_painter->setOpacity( value );
+            m_displayList->setOpacity( value );
         } else {
-            m_painter->restore();
+            m_displayList->restore();
             return;
         }
     }
@@ -878,7 +1066,7 @@ void XpsHandler::processGlyph( XpsRenderNode &node )
     //RenderTransform
     att = node.attributes.value("RenderTransform");
     if (!att.isEmpty()) {
-        m_painter->setWorldMatrix( parseRscRefMatrix( att ), true);
+        m_displayList->setWorldMatrix( parseRscRefMatrix( att ), true);
     }
 
     // Clip
@@ -886,17 +1074,17 @@ void XpsHandler::processGlyph( XpsRenderNode &node )
     if ( !att.isEmpty() ) {
         QPainterPath clipPath = parseRscRefPath( att );
         if ( !clipPath.isEmpty() ) {
-            m_painter->setClipPath( clipPath );
+            m_displayList->setClipPath( clipPath );
         }
     }
 
     // BiDiLevel - default Left-to-Right
-    m_painter->setLayoutDirection( Qt::LeftToRight );
+    m_displayList->setLayoutDirection( Qt::LeftToRight );
     att = node.attributes.value( "BiDiLevel" );
     if ( !att.isEmpty() ) {
         if ( (att.toInt() % 2) == 1 ) {
             // odd BiDiLevel, so Right-to-Left
-            m_painter->setLayoutDirection( Qt::RightToLeft );
+            m_displayList->setLayoutDirection( Qt::RightToLeft );
         }
     }
 
@@ -931,10 +1119,11 @@ void XpsHandler::processGlyph( XpsRenderNode &node )
     // UnicodeString
     QString stringToDraw( unicodeString( node.attributes.value( "UnicodeString" ) ) );
     QPointF originAdvance(0, 0);
-    QFontMetrics metrics = m_painter->fontMetrics();
+    QFontMetrics metrics = m_displayList->fontMetrics();
+    QVector<QPointF> positions( stringToDraw.size() );
     for ( int i = 0; i < stringToDraw.size(); ++i ) {
         QChar thisChar = stringToDraw.at( i );
-        m_painter->drawText( origin + originAdvance, QString( thisChar ) );
+        positions[i] = origin + originAdvance;
 	const qreal advanceWidth = advanceWidths.value( i, qreal(-1.0) );
         if ( advanceWidth > 0.0 ) {
             originAdvance.rx() += advanceWidth;
@@ -942,11 +1131,12 @@ void XpsHandler::processGlyph( XpsRenderNode &node )
             originAdvance.rx() += metrics.width( thisChar );
         }
     }
+    m_displayList->drawGlyphRun( positions, stringToDraw );
     // kDebug(XpsDebug) << "Glyphs: " << atts.value("Fill") << ", " << atts.value("FontUri");
     // kDebug(XpsDebug) << "    Origin: " << atts.value("OriginX") << "," << atts.value("OriginY");
     // kDebug(XpsDebug) << "    Unicode: " << atts.value("UnicodeString");
 
-    m_painter->restore();
+    m_displayList->restore();
 }
 
 void XpsHandler::processFill( XpsRenderNode &node )
@@ -1014,7 +1204,7 @@ void XpsHandler::processPath( XpsRenderNode &node )
     //TODO Ignored attributes: Clip, OpacityMask, StrokeEndLineCap, StorkeStartLineCap, Name, FixedPage.NavigateURI, xml:lang, x:key, AutomationProperties.Name, AutomationProperties.HelpText, SnapsToDevicePixels
     //TODO Ignored child elements: RenderTransform, Clip, OpacityMask
     // Handled separately: RenderTransform
-    m_painter->save();
+    m_displayList->save();
 
     QString att;
     QVariant data;
@@ -1030,7 +1220,7 @@ void XpsHandler::processPath( XpsRenderNode &node )
     }
     if ( !pathdata ) {
         // nothing to draw
-        m_painter->restore();
+        m_displayList->restore();
         return;
     }
 
@@ -1045,7 +1235,7 @@ void XpsHandler::processPath( XpsRenderNode &node )
             brush = data.value<QBrush>();
         }
     }
-    m_painter->setBrush( brush );
+    m_displayList->setBrush( brush );
 
     // Stroke (pen)
     att = node.attributes.value( "Stroke" );
@@ -1124,31 +1314,31 @@ void XpsHandler::processPath( XpsRenderNode &node )
             pen.setMiterLimit( limit / 2 );
         }
     }
-    m_painter->setPen( pen );
+    m_displayList->setPen( pen );
 
     // Opacity
     att = node.attributes.value("Opacity");
     if (! att.isEmpty()) {
-        m_painter->setOpacity(att.toDouble());
+        m_displayList->setOpacity(att.toDouble());
     }
 
     // RenderTransform
     att = node.attributes.value( "RenderTransform" );
     if (! att.isEmpty() ) {
-        m_painter->setWorldMatrix( parseRscRefMatrix( att ), true );
+        m_displayList->setWorldMatrix( parseRscRefMatrix( att ), true );
     }
     if ( !pathdata->transform.isIdentity() ) {
-        m_painter->setWorldMatrix( pathdata->transform, true );
+        m_displayList->setWorldMatrix( pathdata->transform, true );
     }
 
     Q_FOREACH ( XpsPathFigure *figure, pathdata->paths ) {
-        m_painter->setBrush( figure->isFilled ? brush : QBrush() );
-        m_painter->drawPath( figure->path );
+        m_displayList->setBrush( figure->isFilled ? brush : QBrush() );
+        m_displayList->drawPath( figure->path );
     }
 
     delete pathdata;
 
-    m_painter->restore();
+    m_displayList->restore();
 }
 
 void XpsHandler::processPathData( XpsRenderNode &node )
@@ -1288,21 +1478,24 @@ void XpsHandler::processPathFigure( XpsRenderNode &node )
 
 void XpsHandler::processStartElement( XpsRenderNode &node )
 {
-    if (node.name == "Canvas") {
-        m_painter->save();
+    if (node.name == "FixedPage") {
+        m_page->setFixedPageSize( QSizeF( node.attributes.value( "Width" ).toDouble(),
+                                          node.attributes.value( "Height" ).toDouble() ) );
+    } else if (node.name == "Canvas") {
+        m_displayList->save();
         QString att = node.attributes.value( "RenderTransform" );
         if ( !att.isEmpty() ) {
-            m_painter->setWorldMatrix( parseRscRefMatrix( att ), true );
+            m_displayList->setWorldMatrix( parseRscRefMatrix( att ), true );
         }
         att = node.attributes.value( "Opacity" );
         if ( !att.isEmpty() ) {
             double value = att.toDouble();
             if ( value > 0.0 && value <= 1.0 ) {
-                m_painter->setOpacity( m_painter->opacity() * value );
+                m_displayList->setOpacity( m_displayList->opacity() * value );
             } else {
                 // setting manually to 0 is necessary to "disable"
                 // all the stuff inside
-                m_painter->setOpacity( 0.0 );
+                m_displayList->setOpacity( 0.0 );
             }
         }
     }
@@ -1320,10 +1513,10 @@ void XpsHandler::processEndElement( XpsRenderNode &node )
     } else if ((node.name == "Canvas.RenderTransform") || (node.name == "Glyphs.RenderTransform") || (node.name == "Path.RenderTransform"))  {
         QVariant data = node.getRequiredChildData( "MatrixTransform" );
         if (data.canConvert<QMatrix>()) {
-            m_painter->setWorldMatrix( data.value<QMatrix>(), true );
+            m_displayList->setWorldMatrix( data.value<QMatrix>(), true );
         }
     } else if (node.name == "Canvas") {
-        m_painter->restore();
+        m_displayList->restore();
     } else if ((node.name == "Path.Fill") || (node.name == "Glyphs.Fill")) {
         processFill( node );
     } else if (node.name == "Path.Stroke") {
@@ -1400,14 +1593,22 @@ void XpsHandler::processEndElement( XpsRenderNode &node )
     }
 }
 
-XpsPage::XpsPage(XpsFile *file, const QString &fileName): m_file( file ),
-    m_fileName( fileName ), m_pageIsRendered(false)
+XpsPage::XpsPage(XpsFile *file, const QString &fileName, const QSizeF &size, bool sizeIsEstimated): m_file( file ),
+    m_fileName( fileName ), m_pageSize( size ), m_sizeIsRead( false ), m_sizeIsEstimated( sizeIsEstimated ),
+    m_sizeUpdated( false )
 {
-    m_pageImage = NULL;
-
     // kDebug(XpsDebug) << "page file name: " << fileName;
 
-    const KZipFileEntry* pageFile = static_cast<const KZipFileEntry *>(m_file->xpsArchive()->directory()->entry( fileName ));
+    // the part is parsed only when the page is first needed, if its size is given
+    if ( m_pageSize.isEmpty() ) {
+        m_sizeIsEstimated = false;
+        readSize();
+    }
+}
+
+void XpsPage::readSize()
+{
+    const KZipFileEntry* pageFile = static_cast<const KZipFileEntry *>(m_file->xpsArchive()->directory()->entry( m_fileName ));
 
     QXmlStreamReader xml;
     xml.addData( readFileOrDirectoryParts( pageFile ) );
@@ -1417,8 +1618,8 @@ XpsPage::XpsPage(XpsFile *file, const QString &fileName): m_file( file ),
         if ( xml.isStartElement() && ( xml.name() == "FixedPage" ) )
         {
             QXmlStreamAttributes attributes = xml.attributes();
-            m_pageSize.setWidth( attributes.value( "Width" ).toString().toDouble() );
-            m_pageSize.setHeight( attributes.value( "Height" ).toString().toDouble() );
+            setFixedPageSize( QSizeF( attributes.value( "Width" ).toString().toDouble(),
+                                      attributes.value( "Height" ).toString().toDouble() ) );
             break;
         }
     }
@@ -1428,40 +1629,79 @@ XpsPage::XpsPage(XpsFile *file, const QString &fileName): m_file( file ),
     }
 }
 
+void XpsPage::setFixedPageSize( const QSizeF &size )
+{
+    if ( m_sizeIsRead || size.isEmpty() )
+        return;
+
+    m_sizeIsRead = true;
+    // the size given at construction was wrong, or only a guess
+    if ( !m_pageSize.isEmpty() && ( m_sizeIsEstimated || size != m_pageSize ) ) {
+        m_sizeUpdated = true;
+    }
+    m_sizeIsEstimated = false;
+    m_pageSize = size;
+}
+
 XpsPage::~XpsPage()
 {
-    delete m_pageImage;
 }
 
 bool XpsPage::renderToImage( QImage *p )
 {
+    // the rendered pages are not retained: the core keeps their pixmaps, and
+    // rendering them again only replays their display list
+    // Set one point = one drawing unit. Useful for fonts, because xps specifies font size using drawing units, not points as usual
+    p->setDotsPerMeterX( 2835 );
+    p->setDotsPerMeterY( 2835 );
+    p->fill( qRgba( 255, 255, 255, 255 ) );
 
-    if ((m_pageImage == NULL) || (m_pageImage->size() != p->size())) {
-        delete m_pageImage;
-        m_pageImage = new QImage( p->size(), QImage::Format_ARGB32 );
-        // Set one point = one drawing unit. Useful for fonts, because xps specifies font size using drawing units, not points as usual
-        m_pageImage->setDotsPerMeterX( 2835 );
-        m_pageImage->setDotsPerMeterY( 2835 );
+    QPainter painter( p );
+    return renderToPainter( &painter );
+}
 
-        m_pageIsRendered = false;
-    }
-    if (! m_pageIsRendered) {
-        m_pageImage->fill( qRgba( 255, 255, 255, 255 ) );
-        QPainter painter( m_pageImage );
-        renderToPainter( &painter );
-        m_pageIsRendered = true;
+bool XpsPage::renderToImage( QImage *p, const QSize &pageSize, const QRect &rect )
+{
+    *p = QImage( rect.size(), QImage::Format_ARGB32 );
+    // Set one point = one drawing unit, see renderToImage() above
+    p->setDotsPerMeterX( 2835 );
+    p->setDotsPerMeterY( 2835 );
+    p->fill( qRgba( 255, 255, 255, 255 ) );
+
+    QPainter painter( p );
+    painter.translate( -rect.x(), -rect.y() );
+    return renderToPainter( &painter, pageSize );
+}
+
+bool XpsPage::renderToPainter( QPainter *painter )
+{
+    return renderToPainter( painter, QSize( painter->device()->width(), painter->device()->height() ) );
+}
+
+bool XpsPage::renderToPainter( QPainter *painter, const QSize &pageSize )
+{
+    // compiling the page reads its actual size, which the scale depends on
+    XpsDisplayList *displayList = m_file->displayList( this );
+    const bool compiled = !displayList;
+    if ( compiled ) {
+        displayList = compile();
     }
 
-    *p = *m_pageImage;
+    painter->setWorldMatrix(QMatrix().scale((qreal)pageSize.width() / size().width(), (qreal)pageSize.height() / size().height()), true);
+    displayList->replay( painter );
+
+    if ( compiled ) {
+        m_file->retainDisplayList( this, displayList );
+    }
 
     return true;
 }
 
-bool XpsPage::renderToPainter( QPainter *painter )
+XpsDisplayList* XpsPage::compile()
 {
+    XpsDisplayList *displayList = new XpsDisplayList;
     XpsHandler handler( this );
-    handler.m_painter = painter;
-    handler.m_painter->setWorldMatrix(QMatrix().scale((qreal)painter->device()->width() / size().width(), (qreal)painter->device()->height() / size().height()));
+    handler.m_displayList = displayList;
     QXmlSimpleReader parser;
     parser.setContentHandler( &handler );
     parser.setErrorHandler( &handler );
@@ -1472,7 +1712,7 @@ bool XpsPage::renderToPainter( QPainter *painter )
     bool ok = parser.parse( source );
     kDebug(XpsDebug) << "Parse result: " << ok;
 
-    return true;
+    return displayList;
 }
 
 QSizeF XpsPage::size() const
@@ -1480,34 +1720,59 @@ QSizeF XpsPage::size() const
     return m_pageSize;
 }
 
+bool XpsPage::isSizeEstimated() const
+{
+    return m_sizeIsEstimated;
+}
+
+bool XpsPage::takeSizeUpdate()
+{
+    const bool updated = m_sizeUpdated;
+    m_sizeUpdated = false;
+    return updated;
+}
+
 QFont XpsFile::getFontByName( const QString &fileName, float size )
 {
     // kDebug(XpsDebug) << "trying to get font: " << fileName << ", size: " << size;
 
-    int index = m_fontCache.value(fileName, -1);
-    if (index == -1)
-    {
-        index = loadFontByName(fileName);
-        m_fontCache[fileName] = index;
+    // part names are case insensitive
+    const QString key = fileName.toLower();
+    QMap<QString, XpsFontFace>::const_iterator it = m_fontCache.constFind( key );
+    if ( it == m_fontCache.constEnd() ) {
+        it = m_fontCache.insert( key, fontFaceByName( fileName ) );
+    }
+    if ( it->family.isEmpty() ) {
+        return QFont();
     }
+
+    return m_fontDatabase.font( it->family, it->style, qRound(size) );
+}
+
+XpsFile::XpsFontFace XpsFile::fontFaceByName( const QString &fileName )
+{
+    XpsFontFace face;
+
+    const int index = loadFontByName( fileName );
     if ( index == -1 ) {
         kWarning(XpsDebug) << "Requesting uknown font:" << fileName;
-        return QFont();
+        return face;
     }
 
     const QStringList fontFamilies = m_fontDatabase.applicationFontFamilies( index );
     if ( fontFamilies.isEmpty() ) {
       kWarning(XpsDebug) << "The unexpected has happened. No font family for a known font:" << fileName << index;
-      return QFont();
+      return face;
     }
     const QString fontFamily = fontFamilies[0];
     const QStringList fontStyles = m_fontDatabase.styles( fontFamily );
     if ( fontStyles.isEmpty() ) {
       kWarning(XpsDebug) << "The unexpected has happened. No font style for a known font family:" << fileName << index << fontFamily ;
-      return QFont();
+      return face;
     }
-    const QString fontStyle =  fontStyles[0];
-    return m_fontDatabase.font(fontFamily, fontStyle, qRound(size));
+    face.family = fontFamily;
+    face.style = fontStyles[0];
+    return face;
 }
 
 int XpsFile::loadFontByName( const QString &fileName )
@@ -1560,6 +1825,16 @@ KZip * XpsFile::xpsArchive() {
     return m_xpsArchive;
 }
 
+XpsDisplayList* XpsFile::displayList( const XpsPage *page )
+{
+    return m_displayLists.object( page );
+}
+
+void XpsFile::retainDisplayList( const XpsPage *page, XpsDisplayList *list )
+{
+    m_displayLists.insert( page, list, qMax( list->cost() / 1024, 1 ) );
+}
+
 QImage XpsPage::loadImageFromFile( const QString &fileName )
 {
     // kDebug(XpsDebug) << "image file name: " << fileName;
@@ -1570,8 +1845,18 @@ QImage XpsPage::loadImageFromFile( const QString &fileName )
         return QImage();
     }
 
-    QString absoluteFileName = absolutePath( entryPath( m_fileName ), fileName );
-    const KZipFileEntry* imageFile = loadFile( m_file->xpsArchive(), absoluteFileName, Qt::CaseInsensitive );
+    return m_file->loadImage( absolutePath( entryPath( m_fileName ), fileName ) );
+}
+
+QImage XpsFile::loadImage( const QString &fileName )
+{
+    // part names are case insensitive
+    const QString key = fileName.toLower();
+    if ( QImage *cached = m_imageCache.object( key ) ) {
+        return *cached;
+    }
+
+    const KZipFileEntry* imageFile = loadFile( m_xpsArchive, fileName, Qt::CaseInsensitive );
     if ( !imageFile ) {
         // image not found
         return QImage();
@@ -1581,8 +1866,9 @@ QImage XpsPage::loadImageFromFile( const QString &fileName )
         XPS standard requires to use 96dpi for images which doesn't have dpi specified (in file). When Qt loads such an image,
         it sets its dpi to qt_defaultDpi and doesn't allow to find out that it happend.
 
-        To workaround this I used this procedure: load image, set its dpi to 96, load image again. When dpi isn't set in file,
-        dpi set by me stays unchanged.
+        To workaround this the image is read into an image of its size and format, which the reader reuses, with its dpi
+        already set to 96. When dpi isn't set in file, dpi set by me stays unchanged. Size and format come from the
+        header of the file, so the image is decoded only once.
 
         Trolltech task ID: 159527.
 
@@ -1595,15 +1881,19 @@ QImage XpsPage::loadImageFromFile( const QString &fileName )
     buffer.open(QBuffer::ReadOnly);
 
     QImageReader reader(&buffer);
-    image = reader.read();
-
-    image.setDotsPerMeterX(qRound(96 / 0.0254));
-    image.setDotsPerMeterY(qRound(96 / 0.0254));
-  
-    buffer.seek(0);
-    reader.setDevice(&buffer);
+    const QSize size = reader.size();
+    const QImage::Format format = reader.imageFormat();
+    if ( size.isValid() && format != QImage::Format_Invalid ) {
+        image = QImage( size, format );
+        image.setDotsPerMeterX(qRound(96 / 0.0254));
+        image.setDotsPerMeterY(qRound(96 / 0.0254));
+    }
     reader.read(&image);
 
+    if ( !image.isNull() ) {
+        m_imageCache.insert( key, new QImage( image ), qMax( image.byteCount() / 1024, 1 ) );
+    }
+
     return image;
 }
 
@@ -1648,7 +1938,11 @@ Okular::TextPage* XpsPage::textPage()
                         || (xml.name() == "PathGeometry") || (xml.name() == "PathFigure")
                         || (xml.name() == "PolyLineSegment") ) {
                 // those are only graphical - no use in text handling
-            } else if ( (xml.name() == "FixedPage") || (xml.name() == "FixedPage.Resources") ) {
+            } else if ( xml.name() == "FixedPage" ) {
+                // the glyph areas are relative to the actual size of the page
+                setFixedPageSize( QSizeF( xml.attributes().value( "Width" ).toString().toDouble(),
+                                          xml.attributes().value( "Height" ).toString().toDouble() ) );
+            } else if ( xml.name() == "FixedPage.Resources" ) {
                 // not useful for text extraction
             } else {
                 kDebug(XpsDebug) << "Unhandled element in Text Extraction start: " << xml.name().toString();
@@ -1668,7 +1962,7 @@ Okular::TextPage* XpsPage::textPage()
                 QString text = unicodeString( glyphsAtts.value( "UnicodeString" ).toString() );
 
                 // Get font (doesn't work well because qt doesn't allow to load font from file)
-                QFont font = m_file->getFontByName( glyphsAtts.value( "FontUri" ).toString(),
+                QFont font = m_file->getFontByName( absolutePath( entryPath( m_fileName ), glyphsAtts.value( "FontUri" ).toString() ),
                                                     glyphsAtts.value("FontRenderingEmSize").toString().toFloat() * 72 / 96 );
                 QFontMetrics metrics = QFontMetrics( font );
                 // Origin
@@ -1801,9 +2095,21 @@ XpsDocument::XpsDocument(XpsFile *file, const QString &fileName): m_file(file),
         docXml.readNext();
         if ( docXml.isStartElement() ) {
             if ( docXml.name() == "PageContent" ) {
-                QString pagePath = docXml.attributes().value("Source").toString();
+                const QXmlStreamAttributes attributes = docXml.attributes();
+                QString pagePath = attributes.value("Source").toString();
                 kDebug(XpsDebug) << "Page Path: " << pagePath;
-                XpsPage *page = new XpsPage( file, absolutePath( documentFilePath, pagePath ) );
+                // the optional Width and Height hints spare reading the page part now;
+                // without them, pages are assumed as big as the previous one until read
+                const QSizeF sizeHint( attributes.value( "Width" ).toString().toDouble(),
+                                       attributes.value( "Height" ).toString().toDouble() );
+                XpsPage *page;
+                if ( !sizeHint.isEmpty() ) {
+                    page = new XpsPage( file, absolutePath( documentFilePath, pagePath ), sizeHint );
+                } else if ( !m_pages.isEmpty() ) {
+                    page = new XpsPage( file, absolutePath( documentFilePath, pagePath ), m_pages.last()->size(), true );
+                } else {
+                    page = new XpsPage( file, absolutePath( documentFilePath, pagePath ) );
+                }
                 m_pages.append(page);
             } else if ( docXml.name() == "PageContent.LinkTargets" ) {
                 // do nothing - wait for the real LinkTarget elements
@@ -1892,7 +2198,7 @@ XpsPage* XpsDocument::page(int pageNum) const
     return m_pages.at(pageNum);
 }
 
-XpsFile::XpsFile() : m_docInfo( 0 )
+XpsFile::XpsFile() : m_docInfo( 0 ), m_imageCache( ImageCacheSize ), m_displayLists( DisplayListCacheSize )
 {
 }
 
@@ -2055,6 +2361,8 @@ const Okular::DocumentInfo * XpsFile::generateDocumentInfo()
 
 bool XpsFile::closeDocument()
 {
+    m_displayLists.clear();
+    m_imageCache.clear();
 
     if ( m_docInfo )
         delete m_docInfo;
@@ -2095,6 +2403,7 @@ XpsGenerator::XpsGenerator( QObject *parent, const QVariantList &args )
     setFeature( TextExtraction );
     setFeature( PrintNative );
     setFeature( PrintToFile );
+    setFeature( TiledRendering );
     // activate the threaded rendering iif:
     // 1) QFontDatabase says so
     // 2) Qt >= 4.4.0 (see Trolltech task ID: 169502)
@@ -2126,6 +2435,7 @@ bool XpsGenerator::loadDocument( const QString & fileName, QVector<Okular::Page*
         {
             QSizeF pageSize = doc->page( pageNum )->size();
             pagesVector[pagesVectorOffset] = new Okular::Page( pagesVectorOffset, pageSize.width(), pageSize.height(), Okular::Rotation0 );
+            pagesVector[pagesVectorOffset]->setSizeKnown( !doc->page( pageNum )->isSizeEstimated() );
             ++pagesVectorOffset;
         }
     }
@@ -2146,9 +2456,17 @@ QImage XpsGenerator::image( Okular::PixmapRequest * request )
 {
     QMutexLocker lock( userMutex() );
     QSize size( (int)request->width(), (int)request->height() );
-    QImage image( size, QImage::Format_RGB32 );
     XpsPage *pageToRender = m_xpsFile->page( request->page()->number() );
+    if ( request->isTile() )
+    {
+        QImage image;
+        pageToRender->renderToImage( &image, size, request->pixelRect() );
+        checkPageSize( pageToRender, request->page()->number() );
+        return image;
+    }
+    QImage image( size, QImage::Format_RGB32 );
     pageToRender->renderToImage( &image );
+    checkPageSize( pageToRender, request->page()->number() );
     return image;
 }
 
@@ -2156,7 +2474,28 @@ Okular::TextPage* XpsGenerator::textPage( Okular::Page * page )
 {
     QMutexLocker lock( userMutex() );
     XpsPage * xpsPage = m_xpsFile->page( page->number() );
-    return xpsPage->textPage();
+    Okular::TextPage *textPage = xpsPage->textPage();
+    checkPageSize( xpsPage, page->number() );
+    return textPage;
+}
+
+void XpsGenerator::checkPageSize( XpsPage *xpsPage, int page )
+{
+    // this may run in a generation thread, while the pages are resized in
+    // the thread of the document
+    if ( xpsPage->takeSizeUpdate() )
+        QMetaObject::invokeMethod( this, "slotPageSizeRead", Qt::QueuedConnection, Q_ARG( int, page ) );
+}
+
+void XpsGenerator::slotPageSizeRead( int page )
+{
+    QMutexLocker lock( userMutex() );
+    if ( !m_xpsFile || page >= m_xpsFile->numPages() )
+        return;
+
+    const QSizeF size = m_xpsFile->page( page )->size();
+    lock.unlock();
+    updatePageSize( page, size.width(), size.height() );
 }
 
 const Okular::DocumentInfo * XpsGenerator::generateDocumentInfo()
@@ -2220,6 +2559,7 @@ bool XpsGenerator::print( QPrinter &printer )
                                                          document()->currentPage() + 1,
                                                          document()->bookmarkedPageList() );
 
+    QMutexLocker lock( userMutex() );
     QPainter painter( &printer );
 
     for ( int i = 0; i < pageList.count(); ++i )
@@ -23,10 +23,15 @@
 #include <core/generator.h>
 #include <core/textpage.h>
 
+#include <QCache>
 #include <QColor>
 #include <QDomDocument>
 #include <QFontDatabase>
+#include <QFontMetrics>
 #include <QImage>
+#include <QPainterPath>
+#include <QPen>
+#include <QSet>
 #include <QXmlStreamReader>
 #include <QXmlDefaultHandler>
 #include <QStack>
@@ -103,6 +108,88 @@ struct XpsPathGeometry
     XpsMatrixTransform transform;
 };
 
+/**
+    A page compiled into the painting operations needed to draw it, with its
+    resources (fonts, brushes, images and path geometries) already resolved.
+
+    XpsHandler records into it through the same calls it would make on a
+    QPainter; replaying it, at any scale or clip, only uses the painter.
+*/
+class XpsDisplayList
+{
+public:
+    XpsDisplayList();
+
+    void save();
+    void restore();
+    qreal opacity() const;
+    void setOpacity( qreal opacity );
+    void setWorldMatrix( const QMatrix &matrix, bool combine = false );
+    void setClipPath( const QPainterPath &path );
+    void setFont( const QFont &font );
+    void setBrush( const QBrush &brush );
+    void setPen( const QPen &pen );
+    void setLayoutDirection( Qt::LayoutDirection direction );
+    void drawPath( const QPainterPath &path );
+    /**
+       draw each character of @p text at the matching position
+    */
+    void drawGlyphRun( const QVector<QPointF> &positions, const QString &text );
+
+    /**
+       the metrics of the current font, with one point per drawing unit
+    */
+    QFontMetrics fontMetrics() const;
+
+    void replay( QPainter *painter ) const;
+
+    /**
+       the approximate memory used by the list, in bytes
+    */
+    int cost() const;
+
+private:
+    enum ItemType { Save, Restore, WorldMatrix, Opacity, ClipPath, Font, Brush, Pen,
+                    LayoutDirection, DrawPath, DrawGlyphRun };
+
+    struct Item
+    {
+        Item( ItemType t = Save )
+            : type( t ), combine( false ), opacity( 1.0 ), direction( Qt::LeftToRight )
+        {}
+
+        ItemType type;
+        bool combine;
+        qreal opacity;
+        Qt::LayoutDirection direction;
+        QMatrix matrix;
+        QPainterPath path;
+        QFont font;
+        QBrush brush;
+        QPen pen;
+        QVector<QPointF> positions;
+        QString text;
+    };
+
+    struct State
+    {
+        qreal opacity;
+        QFont font;
+        int saveItem;
+    };
+
+    void addBrushCost( const QBrush &brush );
+
+    QVector<Item> m_items;
+    int m_cost;
+
+    // recording state
+    State m_state;
+    QStack<State> m_states;
+    int m_lastDrawItem;
+    QSet<qint64> m_textures;
+};
+
 class XpsPage;
 class XpsFile;
 
@@ -137,7 +224,7 @@ protected:
     void processPathGeometry( XpsRenderNode &node );
     void processPathFigure( XpsRenderNode &node );
 
-    QPainter *m_painter;
+    XpsDisplayList *m_displayList;
 
     QImage m_image;
 
@@ -149,21 +236,48 @@ protected:
 class XpsPage
 {
 public:
-    XpsPage(XpsFile *file, const QString &fileName);
+    /**
+       \param size the size of the page, as given by its PageContent in the
+       FixedDocument or estimated; if empty, the size is read from the page
+       part right away, otherwise the part is read only when first needed
+       \param sizeIsEstimated whether \p size is only a guess
+    */
+    XpsPage(XpsFile *file, const QString &fileName, const QSizeF &size = QSizeF(), bool sizeIsEstimated = false);
     ~XpsPage();
 
     QSizeF size() const;
+
+    /**
+       whether the size of the page is only a guess, not read yet from the
+       page part
+    */
+    bool isSizeEstimated() const;
+
+    /**
+       whether reading the page part changed the size the page was created
+       with (or confirmed an estimated one) since the last call
+    */
+    bool takeSizeUpdate();
     bool renderToImage( QImage *p );
+    bool renderToImage( QImage *p, const QSize &pageSize, const QRect &rect );
     bool renderToPainter( QPainter *painter );
+    bool renderToPainter( QPainter *painter, const QSize &pageSize );
     Okular::TextPage* textPage();
 
     QImage loadImageFromFile( const QString &filename );
 
 private:
+    XpsDisplayList* compile();
+    void readSize();
+    void setFixedPageSize( const QSizeF &size );
+
     XpsFile *m_file;
     const QString m_fileName;
 
     QSizeF m_pageSize;
+    bool m_sizeIsRead;
+    bool m_sizeIsEstimated;
+    bool m_sizeUpdated;
 
 
     QString m_thumbnailFileName;
@@ -171,9 +285,6 @@ private:
     QImage m_thumbnail;
     bool m_thumbnailIsLoaded;
 
-    QImage *m_pageImage;
-    bool m_pageIsRendered;
-
     friend class XpsHandler;
     friend class XpsTextExtractionHandler;
 };
@@ -270,12 +381,41 @@ public:
     */
     XpsDocument* document(int documentNum) const;
 
+    /**
+       the font in the part \p fontName (an absolute part name), with the
+       given \p size; each font part is read and deobfuscated only once
+    */
     QFont getFontByName( const QString &fontName, float size );
 
+    /**
+       the image in the part \p fileName (an absolute part name); the
+       decoded images are shared by all the pages, as long as the memory cap
+       allows
+    */
+    QImage loadImage( const QString &fileName );
+
     KZip* xpsArchive();
 
+    /**
+       the display list of \p page, if it is still retained
+    */
+    XpsDisplayList* displayList( const XpsPage *page );
+
+    /**
+       retain the display list of \p page, as long as the memory cap allows;
+       the file takes the ownership of \p list, deleting it right away if it
+       is too big to be retained
+    */
+    void retainDisplayList( const XpsPage *page, XpsDisplayList *list );
 
 private:
+    struct XpsFontFace
+    {
+        QString family;
+        QString style;
+    };
+
+    XpsFontFace fontFaceByName( const QString &fontName );
     int loadFontByName( const QString &fontName );
 
     QList<XpsDocument*> m_documents;
@@ -293,8 +433,12 @@ private:
 
     KZip * m_xpsArchive;
 
-    QMap<QString, int> m_fontCache;
+    // the font faces and the decoded images, by lowercase part name
+    QMap<QString, XpsFontFace> m_fontCache;
     QFontDatabase m_fontDatabase;
+    QCache<QString, QImage> m_imageCache;
+
+    QCache<const XpsPage*, XpsDisplayList> m_displayLists;
 };
 
 
@@ -320,7 +464,12 @@ class XpsGenerator : public Okular::Generator
         QImage image( Okular::PixmapRequest *page );
         Okular::TextPage* textPage( Okular::Page * page );
 
+    private slots:
+        void slotPageSizeRead( int page );
+
     private:
+        void checkPageSize( XpsPage *xpsPage, int page );
+
         XpsFile *m_xpsFile;
 };
 
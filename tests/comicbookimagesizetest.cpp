@@ -0,0 +1,141 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include <qtest_kde.h>
+#include <qbuffer.h>
+#include <qimage.h>
+
+#include "../generators/comicbook/imagesize.h"
+
+class ComicBookImageSizeTest : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void testHeader_data();
+        void testHeader();
+        void testEncodedImages_data();
+        void testEncodedImages();
+
+    private:
+        static QByteArray png( int width, int height );
+        static QByteArray jpeg( int width, int height, uchar frameMarker, bool tablesFirst );
+        static QByteArray gif( int width, int height );
+};
+
+QByteArray ComicBookImageSizeTest::png( int width, int height )
+{
+    QByteArray data( "\x89PNG\r\n\x1A\n", 8 );
+    data += QByteArray( "\x00\x00\x00\x0D", 4 ) + "IHDR";
+    for ( int shift = 24; shift >= 0; shift -= 8 )
+        data += (char)( ( width >> shift ) & 0xFF );
+    for ( int shift = 24; shift >= 0; shift -= 8 )
+        data += (char)( ( height >> shift ) & 0xFF );
+    // bit depth, color type, compression, filter, interlace, CRC
+    data += QByteArray( "\x08\x02\x00\x00\x00", 5 ) + QByteArray( 4, '\0' );
+    return data;
+}
+
+QByteArray ComicBookImageSizeTest::jpeg( int width, int height, uchar frameMarker, bool tablesFirst )
+{
+    QByteArray data( "\xFF\xD8", 2 );
+    // a JFIF APP0 segment
+    data += QByteArray( "\xFF\xE0\x00\x10JFIF\x00\x01\x01\x00\x00\x01\x00\x01\x00\x00", 18 );
+    if ( tablesFirst )
+    {
+        // a quantization and a Huffman table segment, with fill bytes between
+        data += QByteArray( "\xFF\xDB\x00\x43", 4 ) + QByteArray( 65, '\x01' );
+        data += QByteArray( "\xFF\xFF\xC4\x00\x05\x00\x00\x00", 8 );
+    }
+    // the frame header: length, precision, height, width, components
+    data += (char)0xFF;
+    data += (char)frameMarker;
+    data += QByteArray( "\x00\x11\x08", 3 );
+    data += (char)( height >> 8 );
+    data += (char)( height & 0xFF );
+    data += (char)( width >> 8 );
+    data += (char)( width & 0xFF );
+    data += QByteArray( "\x03\x01\x22\x00\x02\x11\x01\x03\x11\x01", 10 );
+    return data;
+}
+
+QByteArray ComicBookImageSizeTest::gif( int width, int height )
+{
+    QByteArray data( "GIF89a" );
+    data += (char)( width & 0xFF );
+    data += (char)( width >> 8 );
+    data += (char)( height & 0xFF );
+    data += (char)( height >> 8 );
+    // flags, background color, aspect ratio
+    data += QByteArray( "\xF7\x00\x00", 3 );
+    return data;
+}
+
+void ComicBookImageSizeTest::testHeader_data()
+{
+    QTest::addColumn< QByteArray >( "header" );
+    QTest::addColumn< QByteArray >( "format" );
+    QTest::addColumn< QSize >( "size" );
+
+    QTest::newRow( "png" ) << png( 1200, 1800 ) << QByteArray( "png" ) << QSize( 1200, 1800 );
+    QTest::newRow( "png, truncated" ) << png( 1200, 1800 ).left( 20 ) << QByteArray( "png" ) << QSize();
+    QTest::newRow( "png, empty" ) << png( 0, 1800 ) << QByteArray( "png" ) << QSize();
+    QTest::newRow( "png, too big" ) << png( 0x1000000, 10 ) << QByteArray( "png" ) << QSize();
+    QTest::newRow( "jpeg, baseline" ) << jpeg( 1654, 2338, 0xC0, false ) << QByteArray( "jpeg" ) << QSize( 1654, 2338 );
+    QTest::newRow( "jpeg, progressive" ) << jpeg( 800, 600, 0xC2, false ) << QByteArray( "jpeg" ) << QSize( 800, 600 );
+    QTest::newRow( "jpeg, tables first" ) << jpeg( 3000, 4000, 0xC0, true ) << QByteArray( "jpeg" ) << QSize( 3000, 4000 );
+    QTest::newRow( "jpeg, truncated" ) << jpeg( 3000, 4000, 0xC0, true ).left( 90 ) << QByteArray( "jpeg" ) << QSize();
+    QTest::newRow( "jpeg, scan first" ) << QByteArray( "\xFF\xD8\xFF\xDA\x00\x08", 6 ) << QByteArray( "jpeg" ) << QSize();
+    QTest::newRow( "gif" ) << gif( 640, 480 ) << QByteArray( "gif" ) << QSize( 640, 480 );
+    QTest::newRow( "gif, truncated" ) << gif( 640, 480 ).left( 8 ) << QByteArray( "gif" ) << QSize();
+    QTest::newRow( "unknown" ) << QByteArray( "BM\x36\x00\x00\x00\x00\x00\x00\x00", 10 ) << QByteArray() << QSize();
+    QTest::newRow( "empty" ) << QByteArray() << QByteArray() << QSize();
+}
+
+void ComicBookImageSizeTest::testHeader()
+{
+    QFETCH( QByteArray, header );
+    QFETCH( QByteArray, format );
+    QFETCH( QSize, size );
+
+    QByteArray detectedFormat( "none" );
+    QCOMPARE( ComicBook::imageSizeFromHeader( header, &detectedFormat ), size );
+    QCOMPARE( detectedFormat, format );
+}
+
+void ComicBookImageSizeTest::testEncodedImages_data()
+{
+    QTest::addColumn< QByteArray >( "format" );
+    QTest::addColumn< QSize >( "size" );
+
+    QTest::newRow( "png" ) << QByteArray( "png" ) << QSize( 123, 457 );
+    QTest::newRow( "jpeg" ) << QByteArray( "jpeg" ) << QSize( 611, 97 );
+}
+
+void ComicBookImageSizeTest::testEncodedImages()
+{
+    QFETCH( QByteArray, format );
+    QFETCH( QSize, size );
+
+    // the headers written by the Qt encoders
+    QImage image( size, QImage::Format_RGB32 );
+    image.fill( 0xFF336699 );
+    QByteArray data;
+    QBuffer buffer( &data );
+    buffer.open( QIODevice::WriteOnly );
+    QVERIFY( image.save( &buffer, format.constData() ) );
+
+    QByteArray detectedFormat;
+    QCOMPARE( ComicBook::imageSizeFromHeader( data.left( 64 * 1024 ), &detectedFormat ), size );
+    QCOMPARE( detectedFormat, format );
+}
+
+QTEST_KDEMAIN( ComicBookImageSizeTest, GUI )
+
+#include "comicbookimagesizetest.moc"
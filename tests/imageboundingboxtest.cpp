@@ -0,0 +1,157 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include <qtest_kde.h>
+#include <qimage.h>
+
+#include "../core/area.h"
+#include "../core/utils.h"
+
+Q_DECLARE_METATYPE( QImage::Format )
+
+// an A4 page scanned at 300 DPI
+static const int ScanWidth = 2480;
+static const int ScanHeight = 3508;
+
+class ImageBoundingBoxTest : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void initTestCase();
+        void testBoundingBox_data();
+        void testBoundingBox();
+        void benchmarkPixelByPixel();
+        void benchmarkImageBoundingBox();
+
+    private:
+        // the pixel() based implementation imageBoundingBox() had before
+        static Okular::NormalizedRect pixelByPixelBoundingBox( const QImage * image );
+        // a white page with some lines of "text" inside the margins
+        static QImage makeScan( int width, int height, const QRect &text );
+
+        QImage m_scan;
+};
+
+static inline bool isWhite( QRgb argb )
+{
+    return ( argb & 0xFFFFFF ) == 0xFFFFFF;
+}
+
+Okular::NormalizedRect ImageBoundingBoxTest::pixelByPixelBoundingBox( const QImage * image )
+{
+    int width = image->width();
+    int height = image->height();
+    int left, top, bottom, right, x, y;
+
+    for ( top = 0; top < height; ++top )
+        for ( x = 0; x < width; ++x )
+            if ( !isWhite( image->pixel( x, top ) ) )
+                goto got_top;
+    return Okular::NormalizedRect( 0, 0, 0, 0 );
+got_top:
+    left = right = x;
+
+    for ( bottom = height-1; bottom >= top; --bottom )
+        for ( x = width-1; x >= 0; --x )
+            if ( !isWhite( image->pixel( x, bottom ) ) )
+                goto got_bottom;
+got_bottom:
+    if ( x < left )
+        left = x;
+    if ( x > right )
+        right = x;
+
+    for ( y = top; y <= bottom && ( left > 0 || right < width-1 ); ++y )
+    {
+        for ( x = 0; x < left; ++x )
+            if ( !isWhite( image->pixel( x, y ) ) )
+                left = x;
+        for ( x = width-1; x > right; --x )
+            if ( !isWhite( image->pixel( x, y ) ) )
+                right = x;
+    }
+
+    return Okular::NormalizedRect( QRect( left, top, ( right - left + 1), ( bottom - top + 1 ) ),
+                                   image->width(), image->height() );
+}
+
+QImage ImageBoundingBoxTest::makeScan( int width, int height, const QRect &text )
+{
+    QImage scan( width, height, QImage::Format_RGB32 );
+    scan.fill( 0xFFFFFFFF );
+    qsrand( 1 );
+    // lines of 30 pixels, 2/3 of which are "glyphs" of random dark pixels
+    for ( int y = text.top(); y <= text.bottom(); ++y )
+    {
+        if ( ( y - text.top() ) % 30 >= 20 )
+            continue;
+        QRgb * row = reinterpret_cast< QRgb * >( scan.scanLine( y ) );
+        for ( int x = text.left(); x <= text.right(); ++x )
+            if ( qrand() % 4 == 0 )
+                row[x] = qRgb( qrand() % 128, qrand() % 128, qrand() % 128 );
+    }
+    return scan;
+}
+
+void ImageBoundingBoxTest::initTestCase()
+{
+    m_scan = makeScan( ScanWidth, ScanHeight, QRect( 300, 350, ScanWidth - 600, ScanHeight - 700 ) );
+}
+
+void ImageBoundingBoxTest::testBoundingBox_data()
+{
+    QTest::addColumn< QImage::Format >( "format" );
+    QTest::addColumn< QRect >( "text" );
+
+    const QImage::Format formats[] = { QImage::Format_RGB32, QImage::Format_ARGB32, QImage::Format_ARGB32_Premultiplied,
+                                       QImage::Format_Indexed8, QImage::Format_Mono, QImage::Format_RGB888 };
+    const char * const formatNames[] = { "RGB32", "ARGB32", "ARGB32_Premultiplied", "Indexed8", "Mono", "RGB888" };
+    for ( int i = 0; i < 6; ++i )
+    {
+        QTest::newRow( QByteArray( formatNames[i] ).append( " text" ).constData() ) << formats[i] << QRect( 31, 17, 170, 94 );
+        QTest::newRow( QByteArray( formatNames[i] ).append( " full page" ).constData() ) << formats[i] << QRect( 0, 0, 257, 150 );
+        QTest::newRow( QByteArray( formatNames[i] ).append( " one row" ).constData() ) << formats[i] << QRect( 64, 70, 100, 1 );
+        QTest::newRow( QByteArray( formatNames[i] ).append( " blank" ).constData() ) << formats[i] << QRect();
+    }
+}
+
+void ImageBoundingBoxTest::testBoundingBox()
+{
+    QFETCH( QImage::Format, format );
+    QFETCH( QRect, text );
+
+    const QImage image = makeScan( 257, 150, text ).convertToFormat( format );
+    const Okular::NormalizedRect expected = pixelByPixelBoundingBox( &image );
+    QCOMPARE( Okular::Utils::imageBoundingBox( &image ), expected );
+}
+
+void ImageBoundingBoxTest::benchmarkPixelByPixel()
+{
+    Okular::NormalizedRect bbox;
+    QBENCHMARK
+    {
+        bbox = pixelByPixelBoundingBox( &m_scan );
+    }
+    QVERIFY( !bbox.isNull() );
+}
+
+void ImageBoundingBoxTest::benchmarkImageBoundingBox()
+{
+    Okular::NormalizedRect bbox;
+    QBENCHMARK
+    {
+        bbox = Okular::Utils::imageBoundingBox( &m_scan );
+    }
+    QCOMPARE( bbox, pixelByPixelBoundingBox( &m_scan ) );
+}
+
+QTEST_KDEMAIN_CORE( ImageBoundingBoxTest )
+
+#include "imageboundingboxtest.moc"
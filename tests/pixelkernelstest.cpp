@@ -0,0 +1,167 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include <qtest_kde.h>
+#include <qelapsedtimer.h>
+#include <qvector.h>
+
+#include "../ui/pixelkernels.h"
+
+Q_DECLARE_METATYPE( PixelKernels::Implementation )
+
+enum Kernel { ChangeAlpha, Colorize, Multiply, MultiplyBlackAsWhite, BlackWhite };
+Q_DECLARE_METATYPE( Kernel )
+
+static const char * const KernelNames[] = { "changeAlpha", "colorize", "multiply", "multiply (black as white)", "blackWhite" };
+static const char * const ImplementationNames[] = { "Scalar", "SSE2", "AVX2", "NEON" };
+
+class PixelKernelsTest : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void testEquivalence_data();
+        void testEquivalence();
+        void benchmarkKernels_data();
+        void benchmarkKernels();
+
+    private:
+        static void addRows();
+        static QVector< unsigned int > randomPixels( int count );
+        static void run( Kernel kernel, QVector< unsigned int > &pixels, int seed );
+};
+
+void PixelKernelsTest::addRows()
+{
+    QTest::addColumn< PixelKernels::Implementation >( "implementation" );
+    QTest::addColumn< Kernel >( "kernel" );
+
+    for ( int i = PixelKernels::Scalar; i <= PixelKernels::NEON; ++i )
+    {
+        const PixelKernels::Implementation implementation = (PixelKernels::Implementation)i;
+        if ( !PixelKernels::isAvailable( implementation ) )
+            continue;
+
+        for ( int k = ChangeAlpha; k <= BlackWhite; ++k )
+        {
+            const QByteArray name = QByteArray( ImplementationNames[i] ) + ' ' + KernelNames[k];
+            QTest::newRow( name.constData() ) << implementation << (Kernel)k;
+        }
+    }
+}
+
+QVector< unsigned int > PixelKernelsTest::randomPixels( int count )
+{
+    QVector< unsigned int > pixels( count );
+    for ( int i = 0; i < count; ++i )
+    {
+        unsigned int pixel = ( qrand() & 0xffff ) | ( ( qrand() & 0xffff ) << 16 );
+        // plenty of opaque and of black pixels, which are handled specially
+        if ( i % 5 == 0 )
+            pixel |= 0xff000000;
+        if ( i % 7 == 0 )
+            pixel &= 0xff000000;
+        pixels[i] = pixel;
+    }
+    return pixels;
+}
+
+void PixelKernelsTest::run( Kernel kernel, QVector< unsigned int > &pixels, int seed )
+{
+    // the parameters cover the limit values too
+    const int red = seed * 37 % 256, green = seed * 101 % 256, blue = seed * 173 % 256;
+    const unsigned int alpha = seed % 3 == 0 ? 255 : seed * 59 % 256;
+    switch ( kernel )
+    {
+        case ChangeAlpha:
+            PixelKernels::changeAlpha( pixels.data(), pixels.count(), alpha );
+            break;
+        case Colorize:
+            PixelKernels::colorize( pixels.data(), pixels.count(), red, green, blue, alpha );
+            break;
+        case Multiply:
+            PixelKernels::multiply( pixels.data(), pixels.count(), red, green, blue, false );
+            break;
+        case MultiplyBlackAsWhite:
+            PixelKernels::multiply( pixels.data(), pixels.count(), red, green, blue, true );
+            break;
+        case BlackWhite:
+            PixelKernels::blackWhite( pixels.data(), pixels.count(), seed % 8, seed * 13 % 256 );
+            break;
+    }
+}
+
+void PixelKernelsTest::testEquivalence_data()
+{
+    addRows();
+}
+
+void PixelKernelsTest::testEquivalence()
+{
+    QFETCH( PixelKernels::Implementation, implementation );
+    QFETCH( Kernel, kernel );
+
+    qsrand( 1 );
+    for ( int seed = 0; seed < 256; ++seed )
+    {
+        // odd sizes, to exercise the scalar tails of the vector loops
+        const QVector< unsigned int > pixels = randomPixels( 1 + seed * 7 );
+
+        QVector< unsigned int > expected = pixels;
+        PixelKernels::setImplementation( PixelKernels::Scalar );
+        run( kernel, expected, seed );
+
+        QVector< unsigned int > actual = pixels;
+        PixelKernels::setImplementation( implementation );
+        QCOMPARE( PixelKernels::implementation(), implementation );
+        run( kernel, actual, seed );
+
+        for ( int i = 0; i < pixels.count(); ++i )
+        {
+            if ( actual.at( i ) != expected.at( i ) )
+            {
+                const QString message = QString( "seed %1, pixel %2: %3 turned into %4 instead of %5" )
+                                        .arg( seed ).arg( i ).arg( pixels.at( i ), 8, 16, QChar( '0' ) )
+                                        .arg( actual.at( i ), 8, 16, QChar( '0' ) ).arg( expected.at( i ), 8, 16, QChar( '0' ) );
+                QFAIL( qPrintable( message ) );
+            }
+        }
+    }
+}
+
+void PixelKernelsTest::benchmarkKernels_data()
+{
+    addRows();
+}
+
+void PixelKernelsTest::benchmarkKernels()
+{
+    QFETCH( PixelKernels::Implementation, implementation );
+    QFETCH( Kernel, kernel );
+
+    // about a page rendered at full HD
+    static const int Pixels = 1200 * 1600;
+    static const int Runs = 20;
+    qsrand( 1 );
+    QVector< unsigned int > pixels = randomPixels( Pixels );
+    PixelKernels::setImplementation( implementation );
+
+    QElapsedTimer timer;
+    timer.start();
+    for ( int i = 0; i < Runs; ++i )
+        run( kernel, pixels, i );
+    const qint64 elapsed = qMax( timer.nsecsElapsed(), Q_INT64_C( 1 ) );
+
+    qDebug( "%s %s: %.1f megapixels per second", ImplementationNames[implementation], KernelNames[kernel],
+            double( Pixels ) * Runs * 1000.0 / elapsed );
+}
+
+QTEST_KDEMAIN_CORE( PixelKernelsTest )
+
+#include "pixelkernelstest.moc"
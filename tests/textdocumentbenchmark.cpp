@@ -0,0 +1,154 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include <qtest_kde.h>
+#include <qtextcursor.h>
+#include <qtextdocument.h>
+
+#include "../core/area.h"
+#include "../core/textdocumentgenerator_p.h"
+#include "../core/textpage.h"
+
+static const int Paragraphs = 60;
+
+static const char * const Words[] = {
+    "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit",
+    "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore", "et", "dolore", "magna"
+};
+
+class TextDocumentBenchmark : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void initTestCase();
+        void cleanupTestCase();
+        void testTextPage();
+        void benchmarkCursorPerCharacter();
+        void benchmarkLineWalk();
+
+    private:
+        // the QTextCursor based extraction the generator had before
+        static Okular::TextPage *cursorTextPage( QTextDocument *document, int page );
+        static Okular::TextPage *textPage( QTextDocument *document, int page );
+
+        QTextDocument *m_document;
+};
+
+Okular::TextPage *TextDocumentBenchmark::cursorTextPage( QTextDocument *document, int page )
+{
+    Okular::TextPage *textPage = new Okular::TextPage;
+
+    int start, end;
+    Okular::TextDocumentUtils::calculatePositions( document, page, start, end );
+
+    QTextCursor cursor( document );
+    for ( int i = start; i < end - 1; ++i ) {
+        cursor.setPosition( i );
+        cursor.setPosition( i + 1, QTextCursor::KeepAnchor );
+
+        QString text = cursor.selectedText();
+        if ( text.length() == 1 ) {
+            QRectF rect;
+            int rectPage;
+            Okular::TextDocumentUtils::calculateBoundingRect( document, i, i + 1, rect, rectPage );
+            if ( rectPage == -1 )
+                text = "\n";
+
+            textPage->append( text, new Okular::NormalizedRect( rect.left(), rect.top(), rect.right(), rect.bottom() ) );
+        }
+    }
+
+    return textPage;
+}
+
+Okular::TextPage *TextDocumentBenchmark::textPage( QTextDocument *document, int page )
+{
+    Okular::TextPage *textPage = new Okular::TextPage;
+
+    int start, end;
+    Okular::TextDocumentUtils::calculatePositions( document, page, start, end );
+    Okular::TextDocumentUtils::appendText( document, start, end - 1, textPage );
+
+    return textPage;
+}
+
+void TextDocumentBenchmark::initTestCase()
+{
+    // some pages of wrapped paragraphs, with formatted words and line breaks
+    m_document = new QTextDocument;
+    m_document->setPageSize( QSizeF( 600, 800 ) );
+
+    QTextCursor cursor( m_document );
+    QTextCharFormat bold;
+    bold.setFontWeight( QFont::Bold );
+    int word = 0;
+    for ( int paragraph = 0; paragraph < Paragraphs; ++paragraph )
+    {
+        if ( paragraph > 0 )
+            cursor.insertBlock();
+        for ( int i = 0; i < 40 + paragraph % 7 * 10; ++i, ++word )
+        {
+            const QString text = QString::fromLatin1( Words[ word % ( sizeof( Words ) / sizeof( Words[0] ) ) ] );
+            cursor.insertText( text, word % 11 == 0 ? bold : QTextCharFormat() );
+            cursor.insertText( word % 53 == 0 ? QString( QChar::LineSeparator ) : QString( QLatin1Char( ' ' ) ), QTextCharFormat() );
+        }
+    }
+
+    QVERIFY( m_document->pageCount() > 2 );
+}
+
+void TextDocumentBenchmark::cleanupTestCase()
+{
+    delete m_document;
+}
+
+void TextDocumentBenchmark::testTextPage()
+{
+    for ( int page = 0; page < m_document->pageCount(); ++page )
+    {
+        Okular::TextPage *expectedPage = cursorTextPage( m_document, page );
+        Okular::TextPage *actualPage = textPage( m_document, page );
+        const Okular::TextEntity::List expected = expectedPage->words( 0, Okular::TextPage::AnyPixelTextAreaInclusionBehaviour );
+        const Okular::TextEntity::List actual = actualPage->words( 0, Okular::TextPage::AnyPixelTextAreaInclusionBehaviour );
+
+        QCOMPARE( actual.count(), expected.count() );
+        QVERIFY( !actual.isEmpty() );
+        for ( int i = 0; i < actual.count(); ++i )
+        {
+            QCOMPARE( actual.at( i )->text(), expected.at( i )->text() );
+            QCOMPARE( *actual.at( i )->area(), *expected.at( i )->area() );
+        }
+
+        qDeleteAll( expected );
+        qDeleteAll( actual );
+        delete expectedPage;
+        delete actualPage;
+    }
+}
+
+void TextDocumentBenchmark::benchmarkCursorPerCharacter()
+{
+    QBENCHMARK
+    {
+        delete cursorTextPage( m_document, 1 );
+    }
+}
+
+void TextDocumentBenchmark::benchmarkLineWalk()
+{
+    QBENCHMARK
+    {
+        delete textPage( m_document, 1 );
+    }
+}
+
+QTEST_KDEMAIN( TextDocumentBenchmark, GUI )
+
+#include "textdocumentbenchmark.moc"
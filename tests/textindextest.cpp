@@ -0,0 +1,75 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include <qtest_kde.h>
+
+#include "../core/area.h"
+#include "../core/textindex_p.h"
+#include "../core/textpage.h"
+
+class TextIndexTest : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void testPagesContaining_data();
+        void testPagesContaining();
+
+    private:
+        static QBitArray bits( const QString &pages );
+};
+
+QBitArray TextIndexTest::bits( const QString &pages )
+{
+    QBitArray result( pages.length() );
+    for ( int i = 0; i < pages.length(); ++i )
+        result.setBit( i, pages.at( i ) == QLatin1Char( '1' ) );
+    return result;
+}
+
+void TextIndexTest::testPagesContaining_data()
+{
+    QTest::addColumn< QString >( "text" );
+    QTest::addColumn< QString >( "pages" );
+
+    QTest::newRow( "whole word" ) << "okular" << "1001";
+    QTest::newRow( "part of a word" ) << "ocum" << "0101";
+    QTest::newRow( "two words" ) << "a document" << "0101";
+    QTest::newRow( "no match" ) << "poppler" << "0001";
+    QTest::newRow( "hyphen at a line end" ) << "hyphenated" << "0011";
+    QTest::newRow( "hyphen at a line end, part" ) << "enat" << "0011";
+    QTest::newRow( "hyphen at a line end, as written" ) << "hyphen-ated" << "0011";
+    QTest::newRow( "hyphen in a line" ) << "well-known" << "0101";
+    QTest::newRow( "empty" ) << "" << "1111";
+}
+
+void TextIndexTest::testPagesContaining()
+{
+    QFETCH( QString, text );
+    QFETCH( QString, pages );
+
+    // the last page is not indexed, so it may contain anything
+    Okular::TextIndex index( QString(), 4, QByteArray() );
+    const QStringList pageTexts = QStringList()
+        << "Okular is a viewer."
+        << "It opens a well-known document."
+        << "A word can be hyphen-\nated at the end of a line.";
+    for ( int i = 0; i < pageTexts.count(); ++i )
+    {
+        Okular::TextPage textPage;
+        textPage.append( pageTexts.at( i ), new Okular::NormalizedRect( 0, 0, 1, 1 ) );
+        index.addPage( i, &textPage );
+    }
+
+    QCOMPARE( index.pagesContaining( text ), bits( pages ) );
+}
+
+QTEST_KDEMAIN( TextIndexTest, GUI )
+
+#include "textindextest.moc"
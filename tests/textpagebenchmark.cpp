@@ -0,0 +1,184 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include <qtest_kde.h>
+
+#include "../core/area.h"
+#include "../core/textpage.h"
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+static const int GlyphCount = 5000;
+static const int Columns = 80;
+static const int Rows = ( GlyphCount + Columns - 1 ) / Columns;
+
+static const char * const Words[] = {
+    "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit",
+    "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore", "et", "dolore", "magna"
+};
+
+/**
+ * Returns the bytes currently allocated on the heap, or 0 if that cannot be
+ * known on this platform.
+ */
+static qulonglong heapUsage()
+{
+#if defined(__GLIBC__)
+    const struct mallinfo info = mallinfo();
+    return info.uordblks;
+#else
+    return 0;
+#endif
+}
+
+class TextPageBenchmark : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void initTestCase();
+        void cleanupTestCase();
+        void testMemory();
+        void benchmarkFindText();
+        void benchmarkFindAllMatches();
+        void benchmarkText();
+        void benchmarkTextInArea();
+
+    private:
+        // a page of GlyphCount glyphs, one entity each, as a PDF generator does
+        static Okular::TextEntity::List makeGlyphs();
+
+        Okular::TextPage *m_textPage;
+        QString m_lastWord;
+};
+
+Okular::TextEntity::List TextPageBenchmark::makeGlyphs()
+{
+    QString text;
+    for ( int word = 0; text.length() < GlyphCount; ++word )
+    {
+        text += QString::fromLatin1( Words[ word % ( sizeof( Words ) / sizeof( Words[0] ) ) ] );
+        text += ( text.length() % Columns ) > Columns - 12 ? QLatin1Char( '\n' ) : QLatin1Char( ' ' );
+    }
+    text.truncate( GlyphCount );
+
+    Okular::TextEntity::List glyphs;
+    for ( int i = 0; i < text.length(); ++i )
+    {
+        const double left = double( i % Columns ) / Columns;
+        const double top = double( i / Columns ) / Rows;
+        glyphs.append( new Okular::TextEntity( text.mid( i, 1 ),
+            new Okular::NormalizedRect( left, top, left + 1.0 / Columns, top + 1.0 / Rows ) ) );
+    }
+    return glyphs;
+}
+
+void TextPageBenchmark::initTestCase()
+{
+    m_textPage = new Okular::TextPage( makeGlyphs() );
+
+    const QString text = m_textPage->text( 0 );
+    QCOMPARE( text.length(), GlyphCount );
+    // the text is the same all over the page, so look for the last word
+    m_lastWord = text.split( QRegExp( "\\s+" ), QString::SkipEmptyParts ).last();
+    QVERIFY( !m_lastWord.isEmpty() );
+}
+
+void TextPageBenchmark::cleanupTestCase()
+{
+    delete m_textPage;
+}
+
+void TextPageBenchmark::testMemory()
+{
+    const qulonglong before = heapUsage();
+    if ( before == 0 )
+        QSKIP( "The heap usage cannot be measured on this platform", SkipAll );
+
+    // the entities as handed by a generator, one heap allocation per glyph
+    Okular::TextEntity::List glyphs = makeGlyphs();
+    const qulonglong listUsage = heapUsage() - before;
+    qDeleteAll( glyphs );
+    glyphs.clear();
+
+    const qulonglong beforePage = heapUsage();
+    Okular::TextPage *textPage = new Okular::TextPage();
+    Okular::TextEntity::List pageGlyphs = makeGlyphs();
+    foreach ( Okular::TextEntity *glyph, pageGlyphs )
+    {
+        textPage->append( glyph->text(), new Okular::NormalizedRect( *glyph->area() ) );
+    }
+    qDeleteAll( pageGlyphs );
+    pageGlyphs.clear();
+    const qulonglong pageUsage = heapUsage() - beforePage;
+    delete textPage;
+
+    qDebug( "%d glyphs: TextEntity::List %llu bytes (%.1f per glyph), TextPage %llu bytes (%.1f per glyph)",
+            GlyphCount, listUsage, double( listUsage ) / GlyphCount,
+            pageUsage, double( pageUsage ) / GlyphCount );
+    QVERIFY( pageUsage < listUsage );
+}
+
+void TextPageBenchmark::benchmarkFindText()
+{
+    Okular::RegularAreaRect *area = 0;
+    QBENCHMARK
+    {
+        delete area;
+        area = m_textPage->findText( 1, m_lastWord, Okular::FromTop, Qt::CaseInsensitive );
+    }
+    QVERIFY( area );
+    delete area;
+}
+
+void TextPageBenchmark::benchmarkFindAllMatches()
+{
+    int matches = 0;
+    QBENCHMARK
+    {
+        matches = 0;
+        Okular::SearchDirection direction = Okular::FromTop;
+        while ( Okular::RegularAreaRect *area = m_textPage->findText( 2, QLatin1String( "dolor" ), direction, Qt::CaseSensitive ) )
+        {
+            delete area;
+            direction = Okular::NextResult;
+            ++matches;
+        }
+    }
+    QVERIFY( matches > 1 );
+}
+
+void TextPageBenchmark::benchmarkText()
+{
+    QString text;
+    QBENCHMARK
+    {
+        text = m_textPage->text( 0 );
+    }
+    QCOMPARE( text.length(), GlyphCount );
+}
+
+void TextPageBenchmark::benchmarkTextInArea()
+{
+    Okular::RegularAreaRect area;
+    area.appendShape( Okular::NormalizedRect( 0.0, 0.25, 1.0, 0.75 ) );
+    QString text;
+    QBENCHMARK
+    {
+        text = m_textPage->text( &area, Okular::TextPage::CentralPixelTextAreaInclusionBehaviour );
+    }
+    QVERIFY( !text.isEmpty() );
+    QVERIFY( text.length() < GlyphCount );
+}
+
+QTEST_KDEMAIN_CORE( TextPageBenchmark )
+
+#include "textpagebenchmark.moc"
@@ -0,0 +1,173 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include <qtest_kde.h>
+#include <ktempdir.h>
+#include <kzip.h>
+
+#include "../generators/xps/generator_xps.h"
+
+static const int Pages = 2000;
+static const int PathsPerPage = 50;
+
+class XpsLoadBenchmark : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void initTestCase();
+        void testPageSizeHints();
+        void testEstimatedPageSizes();
+        void benchmarkLoadWithHints();
+        void benchmarkLoadWithoutHints();
+
+    private:
+        // every tenth page is a landscape one
+        static QSizeF pageSize( int page );
+        static bool writeXps( const QString &fileName, bool sizeHints );
+
+        KTempDir m_dir;
+        QString m_withHints;
+        QString m_withoutHints;
+};
+
+QSizeF XpsLoadBenchmark::pageSize( int page )
+{
+    return page % 10 == 9 ? QSizeF( 1056, 816 ) : QSizeF( 816, 1056 );
+}
+
+bool XpsLoadBenchmark::writeXps( const QString &fileName, bool sizeHints )
+{
+    KZip zip( fileName );
+    if ( !zip.open( QIODevice::WriteOnly ) )
+        return false;
+
+    const QByteArray rels =
+        "<Relationships xmlns=\"http://schemas.openxmlformats.org/package/2006/relationships\">"
+        "<Relationship Type=\"http://schemas.microsoft.com/xps/2005/06/fixedrepresentation\" Target=\"/FixedDocSeq.fdseq\" Id=\"R0\"/>"
+        "</Relationships>";
+    zip.writeFile( "_rels/.rels", QString(), QString(), rels.constData(), rels.size() );
+
+    const QByteArray sequence =
+        "<FixedDocumentSequence xmlns=\"http://schemas.microsoft.com/xps/2005/06\">"
+        "<DocumentReference Source=\"/Documents/1/FixedDoc.fdoc\"/>"
+        "</FixedDocumentSequence>";
+    zip.writeFile( "FixedDocSeq.fdseq", QString(), QString(), sequence.constData(), sequence.size() );
+
+    QByteArray document = "<FixedDocument xmlns=\"http://schemas.microsoft.com/xps/2005/06\">";
+    for ( int page = 0; page < Pages; ++page )
+    {
+        const QSizeF size = pageSize( page );
+        document += "<PageContent Source=\"Pages/" + QByteArray::number( page + 1 ) + ".fpage\"";
+        if ( sizeHints )
+            document += " Width=\"" + QByteArray::number( size.width() ) + "\" Height=\"" + QByteArray::number( size.height() ) + "\"";
+        document += "/>";
+
+        QByteArray content = "<FixedPage xmlns=\"http://schemas.microsoft.com/xps/2005/06\" Width=\""
+                             + QByteArray::number( size.width() ) + "\" Height=\"" + QByteArray::number( size.height() ) + "\">";
+        for ( int path = 0; path < PathsPerPage; ++path )
+        {
+            const QByteArray y = QByteArray::number( 20 + path * 15 );
+            content += "<Path Fill=\"#FF" + QByteArray::number( 0x100000 + path * 0x3301, 16 ) + "\" Data=\"M 40," + y
+                       + " L 700," + y + " L 700," + QByteArray::number( 30 + path * 15 ) + " Z\"/>";
+        }
+        content += "</FixedPage>";
+        const QString pageName = QString( "Documents/1/Pages/%1.fpage" ).arg( page + 1 );
+        zip.writeFile( pageName, QString(), QString(), content.constData(), content.size() );
+    }
+    document += "</FixedDocument>";
+    zip.writeFile( "Documents/1/FixedDoc.fdoc", QString(), QString(), document.constData(), document.size() );
+
+    return zip.close();
+}
+
+void XpsLoadBenchmark::initTestCase()
+{
+    m_withHints = m_dir.name() + "hints.xps";
+    m_withoutHints = m_dir.name() + "nohints.xps";
+    QVERIFY( writeXps( m_withHints, true ) );
+    QVERIFY( writeXps( m_withoutHints, false ) );
+}
+
+void XpsLoadBenchmark::testPageSizeHints()
+{
+    XpsFile file;
+    QVERIFY( file.loadDocument( m_withHints ) );
+    QCOMPARE( file.numPages(), Pages );
+
+    for ( int page = 0; page < Pages; ++page )
+    {
+        QVERIFY( !file.page( page )->isSizeEstimated() );
+        QCOMPARE( file.page( page )->size(), pageSize( page ) );
+    }
+
+    // the hints are right, reading the page does not change its size
+    QImage image( 408, 528, QImage::Format_RGB32 );
+    QVERIFY( file.page( 0 )->renderToImage( &image ) );
+    QVERIFY( !file.page( 0 )->takeSizeUpdate() );
+
+    file.closeDocument();
+}
+
+void XpsLoadBenchmark::testEstimatedPageSizes()
+{
+    XpsFile file;
+    QVERIFY( file.loadDocument( m_withoutHints ) );
+    QCOMPARE( file.numPages(), Pages );
+
+    // the first page is read, the other ones are assumed as big as it
+    XpsPage *first = file.page( 0 );
+    QVERIFY( !first->isSizeEstimated() );
+    QCOMPARE( first->size(), pageSize( 0 ) );
+
+    XpsPage *landscape = file.page( 9 );
+    QVERIFY( landscape->isSizeEstimated() );
+    QCOMPARE( landscape->size(), pageSize( 0 ) );
+
+    // rendering the page reads its actual size
+    QImage image( 408, 528, QImage::Format_RGB32 );
+    QVERIFY( landscape->renderToImage( &image ) );
+    QVERIFY( !landscape->isSizeEstimated() );
+    QCOMPARE( landscape->size(), pageSize( 9 ) );
+    QVERIFY( landscape->takeSizeUpdate() );
+    QVERIFY( !landscape->takeSizeUpdate() );
+
+    // an estimate which turns out right is reported too, to confirm it
+    Okular::TextPage *textPage = file.page( 1 )->textPage();
+    delete textPage;
+    QVERIFY( !file.page( 1 )->isSizeEstimated() );
+    QCOMPARE( file.page( 1 )->size(), pageSize( 1 ) );
+    QVERIFY( file.page( 1 )->takeSizeUpdate() );
+
+    file.closeDocument();
+}
+
+void XpsLoadBenchmark::benchmarkLoadWithHints()
+{
+    QBENCHMARK
+    {
+        XpsFile file;
+        file.loadDocument( m_withHints );
+        file.closeDocument();
+    }
+}
+
+void XpsLoadBenchmark::benchmarkLoadWithoutHints()
+{
+    QBENCHMARK
+    {
+        XpsFile file;
+        file.loadDocument( m_withoutHints );
+        file.closeDocument();
+    }
+}
+
+QTEST_KDEMAIN( XpsLoadBenchmark, GUI )
+
+#include "xpsloadbenchmark.moc"
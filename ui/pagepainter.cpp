@@ -14,6 +14,7 @@
 #include <qpainter.h>
 #include <qpalette.h>
 #include <qpixmap.h>
+#include <qcache.h>
 #include <qvarlengtharray.h>
 #include <kiconloader.h>
 #include <kdebug.h>
@@ -26,15 +27,80 @@
 // local includes
 #include "core/area.h"
 #include "core/page.h"
+#include "core/page_p.h"
 #include "core/annotations.h"
+#include "core/tilesmanager_p.h"
 #include "core/utils.h"
 #include "guiutils.h"
+#include "pixelkernels.h"
 #include "settings.h"
 
 K_GLOBAL_STATIC_WITH_ARGS( QPixmap, busyPixmap, ( KIconLoader::global()->loadIcon("okular", KIconLoader::NoGroup, 32, KIconLoader::DefaultState, QStringList(), 0, true) ) )
 
 #define TEXTANNOTATION_ICONSIZE 24
 
+// a pixmap recolored following the accessibility settings, together with the
+// hash of the settings it was recolored with
+struct RecoloredPixmap
+{
+    QPixmap pixmap;
+    uint settingsHash;
+};
+// the recolored pixmaps, by the cache key of their original pixmap
+typedef QCache< qint64, RecoloredPixmap > RecoloredPixmapCache;
+K_GLOBAL_STATIC( RecoloredPixmapCache, recoloredPixmaps )
+
+// the recolored pixmaps cache, sized (in kilobytes) after the memory level
+static RecoloredPixmapCache * recoloredPixmapCache()
+{
+    int size = 64 * 1024;
+    switch ( Okular::Settings::memoryLevel() )
+    {
+        case Okular::Settings::EnumMemoryLevel::Low:
+            size = 16 * 1024;
+            break;
+        case Okular::Settings::EnumMemoryLevel::Aggressive:
+            size = 256 * 1024;
+            break;
+        case Okular::Settings::EnumMemoryLevel::Greedy:
+            size = 512 * 1024;
+            break;
+        default: ;
+    }
+    if ( recoloredPixmaps->maxCost() != size )
+        recoloredPixmaps->setMaxCost( size );
+    return recoloredPixmaps;
+}
+
+// the cost (in kilobytes) of the recolored version of a pixmap
+static int recoloredPixmapCost( const QPixmap & pixmap )
+{
+    return qMax( 1, pixmap.width() * pixmap.height() / 256 );
+}
+
+static bool recolorAccessibilityEnabled()
+{
+    return Okular::Settings::changeColors() && Okular::Settings::renderMode() != Okular::Settings::EnumRenderMode::Paper;
+}
+
+static uint accessibilitySettingsHash()
+{
+    QString settings = QString::number( Okular::Settings::renderMode() );
+    switch ( Okular::Settings::renderMode() )
+    {
+        case Okular::Settings::EnumRenderMode::Recolor:
+            settings += QString( ":%1:%2" ).arg( Okular::Settings::recolorForeground().rgba() )
+                                           .arg( Okular::Settings::recolorBackground().rgba() );
+            break;
+        case Okular::Settings::EnumRenderMode::BlackWhite:
+            settings += QString( ":%1:%2" ).arg( Okular::Settings::bWContrast() )
+                                           .arg( Okular::Settings::bWThreshold() );
+            break;
+        default: ;
+    }
+    return qHash( settings );
+}
+
 inline QPen buildPen( const Okular::Annotation *ann, double width, const QColor &color )
 {
     QPen p(
@@ -65,6 +131,8 @@ void PagePainter::paintCroppedPageOnPainter( QPainter * destPainter, const Okula
 
     /** 1 - RETRIEVE THE 'PAGE+ID' PIXMAP OR A SIMILAR 'PAGE' ONE **/
     const QPixmap * pixmap = page->_o_nearestPixmap( pixID, scaledWidth, scaledHeight );
+    // huge pages may be rendered in tiles instead
+    const bool hasTiles = page->_o_hasTiles( pixID, scaledWidth, scaledHeight );
 
     QColor color = Qt::white;
     if ( Okular::Settings::changeColors() )
@@ -88,8 +156,8 @@ void PagePainter::paintCroppedPageOnPainter( QPainter * destPainter, const Okula
     /** 1B - IF NO PIXMAP, DRAW EMPTY PAGE **/
     double pixmapRescaleRatio = pixmap ? scaledWidth / (double)pixmap->width() : -1;
     long pixmapPixels = pixmap ? (long)pixmap->width() * (long)pixmap->height() : 0;
-    if ( !pixmap || pixmapRescaleRatio > 20.0 || pixmapRescaleRatio < 0.25 ||
-         (scaledWidth != pixmap->width() && pixmapPixels > 6000000L) )
+    if ( !hasTiles && ( !pixmap || pixmapRescaleRatio > 20.0 || pixmapRescaleRatio < 0.25 ||
+         (scaledWidth != pixmap->width() && pixmapPixels > 6000000L) ) )
     {
         // draw something on the blank page: the okular icon or a cross (as a fallback)
         if ( !busyPixmap->isNull() )
@@ -219,19 +287,84 @@ void PagePainter::paintCroppedPageOnPainter( QPainter * destPainter, const Okula
         // end of intersections checking
     }
 
+    /** 2B - RECOLOR THE PIXMAP FOLLOWING ACCESSIBILITY SETTINGS (ONCE, THEN CACHED) **/
+    // a pixmap too big for the cache is recolored each time, but only in the
+    // painted region
+    const bool recolorAccessibility = (flags & Accessibility) && recolorAccessibilityEnabled();
+    bool recolorRegion = false;
+    QPixmap recoloredPagePixmap;
+    if ( recolorAccessibility && pixmap )
+    {
+        if ( recoloredPixmapCost( *pixmap ) <= recoloredPixmapCache()->maxCost() )
+        {
+            recoloredPagePixmap = recoloredPixmap( *pixmap );
+            pixmap = &recoloredPagePixmap;
+        }
+        else
+        {
+            recolorRegion = true;
+        }
+    }
+
     /** 3 - ENABLE BACKBUFFERING IF DIRECT IMAGE MANIPULATION IS NEEDED **/
-    bool bufferAccessibility = (flags & Accessibility) && Okular::Settings::changeColors() && (Okular::Settings::renderMode() != Okular::Settings::EnumRenderMode::Paper);
-    bool useBackBuffer = bufferAccessibility || bufferedHighlights || bufferedAnnotations || viewPortPoint;
+    bool useBackBuffer = bufferedHighlights || bufferedAnnotations || viewPortPoint;
     QPixmap * backPixmap = 0;
     QPainter * mixedPainter = 0;
     QRect limitsInPixmap = limits.translated( crop.geometry( scaledWidth, scaledHeight ).topLeft() );
         // limits within full (scaled but uncropped) pixmap
+    bool pixmapAtScale = pixmap && pixmap->width() == scaledWidth && pixmap->height() == scaledHeight;
+
+    // for tiled pages compose the tiles covering the 'limits' rect (over a
+    // scaled pixmap of the page as placeholder for the missing ones), then
+    // go on as if a pixmap of the right size was there
+    QPixmap tilesPixmap;
+    if ( hasTiles )
+    {
+        tilesPixmap = QPixmap( limitsInPixmap.size() );
+        tilesPixmap.fill( Qt::white );
+        QPainter p( &tilesPixmap );
+        if ( pixmap )
+        {
+            QImage placeholder;
+            scalePixmapOnImage( placeholder, pixmap, scaledWidth, scaledHeight, limitsInPixmap );
+            if ( recolorRegion )
+                recolorImage( placeholder );
+            p.drawImage( 0, 0, placeholder );
+        }
+
+        const Okular::NormalizedRect limitsRect( (double)limitsInPixmap.left() / scaledWidth,
+                                                 (double)limitsInPixmap.top() / scaledHeight,
+                                                 (double)( limitsInPixmap.left() + limitsInPixmap.width() ) / scaledWidth,
+                                                 (double)( limitsInPixmap.top() + limitsInPixmap.height() ) / scaledHeight );
+        const QList< Okular::Tile > tiles = page->d->tilesAt( pixID, limitsRect );
+        QList< Okular::Tile >::const_iterator tIt = tiles.constBegin(), tEnd = tiles.constEnd();
+        for ( ; tIt != tEnd; ++tIt )
+        {
+            const Okular::Tile &tile = *tIt;
+            if ( !tile.pixmap )
+                continue;
+
+            const QRect tileLimits = tile.geometry.intersect( limitsInPixmap );
+            p.drawPixmap( tileLimits.topLeft() - limitsInPixmap.topLeft(),
+                          recolorAccessibility ? recoloredPixmap( *tile.pixmap ) : *tile.pixmap,
+                          tileLimits.translated( -tile.geometry.topLeft() ) );
+        }
+        p.end();
+
+        pixmap = &tilesPixmap;
+        limitsInPixmap = QRect( QPoint( 0, 0 ), limitsInPixmap.size() );
+        pixmapAtScale = true;
+        recolorRegion = false;
+    }
+
+    // the painted region is recolored on the image of the back buffer
+    useBackBuffer = useBackBuffer || recolorRegion;
 
     /** 4A -- REGULAR FLOW. PAINT PIXMAP NORMAL OR RESCALED USING GIVEN QPAINTER **/
     if ( !useBackBuffer )
     {
         // 4A.1. if size is ok, draw the page pixmap using painter
-        if ( pixmap->width() == scaledWidth && pixmap->height() == scaledHeight )
+        if ( pixmapAtScale )
             destPainter->drawPixmap( limits.topLeft(), *pixmap, limitsInPixmap );
 
         // else draw a scaled portion of the magnified pixmap
@@ -254,50 +387,14 @@ void PagePainter::paintCroppedPageOnPainter( QPainter * destPainter, const Okula
         bool has_alpha = pixmap->hasAlpha();
 
         // 4B.1. draw the page pixmap: normal or scaled
-        if ( pixmap->width() == scaledWidth && pixmap->height() == scaledHeight )
+        if ( pixmapAtScale )
             cropPixmapOnImage( backImage, pixmap, limitsInPixmap );
         else
             scalePixmapOnImage( backImage, pixmap, scaledWidth, scaledHeight, limitsInPixmap );
+        if ( recolorRegion )
+            recolorImage( backImage );
 
-        // 4B.2. modify pixmap following accessibility settings
-        if ( bufferAccessibility )
-        {
-            switch ( Okular::Settings::renderMode() )
-            {
-                case Okular::Settings::EnumRenderMode::Inverted:
-                    // Invert image pixels using QImage internal function
-                    backImage.invertPixels(QImage::InvertRgb);
-                    break;
-                case Okular::Settings::EnumRenderMode::Recolor:
-                    // Recolor image using Blitz::flatten with dither:0
-                    Blitz::flatten( backImage, Okular::Settings::recolorForeground(), Okular::Settings::recolorBackground() );
-                    break;
-                case Okular::Settings::EnumRenderMode::BlackWhite:
-                    // Manual Gray and Contrast
-                    unsigned int * data = (unsigned int *)backImage.bits();
-                    int val, pixels = backImage.width() * backImage.height(),
-                        con = Okular::Settings::bWContrast(), thr = 255 - Okular::Settings::bWThreshold();
-                    for( int i = 0; i < pixels; ++i )
-                    {
-                        val = qGray( data[i] );
-                        if ( val > thr )
-                            val = 128 + (127 * (val - thr)) / (255 - thr);
-                        else if ( val < thr )
-                            val = (128 * val) / thr;
-                        if ( con > 2 )
-                        {
-                            val = con * ( val - thr ) / 2 + thr;
-                            if ( val > 255 )
-                                val = 255;
-                            else if ( val < 0 )
-                                val = 0;
-                        }
-                        data[i] = qRgba( val, val, val, 255 );
-                    }
-                    break;
-            }
-        }
-        // 4B.3. highlight rects in page
+        // 4B.2. highlight rects in page
         if ( bufferedHighlights )
         {
             // draw highlights that are inside the 'limits' paint region
@@ -310,44 +407,20 @@ void PagePainter::paintCroppedPageOnPainter( QPainter * destPainter, const Okula
                 highlightRect.translate( -limits.left(), -limits.top() );
 
                 // highlight composition (product: highlight color * destcolor)
+                // for odt or epub (pixmaps with alpha) black is the page background
                 unsigned int * data = (unsigned int *)backImage.bits();
-                int val, newR, newG, newB,
-                    rh = (*hIt).first.red(),
-                    gh = (*hIt).first.green(),
-                    bh = (*hIt).first.blue(),
-                    offset = highlightRect.top() * backImage.width();
+                int offset = highlightRect.top() * backImage.width();
                 for( int y = highlightRect.top(); y <= highlightRect.bottom(); ++y )
                 {
-                    for( int x = highlightRect.left(); x <= highlightRect.right(); ++x )
-                    {
-                        val = data[ x + offset ];
-                        //for odt or epub
-                        if(has_alpha)
-                        {
-                            newR = qRed(val);
-                            newG = qGreen(val);
-                            newB = qBlue(val);
-
-                            if(newR == newG && newG == newB && newR == 0)
-                                newR = newG = newB = 255;
-
-                            newR = (newR * rh) / 255;
-                            newG = (newG * gh) / 255;
-                            newB = (newB * bh) / 255;
-                        }
-                        else
-                        {
-                            newR = (qRed(val) * rh) / 255;
-                            newG = (qGreen(val) * gh) / 255;
-                            newB = (qBlue(val) * bh) / 255;
-                        }
-                        data[ x + offset ] = qRgba( newR, newG, newB, 255 );
-                    }
+                    if ( highlightRect.width() > 0 )
+                        PixelKernels::multiply( data + offset + highlightRect.left(), highlightRect.width(),
+                                                (*hIt).first.red(), (*hIt).first.green(), (*hIt).first.blue(),
+                                                has_alpha );
                     offset += backImage.width();
                 }
             }
         }
-        // 4B.4. paint annotations [COMPOSITED ONES]
+        // 4B.3. paint annotations [COMPOSITED ONES]
         if ( bufferedAnnotations )
         {
             // Albert: This is quite "heavy" but all the backImage that reach here are QImage::Format_ARGB32_Premultiplied
@@ -563,10 +636,10 @@ void PagePainter::paintCroppedPageOnPainter( QPainter * destPainter, const Okula
 */
         }
 
-        // 4B.5. create the back pixmap converting from the local image
+        // 4B.4. create the back pixmap converting from the local image
         backPixmap = new QPixmap( QPixmap::fromImage( backImage ) );
 
-        // 4B.6. create a painter over the pixmap and set it as the active one
+        // 4B.5. create a painter over the pixmap and set it as the active one
         mixedPainter = new QPainter( backPixmap );
         mixedPainter->translate( -limits.left(), -limits.top() );
     }
@@ -766,6 +839,66 @@ void PagePainter::paintCroppedPageOnPainter( QPainter * destPainter, const Okula
 
 
 /** Private Helpers :: Pixmap conversion **/
+QPixmap PagePainter::recoloredPixmap( const QPixmap & pixmap )
+{
+    const qint64 key = pixmap.cacheKey();
+    const uint settingsHash = accessibilitySettingsHash();
+    RecoloredPixmapCache * cache = recoloredPixmapCache();
+    RecoloredPixmap * cached = cache->object( key );
+    if ( cached && cached->settingsHash == settingsHash )
+        return cached->pixmap;
+
+    QImage image = pixmap.toImage().convertToFormat( QImage::Format_ARGB32_Premultiplied );
+    recolorImage( image );
+    // keep opaque pixmaps opaque, as the highlights are composed differently on them
+    if ( !pixmap.hasAlpha() )
+        image = image.convertToFormat( QImage::Format_RGB32 );
+
+    RecoloredPixmap * recolored = new RecoloredPixmap;
+    recolored->pixmap = QPixmap::fromImage( image );
+    recolored->settingsHash = settingsHash;
+    const QPixmap result = recolored->pixmap;
+    // pixmaps too big for the cache are just not kept
+    cache->insert( key, recolored, recoloredPixmapCost( result ) );
+    return result;
+}
+
+void PagePainter::recolorPagePixmap( const Okular::Page * page, int pixID )
+{
+    if ( !recolorAccessibilityEnabled() )
+        return;
+
+    // the tiles are small, and recolored only when they are painted
+    QMap< int, Okular::PagePrivate::PixmapObject >::const_iterator it = page->d->m_pixmaps.constFind( pixID );
+    if ( it == page->d->m_pixmaps.constEnd() )
+        return;
+
+    const QPixmap & pixmap = *it.value().m_pixmap;
+    if ( recoloredPixmapCost( pixmap ) <= recoloredPixmapCache()->maxCost() )
+        recoloredPixmap( pixmap );
+}
+
+void PagePainter::recolorImage( QImage & image )
+{
+    switch ( Okular::Settings::renderMode() )
+    {
+        case Okular::Settings::EnumRenderMode::Inverted:
+            // Invert image pixels using QImage internal function
+            image.invertPixels(QImage::InvertRgb);
+            break;
+        case Okular::Settings::EnumRenderMode::Recolor:
+            // Recolor image using Blitz::flatten with dither:0
+            Blitz::flatten( image, Okular::Settings::recolorForeground(), Okular::Settings::recolorBackground() );
+            break;
+        case Okular::Settings::EnumRenderMode::BlackWhite:
+            // Manual Gray and Contrast
+            PixelKernels::blackWhite( (unsigned int *)image.bits(), image.width() * image.height(),
+                                      Okular::Settings::bWContrast(), Okular::Settings::bWThreshold() );
+            break;
+        default: ;
+    }
+}
+
 void PagePainter::cropPixmapOnImage( QImage & dest, const QPixmap * src, const QRect & r )
 {
     // handle quickly the case in which the whole pixmap has to be converted
@@ -820,64 +953,18 @@ void PagePainter::scalePixmapOnImage ( QImage & dest, const QPixmap * src,
 }
 
 /** Private Helpers :: Image Drawing **/
-// from Arthur - qt4
-inline int qt_div_255(int x) { return (x + (x>>8) + 0x80) >> 8; }
-
 void PagePainter::changeImageAlpha( QImage & image, unsigned int destAlpha )
 {
     // iterate over all pixels changing the alpha component value
-    unsigned int * data = (unsigned int *)image.bits();
-    unsigned int pixels = image.width() * image.height();
-
-    int source, sourceAlpha;
-    for( register unsigned int i = 0; i < pixels; ++i )
-    {   // optimize this loop keeping byte order into account
-        source = data[i];
-        if ( (sourceAlpha = qAlpha( source )) == 255 )
-        {
-            // use destAlpha
-            data[i] = qRgba( qRed(source), qGreen(source), qBlue(source), destAlpha );
-        }
-        else
-        {
-            // use destAlpha * sourceAlpha product
-            sourceAlpha = qt_div_255( destAlpha * sourceAlpha );
-            data[i] = qRgba( qRed(source), qGreen(source), qBlue(source), sourceAlpha );
-        }
-    }
+    PixelKernels::changeAlpha( (unsigned int *)image.bits(), image.width() * image.height(), destAlpha );
 }
 
 void PagePainter::colorizeImage( QImage & grayImage, const QColor & color,
     unsigned int destAlpha )
 {
-    // iterate over all pixels changing the alpha component value
-    unsigned int * data = (unsigned int *)grayImage.bits();
-    unsigned int pixels = grayImage.width() * grayImage.height();
-    int red = color.red(),
-        green = color.green(),
-        blue = color.blue();
-
-    int source, sourceSat, sourceAlpha;
-    for( register unsigned int i = 0; i < pixels; ++i )
-    {   // optimize this loop keeping byte order into account
-        source = data[i];
-        sourceSat = qRed( source );
-        int newR = qt_div_255( sourceSat * red ),
-            newG = qt_div_255( sourceSat * green ),
-            newB = qt_div_255( sourceSat * blue );
-        if ( (sourceAlpha = qAlpha( source )) == 255 )
-        {
-            // use destAlpha
-            data[i] = qRgba( newR, newG, newB, destAlpha );
-        }
-        else
-        {
-            // use destAlpha * sourceAlpha product
-            if ( destAlpha < 255 )
-                sourceAlpha = qt_div_255( destAlpha * sourceAlpha );
-            data[i] = qRgba( newR, newG, newB, sourceAlpha );
-        }
-    }
+    // iterate over all pixels changing the color and the alpha component value
+    PixelKernels::colorize( (unsigned int *)grayImage.bits(), grayImage.width() * grayImage.height(),
+                            color.red(), color.green(), color.blue(), destAlpha );
 }
 
 void PagePainter::drawShapeOnImage(
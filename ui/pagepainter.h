@@ -51,7 +51,19 @@ class PagePainter
             int flags, int scaledWidth, int scaledHeight, const QRect & pageLimits,
             const Okular::NormalizedRect & crop, Okular::NormalizedPoint *viewPortPoint );
 
+        // recolor the pixmap of the 'page' for 'pixID' following the accessibility
+        // settings, if needed, so it is ready when the page gets painted; to be
+        // called as soon as the pixmap arrives
+        static void recolorPagePixmap( const Okular::Page * page, int pixID );
+
     private:
+        // return 'pixmap' recolored following the accessibility settings; the
+        // result is cached per pixmap and settings, so it is computed only once
+        static QPixmap recoloredPixmap( const QPixmap & pixmap );
+
+        // recolor an ARGB32_Premultiplied image following the accessibility settings
+        static void recolorImage( QImage & image );
+
         static void cropPixmapOnImage( QImage & dest, const QPixmap * src, const QRect & r );
 
         // create an image taking the 'cropRect' portion of an image scaled
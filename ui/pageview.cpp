@@ -82,6 +82,11 @@ static int pageflags = PagePainter::Accessibility | PagePainter::EnhanceLinks |
                        PagePainter::EnhanceImages | PagePainter::Highlights |
                        PagePainter::TextSelection | PagePainter::Annotations;
 
+// pages bigger than this (in pixels) are requested in tiles, if possible
+#define PAGEVIEW_TILES_THRESHOLD 8000000L
+// pixels around the visible area of a tiled page to render in advance
+#define PAGEVIEW_TILES_MARGIN 256
+
 static inline double normClamp( double value, double def )
 {
     return ( value < 0.0 || value > 1.0 ) ? def : value;
@@ -109,6 +114,8 @@ public:
     FormWidgetsController* formWidgetsController();
     OkularTTS* tts();
     QString selectedText() const;
+    bool useTiles( const PageViewItem * item ) const;
+    Okular::PixmapRequest * pixmapRequest( const PageViewItem * item, const Okular::NormalizedRect & area, int priority ) const;
 
     // the document, pageviewItems and the 'visible cache'
     PageView *q;
@@ -226,6 +233,40 @@ FormWidgetsController* PageViewPrivate::formWidgetsController()
     return formsWidgetController;
 }
 
+bool PageViewPrivate::useTiles( const PageViewItem * item ) const
+{
+    return document->supportsTiles() && document->rotation() == Okular::Rotation0 &&
+           (long)item->uncroppedWidth() * (long)item->uncroppedHeight() > PAGEVIEW_TILES_THRESHOLD;
+}
+
+Okular::PixmapRequest * PageViewPrivate::pixmapRequest( const PageViewItem * item, const Okular::NormalizedRect & area, int priority ) const
+{
+    const int width = item->uncroppedWidth(),
+              height = item->uncroppedHeight();
+
+    // huge pages: ask only for the tiles around the requested area
+    if ( useTiles( item ) )
+    {
+        const double marginX = (double)PAGEVIEW_TILES_MARGIN / width,
+                     marginY = (double)PAGEVIEW_TILES_MARGIN / height;
+        const Okular::NormalizedRect tilesArea = Okular::NormalizedRect( area.left - marginX, area.top - marginY,
+                                                                         area.right + marginX, area.bottom + marginY )
+                                                 & Okular::NormalizedRect( 0., 0., 1., 1. );
+        if ( item->page()->hasPixmap( PAGEVIEW_ID, width, height, tilesArea ) )
+            return 0;
+
+        Okular::PixmapRequest * p = new Okular::PixmapRequest( PAGEVIEW_ID, item->pageNumber(), width, height, priority, true );
+        p->setTile( true );
+        p->setNormalizedRect( tilesArea );
+        return p;
+    }
+
+    if ( item->page()->hasPixmap( PAGEVIEW_ID, width, height ) )
+        return 0;
+
+    return new Okular::PixmapRequest( PAGEVIEW_ID, item->pageNumber(), width, height, priority, true );
+}
+
 OkularTTS* PageViewPrivate::tts()
 {
     if ( !m_tts )
@@ -1163,10 +1204,13 @@ void PageView::notifyPageChanged( int pageNumber, int changedFlags )
 #ifdef PAGEVIEW_DEBUG
         kDebug() << "BoundingBox change on page" << pageNumber;
 #endif
-        slotRelayoutPages();
-        slotRequestVisiblePixmaps(); // TODO: slotRelayoutPages() may have done this already!
-        // Repaint the whole widget since layout may have changed
-        viewport()->update();
+        // the layout depends on the bounding boxes only when trimming margins
+        if ( !Okular::Settings::trimMargins() )
+            return;
+        // the bounding boxes of all the pages may be computed in background
+        // right after loading: relayout once for each bunch of them
+        if ( !d->delayResizeEventTimer->isActive() )
+            d->delayResizeEventTimer->start( 100 );
         return;
     }
 
@@ -1175,6 +1219,9 @@ void PageView::notifyPageChanged( int pageNumber, int changedFlags )
     for ( ; iIt != iEnd; ++iIt )
         if ( (*iIt)->pageNumber() == pageNumber && (*iIt)->isVisible() )
         {
+            if ( changedFlags & DocumentObserver::Pixmap )
+                PagePainter::recolorPagePixmap( (*iIt)->page(), PAGEVIEW_ID );
+
             // update item's rectangle plus the little outline
             QRect expandedRect = (*iIt)->croppedGeometry();
             // a PageViewItem is placed in the global page layout,
@@ -3961,15 +4008,14 @@ void PageView::slotRequestVisiblePixmaps( int newValue )
         kWarning() << "checking for pixmap for page" << i->pageNumber() << "=" << i->page()->hasPixmap( PAGEVIEW_ID, i->uncroppedWidth(), i->uncroppedHeight() );
         kWarning() << "checking for text for page" << i->pageNumber() << "=" << i->page()->hasTextPage();
 #endif
-        // if the item has not the right pixmap, add a request for it
-        // TODO: We presently request a pixmap for the full page, and then render just the crop part. This waste memory and cycles.
-        if ( !i->page()->hasPixmap( PAGEVIEW_ID, i->uncroppedWidth(), i->uncroppedHeight() ) )
+        // if the item has not the right pixmap, add a request for it;
+        // big pages get only the tiles around the visible part
+        Okular::PixmapRequest * p = d->pixmapRequest( i, vItem->rect, PAGEVIEW_PRIO );
+        if ( p )
         {
 #ifdef PAGEVIEW_DEBUG
             kWarning() << "rerequesting visible pixmaps for page" << i->pageNumber() << "!";
 #endif
-            Okular::PixmapRequest * p = new Okular::PixmapRequest(
-                    PAGEVIEW_ID, i->pageNumber(), i->uncroppedWidth(), i->uncroppedHeight(), PAGEVIEW_PRIO, true );
             requestedPixmaps.push_back( p );
         }
 
@@ -4014,10 +4060,14 @@ void PageView::slotRequestVisiblePixmaps( int newValue )
             if ( tailRequest < (int)d->items.count() )
             {
                 PageViewItem * i = d->items[ tailRequest ];
-                // request the pixmap if not already present
-                if ( !i->page()->hasPixmap( PAGEVIEW_ID, i->uncroppedWidth(), i->uncroppedHeight() ) && i->uncroppedWidth() > 0 )
-                    requestedPixmaps.push_back( new Okular::PixmapRequest(
-                                PAGEVIEW_ID, i->pageNumber(), i->uncroppedWidth(), i->uncroppedHeight(), PAGEVIEW_PRELOAD_PRIO, true ) );
+                // request the pixmap (or the top of it) if not already present
+                if ( i->uncroppedWidth() > 0 && i->uncroppedHeight() > 0 )
+                {
+                    const Okular::NormalizedRect area( 0., 0., 1., qMin( 1.0, (double)viewportRect.height() / i->uncroppedHeight() ) );
+                    Okular::PixmapRequest * p = d->pixmapRequest( i, area, PAGEVIEW_PRELOAD_PRIO );
+                    if ( p )
+                        requestedPixmaps.push_back( p );
+                }
             }
         }
 
@@ -4028,10 +4078,14 @@ void PageView::slotRequestVisiblePixmaps( int newValue )
             if ( headRequest >= 0 )
             {
                 PageViewItem * i = d->items[ headRequest ];
-                // request the pixmap if not already present
-                if ( !i->page()->hasPixmap( PAGEVIEW_ID, i->uncroppedWidth(), i->uncroppedHeight() ) && i->uncroppedWidth() > 0 )
-                    requestedPixmaps.push_back( new Okular::PixmapRequest(
-                                PAGEVIEW_ID, i->pageNumber(), i->uncroppedWidth(), i->uncroppedHeight(), PAGEVIEW_PRELOAD_PRIO, true ) );
+                // request the pixmap (or the bottom of it) if not already present
+                if ( i->uncroppedWidth() > 0 && i->uncroppedHeight() > 0 )
+                {
+                    const Okular::NormalizedRect area( 0., qMax( 0.0, 1.0 - (double)viewportRect.height() / i->uncroppedHeight() ), 1., 1. );
+                    Okular::PixmapRequest * p = d->pixmapRequest( i, area, PAGEVIEW_PRELOAD_PRIO );
+                    if ( p )
+                        requestedPixmaps.push_back( p );
+                }
             }
         }
     }
@@ -4378,6 +4432,8 @@ void PageView::slotTrimMarginsToggled( bool on )
         Okular::Settings::self()->writeConfig();
         if ( d->document->pages() > 0 )
         {
+            // let the document compute the bounding boxes, if it did not yet
+            d->document->reparseConfig();
             slotRelayoutPages();
             slotRequestVisiblePixmaps(); // TODO: slotRelayoutPages() may have done this already!
         }
@@ -4414,6 +4470,12 @@ void PageView::slotRefreshPage()
 
 void PageView::slotSpeakDocument()
 {
+    // let the text of the next pages be extracted while waiting for the first ones
+    QList< int > pages;
+    for ( int i = 0; i < d->items.count(); ++i )
+        pages.append( d->items.at( i )->pageNumber() );
+    d->document->prefetchTextPages( pages );
+
     QString text;
     QVector< PageViewItem * >::const_iterator it = d->items.constBegin(), itEnd = d->items.constEnd();
     for ( ; it < itEnd; ++it )
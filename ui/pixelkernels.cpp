@@ -0,0 +1,606 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "pixelkernels.h"
+
+#include <QtCore/QAtomicPointer>
+
+#include <kglobal.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#  if defined(__SSE2__)
+#    define OKULAR_KERNELS_SSE2
+#  endif
+// AVX2 functions are built with a target attribute, and used only if the CPU has it
+#  if ( defined(__GNUC__) && ( __GNUC__ > 4 || ( __GNUC__ == 4 && __GNUC_MINOR__ >= 9 ) ) ) || defined(__clang__)
+#    define OKULAR_KERNELS_AVX2
+#  endif
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#  define OKULAR_KERNELS_NEON
+#endif
+
+#if defined(OKULAR_KERNELS_AVX2)
+#  include <immintrin.h>
+#elif defined(OKULAR_KERNELS_SSE2)
+#  include <emmintrin.h>
+#endif
+#if defined(OKULAR_KERNELS_NEON)
+#  include <arm_neon.h>
+#endif
+
+/*
+ * All the kernels work on products of two 8 bit values, so everything fits
+ * in 16 bits; the vector implementations keep one pixel (or one component of
+ * a pixel) per 32 bit lane, which keeps them simple.
+ *
+ * Two divisions by 255 are used, the same as the original scalar loops:
+ * - a rounded one, x / 255 = ( x + ( x >> 8 ) + 0x80 ) >> 8
+ * - a truncating one, x / 255 = ( x + 1 + ( x >> 8 ) ) >> 8, exact for x <= 255 * 255
+ */
+
+/** Scalar implementation **/
+
+static inline unsigned int div255( unsigned int x )
+{
+    return ( x + ( x >> 8 ) + 0x80 ) >> 8;
+}
+
+static void changeAlphaScalar( unsigned int * data, int pixels, unsigned int alpha )
+{
+    for ( int i = 0; i < pixels; ++i )
+    {
+        const unsigned int source = data[i];
+        const unsigned int sourceAlpha = source >> 24;
+        // use alpha, or the alpha * sourceAlpha product
+        const unsigned int newAlpha = sourceAlpha == 255 ? alpha : div255( alpha * sourceAlpha );
+        data[i] = ( source & 0x00ffffff ) | ( newAlpha << 24 );
+    }
+}
+
+static void colorizeScalar( unsigned int * data, int pixels, int red, int green, int blue, unsigned int alpha )
+{
+    for ( int i = 0; i < pixels; ++i )
+    {
+        const unsigned int source = data[i];
+        const unsigned int sourceSat = ( source >> 16 ) & 0xff;
+        unsigned int sourceAlpha = source >> 24;
+        if ( sourceAlpha == 255 )
+            sourceAlpha = alpha;
+        else if ( alpha < 255 )
+            sourceAlpha = div255( alpha * sourceAlpha );
+        data[i] = ( sourceAlpha << 24 ) | ( div255( sourceSat * red ) << 16 )
+                  | ( div255( sourceSat * green ) << 8 ) | div255( sourceSat * blue );
+    }
+}
+
+static void multiplyScalar( unsigned int * data, int pixels, int red, int green, int blue, bool blackAsWhite )
+{
+    for ( int i = 0; i < pixels; ++i )
+    {
+        const unsigned int source = data[i];
+        unsigned int r = ( source >> 16 ) & 0xff,
+                     g = ( source >> 8 ) & 0xff,
+                     b = source & 0xff;
+        if ( blackAsWhite && r == 0 && g == 0 && b == 0 )
+            r = g = b = 255;
+        data[i] = 0xff000000 | ( ( r * red / 255 ) << 16 ) | ( ( g * green / 255 ) << 8 ) | ( b * blue / 255 );
+    }
+}
+
+// the black & white mapping only depends on the gray level, so it is precalculated
+static void blackWhiteTable( unsigned int * table, int contrast, int threshold )
+{
+    const int thr = 255 - threshold;
+    for ( int gray = 0; gray < 256; ++gray )
+    {
+        int val = gray;
+        if ( val > thr )
+            val = 128 + (127 * (val - thr)) / (255 - thr);
+        else if ( val < thr )
+            val = (128 * val) / thr;
+        if ( contrast > 2 )
+        {
+            val = contrast * ( val - thr ) / 2 + thr;
+            if ( val > 255 )
+                val = 255;
+            else if ( val < 0 )
+                val = 0;
+        }
+        table[gray] = 0xff000000 | ( val << 16 ) | ( val << 8 ) | val;
+    }
+}
+
+static void blackWhiteScalar( unsigned int * data, int pixels, const unsigned int * table )
+{
+    for ( int i = 0; i < pixels; ++i )
+    {
+        const unsigned int source = data[i];
+        // same as qGray()
+        const unsigned int gray = ( ( ( source >> 16 ) & 0xff ) * 11 + ( ( source >> 8 ) & 0xff ) * 16 + ( source & 0xff ) * 5 ) / 32;
+        data[i] = table[gray];
+    }
+}
+
+/** SSE2 implementation **/
+
+#if defined(OKULAR_KERNELS_SSE2)
+
+// products of values in the low 16 bits of 32 bit lanes (the high 16 bits being 0)
+static inline __m128i mul16Sse2( __m128i a, __m128i b )
+{
+    return _mm_mullo_epi16( a, b );
+}
+
+static inline __m128i div255Sse2( __m128i x )
+{
+    return _mm_srli_epi32( _mm_add_epi32( _mm_add_epi32( x, _mm_srli_epi32( x, 8 ) ), _mm_set1_epi32( 0x80 ) ), 8 );
+}
+
+static inline __m128i truncatingDiv255Sse2( __m128i x )
+{
+    return _mm_srli_epi32( _mm_add_epi32( _mm_add_epi32( x, _mm_set1_epi32( 1 ) ), _mm_srli_epi32( x, 8 ) ), 8 );
+}
+
+static void changeAlphaSse2( unsigned int * data, int pixels, unsigned int alpha )
+{
+    const __m128i alphaVector = _mm_set1_epi32( alpha );
+    const __m128i colorMask = _mm_set1_epi32( 0x00ffffff );
+    int i = 0;
+    for ( ; i + 4 <= pixels; i += 4 )
+    {
+        const __m128i source = _mm_loadu_si128( (const __m128i *)( data + i ) );
+        // alpha * 255 / 255 is alpha, so there is no need to handle opaque pixels apart
+        const __m128i newAlpha = div255Sse2( mul16Sse2( _mm_srli_epi32( source, 24 ), alphaVector ) );
+        _mm_storeu_si128( (__m128i *)( data + i ),
+                          _mm_or_si128( _mm_and_si128( source, colorMask ), _mm_slli_epi32( newAlpha, 24 ) ) );
+    }
+    changeAlphaScalar( data + i, pixels - i, alpha );
+}
+
+static void colorizeSse2( unsigned int * data, int pixels, int red, int green, int blue, unsigned int alpha )
+{
+    const __m128i redVector = _mm_set1_epi32( red ),
+                  greenVector = _mm_set1_epi32( green ),
+                  blueVector = _mm_set1_epi32( blue ),
+                  alphaVector = _mm_set1_epi32( alpha ),
+                  byteMask = _mm_set1_epi32( 0xff );
+    int i = 0;
+    for ( ; i + 4 <= pixels; i += 4 )
+    {
+        const __m128i source = _mm_loadu_si128( (const __m128i *)( data + i ) );
+        const __m128i sat = _mm_and_si128( _mm_srli_epi32( source, 16 ), byteMask );
+        const __m128i newAlpha = div255Sse2( mul16Sse2( _mm_srli_epi32( source, 24 ), alphaVector ) );
+        const __m128i r = div255Sse2( mul16Sse2( sat, redVector ) ),
+                      g = div255Sse2( mul16Sse2( sat, greenVector ) ),
+                      b = div255Sse2( mul16Sse2( sat, blueVector ) );
+        _mm_storeu_si128( (__m128i *)( data + i ),
+                          _mm_or_si128( _mm_or_si128( _mm_slli_epi32( newAlpha, 24 ), _mm_slli_epi32( r, 16 ) ),
+                                        _mm_or_si128( _mm_slli_epi32( g, 8 ), b ) ) );
+    }
+    colorizeScalar( data + i, pixels - i, red, green, blue, alpha );
+}
+
+static void multiplySse2( unsigned int * data, int pixels, int red, int green, int blue, bool blackAsWhite )
+{
+    const __m128i redVector = _mm_set1_epi32( red ),
+                  greenVector = _mm_set1_epi32( green ),
+                  blueVector = _mm_set1_epi32( blue ),
+                  byteMask = _mm_set1_epi32( 0xff ),
+                  colorMask = _mm_set1_epi32( 0x00ffffff ),
+                  opaque = _mm_set1_epi32( (int)0xff000000 );
+    int i = 0;
+    for ( ; i + 4 <= pixels; i += 4 )
+    {
+        const __m128i source = _mm_loadu_si128( (const __m128i *)( data + i ) );
+        __m128i r = _mm_and_si128( _mm_srli_epi32( source, 16 ), byteMask ),
+                g = _mm_and_si128( _mm_srli_epi32( source, 8 ), byteMask ),
+                b = _mm_and_si128( source, byteMask );
+        if ( blackAsWhite )
+        {
+            // the components of black pixels are 0, so or-ing them with 255 is enough
+            const __m128i white = _mm_and_si128( _mm_cmpeq_epi32( _mm_and_si128( source, colorMask ), _mm_setzero_si128() ), byteMask );
+            r = _mm_or_si128( r, white );
+            g = _mm_or_si128( g, white );
+            b = _mm_or_si128( b, white );
+        }
+        r = truncatingDiv255Sse2( mul16Sse2( r, redVector ) );
+        g = truncatingDiv255Sse2( mul16Sse2( g, greenVector ) );
+        b = truncatingDiv255Sse2( mul16Sse2( b, blueVector ) );
+        _mm_storeu_si128( (__m128i *)( data + i ),
+                          _mm_or_si128( _mm_or_si128( opaque, _mm_slli_epi32( r, 16 ) ),
+                                        _mm_or_si128( _mm_slli_epi32( g, 8 ), b ) ) );
+    }
+    multiplyScalar( data + i, pixels - i, red, green, blue, blackAsWhite );
+}
+
+static void blackWhiteSse2( unsigned int * data, int pixels, const unsigned int * table )
+{
+    const __m128i byteMask = _mm_set1_epi32( 0xff ),
+                  redWeight = _mm_set1_epi32( 11 ),
+                  blueWeight = _mm_set1_epi32( 5 );
+    unsigned int grays[4];
+    int i = 0;
+    for ( ; i + 4 <= pixels; i += 4 )
+    {
+        const __m128i source = _mm_loadu_si128( (const __m128i *)( data + i ) );
+        const __m128i r = _mm_and_si128( _mm_srli_epi32( source, 16 ), byteMask ),
+                      g = _mm_and_si128( _mm_srli_epi32( source, 8 ), byteMask ),
+                      b = _mm_and_si128( source, byteMask );
+        const __m128i gray = _mm_srli_epi32( _mm_add_epi32( _mm_add_epi32( mul16Sse2( r, redWeight ), _mm_slli_epi32( g, 4 ) ),
+                                                            mul16Sse2( b, blueWeight ) ), 5 );
+        _mm_storeu_si128( (__m128i *)grays, gray );
+        data[i] = table[ grays[0] ];
+        data[i + 1] = table[ grays[1] ];
+        data[i + 2] = table[ grays[2] ];
+        data[i + 3] = table[ grays[3] ];
+    }
+    blackWhiteScalar( data + i, pixels - i, table );
+}
+
+#endif
+
+/** AVX2 implementation **/
+
+#if defined(OKULAR_KERNELS_AVX2)
+
+#define OKULAR_AVX2 __attribute__(( target( "avx2" ) ))
+
+OKULAR_AVX2 static inline __m256i mul16Avx2( __m256i a, __m256i b )
+{
+    return _mm256_mullo_epi16( a, b );
+}
+
+OKULAR_AVX2 static inline __m256i div255Avx2( __m256i x )
+{
+    return _mm256_srli_epi32( _mm256_add_epi32( _mm256_add_epi32( x, _mm256_srli_epi32( x, 8 ) ), _mm256_set1_epi32( 0x80 ) ), 8 );
+}
+
+OKULAR_AVX2 static inline __m256i truncatingDiv255Avx2( __m256i x )
+{
+    return _mm256_srli_epi32( _mm256_add_epi32( _mm256_add_epi32( x, _mm256_set1_epi32( 1 ) ), _mm256_srli_epi32( x, 8 ) ), 8 );
+}
+
+OKULAR_AVX2 static void changeAlphaAvx2( unsigned int * data, int pixels, unsigned int alpha )
+{
+    const __m256i alphaVector = _mm256_set1_epi32( alpha );
+    const __m256i colorMask = _mm256_set1_epi32( 0x00ffffff );
+    int i = 0;
+    for ( ; i + 8 <= pixels; i += 8 )
+    {
+        const __m256i source = _mm256_loadu_si256( (const __m256i *)( data + i ) );
+        const __m256i newAlpha = div255Avx2( mul16Avx2( _mm256_srli_epi32( source, 24 ), alphaVector ) );
+        _mm256_storeu_si256( (__m256i *)( data + i ),
+                             _mm256_or_si256( _mm256_and_si256( source, colorMask ), _mm256_slli_epi32( newAlpha, 24 ) ) );
+    }
+    changeAlphaScalar( data + i, pixels - i, alpha );
+}
+
+OKULAR_AVX2 static void colorizeAvx2( unsigned int * data, int pixels, int red, int green, int blue, unsigned int alpha )
+{
+    const __m256i redVector = _mm256_set1_epi32( red ),
+                  greenVector = _mm256_set1_epi32( green ),
+                  blueVector = _mm256_set1_epi32( blue ),
+                  alphaVector = _mm256_set1_epi32( alpha ),
+                  byteMask = _mm256_set1_epi32( 0xff );
+    int i = 0;
+    for ( ; i + 8 <= pixels; i += 8 )
+    {
+        const __m256i source = _mm256_loadu_si256( (const __m256i *)( data + i ) );
+        const __m256i sat = _mm256_and_si256( _mm256_srli_epi32( source, 16 ), byteMask );
+        const __m256i newAlpha = div255Avx2( mul16Avx2( _mm256_srli_epi32( source, 24 ), alphaVector ) );
+        const __m256i r = div255Avx2( mul16Avx2( sat, redVector ) ),
+                      g = div255Avx2( mul16Avx2( sat, greenVector ) ),
+                      b = div255Avx2( mul16Avx2( sat, blueVector ) );
+        _mm256_storeu_si256( (__m256i *)( data + i ),
+                             _mm256_or_si256( _mm256_or_si256( _mm256_slli_epi32( newAlpha, 24 ), _mm256_slli_epi32( r, 16 ) ),
+                                              _mm256_or_si256( _mm256_slli_epi32( g, 8 ), b ) ) );
+    }
+    colorizeScalar( data + i, pixels - i, red, green, blue, alpha );
+}
+
+OKULAR_AVX2 static void multiplyAvx2( unsigned int * data, int pixels, int red, int green, int blue, bool blackAsWhite )
+{
+    const __m256i redVector = _mm256_set1_epi32( red ),
+                  greenVector = _mm256_set1_epi32( green ),
+                  blueVector = _mm256_set1_epi32( blue ),
+                  byteMask = _mm256_set1_epi32( 0xff ),
+                  colorMask = _mm256_set1_epi32( 0x00ffffff ),
+                  opaque = _mm256_set1_epi32( (int)0xff000000 );
+    int i = 0;
+    for ( ; i + 8 <= pixels; i += 8 )
+    {
+        const __m256i source = _mm256_loadu_si256( (const __m256i *)( data + i ) );
+        __m256i r = _mm256_and_si256( _mm256_srli_epi32( source, 16 ), byteMask ),
+                g = _mm256_and_si256( _mm256_srli_epi32( source, 8 ), byteMask ),
+                b = _mm256_and_si256( source, byteMask );
+        if ( blackAsWhite )
+        {
+            const __m256i white = _mm256_and_si256( _mm256_cmpeq_epi32( _mm256_and_si256( source, colorMask ), _mm256_setzero_si256() ), byteMask );
+            r = _mm256_or_si256( r, white );
+            g = _mm256_or_si256( g, white );
+            b = _mm256_or_si256( b, white );
+        }
+        r = truncatingDiv255Avx2( mul16Avx2( r, redVector ) );
+        g = truncatingDiv255Avx2( mul16Avx2( g, greenVector ) );
+        b = truncatingDiv255Avx2( mul16Avx2( b, blueVector ) );
+        _mm256_storeu_si256( (__m256i *)( data + i ),
+                             _mm256_or_si256( _mm256_or_si256( opaque, _mm256_slli_epi32( r, 16 ) ),
+                                              _mm256_or_si256( _mm256_slli_epi32( g, 8 ), b ) ) );
+    }
+    multiplyScalar( data + i, pixels - i, red, green, blue, blackAsWhite );
+}
+
+OKULAR_AVX2 static void blackWhiteAvx2( unsigned int * data, int pixels, const unsigned int * table )
+{
+    const __m256i byteMask = _mm256_set1_epi32( 0xff ),
+                  redWeight = _mm256_set1_epi32( 11 ),
+                  blueWeight = _mm256_set1_epi32( 5 );
+    int i = 0;
+    for ( ; i + 8 <= pixels; i += 8 )
+    {
+        const __m256i source = _mm256_loadu_si256( (const __m256i *)( data + i ) );
+        const __m256i r = _mm256_and_si256( _mm256_srli_epi32( source, 16 ), byteMask ),
+                      g = _mm256_and_si256( _mm256_srli_epi32( source, 8 ), byteMask ),
+                      b = _mm256_and_si256( source, byteMask );
+        const __m256i gray = _mm256_srli_epi32( _mm256_add_epi32( _mm256_add_epi32( mul16Avx2( r, redWeight ), _mm256_slli_epi32( g, 4 ) ),
+                                                                  mul16Avx2( b, blueWeight ) ), 5 );
+        // AVX2 can look up the table by itself
+        _mm256_storeu_si256( (__m256i *)( data + i ), _mm256_i32gather_epi32( (const int *)table, gray, 4 ) );
+    }
+    blackWhiteScalar( data + i, pixels - i, table );
+}
+
+#endif
+
+/** NEON implementation **/
+
+#if defined(OKULAR_KERNELS_NEON)
+
+static inline uint32x4_t div255Neon( uint32x4_t x )
+{
+    return vshrq_n_u32( vaddq_u32( vaddq_u32( x, vshrq_n_u32( x, 8 ) ), vdupq_n_u32( 0x80 ) ), 8 );
+}
+
+static inline uint32x4_t truncatingDiv255Neon( uint32x4_t x )
+{
+    return vshrq_n_u32( vaddq_u32( vaddq_u32( x, vdupq_n_u32( 1 ) ), vshrq_n_u32( x, 8 ) ), 8 );
+}
+
+static void changeAlphaNeon( unsigned int * data, int pixels, unsigned int alpha )
+{
+    const uint32x4_t alphaVector = vdupq_n_u32( alpha );
+    const uint32x4_t colorMask = vdupq_n_u32( 0x00ffffff );
+    int i = 0;
+    for ( ; i + 4 <= pixels; i += 4 )
+    {
+        const uint32x4_t source = vld1q_u32( data + i );
+        const uint32x4_t newAlpha = div255Neon( vmulq_u32( vshrq_n_u32( source, 24 ), alphaVector ) );
+        vst1q_u32( data + i, vorrq_u32( vandq_u32( source, colorMask ), vshlq_n_u32( newAlpha, 24 ) ) );
+    }
+    changeAlphaScalar( data + i, pixels - i, alpha );
+}
+
+static void colorizeNeon( unsigned int * data, int pixels, int red, int green, int blue, unsigned int alpha )
+{
+    const uint32x4_t redVector = vdupq_n_u32( red ),
+                     greenVector = vdupq_n_u32( green ),
+                     blueVector = vdupq_n_u32( blue ),
+                     alphaVector = vdupq_n_u32( alpha ),
+                     byteMask = vdupq_n_u32( 0xff );
+    int i = 0;
+    for ( ; i + 4 <= pixels; i += 4 )
+    {
+        const uint32x4_t source = vld1q_u32( data + i );
+        const uint32x4_t sat = vandq_u32( vshrq_n_u32( source, 16 ), byteMask );
+        const uint32x4_t newAlpha = div255Neon( vmulq_u32( vshrq_n_u32( source, 24 ), alphaVector ) );
+        const uint32x4_t r = div255Neon( vmulq_u32( sat, redVector ) ),
+                         g = div255Neon( vmulq_u32( sat, greenVector ) ),
+                         b = div255Neon( vmulq_u32( sat, blueVector ) );
+        vst1q_u32( data + i, vorrq_u32( vorrq_u32( vshlq_n_u32( newAlpha, 24 ), vshlq_n_u32( r, 16 ) ),
+                                        vorrq_u32( vshlq_n_u32( g, 8 ), b ) ) );
+    }
+    colorizeScalar( data + i, pixels - i, red, green, blue, alpha );
+}
+
+static void multiplyNeon( unsigned int * data, int pixels, int red, int green, int blue, bool blackAsWhite )
+{
+    const uint32x4_t redVector = vdupq_n_u32( red ),
+                     greenVector = vdupq_n_u32( green ),
+                     blueVector = vdupq_n_u32( blue ),
+                     byteMask = vdupq_n_u32( 0xff ),
+                     colorMask = vdupq_n_u32( 0x00ffffff ),
+                     opaque = vdupq_n_u32( 0xff000000 );
+    int i = 0;
+    for ( ; i + 4 <= pixels; i += 4 )
+    {
+        const uint32x4_t source = vld1q_u32( data + i );
+        uint32x4_t r = vandq_u32( vshrq_n_u32( source, 16 ), byteMask ),
+                   g = vandq_u32( vshrq_n_u32( source, 8 ), byteMask ),
+                   b = vandq_u32( source, byteMask );
+        if ( blackAsWhite )
+        {
+            const uint32x4_t white = vandq_u32( vceqq_u32( vandq_u32( source, colorMask ), vdupq_n_u32( 0 ) ), byteMask );
+            r = vorrq_u32( r, white );
+            g = vorrq_u32( g, white );
+            b = vorrq_u32( b, white );
+        }
+        r = truncatingDiv255Neon( vmulq_u32( r, redVector ) );
+        g = truncatingDiv255Neon( vmulq_u32( g, greenVector ) );
+        b = truncatingDiv255Neon( vmulq_u32( b, blueVector ) );
+        vst1q_u32( data + i, vorrq_u32( vorrq_u32( opaque, vshlq_n_u32( r, 16 ) ),
+                                        vorrq_u32( vshlq_n_u32( g, 8 ), b ) ) );
+    }
+    multiplyScalar( data + i, pixels - i, red, green, blue, blackAsWhite );
+}
+
+static void blackWhiteNeon( unsigned int * data, int pixels, const unsigned int * table )
+{
+    const uint32x4_t byteMask = vdupq_n_u32( 0xff );
+    unsigned int grays[4];
+    int i = 0;
+    for ( ; i + 4 <= pixels; i += 4 )
+    {
+        const uint32x4_t source = vld1q_u32( data + i );
+        const uint32x4_t r = vandq_u32( vshrq_n_u32( source, 16 ), byteMask ),
+                         g = vandq_u32( vshrq_n_u32( source, 8 ), byteMask ),
+                         b = vandq_u32( source, byteMask );
+        const uint32x4_t gray = vshrq_n_u32( vmlaq_n_u32( vmlaq_n_u32( vshlq_n_u32( g, 4 ), r, 11 ), b, 5 ), 5 );
+        vst1q_u32( grays, gray );
+        data[i] = table[ grays[0] ];
+        data[i + 1] = table[ grays[1] ];
+        data[i + 2] = table[ grays[2] ];
+        data[i + 3] = table[ grays[3] ];
+    }
+    blackWhiteScalar( data + i, pixels - i, table );
+}
+
+#endif
+
+/** Dispatching **/
+
+namespace
+{
+
+struct Kernels
+{
+    PixelKernels::Implementation implementation;
+    void ( *changeAlpha )( unsigned int *, int, unsigned int );
+    void ( *colorize )( unsigned int *, int, int, int, int, unsigned int );
+    void ( *multiply )( unsigned int *, int, int, int, int, bool );
+    void ( *blackWhite )( unsigned int *, int, const unsigned int * );
+};
+
+const Kernels scalarKernels = { PixelKernels::Scalar, changeAlphaScalar, colorizeScalar, multiplyScalar, blackWhiteScalar };
+#if defined(OKULAR_KERNELS_SSE2)
+const Kernels sse2Kernels = { PixelKernels::SSE2, changeAlphaSse2, colorizeSse2, multiplySse2, blackWhiteSse2 };
+#endif
+#if defined(OKULAR_KERNELS_AVX2)
+const Kernels avx2Kernels = { PixelKernels::AVX2, changeAlphaAvx2, colorizeAvx2, multiplyAvx2, blackWhiteAvx2 };
+#endif
+#if defined(OKULAR_KERNELS_NEON)
+const Kernels neonKernels = { PixelKernels::NEON, changeAlphaNeon, colorizeNeon, multiplyNeon, blackWhiteNeon };
+#endif
+
+const Kernels * kernelsFor( PixelKernels::Implementation implementation )
+{
+    if ( !PixelKernels::isAvailable( implementation ) )
+        return 0;
+
+    switch ( implementation )
+    {
+        case PixelKernels::Scalar:
+            return &scalarKernels;
+#if defined(OKULAR_KERNELS_SSE2)
+        case PixelKernels::SSE2:
+            return &sse2Kernels;
+#endif
+#if defined(OKULAR_KERNELS_AVX2)
+        case PixelKernels::AVX2:
+            return &avx2Kernels;
+#endif
+#if defined(OKULAR_KERNELS_NEON)
+        case PixelKernels::NEON:
+            return &neonKernels;
+#endif
+        default: ;
+    }
+    return 0;
+}
+
+// the kernels in use, the best ones available unless others are forced; the
+// kernels are called from the painting and the recoloring threads
+class CurrentKernels
+{
+    public:
+        CurrentKernels()
+        {
+            const PixelKernels::Implementation implementations[] = { PixelKernels::AVX2, PixelKernels::SSE2, PixelKernels::NEON, PixelKernels::Scalar };
+            const Kernels * best = 0;
+            for ( unsigned int i = 0; !best; ++i )
+                best = kernelsFor( implementations[i] );
+            kernels = best;
+        }
+
+        QAtomicPointer< const Kernels > kernels;
+};
+
+K_GLOBAL_STATIC( CurrentKernels, s_currentKernels )
+
+inline const Kernels * currentKernels()
+{
+    return s_currentKernels->kernels;
+}
+
+}
+
+bool PixelKernels::isAvailable( Implementation implementation )
+{
+    switch ( implementation )
+    {
+        case Scalar:
+            return true;
+        case SSE2:
+#if defined(OKULAR_KERNELS_SSE2)
+            // built only when the compiler targets SSE2 already
+            return true;
+#else
+            return false;
+#endif
+        case AVX2:
+#if defined(OKULAR_KERNELS_AVX2)
+            __builtin_cpu_init();
+            return __builtin_cpu_supports( "avx2" );
+#else
+            return false;
+#endif
+        case NEON:
+#if defined(OKULAR_KERNELS_NEON)
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+PixelKernels::Implementation PixelKernels::implementation()
+{
+    return currentKernels()->implementation;
+}
+
+void PixelKernels::setImplementation( Implementation implementation )
+{
+    const Kernels * newKernels = kernelsFor( implementation );
+    if ( !newKernels )
+        return;
+
+    s_currentKernels->kernels.fetchAndStoreOrdered( newKernels );
+}
+
+void PixelKernels::changeAlpha( unsigned int * data, int pixels, unsigned int alpha )
+{
+    currentKernels()->changeAlpha( data, pixels, alpha );
+}
+
+void PixelKernels::colorize( unsigned int * data, int pixels, int red, int green, int blue, unsigned int alpha )
+{
+    currentKernels()->colorize( data, pixels, red, green, blue, alpha );
+}
+
+void PixelKernels::multiply( unsigned int * data, int pixels, int red, int green, int blue, bool blackAsWhite )
+{
+    currentKernels()->multiply( data, pixels, red, green, blue, blackAsWhite );
+}
+
+void PixelKernels::blackWhite( unsigned int * data, int pixels, int contrast, int threshold )
+{
+    unsigned int table[256];
+    blackWhiteTable( table, contrast, threshold );
+    currentKernels()->blackWhite( data, pixels, table );
+}
@@ -0,0 +1,50 @@
+/***************************************************************************
+ *   Copyright (C) 2012 by Okular developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef _OKULAR_PIXELKERNELS_H_
+#define _OKULAR_PIXELKERNELS_H_
+
+/**
+ * @short The per-pixel loops of PagePainter, over 32 bit (A)RGB pixels.
+ *
+ * Each kernel has a scalar implementation and, depending on the compiler and
+ * on the CPU, vectorized ones; the fastest one available is used, unless
+ * another one is forced with setImplementation(). All the implementations
+ * give exactly the same results.
+ */
+namespace PixelKernels
+{
+    enum Implementation { Scalar, SSE2, AVX2, NEON };
+
+    // whether 'implementation' was built in and is supported by the CPU
+    bool isAvailable( Implementation implementation );
+
+    // the implementation in use
+    Implementation implementation();
+
+    // use 'implementation' from now on (if available; mainly for testing)
+    void setImplementation( Implementation implementation );
+
+    // multiply the alpha component of the pixels by 'alpha'
+    void changeAlpha( unsigned int * data, int pixels, unsigned int alpha );
+
+    // replace the pixels of a gray image with 'red', 'green', 'blue' scaled by
+    // their gray level, multiplying their alpha component by 'alpha'
+    void colorize( unsigned int * data, int pixels, int red, int green, int blue, unsigned int alpha );
+
+    // multiply the color of the pixels by 'red', 'green', 'blue', making them
+    // opaque; if 'blackAsWhite' black pixels are multiplied as white ones
+    void multiply( unsigned int * data, int pixels, int red, int green, int blue, bool blackAsWhite );
+
+    // turn the pixels into opaque gray ones, remapping their gray level
+    // around 'threshold' and stretching it by 'contrast'
+    void blackWhite( unsigned int * data, int pixels, int contrast, int threshold );
+}
+
+#endif
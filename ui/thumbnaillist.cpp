@@ -354,6 +354,8 @@ void ThumbnailList::notifyPageChanged( int pageNumber, int changedFlags )
     for ( ; vIt != vEnd; ++vIt )
         if ( (*vIt)->pageNumber() == pageNumber )
         {
+            if ( changedFlags & DocumentObserver::Pixmap )
+                PagePainter::recolorPagePixmap( (*vIt)->page(), THUMBNAILS_ID );
             (*vIt)->update();
             break;
         }